@@ -0,0 +1,363 @@
+#include "Aggregation.h"
+
+#include "bvh2.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+void RunningStats::add(double value)
+{
+  if (count == 0)
+  {
+    minimum = value;
+    maximum = value;
+  }
+  else
+  {
+    minimum = std::min(minimum, value);
+    maximum = std::max(maximum, value);
+  }
+
+  count++;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+}
+
+void RunningStats::merge(const RunningStats& other)
+{
+  if (other.count == 0)
+    return;
+  if (count == 0)
+  {
+    *this = other;
+    return;
+  }
+
+  unsigned long long total = count + other.count;
+  double delta = other.mean - mean;
+  mean += delta * other.count / total;
+  m2 += other.m2 + delta * delta * ((double)count * other.count / total);
+  minimum = std::min(minimum, other.minimum);
+  maximum = std::max(maximum, other.maximum);
+  count = total;
+}
+
+QuantileSketch::QuantileSketch(double relativeAccuracy, unsigned int maxBuckets)
+  :
+  gamma((1.0 + relativeAccuracy) / (1.0 - relativeAccuracy)),
+  logGamma(std::log(gamma)),
+  maxBuckets(maxBuckets)
+{
+}
+
+int QuantileSketch::bucketIndex(double value) const
+{
+  return (int)std::ceil(std::log(value) / logGamma);
+}
+
+double QuantileSketch::bucketValue(int index) const
+{
+  return 2.0 * std::pow(gamma, index) / (gamma + 1.0);
+}
+
+// the smallest magnitudes lose their resolution first
+void QuantileSketch::collapse(std::map<int, unsigned long long>& buckets)
+{
+  while (buckets.size() > maxBuckets)
+  {
+    auto first = buckets.begin();
+    auto second = std::next(first);
+    second->second += first->second;
+    buckets.erase(first);
+  }
+}
+
+void QuantileSketch::add(double value)
+{
+  count++;
+  if (value > 1e-9)
+  {
+    positive[bucketIndex(value)]++;
+    collapse(positive);
+  }
+  else if (value < -1e-9)
+  {
+    negative[bucketIndex(-value)]++;
+    collapse(negative);
+  }
+  else
+  {
+    zeroCount++;
+  }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+  count += other.count;
+  zeroCount += other.zeroCount;
+  for (const auto& bucket : other.positive)
+    positive[bucket.first] += bucket.second;
+  for (const auto& bucket : other.negative)
+    negative[bucket.first] += bucket.second;
+  collapse(positive);
+  collapse(negative);
+}
+
+double QuantileSketch::quantile(double q) const
+{
+  if (count == 0)
+    return 0.0;
+
+  unsigned long long rank = (unsigned long long)(glm::clamp(q, 0.0, 1.0) * (count - 1));
+  unsigned long long seen = 0;
+
+  // negative values from the largest magnitude down
+  for (auto it = negative.rbegin(); it != negative.rend(); ++it)
+  {
+    seen += it->second;
+    if (seen > rank)
+      return -bucketValue(it->first);
+  }
+
+  seen += zeroCount;
+  if (seen > rank)
+    return 0.0;
+
+  for (const auto& bucket : positive)
+  {
+    seen += bucket.second;
+    if (seen > rank)
+      return bucketValue(bucket.first);
+  }
+
+  return positive.empty() ? 0.0 : bucketValue(positive.rbegin()->first);
+}
+
+void GroupSummary::merge(const ClipSummary& clip)
+{
+  numClips++;
+  numFrames += clip.numFrames;
+  comHeight.merge(clip.comHeight);
+  comSpeed.merge(clip.comSpeed);
+  comHeightSketch.merge(clip.comHeightSketch);
+  comSpeedSketch.merge(clip.comSpeedSketch);
+  for (int axis = 0; axis < 3; axis++)
+    excursion[axis].add(clip.excursion[axis]);
+  peakSpeed.add(clip.peakSpeed);
+}
+
+void GroupSummary::merge(const GroupSummary& other)
+{
+  numClips += other.numClips;
+  numFrames += other.numFrames;
+  comHeight.merge(other.comHeight);
+  comSpeed.merge(other.comSpeed);
+  comHeightSketch.merge(other.comHeightSketch);
+  comSpeedSketch.merge(other.comSpeedSketch);
+  for (int axis = 0; axis < 3; axis++)
+    excursion[axis].merge(other.excursion[axis]);
+  peakSpeed.merge(other.peakSpeed);
+}
+
+static std::string trimmed(const std::string& s)
+{
+  size_t first = s.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos)
+    return "";
+  size_t last = s.find_last_not_of(" \t\r\n");
+  return s.substr(first, last - first + 1);
+}
+
+bool readClipManifest(const std::string& filename, std::vector<ClipEntry>& clips)
+{
+  std::ifstream file(filename.c_str());
+  if (!file.is_open())
+  {
+    std::cout << "Failed to open clip manifest " << filename << std::endl;
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    line = trimmed(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ','))
+      fields.push_back(trimmed(field));
+
+    ClipEntry clip;
+    clip.path = fields[0];
+
+    // .../subject/condition/clip.bvh
+    std::string path = clip.path;
+    std::replace(path.begin(), path.end(), '\\', '/');
+    size_t conditionEnd = path.find_last_of('/');
+    size_t subjectEnd = conditionEnd == std::string::npos || conditionEnd == 0 ? std::string::npos : path.find_last_of('/', conditionEnd - 1);
+    size_t subjectBegin = subjectEnd == std::string::npos || subjectEnd == 0 ? std::string::npos : path.find_last_of('/', subjectEnd - 1);
+    if (subjectEnd != std::string::npos)
+    {
+      clip.condition = path.substr(subjectEnd + 1, conditionEnd - subjectEnd - 1);
+      size_t begin = subjectBegin == std::string::npos ? 0 : subjectBegin + 1;
+      clip.subject = path.substr(begin, subjectEnd - begin);
+    }
+
+    if (fields.size() > 1 && !fields[1].empty())
+      clip.subject = fields[1];
+    if (fields.size() > 2 && !fields[2].empty())
+      clip.condition = fields[2];
+    if (fields.size() > 3 && !fields[3].empty())
+      clip.sex = (fields[3][0] == 'f' || fields[3][0] == 'F') ? 1 : 0;
+
+    clips.push_back(clip);
+  }
+  return true;
+}
+
+void summarizeClip(const ClipTrajectory& trajectory, ClipSummary& summary)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+
+  summary.numFrames = numFrames;
+  if (numFrames == 0)
+    return;
+
+  glm::vec3 minimum(trajectory.bodyCOM[0]), maximum(trajectory.bodyCOM[0]);
+  for (unsigned int frame = 0; frame < numFrames; frame++)
+  {
+    glm::vec3 com(trajectory.bodyCOM[frame]);
+    minimum = glm::min(minimum, com);
+    maximum = glm::max(maximum, com);
+    summary.comHeight.add(com.y);
+    summary.comHeightSketch.add(com.y);
+
+    if (numFrames > 1)
+    {
+      unsigned int previous = frame > 0 ? frame - 1 : frame;
+      unsigned int next = frame + 1 < numFrames ? frame + 1 : frame;
+      glm::vec3 velocity = glm::vec3(trajectory.bodyCOM[next] - trajectory.bodyCOM[previous]) / ((next - previous) * dt);
+      float speed = glm::length(velocity);
+      summary.comSpeed.add(speed);
+      summary.comSpeedSketch.add(speed);
+      summary.peakSpeed = std::max(summary.peakSpeed, speed);
+    }
+  }
+
+  for (int axis = 0; axis < 3; axis++)
+    summary.excursion[axis] = maximum[axis] - minimum[axis];
+}
+
+bool loadManifestClip(const ClipEntry& clip, int model, Bvh2& bvh, ClipTrajectory& trajectory)
+{
+  bvh.load(clip.path);
+  if (bvh.getRootJoint() == nullptr || bvh.getMotion().numFrames == 0)
+    return false;
+  if (model != ManifestJointsOnly && bvh.getNumJoints() < MinBodyModelJoints)
+    return false;
+
+  bakeJoints(bvh, trajectory);
+  if (model != ManifestJointsOnly)
+    bakeModelCOM(model == CustomModel ? ZatsiorskyDeLevaModel : (AnthropometricModel)model, clip.sex, trajectory);
+  return true;
+}
+
+unsigned int aggregateClips(const std::vector<ClipEntry>& clips, const AggregationSettings& settings,
+                            std::map<std::string, GroupSummary>& groups)
+{
+  unsigned int numWorkers = settings.numWorkers > 0 ? settings.numWorkers : std::max(1u, std::thread::hardware_concurrency());
+  numWorkers = std::min(numWorkers, std::max(1u, (unsigned int)clips.size()));
+
+  std::atomic<unsigned int> nextClip(0);
+  std::atomic<unsigned int> failures(0);
+  std::vector<std::map<std::string, GroupSummary>> workerGroups(numWorkers);
+
+  auto worker = [&](unsigned int w)
+  {
+    parallelWorker() = true;
+    std::map<std::string, GroupSummary>& local = workerGroups[w];
+
+    for (unsigned int i = nextClip++; i < clips.size(); i = nextClip++)
+    {
+      const ClipEntry& clip = clips[i];
+      ClipSummary summary;
+      {
+        // the frames of the clip only live in this scope
+        Bvh2 bvh;
+        ClipTrajectory trajectory;
+        if (!loadManifestClip(clip, settings.model, bvh, trajectory))
+        {
+          std::cout << "Skipping " << clip.path << std::endl;
+          failures++;
+          continue;
+        }
+        summarizeClip(trajectory, summary);
+      }
+
+      GroupSummary& group = local[clip.subject + "/" + clip.condition];
+      group.subject = clip.subject;
+      group.condition = clip.condition;
+      group.merge(summary);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int w = 1; w < numWorkers; w++)
+    threads.emplace_back(worker, w);
+  worker(0);
+  parallelWorker() = false;
+  for (auto& thread : threads)
+    thread.join();
+
+  for (const auto& local : workerGroups)
+  {
+    for (const auto& entry : local)
+    {
+      GroupSummary& group = groups[entry.first];
+      group.subject = entry.second.subject;
+      group.condition = entry.second.condition;
+      group.merge(entry.second);
+    }
+  }
+
+  return failures;
+}
+
+// the sketch answers within its relative accuracy, keep it inside the exact range
+static double quantile(const QuantileSketch& sketch, const RunningStats& stats, double q)
+{
+  return glm::clamp(sketch.quantile(q), stats.minimum, stats.maximum);
+}
+
+void writeGroupTable(const std::map<std::string, GroupSummary>& groups, std::ostream& stream)
+{
+  stream << "subject,condition,clips,frames,"
+         << "com_height_mean,com_height_sd,com_height_min,com_height_max,com_height_p05,com_height_p50,com_height_p95,"
+         << "com_speed_mean,com_speed_sd,com_speed_p50,com_speed_p95,com_speed_max,"
+         << "excursion_x_mean,excursion_y_mean,excursion_z_mean,peak_speed_mean,peak_speed_sd" << std::endl;
+
+  for (const auto& entry : groups)
+  {
+    const GroupSummary& g = entry.second;
+    stream << g.subject << "," << g.condition << "," << g.numClips << "," << g.numFrames << ","
+           << g.comHeight.mean << "," << std::sqrt(g.comHeight.variance()) << ","
+           << g.comHeight.minimum << "," << g.comHeight.maximum << ","
+           << quantile(g.comHeightSketch, g.comHeight, 0.05) << "," << quantile(g.comHeightSketch, g.comHeight, 0.5) << ","
+           << quantile(g.comHeightSketch, g.comHeight, 0.95) << ","
+           << g.comSpeed.mean << "," << std::sqrt(g.comSpeed.variance()) << ","
+           << quantile(g.comSpeedSketch, g.comSpeed, 0.5) << "," << quantile(g.comSpeedSketch, g.comSpeed, 0.95) << "," << g.comSpeed.maximum << ","
+           << g.excursion[0].mean << "," << g.excursion[1].mean << "," << g.excursion[2].mean << ","
+           << g.peakSpeed.mean << "," << std::sqrt(g.peakSpeed.variance()) << std::endl;
+  }
+}
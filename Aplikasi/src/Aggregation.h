@@ -0,0 +1,121 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "AnthropometricModels.h"
+
+class Bvh2;
+
+// Welford running mean and variance, merged with Chan's formula
+struct RunningStats
+{
+  unsigned long long count = 0;
+  double mean = 0.0;
+  double m2 = 0.0;
+  double minimum = 0.0;
+  double maximum = 0.0;
+
+  void add(double value);
+  void merge(const RunningStats& other);
+  double variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+};
+
+// relative error quantile sketch on logarithmic buckets (DDSketch), merging adds the
+// bucket counts so clips can be summarized independently and combined in any order
+class QuantileSketch
+{
+public:
+  explicit QuantileSketch(double relativeAccuracy = 0.01, unsigned int maxBuckets = 2048);
+
+  void add(double value);
+  void merge(const QuantileSketch& other);
+  double quantile(double q) const;
+  unsigned long long getCount() const { return count; }
+
+private:
+  int bucketIndex(double value) const;
+  double bucketValue(int index) const;
+  void collapse(std::map<int, unsigned long long>& buckets);
+
+private:
+  double gamma;
+  double logGamma;
+  unsigned int maxBuckets;
+  unsigned long long count = 0;
+  unsigned long long zeroCount = 0;
+  std::map<int, unsigned long long> positive;
+  std::map<int, unsigned long long> negative;
+};
+
+// what's left of a clip once its frames are gone
+struct ClipSummary
+{
+  unsigned int numFrames = 0;
+  RunningStats comHeight;
+  RunningStats comSpeed;
+  QuantileSketch comHeightSketch;
+  QuantileSketch comSpeedSketch;
+  float excursion[3] = {}; // max - min of the COM per axis
+  float peakSpeed = 0.0f;
+};
+
+struct GroupSummary
+{
+  std::string subject;
+  std::string condition;
+  unsigned int numClips = 0;
+  unsigned long long numFrames = 0;
+
+  // over all frames of the group
+  RunningStats comHeight;
+  RunningStats comSpeed;
+  QuantileSketch comHeightSketch;
+  QuantileSketch comSpeedSketch;
+
+  // over the clips of the group
+  RunningStats excursion[3];
+  RunningStats peakSpeed;
+
+  void merge(const ClipSummary& clip);
+  void merge(const GroupSummary& other);
+};
+
+struct ClipEntry
+{
+  std::string path;
+  std::string subject;
+  std::string condition;
+  int sex = 0;
+};
+
+struct AggregationSettings
+{
+  int model = ZatsiorskyDeLevaModel;
+  unsigned int numWorkers = 0; // 0 uses every hardware thread
+};
+
+// one clip per line: path[,subject[,condition[,sex]]], sex is m or f, a missing subject and
+// condition are taken from the two parent directories of the path
+bool readClipManifest(const std::string& filename, std::vector<ClipEntry>& clips);
+
+// the model for loadManifestClip to bake only the joints, of any skeleton
+#define ManifestJointsOnly -1
+
+// loads a clip of the manifest and bakes its joints, and the segment and body COM of model with
+// the clip's sex (Custom is taken as Zatsiorsky-de Leva, there are no runtime percents per
+// clip). false when it doesn't load, has no frames or, with a model, too few joints for it
+bool loadManifestClip(const ClipEntry& clip, int model, Bvh2& bvh, ClipTrajectory& trajectory);
+
+// needs bodyCOM baked
+void summarizeClip(const ClipTrajectory& trajectory, ClipSummary& summary);
+
+// streams the clips through a pool of workers, each worker holds one clip at a time and
+// folds its summary into per worker groups that are merged at the end,
+// returns the number of clips that couldn't be loaded
+unsigned int aggregateClips(const std::vector<ClipEntry>& clips, const AggregationSettings& settings,
+                            std::map<std::string, GroupSummary>& groups);
+
+void writeGroupTable(const std::map<std::string, GroupSummary>& groups, std::ostream& stream);
@@ -0,0 +1,132 @@
+#include "AnthropometricModels.h"
+
+#include "ParallelFor.h"
+
+const char* anthropometricModelNames[NumAnthropometricModels] = {
+  "Zatsiorsky - de Leva",
+  "Dempster",
+  "Clauser",
+  "Custom"
+};
+
+constexpr SegmentProperties ZatsiorskyDeLeva::segments[2][NumSegments];
+constexpr SegmentProperties Dempster::segments[2][NumSegments];
+constexpr SegmentProperties Clauser::segments[2][NumSegments];
+
+// weights folded at compile time, the kernel only sees constants
+template <typename Model, int Sex, int S>
+struct SegmentWeights
+{
+  static constexpr float com = Model::segments[Sex][S].comPercent / 100.0f;
+  static constexpr float mass = Model::segments[Sex][S].massPercent / 100.0f;
+  static constexpr int proximal = segmentJoints[S].proximal;
+  static constexpr int distal = segmentJoints[S].distal;
+};
+
+template <typename Model, int Sex, int S>
+struct AccumulateSegments
+{
+  static inline void apply(const glm::vec4* pose, glm::vec4* segmentsCOM, glm::vec3& bodyCOM)
+  {
+    AccumulateSegments<Model, Sex, S - 1>::apply(pose, segmentsCOM, bodyCOM);
+
+    const float com = SegmentWeights<Model, Sex, S - 1>::com;
+    const float mass = SegmentWeights<Model, Sex, S - 1>::mass;
+    const glm::vec4& proximal = pose[SegmentWeights<Model, Sex, S - 1>::proximal];
+    const glm::vec4& distal = pose[SegmentWeights<Model, Sex, S - 1>::distal];
+
+    glm::vec4 segment = proximal + (distal - proximal) * com;
+    segmentsCOM[S - 1] = segment;
+    bodyCOM += glm::vec3(segment) * mass;
+  }
+};
+
+template <typename Model, int Sex>
+struct AccumulateSegments<Model, Sex, 0>
+{
+  static inline void apply(const glm::vec4*, glm::vec4*, glm::vec3&) {}
+};
+
+template <typename Model, int Sex>
+static void bakeCOMKernel(ClipTrajectory& trajectory)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  trajectory.segmentsCOM.resize((size_t)numFrames * NumSegments);
+  trajectory.bodyCOM.resize(numFrames);
+
+  const glm::vec4* joints = trajectory.joints.data();
+  glm::vec4* segments = trajectory.segmentsCOM.data();
+  glm::vec4* body = trajectory.bodyCOM.data();
+
+  parallelFor(0, numFrames, [=](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      glm::vec3 bodyCOM(0.0f);
+      AccumulateSegments<Model, Sex, NumSegments>::apply(joints + (size_t)frame * numJoints,
+                                                          segments + (size_t)frame * NumSegments, bodyCOM);
+      body[frame] = glm::vec4(bodyCOM, 1.0f);
+    }
+  });
+}
+
+template <typename Model>
+static void bakeCOMKernel(int sex, ClipTrajectory& trajectory)
+{
+  if (sex == 0)
+    bakeCOMKernel<Model, 0>(trajectory);
+  else
+    bakeCOMKernel<Model, 1>(trajectory);
+}
+
+const SegmentProperties* modelSegments(AnthropometricModel model, int sex)
+{
+  sex = sex == 0 ? 0 : 1;
+  switch (model)
+  {
+  case ZatsiorskyDeLevaModel:
+    return ZatsiorskyDeLeva::segments[sex];
+  case DempsterModel:
+    return Dempster::segments[sex];
+  case ClauserModel:
+    return Clauser::segments[sex];
+  default:
+    return nullptr;
+  }
+}
+
+BodyParameters modelParameters(AnthropometricModel model, int sex, float totalBodyWeight)
+{
+  BodyParameters parameters = {};
+  parameters.totalBodyWeight = totalBodyWeight;
+
+  const SegmentProperties* segments = modelSegments(model, sex);
+  if (segments == nullptr)
+    return parameters;
+
+  for (int s = 0; s < NumSegments; s++)
+  {
+    parameters.massPercent[s] = segments[s].massPercent;
+    parameters.lengthPercent[s] = segments[s].comPercent;
+  }
+  return parameters;
+}
+
+void bakeModelCOM(AnthropometricModel model, int sex, ClipTrajectory& trajectory)
+{
+  switch (model)
+  {
+  case ZatsiorskyDeLevaModel:
+    bakeCOMKernel<ZatsiorskyDeLeva>(sex, trajectory);
+    break;
+  case DempsterModel:
+    bakeCOMKernel<Dempster>(sex, trajectory);
+    break;
+  case ClauserModel:
+    bakeCOMKernel<Clauser>(sex, trajectory);
+    break;
+  default:
+    break;
+  }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "BodyModel.h"
+
+// percent of body mass, COM location and radius of gyration in percent of the
+// segment length, measured from the first joint in segmentJoints
+struct SegmentProperties
+{
+  float massPercent;
+  float comPercent;
+  float gyrationPercent;
+};
+
+enum AnthropometricModel
+{
+  ZatsiorskyDeLevaModel,
+  DempsterModel,
+  ClauserModel,
+  CustomModel,
+  NumAnthropometricModels
+};
+
+extern const char* anthropometricModelNames[NumAnthropometricModels];
+
+// de Leva 1996 adjustments of Zatsiorsky-Seluyanov, sagittal radii of gyration
+struct ZatsiorskyDeLeva
+{
+  static constexpr SegmentProperties segments[2][NumSegments] = {
+    { // male
+      { 6.94f, 50.02f, 30.3f }, { 43.46f, 43.10f, 32.8f },
+      { 2.71f, 57.72f, 28.5f }, { 2.71f, 57.72f, 28.5f },
+      { 1.62f, 45.74f, 27.6f }, { 1.62f, 45.74f, 27.6f },
+      { 0.61f, 79.00f, 62.8f }, { 0.61f, 79.00f, 62.8f },
+      { 14.16f, 40.95f, 32.9f }, { 14.16f, 40.95f, 32.9f },
+      { 4.33f, 43.95f, 25.1f }, { 4.33f, 43.95f, 25.1f },
+      { 1.37f, 44.15f, 25.7f }, { 1.37f, 44.15f, 25.7f }
+    },
+    { // female
+      { 6.68f, 48.41f, 27.1f }, { 42.58f, 37.82f, 30.7f },
+      { 2.55f, 57.54f, 27.8f }, { 2.55f, 57.54f, 27.8f },
+      { 1.38f, 45.59f, 26.1f }, { 1.38f, 45.59f, 26.1f },
+      { 0.56f, 74.74f, 53.1f }, { 0.56f, 74.74f, 53.1f },
+      { 14.78f, 36.12f, 36.9f }, { 14.78f, 36.12f, 36.9f },
+      { 4.81f, 43.52f, 27.1f }, { 4.81f, 43.52f, 27.1f },
+      { 1.29f, 40.14f, 29.9f }, { 1.29f, 40.14f, 29.9f }
+    }
+  };
+};
+
+// Dempster 1955 as tabulated by Winter, one table for both sexes, the trunk has no
+// published radius of gyration so de Leva's male value is used
+struct Dempster
+{
+  static constexpr SegmentProperties segments[2][NumSegments] = {
+    {
+      { 8.10f, 100.0f, 49.5f }, { 49.70f, 50.00f, 32.8f },
+      { 2.80f, 43.60f, 32.2f }, { 2.80f, 43.60f, 32.2f },
+      { 1.60f, 43.00f, 30.3f }, { 1.60f, 43.00f, 30.3f },
+      { 0.60f, 50.60f, 29.7f }, { 0.60f, 50.60f, 29.7f },
+      { 10.00f, 43.30f, 32.3f }, { 10.00f, 43.30f, 32.3f },
+      { 4.65f, 43.30f, 30.2f }, { 4.65f, 43.30f, 30.2f },
+      { 1.45f, 50.00f, 47.5f }, { 1.45f, 50.00f, 47.5f }
+    },
+    {
+      { 8.10f, 100.0f, 49.5f }, { 49.70f, 50.00f, 32.8f },
+      { 2.80f, 43.60f, 32.2f }, { 2.80f, 43.60f, 32.2f },
+      { 1.60f, 43.00f, 30.3f }, { 1.60f, 43.00f, 30.3f },
+      { 0.60f, 50.60f, 29.7f }, { 0.60f, 50.60f, 29.7f },
+      { 10.00f, 43.30f, 32.3f }, { 10.00f, 43.30f, 32.3f },
+      { 4.65f, 43.30f, 30.2f }, { 4.65f, 43.30f, 30.2f },
+      { 1.45f, 50.00f, 47.5f }, { 1.45f, 50.00f, 47.5f }
+    }
+  };
+};
+
+// Clauser, McConville & Young 1969, male cadavers only so both sexes share it,
+// radii of gyration weren't measured and are taken from Dempster
+struct Clauser
+{
+  static constexpr SegmentProperties segments[2][NumSegments] = {
+    {
+      { 7.30f, 46.60f, 49.5f }, { 50.70f, 38.00f, 32.8f },
+      { 2.60f, 51.30f, 32.2f }, { 2.60f, 51.30f, 32.2f },
+      { 1.60f, 39.00f, 30.3f }, { 1.60f, 39.00f, 30.3f },
+      { 0.70f, 48.00f, 29.7f }, { 0.70f, 48.00f, 29.7f },
+      { 10.30f, 37.20f, 32.3f }, { 10.30f, 37.20f, 32.3f },
+      { 4.30f, 37.10f, 30.2f }, { 4.30f, 37.10f, 30.2f },
+      { 1.50f, 44.90f, 47.5f }, { 1.50f, 44.90f, 47.5f }
+    },
+    {
+      { 7.30f, 46.60f, 49.5f }, { 50.70f, 38.00f, 32.8f },
+      { 2.60f, 51.30f, 32.2f }, { 2.60f, 51.30f, 32.2f },
+      { 1.60f, 39.00f, 30.3f }, { 1.60f, 39.00f, 30.3f },
+      { 0.70f, 48.00f, 29.7f }, { 0.70f, 48.00f, 29.7f },
+      { 10.30f, 37.20f, 32.3f }, { 10.30f, 37.20f, 32.3f },
+      { 4.30f, 37.10f, 30.2f }, { 4.30f, 37.10f, 30.2f },
+      { 1.50f, 44.90f, 47.5f }, { 1.50f, 44.90f, 47.5f }
+    }
+  };
+};
+
+// table of a compiled model, nullptr for CustomModel
+const SegmentProperties* modelSegments(AnthropometricModel model, int sex);
+
+// mass and COM percents of a compiled model as runtime parameters, for the dynamics
+BodyParameters modelParameters(AnthropometricModel model, int sex, float totalBodyWeight);
+
+// segment and body COM of the whole clip with the COM kernel specialized for the model,
+// CustomModel isn't compiled in, use bakeCOM for it
+void bakeModelCOM(AnthropometricModel model, int sex, ClipTrajectory& trajectory);
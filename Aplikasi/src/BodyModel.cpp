@@ -0,0 +1,79 @@
+#include "BodyModel.h"
+
+#include "bvh2.h"
+#include "ParallelFor.h"
+
+#include <cmath>
+
+void bakeJoints(const Bvh2& bvh, ClipTrajectory& trajectory)
+{
+  trajectory.numFrames = bvh.getMotion().numFrames;
+  trajectory.numJoints = bvh.getNumJoints();
+  trajectory.frameTime = bvh.getFrameTime();
+  trajectory.joints.resize((size_t)trajectory.numFrames * trajectory.numJoints);
+  trajectory.rotations.resize((size_t)trajectory.numFrames * trajectory.numJoints);
+
+  unsigned int numJoints = trajectory.numJoints;
+  glm::vec4* joints = trajectory.joints.data();
+  glm::quat* rotations = trajectory.rotations.data();
+
+  parallelFor(0, trajectory.numFrames, [&bvh, numJoints, joints, rotations](unsigned int begin, unsigned int end)
+  {
+    std::vector<glm::mat4> matrices(numJoints);
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      bvh.computePositions(frame, joints + (size_t)frame * numJoints, matrices.data());
+      for (unsigned int j = 0; j < numJoints; j++)
+        rotations[(size_t)frame * numJoints + j] = glm::normalize(glm::quat_cast(glm::mat3(matrices[j])));
+    }
+  });
+}
+
+glm::vec2 rootHeading(const ClipTrajectory& trajectory, unsigned int frame)
+{
+  glm::vec3 forward = trajectory.rotations[(size_t)frame * trajectory.numJoints] * glm::vec3(0.0f, 0.0f, 1.0f);
+  float length = std::sqrt(forward.x * forward.x + forward.z * forward.z);
+  if (length < 1e-6f)
+    return glm::vec2(0.0f, 1.0f);
+  return glm::vec2(forward.x / length, forward.z / length);
+}
+
+void bakeCOM(const BodyParameters& parameters, ClipTrajectory& trajectory)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  trajectory.segmentsCOM.resize((size_t)numFrames * NumSegments);
+  trajectory.bodyCOM.resize(numFrames);
+
+  float lengthFraction[NumSegments];
+  float massFraction[NumSegments];
+  for (int s = 0; s < NumSegments; s++)
+  {
+    lengthFraction[s] = parameters.lengthPercent[s] / 100.0f;
+    // (mass percent / 100 * weight) / weight
+    massFraction[s] = parameters.massPercent[s] / 100.0f;
+  }
+
+  const glm::vec4* joints = trajectory.joints.data();
+  glm::vec4* segments = trajectory.segmentsCOM.data();
+  glm::vec4* body = trajectory.bodyCOM.data();
+
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      const glm::vec4* pose = joints + (size_t)frame * numJoints;
+      glm::vec4* segmentsCOM = segments + (size_t)frame * NumSegments;
+      glm::vec3 bodyCOM(0.0f);
+
+      for (int s = 0; s < NumSegments; s++)
+      {
+        glm::vec4 com = glm::mix(pose[segmentJoints[s].proximal], pose[segmentJoints[s].distal], lengthFraction[s]);
+        segmentsCOM[s] = com;
+        bodyCOM += glm::vec3(com) * massFraction[s];
+      }
+
+      body[frame] = glm::vec4(bodyCOM, 1.0f);
+    }
+  });
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class Bvh2;
+
+// segments in the same order as segmentsCogVertices in main.cpp
+enum Segment
+{
+  HeadNeck,
+  Trunk,
+  LeftUpperArm,
+  RightUpperArm,
+  LeftForeArm,
+  RightForeArm,
+  LeftHand,
+  RightHand,
+  LeftThigh,
+  RightThigh,
+  LeftShank,
+  RightShank,
+  LeftFoot,
+  RightFoot,
+  NumSegments
+};
+
+// skeletons need at least this many joints for segmentJoints
+#define MinBodyModelJoints 26
+
+// joint indices, same as bvhVertices / Bvh2::getJoints()
+struct SegmentJoints
+{
+  int proximal;
+  int distal;
+};
+
+constexpr SegmentJoints segmentJoints[NumSegments] = {
+  { 3, 5 },   // head neck
+  { 0, 2 },   // trunk
+  { 6, 8 },   // left upper arm
+  { 11, 13 }, // right upper arm
+  { 8, 9 },   // left fore arm
+  { 13, 14 }, // right fore arm
+  { 9, 10 },  // left hand
+  { 14, 15 }, // right hand
+  { 16, 17 }, // left thigh
+  { 21, 22 }, // right thigh
+  { 17, 18 }, // left shank
+  { 22, 23 }, // right shank
+  { 18, 20 }, // left foot
+  { 23, 25 }  // right foot
+};
+
+struct BodyParameters
+{
+  float totalBodyWeight;
+  float massPercent[NumSegments];
+  float lengthPercent[NumSegments];
+};
+
+// whole clip evaluated at once
+struct ClipTrajectory
+{
+  unsigned int numFrames = 0;
+  unsigned int numJoints = 0;
+  float frameTime = 0.0f;
+
+  std::vector<glm::vec4> joints;      // frame * numJoints + joint
+  std::vector<glm::quat> rotations;   // frame * numJoints + joint, world orientation
+  std::vector<glm::vec4> segmentsCOM; // frame * NumSegments + segment
+  std::vector<glm::vec4> bodyCOM;     // frame
+};
+
+// runs forward kinematics on every frame of the clip, positions and orientations
+void bakeJoints(const Bvh2& bvh, ClipTrajectory& trajectory);
+
+// segment and body COM for every baked frame from runtime percents, used by the Custom model
+void bakeCOM(const BodyParameters& parameters, ClipTrajectory& trajectory);
+
+// sine and cosine of the yaw of the root, the direction its local +z points at on the floor.
+// turning a vector by (x c - z s, y, x s + z c) makes the character face +z
+glm::vec2 rootHeading(const ClipTrajectory& trajectory, unsigned int frame);
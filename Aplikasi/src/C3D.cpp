@@ -0,0 +1,425 @@
+#include "C3D.h"
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static bool sameName(const std::string& a, const char* b)
+{
+  size_t length = strlen(b);
+  if (a.size() != length)
+    return false;
+  for (size_t i = 0; i < length; i++)
+  {
+    if (std::toupper((unsigned char)a[i]) != std::toupper((unsigned char)b[i]))
+      return false;
+  }
+  return true;
+}
+
+static std::string upper(std::string text)
+{
+  for (char& c : text)
+    c = (char)std::toupper((unsigned char)c);
+  return text;
+}
+
+// group and parameter records between begin and end. a record is a signed name length (negative
+// when locked), an id (negative for groups, the group's for parameters), the name and the offset
+// of the next record from the offset itself
+static void readParameters(C3DFile& file, size_t begin, size_t end)
+{
+  const unsigned char* data = file.mapped.data;
+  std::vector<std::pair<int, std::string>> groups;
+  std::vector<int> parameterGroups;
+
+  size_t at = begin;
+  while (at + 2 <= end)
+  {
+    int nameLength = std::abs((int)(signed char)data[at]);
+    int id = (signed char)data[at + 1];
+    size_t offsetAt = at + 2 + nameLength;
+    if (nameLength == 0 || id == 0 || offsetAt + 2 > end)
+      break;
+    std::string name = upper(std::string((const char*)data + at + 2, nameLength));
+    size_t next = (size_t)(c3dReadInt16(data + offsetAt, file.processor) & 0xffff);
+
+    if (id < 0)
+      groups.push_back(std::make_pair(-id, name));
+    else if (offsetAt + 4 <= end)
+    {
+      size_t p = offsetAt + 2;
+      C3DParameter parameter;
+      parameter.name = name;
+      parameter.type = (signed char)data[p];
+      int numDimensions = data[p + 1];
+      p += 2;
+      parameter.count = 1;
+      for (int d = 0; d < numDimensions && p < end; d++, p++)
+      {
+        parameter.dimensions.push_back(data[p]);
+        parameter.count *= data[p];
+      }
+      size_t bytes = parameter.count * std::abs(parameter.type);
+      bool known = parameter.type == C3DChar || parameter.type == C3DByte || parameter.type == C3DInt16 || parameter.type == C3DFloat;
+      if (known && p + bytes <= end)
+      {
+        parameter.data = data + p;
+        file.parameters.push_back(parameter);
+        parameterGroups.push_back(id);
+      }
+    }
+
+    if (next == 0)
+      break;
+    at = offsetAt + next;
+  }
+
+  // groups may come after their parameters
+  for (size_t i = 0; i < file.parameters.size(); i++)
+  {
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+      if (groups[g].first == parameterGroups[i])
+        file.parameters[i].group = groups[g].second;
+    }
+  }
+}
+
+const C3DParameter* findC3DParameter(const C3DFile& file, const char* group, const char* name)
+{
+  for (const C3DParameter& parameter : file.parameters)
+  {
+    if (sameName(parameter.group, group) && sameName(parameter.name, name))
+      return &parameter;
+  }
+  return nullptr;
+}
+
+int c3dParameterInt(const C3DFile& file, const C3DParameter& parameter, size_t index)
+{
+  if (index >= parameter.count)
+    return 0;
+  switch (parameter.type)
+  {
+  case C3DInt16:
+    return c3dReadInt16(parameter.data + index * 2, file.processor);
+  case C3DFloat:
+    return (int)c3dReadFloat(parameter.data + index * 4, file.processor);
+  default:
+    return parameter.data[index];
+  }
+}
+
+float c3dParameterFloat(const C3DFile& file, const C3DParameter& parameter, size_t index)
+{
+  if (parameter.type == C3DFloat && index < parameter.count)
+    return c3dReadFloat(parameter.data + index * 4, file.processor);
+  return (float)c3dParameterInt(file, parameter, index);
+}
+
+std::string c3dParameterString(const C3DParameter& parameter, size_t index)
+{
+  if (parameter.type != C3DChar || parameter.count == 0)
+    return std::string();
+  size_t length = parameter.dimensions.empty() ? parameter.count : parameter.dimensions[0];
+  if (length == 0 || (index + 1) * length > parameter.count)
+    return std::string();
+  std::string text((const char*)parameter.data + index * length, length);
+  size_t last = text.find_last_not_of(std::string(" \0", 2));
+  return last == std::string::npos ? std::string() : text.substr(0, last + 1);
+}
+
+int findC3DPoint(const C3DFile& file, const std::string& label)
+{
+  for (size_t i = 0; i < file.labels.size(); i++)
+  {
+    if (sameName(file.labels[i], label.c_str()))
+      return (int)i;
+  }
+  return -1;
+}
+
+void closeC3D(C3DFile& file)
+{
+  unmapFile(file.mapped);
+  file = C3DFile();
+}
+
+bool openC3D(const std::string& filename, C3DFile& file)
+{
+  closeC3D(file);
+  if (!mapFile(filename, file.mapped))
+  {
+    std::cout << "Failed to read " << filename << std::endl;
+    return false;
+  }
+
+  const unsigned char* data = file.mapped.data;
+  size_t size = file.mapped.size;
+  size_t parameterStart = data[0] > 0 ? (size_t)(data[0] - 1) * C3DBlockBytes : size;
+  if (size < C3DBlockBytes || data[1] != 0x50 || parameterStart + 4 > size)
+  {
+    std::cout << "Not a C3D file " << filename << std::endl;
+    closeC3D(file);
+    return false;
+  }
+
+  // the parameter section says how everything, the header included, is stored
+  file.processor = data[parameterStart + 3];
+  if (file.processor != C3DProcessorIntel && file.processor != C3DProcessorDec && file.processor != C3DProcessorMips)
+  {
+    std::cout << "Unknown C3D processor type " << file.processor << " in " << filename << std::endl;
+    closeC3D(file);
+    return false;
+  }
+  size_t numBlocks = data[parameterStart + 2];
+  size_t parameterEnd = numBlocks > 0 ? std::min(size, parameterStart + numBlocks * C3DBlockBytes) : size;
+  readParameters(file, parameterStart + 4, parameterEnd);
+
+  // header words, the parameters win where they exist
+  int processor = file.processor;
+  unsigned int numPoints = c3dReadInt16(data + 2, processor) & 0xffff;
+  file.analogPerFrame = c3dReadInt16(data + 4, processor) & 0xffff;
+  file.firstFrame = c3dReadInt16(data + 6, processor) & 0xffff;
+  unsigned int lastFrame = c3dReadInt16(data + 8, processor) & 0xffff;
+  float scale = c3dReadFloat(data + 12, processor);
+  size_t dataBlock = c3dReadInt16(data + 16, processor) & 0xffff;
+  file.pointRate = c3dReadFloat(data + 20, processor);
+
+  if (const C3DParameter* used = findC3DParameter(file, "POINT", "USED"))
+    numPoints = c3dParameterInt(file, *used, 0) & 0xffff;
+  if (const C3DParameter* pointScale = findC3DParameter(file, "POINT", "SCALE"))
+    scale = c3dParameterFloat(file, *pointScale, 0);
+  if (const C3DParameter* rate = findC3DParameter(file, "POINT", "RATE"))
+    file.pointRate = c3dParameterFloat(file, *rate, 0);
+  if (const C3DParameter* start = findC3DParameter(file, "POINT", "DATA_START"))
+    dataBlock = c3dParameterInt(file, *start, 0) & 0xffff;
+
+  // the analog sample count of the header overflows with many channels
+  const C3DParameter* analogUsed = findC3DParameter(file, "ANALOG", "USED");
+  const C3DParameter* analogRate = findC3DParameter(file, "ANALOG", "RATE");
+  if (analogUsed != nullptr && analogRate != nullptr && file.pointRate > 0.0f)
+  {
+    float samples = c3dParameterFloat(file, *analogRate, 0) / file.pointRate;
+    file.analogPerFrame = (c3dParameterInt(file, *analogUsed, 0) & 0xffff) * (unsigned int)(samples + 0.5f);
+  }
+
+  // 16 bit frame numbers end at 65535, longer trials keep 32 bit ones in TRIAL
+  unsigned int numFrames = lastFrame >= file.firstFrame ? lastFrame - file.firstFrame + 1 : 0;
+  const C3DParameter* actualStart = findC3DParameter(file, "TRIAL", "ACTUAL_START_FIELD");
+  const C3DParameter* actualEnd = findC3DParameter(file, "TRIAL", "ACTUAL_END_FIELD");
+  if (actualStart != nullptr && actualEnd != nullptr && actualStart->count >= 2 && actualEnd->count >= 2)
+  {
+    unsigned int first = (c3dParameterInt(file, *actualStart, 0) & 0xffff) | ((c3dParameterInt(file, *actualStart, 1) & 0xffff) << 16);
+    unsigned int last = (c3dParameterInt(file, *actualEnd, 0) & 0xffff) | ((c3dParameterInt(file, *actualEnd, 1) & 0xffff) << 16);
+    if (last >= first)
+    {
+      file.firstFrame = first;
+      numFrames = last - first + 1;
+    }
+  }
+
+  C3DPointView& points = file.points;
+  points.processor = processor;
+  points.floats = scale < 0.0f;
+  points.scale = scale;
+  points.numPoints = numPoints;
+  size_t element = points.floats ? 4 : 2;
+  points.pointStride = 4 * element;
+  points.frameStride = (4 * (size_t)numPoints + file.analogPerFrame) * element;
+  size_t dataStart = dataBlock > 0 ? (dataBlock - 1) * C3DBlockBytes : size;
+  if (dataStart > size || points.frameStride == 0)
+  {
+    std::cout << "No point data in " << filename << std::endl;
+    closeC3D(file);
+    return false;
+  }
+  points.data = data + dataStart;
+  // a trial cut short keeps the frames it has
+  points.numFrames = (unsigned int)std::min((size_t)numFrames, (size - dataStart) / points.frameStride);
+
+  // LABELS holds 255 at most, then LABELS2, LABELS3...
+  for (int part = 1; file.labels.size() < numPoints; part++)
+  {
+    std::string name = part == 1 ? "LABELS" : "LABELS" + std::to_string(part);
+    const C3DParameter* labels = findC3DParameter(file, "POINT", name.c_str());
+    if (labels == nullptr)
+      break;
+    size_t count = labels->dimensions.size() > 1 ? labels->dimensions[1] : 1;
+    for (size_t i = 0; i < count && file.labels.size() < numPoints; i++)
+      file.labels.push_back(c3dParameterString(*labels, i));
+  }
+  file.labels.resize(numPoints);
+
+  if (const C3DParameter* units = findC3DParameter(file, "POINT", "UNITS"))
+    file.units = c3dParameterString(*units, 0);
+  return true;
+}
+
+void defaultMarkerJointMap(MarkerJointMap& map)
+{
+  static const char* joints[MinBodyModelJoints] = {
+    "LASI RASI LPSI RPSI", // hips
+    "T10 STRN",            // spine
+    "C7 CLAV",             // spine, top of the trunk
+    "C7 CLAV",             // neck
+    "LFHD RFHD LBHD RBHD", // head
+    "LFHD RFHD LBHD RBHD", // head end
+    "LSHO", "LSHO", "LELB", "LWRA LWRB", "LFIN",
+    "RSHO", "RSHO", "RELB", "RWRA RWRB", "RFIN",
+    "LASI LPSI", "LKNE", "LANK", "LTOE", "LTOE",
+    "RASI RPSI", "RKNE", "RANK", "RTOE", "RTOE"
+  };
+
+  for (int j = 0; j < MinBodyModelJoints; j++)
+  {
+    map.markers[j].clear();
+    std::istringstream labels(joints[j]);
+    std::string label;
+    while (labels >> label)
+      map.markers[j].push_back(label);
+  }
+}
+
+bool readMarkerJointMap(const std::string& filename, MarkerJointMap& map)
+{
+  std::ifstream file(filename.c_str());
+  if (!file.is_open())
+  {
+    std::cout << "Failed to open marker map " << filename << std::endl;
+    return false;
+  }
+
+  MarkerJointMap result;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(file, line))
+  {
+    lineNumber++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    int joint;
+    if (!(fields >> joint))
+    {
+      if (line.find_first_not_of(" \t\r") != std::string::npos)
+        std::cout << filename << ":" << lineNumber << " doesn't start with a joint index" << std::endl;
+      continue;
+    }
+    if (joint < 0 || joint >= MinBodyModelJoints)
+    {
+      std::cout << filename << ":" << lineNumber << " joint " << joint << " isn't in the body model" << std::endl;
+      return false;
+    }
+    std::string label;
+    while (fields >> label)
+      result.markers[joint].push_back(label);
+  }
+  map = result;
+  return true;
+}
+
+static float unitsToCentimeters(const std::string& units)
+{
+  std::string name = upper(units);
+  if (name == "MM")
+    return 0.1f;
+  if (name == "M")
+    return 100.0f;
+  return 1.0f;
+}
+
+glm::vec3 c3dScenePoint(const C3DFile& file, const MarkerSettings& settings, const glm::vec3& point)
+{
+  glm::vec3 position = point * (settings.unitScale > 0.0f ? settings.unitScale : unitsToCentimeters(file.units));
+  if (settings.zUp)
+    return glm::vec3(position.x, position.z, -position.y);
+  return position;
+}
+
+bool bakeMarkerJoints(const C3DFile& file, const MarkerJointMap& map, const MarkerSettings& settings, ClipTrajectory& trajectory)
+{
+  // every joint needs at least one marker the trial has
+  std::vector<int> points[MinBodyModelJoints];
+  bool complete = true;
+  for (int j = 0; j < MinBodyModelJoints; j++)
+  {
+    for (const std::string& label : map.markers[j])
+    {
+      int point = findC3DPoint(file, label);
+      if (point >= 0)
+        points[j].push_back(point);
+    }
+    if (points[j].empty())
+    {
+      std::cout << "None of the markers of joint " << j << " are in the trial" << std::endl;
+      complete = false;
+    }
+  }
+  if (!complete || file.points.numFrames == 0)
+    return false;
+
+  const C3DPointView& view = file.points;
+  unsigned int numFrames = view.numFrames;
+  unsigned int numJoints = MinBodyModelJoints;
+
+  trajectory.numFrames = numFrames;
+  trajectory.numJoints = numJoints;
+  trajectory.frameTime = file.pointRate > 0.0f ? 1.0f / file.pointRate : 0.0f;
+  trajectory.joints.resize((size_t)numFrames * numJoints);
+  trajectory.rotations.assign((size_t)numFrames * numJoints, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+
+  // centroids of the markers seen in each frame, w 0 when none were
+  glm::vec4* joints = trajectory.joints.data();
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      for (unsigned int j = 0; j < numJoints; j++)
+      {
+        glm::vec3 sum(0.0f);
+        int seen = 0;
+        for (int point : points[j])
+        {
+          glm::vec4 marker = c3dPoint(view, frame, point);
+          if (marker.w >= 0.0f)
+          {
+            sum += glm::vec3(marker);
+            seen++;
+          }
+        }
+        glm::vec3 position = seen > 0 ? c3dScenePoint(file, settings, sum / (float)seen) : glm::vec3(0.0f);
+        joints[(size_t)frame * numJoints + j] = glm::vec4(position, seen > 0 ? 1.0f : 0.0f);
+      }
+    }
+  });
+
+  // gaps hold the last position seen, the frames before the first sighting the first one
+  for (unsigned int j = 0; j < numJoints; j++)
+  {
+    unsigned int firstSeen = numFrames;
+    for (unsigned int frame = 0; frame < numFrames; frame++)
+    {
+      glm::vec4& joint = joints[(size_t)frame * numJoints + j];
+      if (joint.w > 0.0f)
+      {
+        if (firstSeen == numFrames)
+          firstSeen = frame;
+      }
+      else if (firstSeen < numFrames)
+        joint = joints[(size_t)(frame - 1) * numJoints + j];
+    }
+    if (firstSeen == numFrames)
+      std::cout << "Joint " << j << " has no markers in any frame" << std::endl;
+    for (unsigned int frame = 0; frame < firstSeen && firstSeen < numFrames; frame++)
+      joints[(size_t)frame * numJoints + j] = joints[(size_t)firstSeen * numJoints + j];
+    for (unsigned int frame = 0; frame < numFrames; frame++)
+      joints[(size_t)frame * numJoints + j].w = 1.0f;
+  }
+  return true;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BodyModel.h"
+#include "FileSystem.h"
+
+// processor types of the parameter section, they decide the byte order and the float format
+#define C3DProcessorIntel 84 // little endian, IEEE floats
+#define C3DProcessorDec 85   // little endian, VAX F floats
+#define C3DProcessorMips 86  // big endian, IEEE floats
+
+#define C3DBlockBytes 512
+
+// parameter types
+#define C3DChar -1
+#define C3DByte 1
+#define C3DInt16 2
+#define C3DFloat 4
+
+struct C3DParameter
+{
+  std::string group;
+  std::string name;
+  int type = C3DChar;
+  std::vector<int> dimensions;
+  const unsigned char* data = nullptr; // in the mapped file
+  size_t count = 0;                    // elements, the product of the dimensions
+};
+
+// the point block of every frame in place in the mapped file, nothing is copied or converted
+// until a point is read
+struct C3DPointView
+{
+  const unsigned char* data = nullptr; // first frame
+  size_t frameStride = 0;              // bytes from one frame to the next, analog samples included
+  size_t pointStride = 0;              // bytes from one point to the next, x y z and residual
+  unsigned int numFrames = 0;
+  unsigned int numPoints = 0;
+  bool floats = false;                 // IEEE or VAX floats instead of scaled integers
+  int processor = C3DProcessorIntel;
+  float scale = 1.0f;                  // integer data to file units
+};
+
+struct C3DFile
+{
+  MappedFile mapped;
+  int processor = C3DProcessorIntel;
+  std::vector<C3DParameter> parameters;
+
+  unsigned int firstFrame = 1;
+  float pointRate = 0.0f;             // frames per second
+  unsigned int analogPerFrame = 0;    // analog samples stored after the points of each frame
+  std::vector<std::string> labels;    // POINT:LABELS, one per point
+  std::string units;                  // POINT:UNITS, usually mm
+  C3DPointView points;
+};
+
+// maps the file and reads the header and the parameter section, the point data is only
+// touched when it's read
+bool openC3D(const std::string& filename, C3DFile& file);
+void closeC3D(C3DFile& file);
+
+// nullptr when the file doesn't have it, names are compared case insensitive
+const C3DParameter* findC3DParameter(const C3DFile& file, const char* group, const char* name);
+int c3dParameterInt(const C3DFile& file, const C3DParameter& parameter, size_t index);
+float c3dParameterFloat(const C3DFile& file, const C3DParameter& parameter, size_t index);
+// string index of a char array, the first dimension is the length, trailing blanks removed
+std::string c3dParameterString(const C3DParameter& parameter, size_t index);
+
+// index of the point with that label, -1 when there's none
+int findC3DPoint(const C3DFile& file, const std::string& label);
+
+inline int c3dReadInt16(const unsigned char* bytes, int processor)
+{
+  if (processor == C3DProcessorMips)
+    return (short)((bytes[0] << 8) | bytes[1]);
+  return (short)(bytes[0] | (bytes[1] << 8));
+}
+
+inline float c3dReadFloat(const unsigned char* bytes, int processor)
+{
+  unsigned char ieee[4];
+  if (processor == C3DProcessorMips)
+  {
+    ieee[0] = bytes[3];
+    ieee[1] = bytes[2];
+    ieee[2] = bytes[1];
+    ieee[3] = bytes[0];
+  }
+  else if (processor == C3DProcessorDec)
+  {
+    // VAX F: the two 16 bit halves swapped, and an exponent bias that makes it 4 times the IEEE value
+    ieee[0] = bytes[2];
+    ieee[1] = bytes[3];
+    ieee[2] = bytes[0];
+    ieee[3] = bytes[1];
+  }
+  else
+    memcpy(ieee, bytes, 4);
+
+  float value;
+  memcpy(&value, ieee, 4);
+  return processor == C3DProcessorDec ? value / 4.0f : value;
+}
+
+// x y z of the point in file units, w the residual, -1 when the point wasn't seen in the frame
+inline glm::vec4 c3dPoint(const C3DPointView& view, unsigned int frame, unsigned int point)
+{
+  const unsigned char* bytes = view.data + frame * view.frameStride + point * view.pointStride;
+  glm::vec4 position;
+  int residual;
+  if (view.floats)
+  {
+    position.x = c3dReadFloat(bytes, view.processor);
+    position.y = c3dReadFloat(bytes + 4, view.processor);
+    position.z = c3dReadFloat(bytes + 8, view.processor);
+    residual = (int)c3dReadFloat(bytes + 12, view.processor);
+  }
+  else
+  {
+    position.x = c3dReadInt16(bytes, view.processor) * view.scale;
+    position.y = c3dReadInt16(bytes + 2, view.processor) * view.scale;
+    position.z = c3dReadInt16(bytes + 4, view.processor) * view.scale;
+    residual = c3dReadInt16(bytes + 6, view.processor);
+  }
+  // the low byte is the residual in scale units, the high byte the cameras that saw it
+  position.w = residual < 0 ? -1.0f : (residual & 0xff) * glm::abs(view.scale);
+  return position;
+}
+
+// the frame as floats straight from the file, x y z residual per point, when the file holds
+// IEEE floats in this machine's order. nullptr otherwise, read it with c3dPoint then
+inline const float* c3dFrameFloats(const C3DPointView& view, unsigned int frame)
+{
+  if (!view.floats || view.processor != C3DProcessorIntel)
+    return nullptr;
+  return (const float*)(view.data + frame * view.frameStride);
+}
+
+// labels of the markers whose centroid is each joint of the body model, joints as in bvhVertices
+struct MarkerJointMap
+{
+  std::vector<std::string> markers[MinBodyModelJoints];
+};
+
+struct MarkerSettings
+{
+  float unitScale = 0.0f; // file units to scene units, 0 takes it from POINT:UNITS to cm like the example clips
+  bool zUp = true;        // labs record z up, the scene is y up
+};
+
+// a point of the file in scene units and axes
+glm::vec3 c3dScenePoint(const C3DFile& file, const MarkerSettings& settings, const glm::vec3& point);
+
+// rough centroids of the Plug-in Gait full body markers
+void defaultMarkerJointMap(MarkerJointMap& map);
+
+// lines of a joint index followed by marker labels, # starts a comment
+bool readMarkerJointMap(const std::string& filename, MarkerJointMap& map);
+
+// the joints of every frame from the markers, where bakeJoints would put them for a clip, so
+// the segment COM passes run on marker trials unchanged. markers missing in a frame are left
+// out of their joint's centroid, a joint with none of them keeps its previous position.
+// rotations are identity, markers alone don't give the segment orientations
+bool bakeMarkerJoints(const C3DFile& file, const MarkerJointMap& map, const MarkerSettings& settings, ClipTrajectory& trajectory);
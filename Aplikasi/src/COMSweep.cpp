@@ -0,0 +1,235 @@
+#include "COMSweep.h"
+
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#define SweepFrameBlock 8
+#define SweepBins 256
+
+// exact order statistics through a histogram pass, only the two bins holding the
+// ranks are selected on, much cheaper than nth_element over all sets
+static void selectRanks(const float* values, unsigned int count, float minimum, float maximum,
+                        unsigned int lowerRank, unsigned int upperRank,
+                        float& lower, float& upper, std::vector<float>& scratch)
+{
+  if (maximum <= minimum)
+  {
+    lower = upper = minimum;
+    return;
+  }
+
+  unsigned int bins[SweepBins] = {};
+  float scale = (SweepBins - 1) / (maximum - minimum);
+  for (unsigned int k = 0; k < count; k++)
+    bins[(int)((values[k] - minimum) * scale)]++;
+
+  unsigned int lowerBin = 0, lowerBefore = 0;
+  while (lowerBefore + bins[lowerBin] <= lowerRank)
+    lowerBefore += bins[lowerBin++];
+  unsigned int upperBin = lowerBin, upperBefore = lowerBefore;
+  while (upperBefore + bins[upperBin] <= upperRank)
+    upperBefore += bins[upperBin++];
+
+  // lower bin first, upper bin after it
+  scratch.resize(bins[lowerBin] + (upperBin != lowerBin ? bins[upperBin] : 0));
+  unsigned int lowerCount = 0, upperCount = bins[lowerBin];
+  for (unsigned int k = 0; k < count; k++)
+  {
+    unsigned int bin = (unsigned int)((values[k] - minimum) * scale);
+    if (bin == lowerBin)
+      scratch[lowerCount++] = values[k];
+    else if (bin == upperBin)
+      scratch[upperCount++] = values[k];
+  }
+
+  float* lowerValues = scratch.data();
+  std::nth_element(lowerValues, lowerValues + (lowerRank - lowerBefore), lowerValues + bins[lowerBin]);
+  lower = lowerValues[lowerRank - lowerBefore];
+
+  float* upperValues = upperBin == lowerBin ? lowerValues : lowerValues + bins[lowerBin];
+  std::nth_element(upperValues, upperValues + (upperRank - upperBefore), upperValues + bins[upperBin]);
+  upper = upperValues[upperRank - upperBefore];
+}
+
+void generateParameterSets(const SweepSettings& settings, std::vector<BodyParameters>& parameterSets)
+{
+  std::mt19937 generator(settings.seed);
+  std::uniform_real_distribution<float> massFactor(-settings.massPerturbation / 100.0f, settings.massPerturbation / 100.0f);
+  std::uniform_real_distribution<float> lengthFactor(-settings.lengthPerturbation / 100.0f, settings.lengthPerturbation / 100.0f);
+  std::bernoulli_distribution female(0.5);
+
+  AnthropometricModel model = settings.model == CustomModel ? ZatsiorskyDeLevaModel : (AnthropometricModel)settings.model;
+
+  parameterSets.resize(std::max(settings.numSets, 1));
+  for (BodyParameters& parameters : parameterSets)
+  {
+    int sex = settings.sex == SweepBothSexes ? (female(generator) ? 1 : 0) : settings.sex;
+    parameters = modelParameters(model, sex, 1.0f);
+
+    // head neck and trunk alone, then left/right pairs
+    for (int s = 0; s < NumSegments; s++)
+    {
+      if (s >= LeftUpperArm && (s - LeftUpperArm) % 2 == 1)
+      {
+        parameters.massPercent[s] = parameters.massPercent[s - 1];
+        parameters.lengthPercent[s] = parameters.lengthPercent[s - 1];
+        continue;
+      }
+      parameters.massPercent[s] *= 1.0f + massFactor(generator);
+      parameters.lengthPercent[s] *= 1.0f + lengthFactor(generator);
+    }
+  }
+}
+
+void sweepCOM(const ClipTrajectory& trajectory, const std::vector<BodyParameters>& parameterSets,
+              float confidence, SweepResult& result)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  unsigned int numSets = (unsigned int)parameterSets.size();
+  unsigned int paddedSets = (numSets + 7) & ~7u;
+
+  result.mean.resize(numFrames);
+  result.standardDeviation.resize(numFrames);
+  result.lower.resize(numFrames);
+  result.upper.resize(numFrames);
+  if (numFrames == 0 || numSets == 0)
+    return;
+
+  // weights, rows are segments (proximal joint) then segments (distal - proximal), columns are sets
+  const unsigned int numRows = 2 * NumSegments;
+  std::vector<float> weights((size_t)numRows * paddedSets, 0.0f);
+  for (unsigned int k = 0; k < numSets; k++)
+  {
+    const BodyParameters& parameters = parameterSets[k];
+    float totalMass = 0.0f;
+    for (int s = 0; s < NumSegments; s++)
+      totalMass += parameters.massPercent[s];
+
+    for (int s = 0; s < NumSegments; s++)
+    {
+      float mass = totalMass > 0.0f ? parameters.massPercent[s] / totalMass : 0.0f;
+      weights[(size_t)s * paddedSets + k] = mass;
+      weights[(size_t)(NumSegments + s) * paddedSets + k] = mass * parameters.lengthPercent[s] / 100.0f;
+    }
+  }
+
+  float tail = glm::clamp((100.0f - confidence) / 200.0f, 0.0f, 0.5f);
+  unsigned int lowerIndex = (unsigned int)std::floor(tail * (numSets - 1));
+  unsigned int upperIndex = numSets - 1 - lowerIndex;
+
+  unsigned int numBlocks = (numFrames + SweepFrameBlock - 1) / SweepFrameBlock;
+
+  parallelFor(0, numBlocks, [&](unsigned int begin, unsigned int end)
+  {
+    // frame block x axis x sets
+    std::vector<float> com((size_t)SweepFrameBlock * 3 * paddedSets);
+    std::vector<float> scratch;
+    float features[SweepFrameBlock][3][2 * NumSegments];
+
+    for (unsigned int block = begin; block < end; block++)
+    {
+      unsigned int firstFrame = block * SweepFrameBlock;
+      unsigned int blockFrames = std::min((unsigned int)SweepFrameBlock, numFrames - firstFrame);
+
+      // left matrix of the block
+      for (unsigned int b = 0; b < blockFrames; b++)
+      {
+        const glm::vec4* pose = &trajectory.joints[(size_t)(firstFrame + b) * numJoints];
+        for (int s = 0; s < NumSegments; s++)
+        {
+          glm::vec4 proximal = pose[segmentJoints[s].proximal];
+          glm::vec4 length = pose[segmentJoints[s].distal] - proximal;
+          for (int axis = 0; axis < 3; axis++)
+          {
+            features[b][axis][s] = proximal[axis];
+            features[b][axis][NumSegments + s] = length[axis];
+          }
+        }
+      }
+
+      // product, eight sets per step in two lanes so the adds don't wait on each other
+      for (unsigned int k = 0; k < paddedSets; k += 8)
+      {
+        for (unsigned int b = 0; b < blockFrames; b++)
+        {
+          float4 x0, y0, z0, x1, y1, z1;
+          for (unsigned int row = 0; row < numRows; row++)
+          {
+            const float* w = &weights[(size_t)row * paddedSets + k];
+            float4 w0 = float4::load(w);
+            float4 w1 = float4::load(w + 4);
+            float4 fx(features[b][0][row]);
+            float4 fy(features[b][1][row]);
+            float4 fz(features[b][2][row]);
+            x0 += fx * w0;
+            y0 += fy * w0;
+            z0 += fz * w0;
+            x1 += fx * w1;
+            y1 += fy * w1;
+            z1 += fz * w1;
+          }
+          float* out = &com[(size_t)b * 3 * paddedSets + k];
+          x0.store(out);
+          x1.store(out + 4);
+          y0.store(out + paddedSets);
+          y1.store(out + paddedSets + 4);
+          z0.store(out + 2 * paddedSets);
+          z1.store(out + 2 * paddedSets + 4);
+        }
+      }
+
+      // statistics over the sets
+      for (unsigned int b = 0; b < blockFrames; b++)
+      {
+        unsigned int frame = firstFrame + b;
+        for (int axis = 0; axis < 3; axis++)
+        {
+          float* values = &com[((size_t)b * 3 + axis) * paddedSets];
+
+          // shifted by the first value so the float sums keep their precision,
+          // the padding lanes repeat the first value and add nothing
+          float shift = values[0];
+          for (unsigned int k = numSets; k < paddedSets; k++)
+            values[k] = shift;
+
+          float4 sum4, sumSquares4, minimum4(shift), maximum4(shift);
+          for (unsigned int k = 0; k < paddedSets; k += 4)
+          {
+            float4 value = float4::load(values + k);
+            float4 shifted = value - float4(shift);
+            sum4 += shifted;
+            sumSquares4 += shifted * shifted;
+            minimum4 = vmin(minimum4, value);
+            maximum4 = vmax(maximum4, value);
+          }
+
+          float lanes[4][4];
+          sum4.store(lanes[0]);
+          sumSquares4.store(lanes[1]);
+          minimum4.store(lanes[2]);
+          maximum4.store(lanes[3]);
+          float sum = lanes[0][0] + lanes[0][1] + lanes[0][2] + lanes[0][3];
+          float sumSquares = lanes[1][0] + lanes[1][1] + lanes[1][2] + lanes[1][3];
+          float minimum = std::min(std::min(lanes[2][0], lanes[2][1]), std::min(lanes[2][2], lanes[2][3]));
+          float maximum = std::max(std::max(lanes[3][0], lanes[3][1]), std::max(lanes[3][2], lanes[3][3]));
+
+          float mean = sum / numSets;
+          float variance = std::max(0.0f, sumSquares / numSets - mean * mean);
+
+          float lower, upper;
+          selectRanks(values, numSets, minimum, maximum, lowerIndex, upperIndex, lower, upper, scratch);
+
+          result.mean[frame][axis] = mean + shift;
+          result.standardDeviation[frame][axis] = std::sqrt(variance);
+          result.lower[frame][axis] = lower;
+          result.upper[frame][axis] = upper;
+        }
+      }
+    }
+  }, 4);
+}
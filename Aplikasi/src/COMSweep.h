@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AnthropometricModels.h"
+
+#define SweepMale 0
+#define SweepFemale 1
+#define SweepBothSexes 2
+
+// Monte Carlo around one of the compiled models, each left/right pair gets the same
+// perturbation. Body weight isn't sampled, it cancels out of the COM position
+struct SweepSettings
+{
+  int numSets = 1000;
+  int model = ZatsiorskyDeLevaModel;
+  int sex = SweepMale;
+  float massPerturbation = 5.0f;   // +- percent of each mass percent
+  float lengthPerturbation = 5.0f; // +- percent of each COM location percent
+  float confidence = 95.0f;
+  unsigned int seed = 1;
+};
+
+// per frame statistics of the body COM over all parameter sets
+struct SweepResult
+{
+  std::vector<glm::vec3> mean;
+  std::vector<glm::vec3> standardDeviation;
+  std::vector<glm::vec3> lower; // confidence band
+  std::vector<glm::vec3> upper;
+};
+
+void generateParameterSets(const SweepSettings& settings, std::vector<BodyParameters>& parameterSets);
+
+// evaluates every parameter set on every frame, the joint trajectories are shared and the
+// weighted sums are a (frames x 2 segments) * (2 segments x sets) product per axis
+void sweepCOM(const ClipTrajectory& trajectory, const std::vector<BodyParameters>& parameterSets,
+              float confidence, SweepResult& result);
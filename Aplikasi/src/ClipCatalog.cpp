@@ -0,0 +1,597 @@
+#include "ClipCatalog.h"
+
+#include "Aggregation.h"
+#include "AnthropometricModels.h"
+#include "BodyModel.h"
+#include "bvh2.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#define CatalogMagic 0x54414343 // "CCAT"
+#define CatalogVersion 1
+// columns start on cache lines so filters stream whole lines of one field
+#define CatalogAlignment 64
+
+enum CatalogColumn
+{
+  PathOffsetsColumn,
+  PathsColumn,
+  FileSizesColumn,
+  FileTimesColumn,
+  SkeletonHashesColumn,
+  FlagsColumn,
+  NumFramesColumn,
+  NumJointsColumn,
+  FrameTimesColumn,
+  BoundsMinColumn,
+  BoundsMaxColumn,
+  COMMeanColumn,
+  COMHeightColumn,
+  COMPathColumn,
+  COMSpeedColumn,
+  ThumbnailsColumn,
+  ThumbnailParentsColumn,
+  NumCatalogColumns
+};
+
+struct CatalogHeader
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int numClips;
+  unsigned int thumbnailJoints;
+  int model;
+  unsigned int numColumns;
+  unsigned long long offsets[NumCatalogColumns];
+  unsigned long long sizes[NumCatalogColumns];
+};
+
+static void resizeRows(CatalogRows& rows, size_t numClips)
+{
+  rows.paths.resize(numClips);
+  rows.fileSizes.resize(numClips);
+  rows.fileTimes.resize(numClips);
+  rows.skeletonHashes.resize(numClips);
+  rows.flags.resize(numClips);
+  rows.numFrames.resize(numClips);
+  rows.numJoints.resize(numClips);
+  rows.frameTimes.resize(numClips);
+  rows.boundsMin.resize(numClips);
+  rows.boundsMax.resize(numClips);
+  rows.comMean.resize(numClips);
+  rows.comHeight.resize(numClips);
+  rows.comPath.resize(numClips);
+  rows.comSpeed.resize(numClips);
+  rows.thumbnails.resize(numClips * CatalogThumbnailJoints);
+  rows.thumbnailParents.resize(numClips * CatalogThumbnailJoints);
+}
+
+bool writeCatalog(const CatalogRows& rows, int model, const std::string& filename)
+{
+  unsigned int numClips = (unsigned int)rows.paths.size();
+  std::vector<unsigned int> pathOffsets(numClips + 1, 0);
+  std::string paths;
+  for (unsigned int i = 0; i < numClips; i++)
+  {
+    pathOffsets[i] = (unsigned int)paths.size();
+    paths += rows.paths[i];
+    paths += '\0';
+  }
+  pathOffsets[numClips] = (unsigned int)paths.size();
+
+  const void* columns[NumCatalogColumns] = {
+    pathOffsets.data(), paths.data(), rows.fileSizes.data(), rows.fileTimes.data(), rows.skeletonHashes.data(),
+    rows.flags.data(), rows.numFrames.data(), rows.numJoints.data(), rows.frameTimes.data(), rows.boundsMin.data(),
+    rows.boundsMax.data(), rows.comMean.data(), rows.comHeight.data(), rows.comPath.data(), rows.comSpeed.data(),
+    rows.thumbnails.data(), rows.thumbnailParents.data()
+  };
+
+  CatalogHeader header = {};
+  header.magic = CatalogMagic;
+  header.version = CatalogVersion;
+  header.numClips = numClips;
+  header.thumbnailJoints = CatalogThumbnailJoints;
+  header.model = model;
+  header.numColumns = NumCatalogColumns;
+  header.sizes[PathOffsetsColumn] = pathOffsets.size() * sizeof(unsigned int);
+  header.sizes[PathsColumn] = paths.size();
+  header.sizes[FileSizesColumn] = rows.fileSizes.size() * sizeof(unsigned long long);
+  header.sizes[FileTimesColumn] = rows.fileTimes.size() * sizeof(long long);
+  header.sizes[SkeletonHashesColumn] = rows.skeletonHashes.size() * sizeof(unsigned long long);
+  header.sizes[FlagsColumn] = rows.flags.size() * sizeof(unsigned int);
+  header.sizes[NumFramesColumn] = rows.numFrames.size() * sizeof(unsigned int);
+  header.sizes[NumJointsColumn] = rows.numJoints.size() * sizeof(unsigned int);
+  header.sizes[FrameTimesColumn] = rows.frameTimes.size() * sizeof(float);
+  header.sizes[BoundsMinColumn] = rows.boundsMin.size() * sizeof(glm::vec3);
+  header.sizes[BoundsMaxColumn] = rows.boundsMax.size() * sizeof(glm::vec3);
+  header.sizes[COMMeanColumn] = rows.comMean.size() * sizeof(glm::vec3);
+  header.sizes[COMHeightColumn] = rows.comHeight.size() * sizeof(glm::vec2);
+  header.sizes[COMPathColumn] = rows.comPath.size() * sizeof(float);
+  header.sizes[COMSpeedColumn] = rows.comSpeed.size() * sizeof(float);
+  header.sizes[ThumbnailsColumn] = rows.thumbnails.size() * sizeof(glm::vec3);
+  header.sizes[ThumbnailParentsColumn] = rows.thumbnailParents.size();
+
+  unsigned long long offset = sizeof(CatalogHeader);
+  for (int c = 0; c < NumCatalogColumns; c++)
+  {
+    offset = (offset + CatalogAlignment - 1) / CatalogAlignment * CatalogAlignment;
+    header.offsets[c] = offset;
+    offset += header.sizes[c];
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    std::cout << "Failed to write " << filename << std::endl;
+    return false;
+  }
+
+  const char padding[CatalogAlignment] = {};
+  file.write((const char*)&header, sizeof(header));
+  unsigned long long written = sizeof(header);
+  for (int c = 0; c < NumCatalogColumns; c++)
+  {
+    file.write(padding, (std::streamsize)(header.offsets[c] - written));
+    file.write((const char*)columns[c], (std::streamsize)header.sizes[c]);
+    written = header.offsets[c] + header.sizes[c];
+  }
+  return (bool)file;
+}
+
+bool openCatalog(const std::string& filename, ClipCatalog& catalog)
+{
+  closeCatalog(catalog);
+  if (!mapFile(filename, catalog.file))
+  {
+    std::cout << "Failed to open catalog " << filename << std::endl;
+    return false;
+  }
+
+  const CatalogHeader* header = (const CatalogHeader*)catalog.file.data;
+  bool valid = catalog.file.size >= sizeof(CatalogHeader) && header->magic == CatalogMagic &&
+               header->version == CatalogVersion && header->thumbnailJoints == CatalogThumbnailJoints &&
+               header->numColumns == NumCatalogColumns;
+
+  // every column must lie inside the file and hold one element per clip
+  size_t numClips = valid ? header->numClips : 0;
+  const size_t elementSizes[NumCatalogColumns] = {
+    sizeof(unsigned int), 0, sizeof(unsigned long long), sizeof(long long), sizeof(unsigned long long),
+    sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int), sizeof(float), sizeof(glm::vec3),
+    sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec2), sizeof(float), sizeof(float),
+    sizeof(glm::vec3) * CatalogThumbnailJoints, CatalogThumbnailJoints
+  };
+  for (int c = 0; c < NumCatalogColumns && valid; c++)
+  {
+    size_t elements = c == PathOffsetsColumn ? numClips + 1 : numClips;
+    valid = header->offsets[c] % CatalogAlignment == 0 && header->offsets[c] <= catalog.file.size &&
+            header->sizes[c] <= catalog.file.size - header->offsets[c] &&
+            (c == PathsColumn || header->sizes[c] == elements * elementSizes[c]);
+  }
+
+  if (valid)
+  {
+    const unsigned char* data = catalog.file.data;
+    catalog.numClips = header->numClips;
+    catalog.model = header->model;
+    catalog.pathOffsets = (const unsigned int*)(data + header->offsets[PathOffsetsColumn]);
+    catalog.paths = (const char*)(data + header->offsets[PathsColumn]);
+    catalog.fileSizes = (const unsigned long long*)(data + header->offsets[FileSizesColumn]);
+    catalog.fileTimes = (const long long*)(data + header->offsets[FileTimesColumn]);
+    catalog.skeletonHashes = (const unsigned long long*)(data + header->offsets[SkeletonHashesColumn]);
+    catalog.flags = (const unsigned int*)(data + header->offsets[FlagsColumn]);
+    catalog.numFrames = (const unsigned int*)(data + header->offsets[NumFramesColumn]);
+    catalog.numJoints = (const unsigned int*)(data + header->offsets[NumJointsColumn]);
+    catalog.frameTimes = (const float*)(data + header->offsets[FrameTimesColumn]);
+    catalog.boundsMin = (const glm::vec3*)(data + header->offsets[BoundsMinColumn]);
+    catalog.boundsMax = (const glm::vec3*)(data + header->offsets[BoundsMaxColumn]);
+    catalog.comMean = (const glm::vec3*)(data + header->offsets[COMMeanColumn]);
+    catalog.comHeight = (const glm::vec2*)(data + header->offsets[COMHeightColumn]);
+    catalog.comPath = (const float*)(data + header->offsets[COMPathColumn]);
+    catalog.comSpeed = (const float*)(data + header->offsets[COMSpeedColumn]);
+    catalog.thumbnails = (const glm::vec3*)(data + header->offsets[ThumbnailsColumn]);
+    catalog.thumbnailParents = (const signed char*)(data + header->offsets[ThumbnailParentsColumn]);
+
+    // paths are read as c strings, the offsets must stay inside the blob and end on a 0
+    unsigned long long pathBytes = header->sizes[PathsColumn];
+    for (unsigned int i = 0; i < catalog.numClips && valid; i++)
+    {
+      valid = catalog.pathOffsets[i] < catalog.pathOffsets[i + 1] && catalog.pathOffsets[i + 1] <= pathBytes &&
+              catalog.paths[catalog.pathOffsets[i + 1] - 1] == '\0';
+    }
+  }
+
+  if (!valid)
+  {
+    std::cout << "Corrupt catalog " << filename << std::endl;
+    closeCatalog(catalog);
+    return false;
+  }
+  return true;
+}
+
+void closeCatalog(ClipCatalog& catalog)
+{
+  unmapFile(catalog.file);
+  catalog = ClipCatalog();
+}
+
+void readCatalogRows(const ClipCatalog& catalog, CatalogRows& rows)
+{
+  unsigned int numClips = catalog.numClips;
+  rows = CatalogRows();
+  resizeRows(rows, numClips);
+  for (unsigned int i = 0; i < numClips; i++)
+    rows.paths[i] = catalogPath(catalog, i);
+  if (numClips == 0)
+    return;
+
+  std::copy(catalog.fileSizes, catalog.fileSizes + numClips, rows.fileSizes.begin());
+  std::copy(catalog.fileTimes, catalog.fileTimes + numClips, rows.fileTimes.begin());
+  std::copy(catalog.skeletonHashes, catalog.skeletonHashes + numClips, rows.skeletonHashes.begin());
+  std::copy(catalog.flags, catalog.flags + numClips, rows.flags.begin());
+  std::copy(catalog.numFrames, catalog.numFrames + numClips, rows.numFrames.begin());
+  std::copy(catalog.numJoints, catalog.numJoints + numClips, rows.numJoints.begin());
+  std::copy(catalog.frameTimes, catalog.frameTimes + numClips, rows.frameTimes.begin());
+  std::copy(catalog.boundsMin, catalog.boundsMin + numClips, rows.boundsMin.begin());
+  std::copy(catalog.boundsMax, catalog.boundsMax + numClips, rows.boundsMax.begin());
+  std::copy(catalog.comMean, catalog.comMean + numClips, rows.comMean.begin());
+  std::copy(catalog.comHeight, catalog.comHeight + numClips, rows.comHeight.begin());
+  std::copy(catalog.comPath, catalog.comPath + numClips, rows.comPath.begin());
+  std::copy(catalog.comSpeed, catalog.comSpeed + numClips, rows.comSpeed.begin());
+  std::copy(catalog.thumbnails, catalog.thumbnails + numClips * CatalogThumbnailJoints, rows.thumbnails.begin());
+  std::copy(catalog.thumbnailParents, catalog.thumbnailParents + numClips * CatalogThumbnailJoints,
+            rows.thumbnailParents.begin());
+}
+
+// FNV-1a
+static void hashBytes(unsigned long long& hash, const void* data, size_t size)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+unsigned long long skeletonHash(const Bvh2& bvh)
+{
+  unsigned long long hash = 14695981039346656037ull;
+  const std::vector<const Joint*>& joints = bvh.getJoints();
+  const std::vector<int>& parents = bvh.getJointParents();
+  for (size_t j = 0; j < joints.size(); j++)
+  {
+    const char* name = joints[j]->name != nullptr ? joints[j]->name : "";
+    hashBytes(hash, name, strlen(name) + 1);
+    hashBytes(hash, &parents[j], sizeof(int));
+    hashBytes(hash, &joints[j]->numChannels, sizeof(unsigned int));
+    if (joints[j]->channelsOrder != nullptr)
+      hashBytes(hash, joints[j]->channelsOrder, joints[j]->numChannels * sizeof(short));
+  }
+  // 0 means any skeleton in CatalogFilter
+  return hash != 0 ? hash : 1;
+}
+
+bool catalogSources(const std::string& source, std::vector<ClipEntry>& clips)
+{
+  clips.clear();
+  if (!isDirectory(source))
+    return readClipManifest(source, clips);
+
+  std::vector<std::string> paths;
+  std::vector<std::string> extensions;
+  extensions.push_back(".bvh");
+  extensions.push_back(".bvh.gz");
+  listFiles(source, extensions, paths);
+  clips.resize(paths.size());
+  for (size_t i = 0; i < paths.size(); i++)
+    clips[i].path = paths[i];
+  return true;
+}
+
+// parses and bakes one clip into row i, false when it didn't load
+static bool indexClip(const ClipEntry& clip, AnthropometricModel model, CatalogRows& rows, size_t i)
+{
+  rows.flags[i] = 0;
+  rows.numFrames[i] = 0;
+  rows.numJoints[i] = 0;
+  rows.skeletonHashes[i] = 0;
+  rows.frameTimes[i] = 0.0f;
+  rows.boundsMin[i] = rows.boundsMax[i] = rows.comMean[i] = glm::vec3(0.0f);
+  rows.comHeight[i] = glm::vec2(0.0f);
+  rows.comPath[i] = rows.comSpeed[i] = 0.0f;
+  std::fill_n(&rows.thumbnails[i * CatalogThumbnailJoints], CatalogThumbnailJoints, glm::vec3(0.0f));
+  std::fill_n(&rows.thumbnailParents[i * CatalogThumbnailJoints], CatalogThumbnailJoints, (signed char)-1);
+
+  // any skeleton is catalogued, the COM columns only for the body model
+  Bvh2 bvh;
+  ClipTrajectory trajectory;
+  if (!loadManifestClip(clip, ManifestJointsOnly, bvh, trajectory))
+    return false;
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  rows.flags[i] = CatalogLoaded;
+  rows.numFrames[i] = numFrames;
+  rows.numJoints[i] = numJoints;
+  rows.skeletonHashes[i] = skeletonHash(bvh);
+  rows.frameTimes[i] = trajectory.frameTime;
+
+  glm::vec3 lower(FLT_MAX), upper(-FLT_MAX);
+  for (const glm::vec4& joint : trajectory.joints)
+  {
+    lower = glm::min(lower, glm::vec3(joint));
+    upper = glm::max(upper, glm::vec3(joint));
+  }
+  rows.boundsMin[i] = lower;
+  rows.boundsMax[i] = upper;
+
+  // middle frame relative to the root on the floor, turned to face +z
+  unsigned int frame = numFrames / 2;
+  const glm::vec4* pose = &trajectory.joints[(size_t)frame * numJoints];
+  glm::vec2 heading = rootHeading(trajectory, frame);
+  const std::vector<int>& parents = bvh.getJointParents();
+  for (unsigned int j = 0; j < numJoints && j < CatalogThumbnailJoints; j++)
+  {
+    float x = pose[j].x - pose[0].x;
+    float z = pose[j].z - pose[0].z;
+    rows.thumbnails[i * CatalogThumbnailJoints + j] = glm::vec3(x * heading.y - z * heading.x, pose[j].y,
+                                                                x * heading.x + z * heading.y);
+    rows.thumbnailParents[i * CatalogThumbnailJoints + j] = (signed char)parents[j];
+  }
+
+  if (numJoints < MinBodyModelJoints)
+    return true;
+
+  bakeModelCOM(model, clip.sex, trajectory);
+  glm::vec3 sum(0.0f);
+  glm::vec2 height(FLT_MAX, -FLT_MAX);
+  float path = 0.0f;
+  for (unsigned int f = 0; f < numFrames; f++)
+  {
+    glm::vec3 com(trajectory.bodyCOM[f]);
+    sum += com;
+    height.x = std::min(height.x, com.y);
+    height.y = std::max(height.y, com.y);
+    if (f > 0)
+    {
+      float dx = com.x - trajectory.bodyCOM[f - 1].x;
+      float dz = com.z - trajectory.bodyCOM[f - 1].z;
+      path += std::sqrt(dx * dx + dz * dz);
+    }
+  }
+  float duration = (numFrames - 1) * trajectory.frameTime;
+  rows.flags[i] |= CatalogHasCOM;
+  rows.comMean[i] = sum / (float)numFrames;
+  rows.comHeight[i] = height;
+  rows.comPath[i] = path;
+  rows.comSpeed[i] = duration > 0.0f ? path / duration : 0.0f;
+  return true;
+}
+
+static void copyRow(const CatalogRows& from, size_t source, CatalogRows& to, size_t target)
+{
+  to.skeletonHashes[target] = from.skeletonHashes[source];
+  to.flags[target] = from.flags[source];
+  to.numFrames[target] = from.numFrames[source];
+  to.numJoints[target] = from.numJoints[source];
+  to.frameTimes[target] = from.frameTimes[source];
+  to.boundsMin[target] = from.boundsMin[source];
+  to.boundsMax[target] = from.boundsMax[source];
+  to.comMean[target] = from.comMean[source];
+  to.comHeight[target] = from.comHeight[source];
+  to.comPath[target] = from.comPath[source];
+  to.comSpeed[target] = from.comSpeed[source];
+  std::copy_n(&from.thumbnails[source * CatalogThumbnailJoints], CatalogThumbnailJoints,
+              &to.thumbnails[target * CatalogThumbnailJoints]);
+  std::copy_n(&from.thumbnailParents[source * CatalogThumbnailJoints], CatalogThumbnailJoints,
+              &to.thumbnailParents[target * CatalogThumbnailJoints]);
+}
+
+bool indexCatalog(const std::string& source, const std::string& filename, int model, CatalogProgress& progress)
+{
+  progress.numDone = 0;
+  progress.numTotal = 0;
+  progress.numReused = 0;
+  progress.numFailed = 0;
+
+  std::vector<ClipEntry> clips;
+  if (!catalogSources(source, clips))
+    return false;
+
+  // the previous catalog is copied out so its file can be replaced while this runs
+  CatalogRows previous;
+  int previousModel = -1;
+  {
+    unsigned long long size;
+    long long time;
+    ClipCatalog catalog;
+    if (fileStatus(filename, size, time) && openCatalog(filename, catalog))
+    {
+      readCatalogRows(catalog, previous);
+      previousModel = catalog.model;
+      closeCatalog(catalog);
+    }
+  }
+  std::unordered_map<std::string, unsigned int> previousRows;
+  if (previousModel == model)
+  {
+    for (unsigned int i = 0; i < (unsigned int)previous.paths.size(); i++)
+      previousRows[previous.paths[i]] = i;
+  }
+
+  CatalogRows rows;
+  resizeRows(rows, clips.size());
+  progress.numTotal = (unsigned int)clips.size();
+
+  std::vector<unsigned int> changed;
+  for (unsigned int i = 0; i < (unsigned int)clips.size(); i++)
+  {
+    rows.paths[i] = clips[i].path;
+    if (!fileStatus(clips[i].path, rows.fileSizes[i], rows.fileTimes[i]))
+      rows.fileSizes[i] = rows.fileTimes[i] = 0;
+
+    auto found = previousRows.find(clips[i].path);
+    if (found != previousRows.end() && previous.fileSizes[found->second] == rows.fileSizes[i] &&
+        previous.fileTimes[found->second] == rows.fileTimes[i])
+    {
+      copyRow(previous, found->second, rows, i);
+      progress.numReused++;
+      progress.numDone++;
+    }
+    else
+    {
+      changed.push_back(i);
+    }
+  }
+
+  AnthropometricModel anthropometricModel = model == CustomModel ? ZatsiorskyDeLevaModel : (AnthropometricModel)model;
+  std::atomic<unsigned int> numFailed(0);
+  parallelFor(0, (unsigned int)changed.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int c = begin; c < end && !progress.cancel; c++)
+    {
+      if (!indexClip(clips[changed[c]], anthropometricModel, rows, changed[c]))
+        numFailed++;
+      progress.numDone++;
+    }
+  }, 1);
+  progress.numFailed = numFailed;
+  if (progress.cancel)
+    return false;
+
+  return writeCatalog(rows, model, filename + ".tmp");
+}
+
+void startCatalogIndexer(CatalogIndexer& indexer, const std::string& source, const std::string& filename, int model)
+{
+  if (indexer.running)
+    return;
+  indexer.progress.cancel = false;
+  indexer.finished = false;
+  indexer.succeeded = false;
+  indexer.running = true;
+  indexer.filename = filename;
+  indexer.thread = std::thread([&indexer, source, filename, model]()
+  {
+    indexer.succeeded = indexCatalog(source, filename, model, indexer.progress);
+    indexer.finished = true;
+  });
+}
+
+bool finishCatalogIndexer(CatalogIndexer& indexer, ClipCatalog& catalog)
+{
+  if (!indexer.running || !indexer.finished)
+    return false;
+  indexer.thread.join();
+  indexer.running = false;
+  if (!indexer.succeeded)
+    return false;
+
+  // windows can't replace a mapped file
+  closeCatalog(catalog);
+  replaceFile(indexer.filename + ".tmp", indexer.filename);
+  return openCatalog(indexer.filename, catalog);
+}
+
+void stopCatalogIndexer(CatalogIndexer& indexer)
+{
+  if (!indexer.running)
+    return;
+  indexer.progress.cancel = true;
+  indexer.thread.join();
+  indexer.running = false;
+}
+
+static bool containsText(const char* path, const std::string& lowerText)
+{
+  if (lowerText.empty())
+    return true;
+  size_t length = strlen(path);
+  for (size_t start = 0; start + lowerText.size() <= length; start++)
+  {
+    size_t i = 0;
+    while (i < lowerText.size() && std::tolower((unsigned char)path[start + i]) == lowerText[i])
+      i++;
+    if (i == lowerText.size())
+      return true;
+  }
+  return false;
+}
+
+void filterCatalog(const ClipCatalog& catalog, const CatalogFilter& filter, std::vector<unsigned int>& clips)
+{
+  clips.clear();
+  std::string text = filter.text;
+  for (char& c : text)
+    c = (char)std::tolower((unsigned char)c);
+  unsigned int maxFrames = filter.maxFrames > 0 ? filter.maxFrames : ~0u;
+  unsigned int required = CatalogLoaded | (filter.requireCOM ? CatalogHasCOM : 0);
+
+  // chunks keep their own matches, concatenated in order afterwards
+  unsigned int numChunks = (catalog.numClips + 4095) / 4096;
+  std::vector<std::vector<unsigned int>> chunkClips(numChunks);
+  parallelFor(0, numChunks, [&](unsigned int beginChunk, unsigned int endChunk)
+  {
+    for (unsigned int chunk = beginChunk; chunk < endChunk; chunk++)
+    {
+      unsigned int end = std::min(catalog.numClips, (chunk + 1) * 4096);
+      for (unsigned int i = chunk * 4096; i < end; i++)
+      {
+        // numeric columns first, the path is only touched by clips that pass them
+        if ((catalog.flags[i] & required) != required || catalog.numFrames[i] < filter.minFrames ||
+            catalog.numFrames[i] > maxFrames || (filter.skeleton != 0 && catalog.skeletonHashes[i] != filter.skeleton))
+          continue;
+        if (containsText(catalogPath(catalog, i), text))
+          chunkClips[chunk].push_back(i);
+      }
+    }
+  }, 1);
+
+  for (const std::vector<unsigned int>& chunk : chunkClips)
+    clips.insert(clips.end(), chunk.begin(), chunk.end());
+}
+
+void sortCatalog(const ClipCatalog& catalog, int key, bool descending, std::vector<unsigned int>& clips)
+{
+  auto sortBy = [&](auto value)
+  {
+    std::stable_sort(clips.begin(), clips.end(), [&](unsigned int a, unsigned int b)
+    {
+      return descending ? value(b) < value(a) : value(a) < value(b);
+    });
+  };
+
+  switch (key)
+  {
+  case CatalogSortFrames:
+    sortBy([&](unsigned int i) { return catalog.numFrames[i]; });
+    break;
+  case CatalogSortDuration:
+    sortBy([&](unsigned int i) { return catalog.numFrames[i] * catalog.frameTimes[i]; });
+    break;
+  case CatalogSortHeight:
+    sortBy([&](unsigned int i) { return catalog.boundsMax[i].y - catalog.boundsMin[i].y; });
+    break;
+  case CatalogSortSpeed:
+    sortBy([&](unsigned int i) { return catalog.comSpeed[i]; });
+    break;
+  case CatalogSortSkeleton:
+    sortBy([&](unsigned int i) { return catalog.skeletonHashes[i]; });
+    break;
+  default:
+    std::stable_sort(clips.begin(), clips.end(), [&](unsigned int a, unsigned int b)
+    {
+      int order = strcmp(catalogPath(catalog, a), catalogPath(catalog, b));
+      return descending ? order > 0 : order < 0;
+    });
+    break;
+  }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FileSystem.h"
+
+class Bvh2;
+struct ClipEntry;
+
+// joints kept of each clip's thumbnail pose, the first ones in depth first order
+#define CatalogThumbnailJoints 32
+
+// flags of a catalog row
+#define CatalogLoaded 0x01 // the clip parsed, frames, bounds and thumbnail are set
+#define CatalogHasCOM 0x02 // the skeleton fits the body model, the COM summary is set
+
+// sort keys of sortCatalog
+#define CatalogSortPath 0
+#define CatalogSortFrames 1
+#define CatalogSortDuration 2
+#define CatalogSortHeight 3
+#define CatalogSortSpeed 4
+#define CatalogSortSkeleton 5
+
+// one column per field, clip i is element i of every column. used to build catalogs,
+// a mapped ClipCatalog points at the same columns in the file
+struct CatalogRows
+{
+  std::vector<std::string> paths;
+  std::vector<unsigned long long> fileSizes;
+  std::vector<long long> fileTimes;
+  std::vector<unsigned long long> skeletonHashes;
+  std::vector<unsigned int> flags;
+  std::vector<unsigned int> numFrames;
+  std::vector<unsigned int> numJoints;
+  std::vector<float> frameTimes;
+  std::vector<glm::vec3> boundsMin;    // every joint of every frame, cm
+  std::vector<glm::vec3> boundsMax;
+  std::vector<glm::vec3> comMean;
+  std::vector<glm::vec2> comHeight;    // lowest and highest body COM
+  std::vector<float> comPath;          // length of the COM path on the floor, cm
+  std::vector<float> comSpeed;         // mean speed along that path, cm/s
+  std::vector<glm::vec3> thumbnails;   // clip * CatalogThumbnailJoints + joint, middle frame relative
+                                       // to the root on the floor, facing +z
+  std::vector<signed char> thumbnailParents; // -1 for the root and for unused joints
+};
+
+// catalog file opened in place, the pointers stay valid until closeCatalog
+struct ClipCatalog
+{
+  MappedFile file;
+  unsigned int numClips = 0;
+  int model = 0; // anthropometric model of the COM summaries
+
+  const unsigned int* pathOffsets = nullptr; // numClips + 1, into paths, every path ends with a 0
+  const char* paths = nullptr;
+  const unsigned long long* fileSizes = nullptr;
+  const long long* fileTimes = nullptr;
+  const unsigned long long* skeletonHashes = nullptr;
+  const unsigned int* flags = nullptr;
+  const unsigned int* numFrames = nullptr;
+  const unsigned int* numJoints = nullptr;
+  const float* frameTimes = nullptr;
+  const glm::vec3* boundsMin = nullptr;
+  const glm::vec3* boundsMax = nullptr;
+  const glm::vec3* comMean = nullptr;
+  const glm::vec2* comHeight = nullptr;
+  const float* comPath = nullptr;
+  const float* comSpeed = nullptr;
+  const glm::vec3* thumbnails = nullptr;
+  const signed char* thumbnailParents = nullptr;
+};
+
+struct CatalogFilter
+{
+  std::string text;                 // part of the path, case insensitive, empty matches all
+  unsigned int minFrames = 0;
+  unsigned int maxFrames = 0;       // 0 has no upper limit
+  unsigned long long skeleton = 0;  // skeleton hash the clips must have, 0 matches all
+  bool requireCOM = false;
+};
+
+struct CatalogProgress
+{
+  std::atomic<unsigned int> numDone{ 0 };
+  std::atomic<unsigned int> numTotal{ 0 };
+  std::atomic<bool> cancel{ false };
+  unsigned int numReused = 0;  // rows copied from the previous catalog
+  unsigned int numFailed = 0;  // clips that didn't parse
+};
+
+// runs indexCatalog on its own thread, finishCatalogIndexer swaps the new file in
+struct CatalogIndexer
+{
+  std::thread thread;
+  CatalogProgress progress;
+  std::string filename; // catalog the new file replaces
+  std::atomic<bool> finished{ false };
+  bool succeeded = false;
+  bool running = false;
+};
+
+bool openCatalog(const std::string& filename, ClipCatalog& catalog);
+void closeCatalog(ClipCatalog& catalog);
+bool writeCatalog(const CatalogRows& rows, int model, const std::string& filename);
+
+// copies the columns of an open catalog back into rows
+void readCatalogRows(const ClipCatalog& catalog, CatalogRows& rows);
+
+inline const char* catalogPath(const ClipCatalog& catalog, unsigned int clip)
+{
+  return catalog.paths + catalog.pathOffsets[clip];
+}
+
+// hash of the joint names, parents and channel layout, offsets are left out so the same
+// skeleton of different subjects hashes the same
+unsigned long long skeletonHash(const Bvh2& bvh);
+
+// the .bvh files below source when it's a directory, the clips of the manifest otherwise
+bool catalogSources(const std::string& source, std::vector<ClipEntry>& clips);
+
+// indexes the clips of source in parallel into filename + ".tmp". rows of the catalog in filename
+// whose file size and write time didn't change are reused, removed files are dropped
+bool indexCatalog(const std::string& source, const std::string& filename, int model, CatalogProgress& progress);
+
+void startCatalogIndexer(CatalogIndexer& indexer, const std::string& source, const std::string& filename, int model);
+
+// true once, when the indexer finished and the catalog was reopened on the new file. cheap
+// while it runs, call it every frame
+bool finishCatalogIndexer(CatalogIndexer& indexer, ClipCatalog& catalog);
+
+// cancels a running indexer and waits for it, the old catalog stays as it was
+void stopCatalogIndexer(CatalogIndexer& indexer);
+
+// indices of the clips that pass the filter, in catalog order
+void filterCatalog(const ClipCatalog& catalog, const CatalogFilter& filter, std::vector<unsigned int>& clips);
+
+void sortCatalog(const ClipCatalog& catalog, int key, bool descending, std::vector<unsigned int>& clips);
@@ -0,0 +1,275 @@
+#include "Dynamics.h"
+
+#include "ParallelFor.h"
+#include "Simd.h"
+#include "Stability.h"
+
+#include <algorithm>
+
+// x, y, z channels of one signal over all frames, padded to a multiple of 4
+struct Channels
+{
+  std::vector<float> x, y, z;
+
+  void resize(size_t size)
+  {
+    x.assign(size, 0.0f);
+    y.assign(size, 0.0f);
+    z.assign(size, 0.0f);
+  }
+
+  vec3x4 load(size_t frame) const { return vec3x4::load(&x[frame], &y[frame], &z[frame]); }
+  void store(size_t frame, const vec3x4& value) { value.store(&x[frame], &y[frame], &z[frame]); }
+};
+
+// second derivative with central differences, the ends copy their neighbours
+static void differentiateTwice(const std::vector<float>& in, std::vector<float>& out, unsigned int numFrames, float dt)
+{
+  float scale = 1.0f / (dt * dt);
+  for (unsigned int frame = 1; frame + 1 < numFrames; frame++)
+    out[frame] = (in[frame + 1] - 2.0f * in[frame] + in[frame - 1]) * scale;
+
+  if (numFrames >= 3)
+  {
+    out[0] = out[1];
+    out[numFrames - 1] = out[numFrames - 2];
+  }
+}
+
+static void accelerate(const Channels& position, Channels& acceleration, unsigned int numFrames, float dt)
+{
+  differentiateTwice(position.x, acceleration.x, numFrames, dt);
+  differentiateTwice(position.y, acceleration.y, numFrames, dt);
+  differentiateTwice(position.z, acceleration.z, numFrames, dt);
+}
+
+void buildDynamicsTopology(const std::vector<int>& jointParents, DynamicsTopology& topology)
+{
+  // the parent segment ends at the proximal joint or at one of its ancestors
+  for (int s = 0; s < NumSegments; s++)
+  {
+    topology.parentSegment[s] = -1;
+    int joint = segmentJoints[s].proximal;
+    bool ancestor = false;
+
+    while (joint >= 0 && topology.parentSegment[s] < 0)
+    {
+      for (int t = 0; t < NumSegments; t++)
+      {
+        if (t == s)
+          continue;
+        if (segmentJoints[t].distal == joint || (ancestor && segmentJoints[t].proximal == joint))
+        {
+          topology.parentSegment[s] = t;
+          break;
+        }
+      }
+      joint = joint < (int)jointParents.size() ? jointParents[joint] : -1;
+      ancestor = true;
+    }
+  }
+
+  bool placed[NumSegments] = {};
+  int count = 0;
+  while (count < NumSegments)
+  {
+    int before = count;
+    for (int s = 0; s < NumSegments; s++)
+    {
+      int parent = topology.parentSegment[s];
+      if (!placed[s] && (parent < 0 || placed[parent]))
+      {
+        topology.order[count++] = s;
+        placed[s] = true;
+      }
+    }
+
+    // a cycle would mean a broken segment table, treat the rest as roots
+    if (count == before)
+    {
+      for (int s = 0; s < NumSegments; s++)
+      {
+        if (!placed[s])
+        {
+          topology.parentSegment[s] = -1;
+          topology.order[count++] = s;
+          placed[s] = true;
+        }
+      }
+    }
+  }
+}
+
+void computeDynamics(const ClipTrajectory& trajectory, const BodyParameters& parameters,
+                     const StabilityResult& stability, const DynamicsTopology& topology,
+                     const DynamicsSettings& settings, DynamicsResult& result)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  size_t paddedFrames = (numFrames + 3) & ~3u;
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+  float unit = settings.lengthUnit;
+
+  result.groundReaction.resize(numFrames);
+  result.jointForces.resize((size_t)numFrames * NumSegments);
+  result.jointMoments.resize((size_t)numFrames * NumSegments);
+  if (numFrames == 0)
+    return;
+
+  float mass[NumSegments];
+  float totalMass = 0.0f;
+  for (int s = 0; s < NumSegments; s++)
+  {
+    mass[s] = parameters.massPercent[s] / 100.0f * parameters.totalBodyWeight;
+    totalMass += mass[s];
+  }
+
+  // transpose to struct of arrays, in meters
+  std::vector<Channels> com(NumSegments), comAcceleration(NumSegments), proximal(NumSegments);
+  Channels bodyCOM, bodyAcceleration, groundReaction;
+  std::vector<float> leftShare(paddedFrames, 0.0f), rightShare(paddedFrames, 0.0f);
+
+  for (int s = 0; s < NumSegments; s++)
+  {
+    com[s].resize(paddedFrames);
+    comAcceleration[s].resize(paddedFrames);
+    proximal[s].resize(paddedFrames);
+  }
+  bodyCOM.resize(paddedFrames);
+  bodyAcceleration.resize(paddedFrames);
+  groundReaction.resize(paddedFrames);
+
+  bool haveContacts = stability.contacts.size() == numFrames;
+
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      const glm::vec4* segments = &trajectory.segmentsCOM[(size_t)frame * NumSegments];
+      const glm::vec4* pose = &trajectory.joints[(size_t)frame * numJoints];
+      for (int s = 0; s < NumSegments; s++)
+      {
+        com[s].x[frame] = segments[s].x * unit;
+        com[s].y[frame] = segments[s].y * unit;
+        com[s].z[frame] = segments[s].z * unit;
+        const glm::vec4& joint = pose[segmentJoints[s].proximal];
+        proximal[s].x[frame] = joint.x * unit;
+        proximal[s].y[frame] = joint.y * unit;
+        proximal[s].z[frame] = joint.z * unit;
+      }
+      bodyCOM.x[frame] = trajectory.bodyCOM[frame].x * unit;
+      bodyCOM.y[frame] = trajectory.bodyCOM[frame].y * unit;
+      bodyCOM.z[frame] = trajectory.bodyCOM[frame].z * unit;
+
+      // split the ground reaction between the feet in contact, closer foot carries more
+      unsigned char contacts = haveContacts ? stability.contacts[frame] : 0xff;
+      bool left = (contacts & (LeftHeelContact | LeftToeContact)) != 0;
+      bool right = (contacts & (RightHeelContact | RightToeContact)) != 0;
+      if (left && right)
+      {
+        glm::vec2 body(trajectory.bodyCOM[frame].x, trajectory.bodyCOM[frame].z);
+        float leftDistance = glm::length(body - glm::vec2(segments[LeftFoot].x, segments[LeftFoot].z));
+        float rightDistance = glm::length(body - glm::vec2(segments[RightFoot].x, segments[RightFoot].z));
+        float sum = leftDistance + rightDistance;
+        leftShare[frame] = sum > 0.0f ? rightDistance / sum : 0.5f;
+        rightShare[frame] = 1.0f - leftShare[frame];
+      }
+      else
+      {
+        leftShare[frame] = left ? 1.0f : 0.0f;
+        rightShare[frame] = right ? 1.0f : 0.0f;
+      }
+    }
+  });
+
+  parallelFor(0, NumSegments + 1, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int s = begin; s < end; s++)
+    {
+      if (s == NumSegments)
+        accelerate(bodyCOM, bodyAcceleration, numFrames, dt);
+      else
+        accelerate(com[s], comAcceleration[s], numFrames, dt);
+    }
+  }, 1);
+
+  // recursive Newton-Euler, four frames per lane, children before parents
+  const float4 gravity(settings.gravity);
+  const float4 zero(0.0f);
+  unsigned int numBlocks = (unsigned int)(paddedFrames / 4);
+
+  std::vector<Channels> forces(NumSegments), moments(NumSegments);
+  for (int s = 0; s < NumSegments; s++)
+  {
+    forces[s].resize(paddedFrames);
+    moments[s].resize(paddedFrames);
+  }
+
+  parallelFor(0, numBlocks, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int block = begin; block < end; block++)
+    {
+      size_t frame = (size_t)block * 4;
+
+      vec3x4 totalReaction = bodyAcceleration.load(frame);
+      totalReaction.y += gravity;
+      totalReaction = totalReaction * float4(totalMass);
+      groundReaction.store(frame, totalReaction);
+
+      vec3x4 childForces[NumSegments];
+      vec3x4 childMoments[NumSegments];
+      for (int s = 0; s < NumSegments; s++)
+      {
+        childForces[s] = vec3x4(zero, zero, zero);
+        childMoments[s] = vec3x4(zero, zero, zero);
+      }
+
+      for (int i = NumSegments - 1; i >= 0; i--)
+      {
+        int s = topology.order[i];
+        vec3x4 c = com[s].load(frame);
+        vec3x4 a = comAcceleration[s].load(frame);
+        vec3x4 p = proximal[s].load(frame);
+        a.y += gravity;
+
+        vec3x4 force = a * float4(mass[s]) + childForces[s];
+        vec3x4 moment = childMoments[s];
+
+        if (s == LeftFoot || s == RightFoot)
+        {
+          // centre of pressure under the foot COM
+          float4 share = float4::load(s == LeftFoot ? &leftShare[frame] : &rightShare[frame]);
+          vec3x4 reaction = totalReaction * share;
+          vec3x4 pressure(c.x, zero, c.z);
+          force -= reaction;
+          moment -= cross(pressure - c, reaction);
+        }
+
+        moment -= cross(p - c, force);
+        forces[s].store(frame, force);
+        moments[s].store(frame, moment);
+
+        int parent = topology.parentSegment[s];
+        if (parent >= 0)
+        {
+          childForces[parent] += force;
+          childMoments[parent] += moment + cross(p - com[parent].load(frame), force);
+        }
+      }
+    }
+  }, 16);
+
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      result.groundReaction[frame] = glm::vec3(groundReaction.x[frame], groundReaction.y[frame], groundReaction.z[frame]);
+      for (int s = 0; s < NumSegments; s++)
+      {
+        size_t index = (size_t)frame * NumSegments + s;
+        result.jointForces[index] = glm::vec3(forces[s].x[frame], forces[s].y[frame], forces[s].z[frame]);
+        result.jointMoments[index] = glm::vec3(moments[s].x[frame], moments[s].y[frame], moments[s].z[frame]);
+      }
+    }
+  });
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BodyModel.h"
+
+struct StabilityResult;
+
+struct DynamicsSettings
+{
+  float lengthUnit = 0.01f; // meters per clip unit, the example clips are in cm
+  float gravity = 9.81f;
+};
+
+// segment tree derived from the Joint hierarchy, built once per skeleton
+struct DynamicsTopology
+{
+  int parentSegment[NumSegments]; // -1 for the root segment
+  int order[NumSegments];         // parents before children
+};
+
+// forces in N and moments in N m, jointForces and jointMoments are what the parent segment
+// applies to the segment at its proximal joint, the root segment gets the residual
+struct DynamicsResult
+{
+  std::vector<glm::vec3> groundReaction; // frame
+  std::vector<glm::vec3> jointForces;    // frame * NumSegments + segment
+  std::vector<glm::vec3> jointMoments;   // frame * NumSegments + segment
+};
+
+void buildDynamicsTopology(const std::vector<int>& jointParents, DynamicsTopology& topology);
+
+// needs segmentsCOM and bodyCOM baked, the ground reaction is shared between the feet
+// in contact, segment angular momentum is not modelled yet
+void computeDynamics(const ClipTrajectory& trajectory, const BodyParameters& parameters,
+                     const StabilityResult& stability, const DynamicsTopology& topology,
+                     const DynamicsSettings& settings, DynamicsResult& result);
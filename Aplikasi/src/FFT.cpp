@@ -0,0 +1,84 @@
+#include "FFT.h"
+
+#include <cmath>
+
+RealFFT::RealFFT(unsigned int size)
+  : size(size < 4 ? 4 : nextPowerOfTwo(size)), half(this->size / 2)
+{
+  const double pi = 3.14159265358979323846;
+
+  unsigned int bits = 0;
+  while ((1u << bits) < half)
+    bits++;
+
+  bitReverse.resize(half);
+  for (unsigned int i = 0; i < half; i++)
+  {
+    unsigned int reversed = 0;
+    for (unsigned int b = 0; b < bits; b++)
+      reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+    bitReverse[i] = reversed;
+  }
+
+  twiddles.resize(half / 2);
+  for (unsigned int k = 0; k < half / 2; k++)
+    twiddles[k] = std::complex<float>((float)std::cos(-2.0 * pi * k / half), (float)std::sin(-2.0 * pi * k / half));
+
+  splitTwiddles.resize(half / 2 + 1);
+  for (unsigned int k = 0; k <= half / 2; k++)
+    splitTwiddles[k] = std::complex<float>((float)std::cos(-2.0 * pi * k / this->size), (float)std::sin(-2.0 * pi * k / this->size));
+}
+
+void RealFFT::forward(const float* input, std::complex<float>* output) const
+{
+  typedef std::complex<float> Complex;
+
+  // even samples as real and odd samples as imaginary parts, in bit reversed order
+  for (unsigned int i = 0; i < half; i++)
+  {
+    unsigned int j = bitReverse[i];
+    output[j] = Complex(input[2 * i], input[2 * i + 1]);
+  }
+
+  // iterative radix 2 butterflies, the twiddle stride halves every stage
+  for (unsigned int length = 2; length <= half; length <<= 1)
+  {
+    unsigned int halfLength = length / 2;
+    unsigned int stride = half / length;
+    for (unsigned int start = 0; start < half; start += length)
+    {
+      Complex* a = output + start;
+      Complex* b = a + halfLength;
+      for (unsigned int k = 0; k < halfLength; k++)
+      {
+        const Complex& w = twiddles[k * stride];
+        float re = b[k].real() * w.real() - b[k].imag() * w.imag();
+        float im = b[k].real() * w.imag() + b[k].imag() * w.real();
+        Complex t(re, im);
+        b[k] = a[k] - t;
+        a[k] += t;
+      }
+    }
+  }
+
+  // split the half size transform into the spectrum of the real input
+  Complex z0 = output[0];
+  output[0] = Complex(z0.real() + z0.imag(), 0.0f);
+  output[half] = Complex(z0.real() - z0.imag(), 0.0f);
+
+  for (unsigned int k = 1; k <= half / 2; k++)
+  {
+    unsigned int m = half - k;
+    Complex zk = output[k];
+    Complex zm = output[m];
+
+    Complex evenK = 0.5f * (zk + std::conj(zm));
+    Complex oddK = Complex(0.0f, -0.5f) * (zk - std::conj(zm));
+    Complex evenM = 0.5f * (zm + std::conj(zk));
+    Complex oddM = Complex(0.0f, -0.5f) * (zm - std::conj(zk));
+
+    // exp(-2 pi i (half - k) / size) = -conj(exp(-2 pi i k / size))
+    output[k] = evenK + splitTwiddles[k] * oddK;
+    output[m] = evenM - std::conj(splitTwiddles[k]) * oddM;
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+// forward FFT of real input, size a power of two. The plan holds the bit reversal and
+// twiddle tables so one instance can transform any number of segments, also from several threads
+class RealFFT
+{
+public:
+  explicit RealFFT(unsigned int size);
+
+  unsigned int getSize() const { return size; }
+
+  // output holds size / 2 + 1 bins, from DC to Nyquist
+  void forward(const float* input, std::complex<float>* output) const;
+
+private:
+  unsigned int size;
+  unsigned int half;
+  std::vector<unsigned int> bitReverse;           // half
+  std::vector<std::complex<float>> twiddles;      // half / 2, of the half size complex transform
+  std::vector<std::complex<float>> splitTwiddles; // half / 2 + 1, exp(-2 pi i k / size)
+};
+
+inline unsigned int nextPowerOfTwo(unsigned int value)
+{
+  unsigned int power = 1;
+  while (power < value)
+    power <<= 1;
+  return power;
+}
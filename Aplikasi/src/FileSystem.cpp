@@ -0,0 +1,195 @@
+#include "FileSystem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool mapFile(const std::string& filename, MappedFile& mapped)
+{
+  unmapFile(mapped);
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  if (data == nullptr)
+  {
+    if (mapping != nullptr)
+      CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  mapped.data = (const unsigned char*)data;
+  mapped.size = (size_t)size.QuadPart;
+  mapped.file = file;
+  mapped.mapping = mapping;
+#else
+  int file = open(filename.c_str(), O_RDONLY);
+  if (file < 0)
+    return false;
+
+  struct stat status;
+  if (fstat(file, &status) != 0 || status.st_size == 0)
+  {
+    close(file);
+    return false;
+  }
+
+  // the mapping keeps the file alive, the descriptor isn't needed anymore
+  void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (data == MAP_FAILED)
+    return false;
+
+  mapped.data = (const unsigned char*)data;
+  mapped.size = (size_t)status.st_size;
+#endif
+  return true;
+}
+
+void unmapFile(MappedFile& mapped)
+{
+  if (mapped.data == nullptr)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(mapped.data);
+  CloseHandle((HANDLE)mapped.mapping);
+  CloseHandle((HANDLE)mapped.file);
+#else
+  munmap((void*)mapped.data, mapped.size);
+#endif
+  mapped = MappedFile();
+}
+
+bool fileStatus(const std::string& filename, unsigned long long& size, long long& time)
+{
+#ifdef _WIN32
+  struct _stat64 status;
+  if (_stat64(filename.c_str(), &status) != 0)
+    return false;
+#else
+  struct stat status;
+  if (stat(filename.c_str(), &status) != 0)
+    return false;
+#endif
+  size = (unsigned long long)status.st_size;
+  time = (long long)status.st_mtime;
+  return true;
+}
+
+bool isDirectory(const std::string& path)
+{
+#ifdef _WIN32
+  DWORD attributes = GetFileAttributesA(path.c_str());
+  return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+#endif
+}
+
+static bool hasExtension(const std::string& name, const std::vector<std::string>& extensions)
+{
+  for (const std::string& extension : extensions)
+  {
+    if (name.size() < extension.size())
+      continue;
+    bool same = true;
+    size_t start = name.size() - extension.size();
+    for (size_t i = 0; i < extension.size() && same; i++)
+      same = std::tolower((unsigned char)name[start + i]) == std::tolower((unsigned char)extension[i]);
+    if (same)
+      return true;
+  }
+  return false;
+}
+
+static void listDirectory(const std::string& directory, const std::vector<std::string>& extensions,
+                          std::vector<std::string>& paths)
+{
+#ifdef _WIN32
+  WIN32_FIND_DATAA entry;
+  HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+  if (find == INVALID_HANDLE_VALUE)
+    return;
+  do
+  {
+    std::string name = entry.cFileName;
+    if (name == "." || name == "..")
+      continue;
+    std::string path = directory + "/" + name;
+    if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      listDirectory(path, extensions, paths);
+    else if (hasExtension(name, extensions))
+      paths.push_back(path);
+  } while (FindNextFileA(find, &entry));
+  FindClose(find);
+#else
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr)
+    return;
+  while (dirent* entry = readdir(dir))
+  {
+    std::string name = entry->d_name;
+    if (name == "." || name == "..")
+      continue;
+    std::string path = directory + "/" + name;
+    bool folder = entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && isDirectory(path));
+    if (folder)
+      listDirectory(path, extensions, paths);
+    else if (hasExtension(name, extensions))
+      paths.push_back(path);
+  }
+  closedir(dir);
+#endif
+}
+
+void listFiles(const std::string& directory, const std::vector<std::string>& extensions, std::vector<std::string>& paths)
+{
+  paths.clear();
+  std::string root = directory;
+  while (root.size() > 1 && (root.back() == '/' || root.back() == '\\'))
+    root.pop_back();
+  listDirectory(root, extensions, paths);
+  std::sort(paths.begin(), paths.end());
+}
+
+bool replaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+  bool replaced = MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  bool replaced = std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+  if (!replaced)
+    std::cout << "Failed to replace " << to << std::endl;
+  return replaced;
+}
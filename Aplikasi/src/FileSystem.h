@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// read only view of a whole file, data stays valid until unmapFile
+struct MappedFile
+{
+  const unsigned char* data = nullptr;
+  size_t size = 0;
+  void* file = nullptr;    // HANDLE on windows, unused elsewhere
+  void* mapping = nullptr; // HANDLE on windows, unused elsewhere
+};
+
+bool mapFile(const std::string& filename, MappedFile& mapped);
+void unmapFile(MappedFile& mapped);
+
+// size in bytes and last write time in seconds, false when the file doesn't exist
+bool fileStatus(const std::string& filename, unsigned long long& size, long long& time);
+
+// files below directory whose names end with one of the extensions, case insensitive, sorted
+void listFiles(const std::string& directory, const std::vector<std::string>& extensions, std::vector<std::string>& paths);
+
+bool isDirectory(const std::string& path);
+
+// moves from over to, replacing it. to must not be mapped on windows
+bool replaceFile(const std::string& from, const std::string& to);
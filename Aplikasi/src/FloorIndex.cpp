@@ -0,0 +1,312 @@
+#include "FloorIndex.h"
+
+#include "Aggregation.h"
+#include "AnthropometricModels.h"
+#include "bvh2.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+
+// points per cell the grid aims for, and the most cells it allocates
+#define FloorCellPoints 4
+#define MaxFloorCells (1 << 20)
+
+static bool byClipAndFrame(const FloorPoint& a, const FloorPoint& b)
+{
+  if (a.clip != b.clip)
+    return a.clip < b.clip;
+  if (a.frame != b.frame)
+    return a.frame < b.frame;
+  return a.kind < b.kind;
+}
+
+// grid and counting sort of the gathered points into cell order
+static void finishFloorIndex(std::vector<FloorPoint>& gathered, FloorIndex& index)
+{
+  unsigned int numPoints = (unsigned int)gathered.size();
+  unsigned int numChunks = std::max(1u, std::min(16u, std::thread::hardware_concurrency()));
+  unsigned int chunkSize = (numPoints + numChunks - 1) / numChunks;
+
+  std::vector<float> chunkBounds(numChunks * 4);
+  parallelFor(0, numChunks, [&](unsigned int beginChunk, unsigned int endChunk)
+  {
+    for (unsigned int chunk = beginChunk; chunk < endChunk; chunk++)
+    {
+      float bounds[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+      unsigned int end = std::min(numPoints, (chunk + 1) * chunkSize);
+      for (unsigned int p = chunk * chunkSize; p < end; p++)
+      {
+        bounds[0] = std::min(bounds[0], gathered[p].x);
+        bounds[1] = std::min(bounds[1], gathered[p].z);
+        bounds[2] = std::max(bounds[2], gathered[p].x);
+        bounds[3] = std::max(bounds[3], gathered[p].z);
+      }
+      std::copy(bounds, bounds + 4, &chunkBounds[chunk * 4]);
+    }
+  }, 1);
+
+  float bounds[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (unsigned int chunk = 0; chunk < numChunks; chunk++)
+  {
+    bounds[0] = std::min(bounds[0], chunkBounds[chunk * 4 + 0]);
+    bounds[1] = std::min(bounds[1], chunkBounds[chunk * 4 + 1]);
+    bounds[2] = std::max(bounds[2], chunkBounds[chunk * 4 + 2]);
+    bounds[3] = std::max(bounds[3], chunkBounds[chunk * 4 + 3]);
+  }
+  if (numPoints == 0)
+    bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0.0f;
+
+  float width = bounds[2] - bounds[0];
+  float depth = bounds[3] - bounds[1];
+  float targetCells = std::max(1.0f, (float)numPoints / FloorCellPoints);
+  index.cellSize = std::max(1.0f, std::sqrt(std::max(width * depth, 1.0f) / targetCells));
+  while ((double)(width / index.cellSize + 1) * (depth / index.cellSize + 1) > MaxFloorCells)
+    index.cellSize *= 1.5f;
+  index.minX = bounds[0];
+  index.minZ = bounds[1];
+  index.columns = (unsigned int)(width / index.cellSize) + 1;
+  index.rows = (unsigned int)(depth / index.cellSize) + 1;
+  unsigned int numCells = index.columns * index.rows;
+
+  // counting sort, every chunk counts its points per cell and scatters from its own offsets
+  std::vector<unsigned int> cells(numPoints);
+  std::vector<std::vector<unsigned int>> counts(numChunks);
+  parallelFor(0, numChunks, [&](unsigned int beginChunk, unsigned int endChunk)
+  {
+    for (unsigned int chunk = beginChunk; chunk < endChunk; chunk++)
+    {
+      counts[chunk].assign(numCells, 0);
+      unsigned int end = std::min(numPoints, (chunk + 1) * chunkSize);
+      for (unsigned int p = chunk * chunkSize; p < end; p++)
+      {
+        unsigned int column = std::min(index.columns - 1, (unsigned int)((gathered[p].x - index.minX) / index.cellSize));
+        unsigned int row = std::min(index.rows - 1, (unsigned int)((gathered[p].z - index.minZ) / index.cellSize));
+        cells[p] = row * index.columns + column;
+        counts[chunk][cells[p]]++;
+      }
+    }
+  }, 1);
+
+  index.cellBegin.assign(numCells + 1, 0);
+  unsigned int offset = 0;
+  for (unsigned int cell = 0; cell < numCells; cell++)
+  {
+    index.cellBegin[cell] = offset;
+    for (unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+      unsigned int count = counts[chunk][cell];
+      counts[chunk][cell] = offset;
+      offset += count;
+    }
+  }
+  index.cellBegin[numCells] = offset;
+
+  index.points.resize(numPoints);
+  parallelFor(0, numChunks, [&](unsigned int beginChunk, unsigned int endChunk)
+  {
+    for (unsigned int chunk = beginChunk; chunk < endChunk; chunk++)
+    {
+      unsigned int end = std::min(numPoints, (chunk + 1) * chunkSize);
+      for (unsigned int p = chunk * chunkSize; p < end; p++)
+        index.points[counts[chunk][cells[p]]++] = gathered[p];
+    }
+  }, 1);
+}
+
+static void gatherClip(const ClipTrajectory& trajectory, unsigned int clip, FloorPoint* points)
+{
+  for (unsigned int frame = 0; frame < trajectory.numFrames; frame++)
+  {
+    const glm::vec4& root = trajectory.joints[(size_t)frame * trajectory.numJoints];
+    const glm::vec4& com = trajectory.bodyCOM[frame];
+    points[frame * 2] = FloorPoint{ root.x, root.z, clip, frame, FloorRoot };
+    points[frame * 2 + 1] = FloorPoint{ com.x, com.z, clip, frame, FloorCOM };
+  }
+}
+
+void buildFloorIndex(const std::vector<const ClipTrajectory*>& trajectories, const std::vector<std::string>& names,
+                     FloorIndex& index)
+{
+  index = FloorIndex();
+  index.clips = names;
+  index.clips.resize(trajectories.size());
+  index.clipFrames.resize(trajectories.size());
+
+  std::vector<size_t> offsets(trajectories.size() + 1, 0);
+  for (size_t i = 0; i < trajectories.size(); i++)
+  {
+    bool baked = trajectories[i]->bodyCOM.size() == trajectories[i]->numFrames && trajectories[i]->numJoints > 0;
+    index.clipFrames[i] = baked ? trajectories[i]->numFrames : 0;
+    offsets[i + 1] = offsets[i] + index.clipFrames[i] * 2;
+  }
+
+  std::vector<FloorPoint> gathered(offsets.back());
+  parallelFor(0, (unsigned int)trajectories.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      if (index.clipFrames[i] > 0)
+        gatherClip(*trajectories[i], i, &gathered[offsets[i]]);
+    }
+  }, 1);
+  finishFloorIndex(gathered, index);
+}
+
+unsigned int buildFloorIndex(const std::vector<ClipEntry>& clips, int model, FloorIndex& index)
+{
+  index = FloorIndex();
+  index.clips.resize(clips.size());
+  index.clipFrames.assign(clips.size(), 0);
+  for (size_t i = 0; i < clips.size(); i++)
+    index.clips[i] = clips[i].path;
+
+  std::vector<std::vector<FloorPoint>> clipPoints(clips.size());
+  parallelFor(0, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      Bvh2 bvh;
+      ClipTrajectory trajectory;
+      if (!loadManifestClip(clips[i], model, bvh, trajectory))
+        continue;
+      clipPoints[i].resize((size_t)trajectory.numFrames * 2);
+      gatherClip(trajectory, i, clipPoints[i].data());
+      index.clipFrames[i] = trajectory.numFrames;
+    }
+  }, 1);
+
+  unsigned int failures = 0;
+  std::vector<FloorPoint> gathered;
+  for (size_t i = 0; i < clips.size(); i++)
+  {
+    failures += index.clipFrames[i] == 0 ? 1 : 0;
+    gathered.insert(gathered.end(), clipPoints[i].begin(), clipPoints[i].end());
+    std::vector<FloorPoint>().swap(clipPoints[i]);
+  }
+  finishFloorIndex(gathered, index);
+  return failures;
+}
+
+void queryFloorRange(const FloorIndex& index, float minX, float minZ, float maxX, float maxZ, unsigned int kinds,
+                     std::vector<FloorPoint>& hits)
+{
+  hits.clear();
+  if (index.points.empty() || maxX < minX || maxZ < minZ)
+    return;
+
+  float firstColumn = std::floor((minX - index.minX) / index.cellSize);
+  float lastColumn = std::floor((maxX - index.minX) / index.cellSize);
+  float firstRow = std::floor((minZ - index.minZ) / index.cellSize);
+  float lastRow = std::floor((maxZ - index.minZ) / index.cellSize);
+  if (lastColumn < 0.0f || lastRow < 0.0f || firstColumn >= index.columns || firstRow >= index.rows)
+    return;
+
+  unsigned int column0 = (unsigned int)std::max(0.0f, firstColumn);
+  unsigned int column1 = (unsigned int)std::min((float)index.columns - 1, lastColumn);
+  unsigned int row0 = (unsigned int)std::max(0.0f, firstRow);
+  unsigned int row1 = (unsigned int)std::min((float)index.rows - 1, lastRow);
+
+  for (unsigned int row = row0; row <= row1; row++)
+  {
+    // cells strictly inside the rectangle are taken whole
+    bool rowInside = row > firstRow && row < lastRow;
+    for (unsigned int column = column0; column <= column1; column++)
+    {
+      bool inside = rowInside && column > firstColumn && column < lastColumn;
+      unsigned int cell = row * index.columns + column;
+      for (unsigned int p = index.cellBegin[cell]; p < index.cellBegin[cell + 1]; p++)
+      {
+        const FloorPoint& point = index.points[p];
+        if (!(kinds & (1u << point.kind)))
+          continue;
+        if (inside || (point.x >= minX && point.x <= maxX && point.z >= minZ && point.z <= maxZ))
+          hits.push_back(point);
+      }
+    }
+  }
+  std::sort(hits.begin(), hits.end(), byClipAndFrame);
+}
+
+void queryFloorNearest(const FloorIndex& index, float x, float z, unsigned int k, unsigned int kinds,
+                       std::vector<FloorPoint>& hits)
+{
+  hits.clear();
+  if (index.points.empty() || k == 0)
+    return;
+
+  std::vector<float> distances; // squared, parallel to hits
+  int centerColumn = (int)std::floor((x - index.minX) / index.cellSize);
+  int centerRow = (int)std::floor((z - index.minZ) / index.cellSize);
+  centerColumn = std::max(0, std::min((int)index.columns - 1, centerColumn));
+  centerRow = std::max(0, std::min((int)index.rows - 1, centerRow));
+  int maxRing = (int)std::max(index.columns, index.rows);
+
+  // rings of cells around the query cell until the nearest unvisited cell is too far
+  for (int ring = 0; ring <= maxRing; ring++)
+  {
+    for (int row = centerRow - ring; row <= centerRow + ring; row++)
+    {
+      if (row < 0 || row >= (int)index.rows)
+        continue;
+      bool edgeRow = row == centerRow - ring || row == centerRow + ring;
+      for (int column = centerColumn - ring; column <= centerColumn + ring; column += edgeRow ? 1 : ring * 2)
+      {
+        if (column >= 0 && column < (int)index.columns)
+        {
+          unsigned int cell = row * index.columns + column;
+          for (unsigned int p = index.cellBegin[cell]; p < index.cellBegin[cell + 1]; p++)
+          {
+            const FloorPoint& point = index.points[p];
+            if (!(kinds & (1u << point.kind)))
+              continue;
+            float dx = point.x - x;
+            float dz = point.z - z;
+            float distance = dx * dx + dz * dz;
+            if (hits.size() == k && distance >= distances.back())
+              continue;
+
+            size_t position = std::upper_bound(distances.begin(), distances.end(), distance) - distances.begin();
+            distances.insert(distances.begin() + position, distance);
+            hits.insert(hits.begin() + position, point);
+            if (hits.size() > k)
+            {
+              distances.pop_back();
+              hits.pop_back();
+            }
+          }
+        }
+        if (ring == 0)
+          break;
+      }
+    }
+
+    if (hits.size() == k)
+    {
+      // distance from the query to the outside of the visited square
+      float left = x - (index.minX + (centerColumn - ring) * index.cellSize);
+      float right = index.minX + (centerColumn + ring + 1) * index.cellSize - x;
+      float bottom = z - (index.minZ + (centerRow - ring) * index.cellSize);
+      float top = index.minZ + (centerRow + ring + 1) * index.cellSize - z;
+      float reach = std::min(std::min(left, right), std::min(bottom, top));
+      if (reach > 0.0f && reach * reach >= distances.back())
+        break;
+    }
+  }
+}
+
+void floorHitRanges(const std::vector<FloorPoint>& hits, std::vector<FloorClipRange>& ranges)
+{
+  ranges.clear();
+  for (const FloorPoint& hit : hits)
+  {
+    if (!ranges.empty() && ranges.back().clip == hit.clip && hit.frame <= ranges.back().end)
+    {
+      ranges.back().end = std::max(ranges.back().end, hit.frame + 1);
+      continue;
+    }
+    ranges.push_back(FloorClipRange{ hit.clip, hit.frame, hit.frame + 1 });
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BodyModel.h"
+
+struct ClipEntry;
+
+// what a floor point is the projection of, also bits of the kinds masks
+#define FloorRoot 0
+#define FloorCOM 1
+#define FloorRootMask (1 << FloorRoot)
+#define FloorCOMMask (1 << FloorCOM)
+
+struct FloorPoint
+{
+  float x, z;
+  unsigned int clip;
+  unsigned int frame;
+  unsigned int kind;
+};
+
+// frames [begin, end) of one clip
+struct FloorClipRange
+{
+  unsigned int clip;
+  unsigned int begin;
+  unsigned int end;
+};
+
+// uniform grid over the floor projections of the root and the body COM of every frame,
+// points are stored cell by cell so a cell is one contiguous run
+struct FloorIndex
+{
+  std::vector<std::string> clips;
+  std::vector<unsigned int> clipFrames;
+
+  float minX = 0.0f, minZ = 0.0f;
+  float cellSize = 1.0f;
+  unsigned int columns = 0, rows = 0;
+  std::vector<unsigned int> cellBegin; // row * columns + column, columns * rows + 1 entries
+  std::vector<FloorPoint> points;
+};
+
+// needs joints and bodyCOM baked, built in parallel
+void buildFloorIndex(const std::vector<const ClipTrajectory*>& trajectories, const std::vector<std::string>& names,
+                     FloorIndex& index);
+
+// loads and bakes the clips of a manifest in parallel, returns the number that failed
+unsigned int buildFloorIndex(const std::vector<ClipEntry>& clips, int model, FloorIndex& index);
+
+// points inside [minX, maxX] x [minZ, maxZ] whose kind is in kinds, by clip and frame
+void queryFloorRange(const FloorIndex& index, float minX, float minZ, float maxX, float maxZ, unsigned int kinds,
+                     std::vector<FloorPoint>& hits);
+
+// k points nearest to (x, z) whose kind is in kinds, nearest first
+void queryFloorNearest(const FloorIndex& index, float x, float z, unsigned int k, unsigned int kinds,
+                       std::vector<FloorPoint>& hits);
+
+// hits sorted by clip and frame merged into runs of consecutive frames
+void floorHitRanges(const std::vector<FloorPoint>& hits, std::vector<FloorClipRange>& ranges);
@@ -0,0 +1,310 @@
+#include "FrameSimilarity.h"
+
+#include "MotionLayout.h"
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+// a tile plus one frame of halo on every side, rows padded for whole 8 column stores
+#define TileSide (SimilarityTileFrames + 2)
+#define TileStride (TileSide + 8)
+
+void buildPoseVectors(const ClipTrajectory& trajectory, const std::vector<float>& jointWeights, bool alignHeading,
+                      unsigned int dims, std::vector<float>& features)
+{
+  unsigned int numJoints = trajectory.numJoints;
+  std::vector<float> weights(numJoints, 1.0f);
+  if (jointWeights.size() == numJoints)
+    weights = jointWeights;
+  float totalWeight = 0.0f;
+  for (float weight : weights)
+    totalWeight += weight;
+  // sqrt(w / sum w) on both sides makes the squared difference a weighted mean
+  for (float& weight : weights)
+    weight = totalWeight > 0.0f ? std::sqrt(weight / totalWeight) : 0.0f;
+
+  features.assign((size_t)trajectory.numFrames * dims, 0.0f);
+  parallelFor(0, trajectory.numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      const glm::vec4* joints = &trajectory.joints[(size_t)frame * numJoints];
+      glm::vec2 heading = alignHeading ? rootHeading(trajectory, frame) : glm::vec2(0.0f, 1.0f);
+      float* feature = &features[(size_t)frame * dims];
+      for (unsigned int j = 0; j < numJoints; j++)
+      {
+        glm::vec3 p = glm::vec3(joints[j].x - joints[0].x, joints[j].y, joints[j].z - joints[0].z);
+        feature[j * 3 + 0] = (p.x * heading.y - p.z * heading.x) * weights[j];
+        feature[j * 3 + 1] = p.y * weights[j];
+        feature[j * 3 + 2] = (p.x * heading.x + p.z * heading.y) * weights[j];
+      }
+    }
+  });
+}
+
+struct SimilarityPass
+{
+  const SimilaritySettings& settings;
+  SimilarityResult& result;
+  const float* rows;    // frame * dims
+  const float* columns; // dim * columnStride + frame
+  unsigned int dims;
+  unsigned int columnStride;
+  bool same;
+  bool triangle;
+
+  // distances of rows [r0, r1) against columns [c0, c1) into tile, 4 rows x 8 columns per
+  // step with the eight sums held in registers
+  void computeTile(unsigned int r0, unsigned int r1, unsigned int c0, unsigned int c1, float* tile) const
+  {
+    for (unsigned int i = r0; i < r1; i += 4)
+    {
+      const float* a0 = rows + (size_t)i * dims;
+      const float* a1 = rows + (size_t)std::min(i + 1, r1 - 1) * dims;
+      const float* a2 = rows + (size_t)std::min(i + 2, r1 - 1) * dims;
+      const float* a3 = rows + (size_t)std::min(i + 3, r1 - 1) * dims;
+
+      for (unsigned int j = c0; j < c1; j += 8)
+      {
+        float4 s00, s01, s10, s11, s20, s21, s30, s31;
+        const float* b = columns + j;
+        for (unsigned int d = 0; d < dims; d++, b += columnStride)
+        {
+          float4 x0 = float4::load(b);
+          float4 x1 = float4::load(b + 4);
+          float4 y = float4(a0[d]);
+          float4 e0 = x0 - y, e1 = x1 - y;
+          s00 += e0 * e0;
+          s01 += e1 * e1;
+          y = float4(a1[d]);
+          e0 = x0 - y;
+          e1 = x1 - y;
+          s10 += e0 * e0;
+          s11 += e1 * e1;
+          y = float4(a2[d]);
+          e0 = x0 - y;
+          e1 = x1 - y;
+          s20 += e0 * e0;
+          s21 += e1 * e1;
+          y = float4(a3[d]);
+          e0 = x0 - y;
+          e1 = x1 - y;
+          s30 += e0 * e0;
+          s31 += e1 * e1;
+        }
+
+        float* out = tile + (i - r0) * TileStride + (j - c0);
+        vsqrt(s00).store(out);
+        vsqrt(s01).store(out + 4);
+        if (i + 1 < r1)
+        {
+          vsqrt(s10).store(out + TileStride);
+          vsqrt(s11).store(out + TileStride + 4);
+        }
+        if (i + 2 < r1)
+        {
+          vsqrt(s20).store(out + TileStride * 2);
+          vsqrt(s21).store(out + TileStride * 2 + 4);
+        }
+        if (i + 3 < r1)
+        {
+          vsqrt(s30).store(out + TileStride * 3);
+          vsqrt(s31).store(out + TileStride * 3 + 4);
+        }
+      }
+    }
+  }
+
+  bool excluded(unsigned int i, unsigned int j) const
+  {
+    if (!same)
+      return false;
+    if (triangle && j <= i)
+      return true;
+    return (i > j ? i - j : j - i) <= settings.excludeRadius;
+  }
+
+  // rows of one stripe, they own their heatmap rows and their sparse picks
+  void runStripe(unsigned int stripeBegin, unsigned int stripeEnd, std::vector<SimilarityMatch>& minima,
+                 std::vector<SimilarityMatch>& nearest) const
+  {
+    unsigned int numRows = result.numRows;
+    unsigned int numColumns = result.numColumns;
+    std::vector<float> tile(TileSide * TileStride);
+    std::vector<std::vector<SimilarityMatch>> best(settings.topK > 0 ? stripeEnd - stripeBegin : 0);
+
+    for (unsigned int r0 = stripeBegin; r0 < stripeEnd; r0 += SimilarityTileFrames)
+    {
+      unsigned int r1 = std::min(stripeEnd, r0 + SimilarityTileFrames);
+      unsigned int haloRow0 = r0 > 0 ? r0 - 1 : 0;
+      unsigned int haloRow1 = std::min(numRows, r1 + 1);
+
+      for (unsigned int c0 = triangle ? r0 : 0; c0 < numColumns; c0 += SimilarityTileFrames)
+      {
+        unsigned int c1 = std::min(numColumns, c0 + SimilarityTileFrames);
+        unsigned int haloColumn0 = c0 > 0 ? c0 - 1 : 0;
+        unsigned int haloColumn1 = std::min(numColumns, c1 + 1);
+        unsigned int haloColumns = haloColumn1 - haloColumn0;
+        computeTile(haloRow0, haloRow1, haloColumn0, haloColumn1, tile.data());
+
+        for (unsigned int i = r0; i < r1; i++)
+        {
+          const float* line = &tile[(i - haloRow0) * TileStride];
+          float* heatmap = &result.heatmap[(size_t)(i / result.rowsPerCell) * result.heatmapColumns];
+          for (unsigned int j = c0; j < c1; j++)
+          {
+            unsigned int t = j - haloColumn0;
+            float distance = line[t];
+            float& cell = heatmap[j / result.columnsPerCell];
+            cell = std::min(cell, distance);
+
+            if (excluded(i, j))
+              continue;
+
+            if (settings.topK > 0)
+            {
+              std::vector<SimilarityMatch>& row = best[i - stripeBegin];
+              if (row.size() < settings.topK || distance < row.back().distance)
+              {
+                SimilarityMatch match = { i, j, distance };
+                auto position = std::upper_bound(row.begin(), row.end(), match,
+                                                 [](const SimilarityMatch& x, const SimilarityMatch& y) { return x.distance < y.distance; });
+                row.insert(position, match);
+                if (row.size() > settings.topK)
+                  row.pop_back();
+              }
+            }
+
+            if (settings.localMinima && distance <= settings.maxDistance)
+            {
+              // ties go to the first cell in row major order
+              bool minimum = true;
+              for (int di = -1; di <= 1 && minimum; di++)
+              {
+                if ((di < 0 && i == 0) || (di > 0 && i + 1 >= numRows))
+                  continue;
+                const float* neighborLine = line + di * TileStride;
+                for (int dj = -1; dj <= 1; dj++)
+                {
+                  if ((di == 0 && dj == 0) || (dj < 0 && j == 0) || (dj > 0 && t + 1 >= haloColumns))
+                    continue;
+                  float neighbor = neighborLine[t + dj];
+                  bool before = di < 0 || (di == 0 && dj < 0);
+                  if (before ? neighbor <= distance : neighbor < distance)
+                  {
+                    minimum = false;
+                    break;
+                  }
+                }
+              }
+              if (minimum)
+                minima.push_back(SimilarityMatch{ i, j, distance });
+            }
+          }
+        }
+      }
+    }
+
+    std::sort(minima.begin(), minima.end(), [](const SimilarityMatch& x, const SimilarityMatch& y)
+    {
+      return x.row != y.row ? x.row < y.row : x.column < y.column;
+    });
+    for (const std::vector<SimilarityMatch>& row : best)
+      nearest.insert(nearest.end(), row.begin(), row.end());
+  }
+};
+
+void computeSimilarity(const ClipTrajectory& a, const ClipTrajectory& b, const SimilaritySettings& settings,
+                       SimilarityResult& result)
+{
+  result = SimilarityResult();
+  if (a.numJoints != b.numJoints || a.numFrames == 0 || b.numFrames == 0 || a.rotations.empty() || b.rotations.empty())
+  {
+    std::cout << "Similarity needs two baked clips with the same skeleton" << std::endl;
+    return;
+  }
+
+  bool same = &a == &b;
+  unsigned int dims = (a.numJoints * 3 + 3) & ~3u;
+  std::vector<float> rows;
+  buildPoseVectors(a, settings.jointWeights, settings.alignHeading, dims, rows);
+
+  // columns dim major so neighboring frames are one load, the slack covers the last 8 column step
+  std::vector<float> columnsFrameMajor;
+  const std::vector<float>* frameMajor = &rows;
+  if (!same)
+  {
+    buildPoseVectors(b, settings.jointWeights, settings.alignHeading, dims, columnsFrameMajor);
+    frameMajor = &columnsFrameMajor;
+  }
+  unsigned int columnStride = ((b.numFrames + 3) & ~3u) + 8;
+  std::vector<float> columns((size_t)dims * columnStride, 0.0f);
+  transpose(frameMajor->data(), b.numFrames, dims, dims, columns.data(), columnStride);
+
+  result.numRows = a.numFrames;
+  result.numColumns = b.numFrames;
+  unsigned int heatmapSize = std::max(1u, settings.heatmapSize);
+  result.rowsPerCell = (a.numFrames + heatmapSize - 1) / heatmapSize;
+  result.columnsPerCell = (b.numFrames + heatmapSize - 1) / heatmapSize;
+  result.heatmapRows = (a.numFrames + result.rowsPerCell - 1) / result.rowsPerCell;
+  result.heatmapColumns = (b.numFrames + result.columnsPerCell - 1) / result.columnsPerCell;
+  result.heatmap.assign((size_t)result.heatmapRows * result.heatmapColumns, FLT_MAX);
+
+  SimilarityPass pass = { settings, result, rows.data(), columns.data(), dims, columnStride, same, same && settings.topK == 0 };
+
+  // stripes of whole heatmap rows and at least one tile of frames
+  unsigned int stripeCells = (SimilarityTileFrames + result.rowsPerCell - 1) / result.rowsPerCell;
+  unsigned int stripeFrames = stripeCells * result.rowsPerCell;
+  unsigned int numStripes = (a.numFrames + stripeFrames - 1) / stripeFrames;
+  std::vector<std::vector<SimilarityMatch>> stripeMinima(numStripes);
+  std::vector<std::vector<SimilarityMatch>> stripeNearest(numStripes);
+
+  auto runStripe = [&](unsigned int s)
+  {
+    pass.runStripe(s * stripeFrames, std::min(a.numFrames, (s + 1) * stripeFrames), stripeMinima[s], stripeNearest[s]);
+  };
+
+  if (pass.triangle)
+  {
+    // the first stripes of a triangle are the longest, pair them with the last ones
+    parallelFor(0, (numStripes + 1) / 2, [&](unsigned int begin, unsigned int end)
+    {
+      for (unsigned int p = begin; p < end; p++)
+      {
+        runStripe(p);
+        if (numStripes - 1 - p != p)
+          runStripe(numStripes - 1 - p);
+      }
+    }, 1);
+
+    for (unsigned int r = 0; r < result.heatmapRows; r++)
+    {
+      for (unsigned int c = r + 1; c < result.heatmapColumns; c++)
+      {
+        float& upper = result.heatmap[(size_t)r * result.heatmapColumns + c];
+        float& lower = result.heatmap[(size_t)c * result.heatmapColumns + r];
+        upper = lower = std::min(upper, lower);
+      }
+    }
+  }
+  else
+  {
+    parallelFor(0, numStripes, [&](unsigned int begin, unsigned int end)
+    {
+      for (unsigned int s = begin; s < end; s++)
+        runStripe(s);
+    }, 1);
+  }
+
+  for (unsigned int s = 0; s < numStripes; s++)
+  {
+    result.minima.insert(result.minima.end(), stripeMinima[s].begin(), stripeMinima[s].end());
+    result.nearest.insert(result.nearest.end(), stripeNearest[s].begin(), stripeNearest[s].end());
+  }
+  for (float value : result.heatmap)
+    result.heatmapMax = std::max(result.heatmapMax, value);
+}
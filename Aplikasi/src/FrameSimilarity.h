@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "BodyModel.h"
+
+// frames per side of one tile, sized so a column tile of features stays in L1
+#define SimilarityTileFrames 64
+
+struct SimilaritySettings
+{
+  std::vector<float> jointWeights; // per joint, empty weights every joint 1
+  bool alignHeading = true;        // compare poses turned to the same facing
+  bool localMinima = true;
+  unsigned int topK = 0;           // nearest columns kept per row, 0 keeps none
+  float maxDistance = 10.0f;       // cm, larger local minima are dropped
+  unsigned int excludeRadius = 10; // frames around the diagonal ignored when a clip is compared to itself
+  unsigned int heatmapSize = 128;  // cells per side at most
+};
+
+struct SimilarityMatch
+{
+  unsigned int row;
+  unsigned int column;
+  float distance;
+};
+
+// distances are the weighted RMS of the joint position differences in cm, positions relative
+// to the root on the floor. the full matrix is never stored, only the sparse picks and a
+// heatmap holding the smallest distance of each cell
+struct SimilarityResult
+{
+  unsigned int numRows = 0;
+  unsigned int numColumns = 0;
+
+  unsigned int heatmapRows = 0;
+  unsigned int heatmapColumns = 0;
+  unsigned int rowsPerCell = 1;
+  unsigned int columnsPerCell = 1;
+  std::vector<float> heatmap; // row * heatmapColumns + column
+  float heatmapMax = 0.0f;
+
+  std::vector<SimilarityMatch> minima;  // 2D local minima below maxDistance, by row
+  std::vector<SimilarityMatch> nearest; // up to topK per row, by row then distance
+};
+
+// joint positions relative to the root on the floor, frame * dims + joint * 3 + axis with
+// dims >= numJoints * 3 and the rest zero. each joint is scaled by sqrt(w / sum w) so the
+// squared distance of two vectors is the weighted mean squared joint distance
+void buildPoseVectors(const ClipTrajectory& trajectory, const std::vector<float>& jointWeights, bool alignHeading,
+                      unsigned int dims, std::vector<float>& vectors);
+
+// rows are the frames of a, columns the frames of b. passing the same trajectory twice only
+// computes the upper triangle, keeps minima above the diagonal and mirrors the heatmap,
+// unless topK needs whole rows. needs joints and rotations baked
+void computeSimilarity(const ClipTrajectory& a, const ClipTrajectory& b, const SimilaritySettings& settings,
+                       SimilarityResult& result);
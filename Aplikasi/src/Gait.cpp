@@ -0,0 +1,272 @@
+#include "Gait.h"
+
+#include "Aggregation.h"
+#include "bvh2.h"
+#include "ParallelFor.h"
+#include "Stability.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+
+static const int heelJoints[2] = { LeftAnkleJoint, RightAnkleJoint };
+static const int toeJoints[2] = { LeftToeJoint, RightToeJoint };
+
+void GaitCycles::merge(const GaitCycles& other)
+{
+  if (other.numCycles == 0)
+    return;
+  if (numCycles == 0)
+  {
+    *this = other;
+    return;
+  }
+
+  numCycles += other.numCycles;
+  for (size_t i = 0; i < sum.size(); i++)
+  {
+    sum[i] += other.sum[i];
+    sumSquares[i] += other.sumSquares[i];
+  }
+}
+
+void GaitCycles::finish()
+{
+  mean.resize(sum.size());
+  standardDeviation.resize(sum.size());
+  for (size_t i = 0; i < sum.size(); i++)
+  {
+    double m = numCycles > 0 ? sum[i] / numCycles : 0.0;
+    double variance = numCycles > 1 ? (sumSquares[i] - numCycles * m * m) / (numCycles - 1) : 0.0;
+    mean[i] = (float)m;
+    standardDeviation[i] = (float)std::sqrt(std::max(0.0, variance));
+  }
+}
+
+// contact runs of one joint, debounced by minPhaseFrames
+static void contactChanges(const std::vector<unsigned char>& contact, int minPhaseFrames,
+                           std::vector<unsigned int>& onsets, std::vector<unsigned int>& offsets)
+{
+  unsigned int numFrames = (unsigned int)contact.size();
+  bool state = numFrames > 0 && contact[0];
+  unsigned int run = 0;
+
+  for (unsigned int frame = 1; frame < numFrames; frame++)
+  {
+    if ((contact[frame] != 0) == state)
+    {
+      run = 0;
+      continue;
+    }
+
+    // the new state has to hold for minPhaseFrames before it counts
+    if (++run < (unsigned int)minPhaseFrames)
+      continue;
+
+    unsigned int changeFrame = frame + 1 - run;
+    state = !state;
+    run = 0;
+    if (state)
+      onsets.push_back(changeFrame);
+    else
+      offsets.push_back(changeFrame);
+  }
+}
+
+void detectGaitEvents(const ClipTrajectory& trajectory, const GaitSettings& settings, GaitEvents& events)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+
+  for (int foot = 0; foot < 2; foot++)
+  {
+    events.heelStrikes[foot].clear();
+    events.toeOffs[foot].clear();
+  }
+  if (numFrames < 3 || numJoints <= RightToeJoint)
+    return;
+
+  const int joints[4] = { heelJoints[0], heelJoints[1], toeJoints[0], toeJoints[1] };
+  std::vector<float> height[4], speed[4];
+  float lowest[4], highest[4], fastest[4];
+
+  // one pass: heights, speeds and their ranges
+  for (int j = 0; j < 4; j++)
+  {
+    height[j].resize(numFrames);
+    speed[j].resize(numFrames);
+    lowest[j] = FLT_MAX;
+    highest[j] = -FLT_MAX;
+    fastest[j] = 0.0f;
+  }
+
+  for (unsigned int frame = 0; frame < numFrames; frame++)
+  {
+    unsigned int previous = frame > 0 ? frame - 1 : frame;
+    unsigned int next = frame + 1 < numFrames ? frame + 1 : frame;
+    const glm::vec4* pose = &trajectory.joints[(size_t)frame * numJoints];
+    const glm::vec4* posePrevious = &trajectory.joints[(size_t)previous * numJoints];
+    const glm::vec4* poseNext = &trajectory.joints[(size_t)next * numJoints];
+
+    for (int j = 0; j < 4; j++)
+    {
+      float y = pose[joints[j]].y;
+      float v = glm::length(glm::vec3(poseNext[joints[j]] - posePrevious[joints[j]])) / ((next - previous) * dt);
+      height[j][frame] = y;
+      speed[j][frame] = v;
+      lowest[j] = std::min(lowest[j], y);
+      highest[j] = std::max(highest[j], y);
+      fastest[j] = std::max(fastest[j], v);
+    }
+  }
+
+  // heel strike when the heel lands, toe off when the toes lift
+  std::vector<unsigned char> contact(numFrames);
+  for (int j = 0; j < 4; j++)
+  {
+    float heightThreshold = lowest[j] + settings.heightFraction * (highest[j] - lowest[j]);
+    float speedThreshold = settings.speedFraction * fastest[j];
+    for (unsigned int frame = 0; frame < numFrames; frame++)
+      contact[frame] = height[j][frame] < heightThreshold && speed[j][frame] < speedThreshold;
+
+    int foot = j % 2;
+    std::vector<unsigned int> onsets, offsets;
+    contactChanges(contact, settings.minPhaseFrames, onsets, offsets);
+    if (j < 2)
+      events.heelStrikes[foot] = onsets;
+    else
+      events.toeOffs[foot] = offsets;
+  }
+}
+
+void accumulateGaitCycles(const ClipTrajectory& trajectory, const GaitEvents& events, const GaitSettings& settings,
+                          int foot, GaitCycles& cycles)
+{
+  unsigned int numJoints = trajectory.numJoints;
+  unsigned int numChannels = 3 + 3 * numJoints;
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+
+  if (cycles.numChannels == 0)
+  {
+    cycles.numChannels = numChannels;
+    cycles.sum.assign((size_t)GaitSamples * numChannels, 0.0);
+    cycles.sumSquares.assign((size_t)GaitSamples * numChannels, 0.0);
+  }
+  if (cycles.numChannels != numChannels)
+    return;
+
+  // frame rows of the channels, filled once per stride frame and then interpolated
+  std::vector<float> rows;
+  std::vector<float> sample(numChannels);
+
+  const std::vector<unsigned int>& strikes = events.heelStrikes[foot];
+  for (size_t i = 0; i + 1 < strikes.size(); i++)
+  {
+    unsigned int first = strikes[i];
+    unsigned int last = strikes[i + 1];
+    float strideTime = (last - first) * dt;
+    if (strideTime < settings.minStrideTime || strideTime > settings.maxStrideTime)
+      continue;
+
+    unsigned int strideFrames = last - first + 1;
+    rows.resize((size_t)strideFrames * numChannels);
+    glm::vec4 origin = trajectory.bodyCOM[first];
+
+    for (unsigned int f = 0; f < strideFrames; f++)
+    {
+      const glm::vec4* pose = &trajectory.joints[(size_t)(first + f) * numJoints];
+      const glm::vec4& com = trajectory.bodyCOM[first + f];
+      float* row = &rows[(size_t)f * numChannels];
+      row[0] = com.x - origin.x;
+      row[1] = com.y;
+      row[2] = com.z - origin.z;
+      for (unsigned int j = 0; j < numJoints; j++)
+      {
+        row[3 + 3 * j + 0] = pose[j].x - pose[0].x;
+        row[3 + 3 * j + 1] = pose[j].y - pose[0].y;
+        row[3 + 3 * j + 2] = pose[j].z - pose[0].z;
+      }
+    }
+
+    // linear resampling, the channel loops are contiguous and vectorize
+    for (unsigned int s = 0; s < GaitSamples; s++)
+    {
+      float position = (float)s * (strideFrames - 1) / (GaitSamples - 1);
+      unsigned int a = std::min((unsigned int)position, strideFrames - 1);
+      unsigned int b = std::min(a + 1, strideFrames - 1);
+      float t = position - a;
+
+      const float* rowA = &rows[(size_t)a * numChannels];
+      const float* rowB = &rows[(size_t)b * numChannels];
+      double* sum = &cycles.sum[(size_t)s * numChannels];
+      double* sumSquares = &cycles.sumSquares[(size_t)s * numChannels];
+      for (unsigned int c = 0; c < numChannels; c++)
+        sample[c] = rowA[c] + t * (rowB[c] - rowA[c]);
+      for (unsigned int c = 0; c < numChannels; c++)
+      {
+        sum[c] += sample[c];
+        sumSquares[c] += (double)sample[c] * sample[c];
+      }
+    }
+    cycles.numCycles++;
+  }
+}
+
+// the clip's strides added to cycles, false when it doesn't load or adds none
+static bool accumulateGaitClip(const ClipEntry& clip, int model, const GaitSettings& settings, int foot, GaitCycles& cycles)
+{
+  Bvh2 bvh;
+  ClipTrajectory trajectory;
+  if (!loadManifestClip(clip, model, bvh, trajectory))
+    return false;
+
+  GaitEvents events;
+  detectGaitEvents(trajectory, settings, events);
+
+  unsigned int before = cycles.numCycles;
+  accumulateGaitCycles(trajectory, events, settings, foot, cycles);
+  return cycles.numChannels == 3 + 3 * trajectory.numJoints && cycles.numCycles > before;
+}
+
+unsigned int averageGaitClips(const std::vector<ClipEntry>& clips, int model, const GaitSettings& settings,
+                              int foot, GaitCycles& cycles)
+{
+  std::atomic<unsigned int> used(0);
+  std::mutex mutex;
+
+  // the first clip that loads, in catalog order, fixes the channel count, so which clips are
+  // skipped doesn't depend on the order the threads finish in
+  cycles = GaitCycles();
+  unsigned int first = 0;
+  while (first < (unsigned int)clips.size() && cycles.numChannels == 0)
+  {
+    if (accumulateGaitClip(clips[first], model, settings, foot, cycles))
+      used++;
+    first++;
+  }
+  if (cycles.numChannels == 0)
+    return 0;
+
+  unsigned int numChannels = cycles.numChannels;
+  parallelFor(first, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    GaitCycles local;
+    local.numChannels = numChannels;
+    local.sum.assign((size_t)GaitSamples * numChannels, 0.0);
+    local.sumSquares.assign((size_t)GaitSamples * numChannels, 0.0);
+    for (unsigned int i = begin; i < end; i++)
+    {
+      if (accumulateGaitClip(clips[i], model, settings, foot, local))
+        used++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    cycles.merge(local);
+  }, 1);
+
+  cycles.finish();
+  return used;
+}
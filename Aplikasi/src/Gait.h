@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BodyModel.h"
+
+struct ClipEntry;
+
+#define GaitSamples 101
+
+struct GaitSettings
+{
+  float heightFraction = 0.15f; // of the joint's vertical range, above its lowest point
+  float speedFraction = 0.2f;   // of the joint's peak speed
+  int minPhaseFrames = 3;       // contact changes shorter than this are noise
+  float minStrideTime = 0.4f;   // seconds
+  float maxStrideTime = 2.5f;
+};
+
+// frames of the events, [0] left foot and [1] right foot
+struct GaitEvents
+{
+  std::vector<unsigned int> heelStrikes[2];
+  std::vector<unsigned int> toeOffs[2];
+};
+
+// mean and SD over strides, time normalized to GaitSamples samples. Channels are the body COM
+// (horizontal relative to the stride's first frame) followed by every joint relative to the root
+struct GaitCycles
+{
+  unsigned int numChannels = 0;
+  unsigned int numCycles = 0;
+  std::vector<double> sum;        // sample * numChannels + channel
+  std::vector<double> sumSquares;
+  std::vector<float> mean;
+  std::vector<float> standardDeviation;
+
+  void merge(const GaitCycles& other);
+  void finish();
+};
+
+// the thresholds come from one pass over the foot joints, the events from a second
+void detectGaitEvents(const ClipTrajectory& trajectory, const GaitSettings& settings, GaitEvents& events);
+
+// adds every stride of the foot, heel strike to heel strike, needs joints and bodyCOM baked
+void accumulateGaitCycles(const ClipTrajectory& trajectory, const GaitEvents& events, const GaitSettings& settings,
+                          int foot, GaitCycles& cycles);
+
+// loads, detects and accumulates the clips in parallel, clips with another joint count than
+// the first one that loads are skipped. Returns the number of clips used
+unsigned int averageGaitClips(const std::vector<ClipEntry>& clips, int model, const GaitSettings& settings,
+                              int foot, GaitCycles& cycles);
@@ -0,0 +1,355 @@
+#include "Inflate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// a private copy of stb_image's inflater, decoding block by block isn't part of its api.
+// static, so it doesn't clash with the implementation in stb_image.cpp
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_NO_STDIO
+#include "stb_image.h"
+
+// deflate copies from at most this far back in the output
+#define InflateWindowBytes 32768
+// output room past a handed on block, enough for the longest stored block. blocks of any size
+// are handed on while they decode, so the buffer doesn't grow
+#define InflateBlockRoom 65536
+// the last bytes of the file are decoded from a copy with zero padding, so reading past the
+// end of the input shows in the position of the bit reader. more than a block header reads
+#define InflateTailBytes 4096
+#define InflateTailPadding 16
+
+bool compressedHeader(const unsigned char* bytes, size_t size)
+{
+  if (size < 2)
+    return false;
+  if (bytes[0] == 0x1f && bytes[1] == 0x8b)
+    return true;
+  // zlib: deflate, a window of 32k at most, no preset dictionary and the header check
+  return (bytes[0] & 0x0f) == 8 && (bytes[0] >> 4) <= 7 && (bytes[1] & 0x20) == 0 &&
+         (bytes[0] * 256 + bytes[1]) % 31 == 0;
+}
+
+bool compressedFile(const std::string& filename)
+{
+  std::ifstream file(filename, std::ios::binary);
+  unsigned char bytes[2] = {};
+  file.read((char*)bytes, 2);
+  return compressedHeader(bytes, (size_t)file.gcount());
+}
+
+// skips the gzip member header at offset, false when it isn't one
+static bool gzipHeader(const unsigned char* data, size_t size, size_t& offset)
+{
+  size_t at = offset + 10;
+  if (at > size || data[offset] != 0x1f || data[offset + 1] != 0x8b || data[offset + 2] != 8)
+    return false;
+
+  unsigned char flags = data[offset + 3];
+  if (flags & 4) // extra field
+  {
+    if (at + 2 > size)
+      return false;
+    at += 2 + (data[at] | (data[at + 1] << 8));
+  }
+  for (int field = 8; field <= 16; field *= 2) // file name, comment
+  {
+    if (flags & field)
+    {
+      while (at < size && data[at] != 0)
+        at++;
+      at++;
+    }
+  }
+  if (flags & 2) // header crc
+    at += 2;
+  if (at > size)
+    return false;
+  offset = at;
+  return true;
+}
+
+InflateBuffer::InflateBuffer(const std::string& filename) : name(filename)
+{
+  if (!mapFile(filename, mapped))
+  {
+    std::cout << "Failed to read " << filename << std::endl;
+    error = true;
+    finished = true;
+    return;
+  }
+  worker = std::thread(&InflateBuffer::inflateFile, this);
+}
+
+InflateBuffer::~InflateBuffer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  drained.notify_all();
+  if (worker.joinable())
+    worker.join();
+  unmapFile(mapped);
+}
+
+bool InflateBuffer::failed() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return error;
+}
+
+InflateBuffer::int_type InflateBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  std::unique_lock<std::mutex> lock(mutex);
+  // the block just read goes back to the inflater
+  if (!current.empty() && spare.size() < InflateQueueBlocks)
+  {
+    spare.emplace_back();
+    spare.back().swap(current);
+  }
+  current.clear();
+
+  filled.wait(lock, [this] { return !blocks.empty() || finished; });
+  if (blocks.empty())
+  {
+    setg(nullptr, nullptr, nullptr);
+    return traits_type::eof();
+  }
+  current.swap(blocks.front());
+  blocks.pop_front();
+  drained.notify_one();
+
+  setg(current.data(), current.data(), current.data() + current.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+bool InflateBuffer::pushBlock(const char* bytes, size_t size)
+{
+  if (size == 0)
+    return true;
+
+  std::vector<char> block;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this] { return blocks.size() < InflateQueueBlocks || stopping; });
+    if (stopping)
+      return false;
+    if (!spare.empty())
+    {
+      block.swap(spare.back());
+      spare.pop_back();
+    }
+  }
+  block.assign(bytes, bytes + size);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  blocks.push_back(std::move(block));
+  filled.notify_one();
+  return true;
+}
+
+// one deflate stream from offset, handed on about InflateBlockBytes at a time. offset ends
+// after the gzip or zlib trailer. what decoded before an error is handed on too
+bool InflateBuffer::inflateStream(size_t& offset, bool zlibHeader)
+{
+  stbi__zbuf z;
+  z.zbuffer = (stbi_uc*)mapped.data + offset;
+  z.zbuffer_end = (stbi_uc*)mapped.data + mapped.size;
+  if (zlibHeader && !stbi__parse_zlib_header(&z))
+    return false;
+
+  // stb reads zeros past the end of its input, near the end the input is a padded copy and
+  // the stream is truncated once the bits taken run past the real bytes
+  std::vector<stbi_uc> tail;
+  size_t tailOffset = mapped.size;
+  const stbi_uc* tailStart = (const stbi_uc*)mapped.data + (mapped.size > InflateTailBytes ? mapped.size - InflateTailBytes : 0);
+  auto toTail = [&]()
+  {
+    if (!tail.empty() || z.zbuffer < tailStart)
+      return;
+    tailOffset = (size_t)(z.zbuffer - (const stbi_uc*)mapped.data);
+    tail.assign(InflateTailPadding + mapped.size - tailOffset, 0);
+    std::memcpy(tail.data(), z.zbuffer, mapped.size - tailOffset);
+    z.zbuffer = tail.data();
+    z.zbuffer_end = tail.data() + tail.size();
+  };
+  auto truncated = [&]()
+  {
+    if (tail.empty())
+      return false;
+    const stbi_uc* end = tail.data() + tail.size() - InflateTailPadding;
+    return z.zbuffer > end && (size_t)(z.zbuffer - end) * 8 > (size_t)z.num_bits;
+  };
+
+  // the output keeps the last window of the previous blocks in front of the new ones
+  std::vector<char> output(InflateWindowBytes + InflateBlockBytes + InflateBlockRoom);
+  z.zout_start = output.data();
+  z.zout = output.data();
+  z.zout_end = output.data() + output.size();
+  z.z_expandable = 0;
+  z.num_bits = 0;
+  z.code_buffer = 0;
+
+  char* handOn = z.zout_start + InflateWindowBytes + InflateBlockBytes;
+  size_t handed = 0; // bytes of the output already pushed
+  unsigned int total = 0;
+  bool stopped = false;
+  auto flush = [&]()
+  {
+    size_t used = (size_t)(z.zout - z.zout_start);
+    if (stopped || !pushBlock(z.zout_start + handed, used - handed))
+    {
+      stopped = true;
+      return false;
+    }
+    total += (unsigned int)(used - handed);
+    size_t keep = std::min(used, (size_t)InflateWindowBytes);
+    std::memmove(z.zout_start, z.zout - keep, keep);
+    z.zout = z.zout_start + keep;
+    handed = keep;
+    return true;
+  };
+  auto fail = [&](const char* reason)
+  {
+    stbi__err(reason, "Corrupt");
+    flush();
+    return false;
+  };
+
+  int final = 0;
+  while (!final)
+  {
+    toTail();
+    if (z.zout > handOn && !flush())
+      return false;
+
+    final = stbi__zreceive(&z, 1);
+    int type = stbi__zreceive(&z, 2);
+    if (type == 0)
+    {
+      if (!stbi__parse_uncompressed_block(&z))
+        return fail(truncated() ? "truncated" : stbi_failure_reason());
+    }
+    else if (type == 3)
+      return fail(truncated() ? "truncated" : "bad block type");
+    else
+    {
+      if (type == 1)
+      {
+        if (!stbi__zbuild_huffman(&z.z_length, stbi__zdefault_length, 288) ||
+            !stbi__zbuild_huffman(&z.z_distance, stbi__zdefault_distance, 32))
+          return fail(stbi_failure_reason());
+      }
+      else if (!stbi__compute_huffman_codes(&z))
+        return fail(truncated() ? "truncated" : stbi_failure_reason());
+
+      // stbi__parse_huffman_block, but the output is handed on when it fills instead of
+      // failing, and it stops at the end of the input instead of decoding stb's zeros
+      while (true)
+      {
+        toTail();
+        if (z.zout > handOn && !flush())
+          return false;
+
+        int symbol = stbi__zhuffman_decode(&z, &z.z_length);
+        if (symbol < 256)
+        {
+          if (truncated())
+            return fail("truncated");
+          if (symbol < 0)
+            return fail("bad huffman code");
+          *z.zout++ = (char)symbol;
+          continue;
+        }
+        if (symbol == 256)
+          break;
+
+        symbol -= 257;
+        if (symbol >= 29)
+          return fail(truncated() ? "truncated" : "bad huffman code");
+        int length = stbi__zlength_base[symbol];
+        if (stbi__zlength_extra[symbol])
+          length += stbi__zreceive(&z, stbi__zlength_extra[symbol]);
+        symbol = stbi__zhuffman_decode(&z, &z.z_distance);
+        if (truncated())
+          return fail("truncated");
+        if (symbol < 0 || symbol >= 30)
+          return fail("bad huffman code");
+        int distance = stbi__zdist_base[symbol];
+        if (stbi__zdist_extra[symbol])
+          distance += stbi__zreceive(&z, stbi__zdist_extra[symbol]);
+        if (truncated())
+          return fail("truncated");
+        if (z.zout - z.zout_start < distance)
+          return fail("bad dist");
+
+        const char* from = z.zout - distance;
+        for (int i = 0; i < length; i++)
+          *z.zout++ = from[i];
+      }
+    }
+    if (truncated())
+      return fail("truncated");
+  }
+  if (!flush())
+    return false;
+
+  // whole bytes the bit reader fetched ahead of the end of the stream are given back
+  if (tail.empty())
+    offset = (size_t)(z.zbuffer - (stbi_uc*)mapped.data) - z.num_bits / 8;
+  else
+    offset = std::min(tailOffset + (size_t)(z.zbuffer - tail.data()) - z.num_bits / 8, mapped.size);
+  if (zlibHeader)
+  {
+    offset = std::min(offset + 4, mapped.size); // adler32
+    return true;
+  }
+
+  // crc32 and the size mod 2^32, only the size is checked
+  if (offset + 8 > mapped.size)
+  {
+    stbi__err("truncated", "Corrupt");
+    return false;
+  }
+  const unsigned char* trailer = mapped.data + offset + 4;
+  unsigned int size = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((unsigned int)trailer[3] << 24);
+  offset += 8;
+  if (size != total)
+  {
+    stbi__err("size mismatch", "Corrupt");
+    return false;
+  }
+  return true;
+}
+
+void InflateBuffer::inflateFile()
+{
+  size_t offset = 0;
+  bool ok = compressedHeader(mapped.data, mapped.size);
+  if (ok && mapped.data[0] != 0x1f)
+    ok = inflateStream(offset, true);
+  else
+  {
+    // gzip members one after another decode to the concatenation, zero padding after the
+    // last one is skipped like gzip does
+    while (ok && offset < mapped.size && mapped.data[offset] != 0)
+      ok = gzipHeader(mapped.data, mapped.size, offset) && inflateStream(offset, false);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!ok && !stopping)
+  {
+    std::cout << "Failed to inflate " << name << ": " << (stbi_failure_reason() ? stbi_failure_reason() : "not gzip or zlib") << std::endl;
+    error = true;
+  }
+  finished = true;
+  filled.notify_all();
+}
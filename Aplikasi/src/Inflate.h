@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FileSystem.h"
+
+// decoded text handed to the reader at once, and how many of those the inflater runs ahead
+#define InflateBlockBytes (1 << 20)
+#define InflateQueueBlocks 4
+
+// true for the first bytes of a gzip member or a zlib stream
+bool compressedHeader(const unsigned char* bytes, size_t size);
+bool compressedFile(const std::string& filename);
+
+// a gzip (one or more members) or zlib file as a stream of its decoded bytes. a second thread
+// inflates the next blocks while the reader parses the current one, the compressed file is
+// mapped rather than read, so on slow storage the page reads overlap with the parsing too
+class InflateBuffer : public std::streambuf
+{
+public:
+  explicit InflateBuffer(const std::string& filename);
+  ~InflateBuffer();
+
+  // the file couldn't be mapped or isn't valid gzip/zlib, whatever was decoded before the
+  // error is still read
+  bool failed() const;
+
+protected:
+  int_type underflow() override;
+
+private:
+  void inflateFile();
+  bool inflateStream(size_t& offset, bool zlibHeader);
+  bool pushBlock(const char* bytes, size_t size);
+
+  MappedFile mapped;
+  std::string name;
+  std::thread worker;
+  mutable std::mutex mutex;
+  std::condition_variable filled;
+  std::condition_variable drained;
+  std::deque<std::vector<char>> blocks;  // decoded, not read yet
+  std::vector<std::vector<char>> spare;  // read, reused by the inflater
+  std::vector<char> current;             // the get area
+  bool finished = false;
+  bool stopping = false;
+  bool error = false;
+};
@@ -0,0 +1,187 @@
+#include "JointAngles.h"
+
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <cmath>
+
+const char* cardanSequenceNames[NumCardanSequences] = { "XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX" };
+
+// axis indices of the sequences, and +1 for the cyclic ones
+static const int cardanAxes[NumCardanSequences][3] = {
+  { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 }
+};
+static const float cardanParity[NumCardanSequences] = { 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, -1.0f };
+
+static const float radiansToDegrees = 57.29577951f;
+
+// R = Ri(a) Rj(b) Rk(c) with the matrix in row major r[row][column]
+static glm::vec3 cardanAngles(const float r[3][3], int sequence)
+{
+  int i = cardanAxes[sequence][0];
+  int j = cardanAxes[sequence][1];
+  int k = cardanAxes[sequence][2];
+  float s = cardanParity[sequence];
+
+  float sine = s * r[i][k];
+  sine = sine > 1.0f ? 1.0f : (sine < -1.0f ? -1.0f : sine);
+  float a = std::atan2(-s * r[j][k], r[k][k]);
+  float b = std::asin(sine);
+  float c = std::atan2(-s * r[i][j], r[i][i]);
+  return glm::vec3(a, b, c) * radiansToDegrees;
+}
+
+int cardanSequence(int first, int second, int third)
+{
+  for (int sequence = 0; sequence < NumCardanSequences; sequence++)
+  {
+    if (cardanAxes[sequence][0] == first && cardanAxes[sequence][1] == second && cardanAxes[sequence][2] == third)
+      return sequence;
+  }
+  return -1;
+}
+
+glm::vec3 cardanAngles(const glm::quat& rotation, int sequence)
+{
+  glm::mat3 m = glm::mat3_cast(rotation);
+  float r[3][3];
+  for (int row = 0; row < 3; row++)
+    for (int column = 0; column < 3; column++)
+      r[row][column] = m[column][row];
+  return cardanAngles(r, sequence);
+}
+
+static float unwrap(float angle, float previous)
+{
+  while (angle - previous > 180.0f)
+    angle -= 360.0f;
+  while (angle - previous < -180.0f)
+    angle += 360.0f;
+  return angle;
+}
+
+// four quaternions of one joint, frames clamped to the clip
+static quat4 loadRotations(const glm::quat* rotations, int joint, unsigned int numJoints,
+                           const unsigned int frames[4])
+{
+  float w[4], x[4], y[4], z[4];
+  for (int lane = 0; lane < 4; lane++)
+  {
+    glm::quat q = joint < 0 ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : rotations[(size_t)frames[lane] * numJoints + joint];
+    w[lane] = q.w;
+    x[lane] = q.x;
+    y[lane] = q.y;
+    z[lane] = q.z;
+  }
+  return quat4(float4::load(w), float4::load(x), float4::load(y), float4::load(z));
+}
+
+void computeJointAngles(const ClipTrajectory& trajectory, const std::vector<int>& jointParents,
+                        const JointAngleSettings& settings, JointAngleResult& result)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  result.numFrames = numFrames;
+  result.numJoints = numJoints;
+  result.angles.resize((size_t)numFrames * numJoints);
+  result.angularVelocities.resize((size_t)numFrames * numJoints);
+  result.sequences.resize(numJoints);
+  for (unsigned int joint = 0; joint < numJoints; joint++)
+    result.sequences[joint] = joint < settings.sequences.size() ? settings.sequences[joint] : settings.defaultSequence;
+  if (numFrames == 0 || trajectory.rotations.size() != (size_t)numFrames * numJoints)
+    return;
+
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+  const glm::quat* rotations = trajectory.rotations.data();
+  glm::vec3* angles = result.angles.data();
+  glm::vec3* velocities = result.angularVelocities.data();
+
+  unsigned int numBlocks = (numFrames + 3) / 4;
+  parallelFor(0, numBlocks, [&](unsigned int beginBlock, unsigned int endBlock)
+  {
+    for (unsigned int block = beginBlock; block < endBlock; block++)
+    {
+      unsigned int frames[4], previous[4], next[4];
+      for (int lane = 0; lane < 4; lane++)
+      {
+        unsigned int frame = block * 4 + lane;
+        frames[lane] = frame < numFrames ? frame : numFrames - 1;
+        previous[lane] = frames[lane] > 0 ? frames[lane] - 1 : 0;
+        next[lane] = frames[lane] + 1 < numFrames ? frames[lane] + 1 : numFrames - 1;
+      }
+
+      for (unsigned int joint = 0; joint < numJoints; joint++)
+      {
+        int parent = joint < jointParents.size() ? jointParents[joint] : -1;
+        int sequence = joint < settings.sequences.size() ? settings.sequences[joint] : settings.defaultSequence;
+
+        // relative rotations of this frame and its neighbours
+        quat4 relative = conjugate(loadRotations(rotations, parent, numJoints, frames)) *
+                         loadRotations(rotations, joint, numJoints, frames);
+        quat4 relativePrevious = conjugate(loadRotations(rotations, parent, numJoints, previous)) *
+                                 loadRotations(rotations, joint, numJoints, previous);
+        quat4 relativeNext = conjugate(loadRotations(rotations, parent, numJoints, next)) *
+                             loadRotations(rotations, joint, numJoints, next);
+
+        // rotation matrix of the relative quaternion
+        float4 two(2.0f), one(1.0f);
+        float4 xx = relative.x * relative.x, yy = relative.y * relative.y, zz = relative.z * relative.z;
+        float4 xy = relative.x * relative.y, xz = relative.x * relative.z, yz = relative.y * relative.z;
+        float4 wx = relative.w * relative.x, wy = relative.w * relative.y, wz = relative.w * relative.z;
+        float m[3][3][4];
+        (one - two * (yy + zz)).store(m[0][0]);
+        (two * (xy - wz)).store(m[0][1]);
+        (two * (xz + wy)).store(m[0][2]);
+        (two * (xy + wz)).store(m[1][0]);
+        (one - two * (xx + zz)).store(m[1][1]);
+        (two * (yz - wx)).store(m[1][2]);
+        (two * (xz - wy)).store(m[2][0]);
+        (two * (yz + wx)).store(m[2][1]);
+        (one - two * (xx + yy)).store(m[2][2]);
+
+        // angular velocity from the central difference, delta = next * conjugate(previous)
+        quat4 delta = relativeNext * conjugate(relativePrevious);
+        float w[4], v[3][4];
+        delta.w.store(w);
+        delta.x.store(v[0]);
+        delta.y.store(v[1]);
+        delta.z.store(v[2]);
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+          unsigned int frame = block * 4 + lane;
+          if (frame >= numFrames)
+            break;
+
+          float r[3][3];
+          for (int row = 0; row < 3; row++)
+            for (int column = 0; column < 3; column++)
+              r[row][column] = m[row][column][lane];
+          angles[(size_t)frame * numJoints + joint] = cardanAngles(r, sequence);
+
+          // shortest arc, 2 * atan2(|v|, w) about v
+          float sign = w[lane] < 0.0f ? -1.0f : 1.0f;
+          glm::vec3 axis(v[0][lane] * sign, v[1][lane] * sign, v[2][lane] * sign);
+          float length = glm::length(axis);
+          float span = (next[lane] - previous[lane]) * dt;
+          glm::vec3 velocity(0.0f);
+          if (length > 1e-9f && span > 0.0f)
+            velocity = axis * (2.0f * std::atan2(length, w[lane] * sign) / (length * span) * radiansToDegrees);
+          velocities[(size_t)frame * numJoints + joint] = velocity;
+        }
+      }
+    }
+  }, 16);
+
+  // continuous curves past +-180
+  for (unsigned int frame = 1; frame < numFrames; frame++)
+  {
+    for (unsigned int joint = 0; joint < numJoints; joint++)
+    {
+      glm::vec3& angle = angles[(size_t)frame * numJoints + joint];
+      const glm::vec3& previous = angles[(size_t)(frame - 1) * numJoints + joint];
+      for (int axis = 0; axis < 3; axis++)
+        angle[axis] = unwrap(angle[axis], previous[axis]);
+    }
+  }
+}
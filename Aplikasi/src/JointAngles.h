@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BodyModel.h"
+
+// intrinsic Cardan sequences, the first axis is applied first in the parent frame
+enum CardanSequence
+{
+  CardanXYZ,
+  CardanXZY,
+  CardanYXZ,
+  CardanYZX,
+  CardanZXY,
+  CardanZYX,
+  NumCardanSequences
+};
+
+extern const char* cardanSequenceNames[NumCardanSequences];
+
+struct JointAngleSettings
+{
+  int defaultSequence = CardanXZY; // flexion about the mediolateral X, then Z, then the long axis
+  std::vector<int> sequences;      // per joint, missing joints use defaultSequence
+};
+
+// child orientation relative to its parent for every joint, the root is relative to the world
+struct JointAngleResult
+{
+  unsigned int numFrames = 0;
+  unsigned int numJoints = 0;
+  std::vector<glm::vec3> angles;            // frame * numJoints + joint, degrees in sequence order, unwrapped
+  std::vector<glm::vec3> angularVelocities; // frame * numJoints + joint, degrees / s in the parent frame
+  std::vector<int> sequences;               // joint, the sequence the angles are in
+};
+
+// sequence of the three axes (0 X, 1 Y, 2 Z) or -1 when they aren't a permutation
+int cardanSequence(int first, int second, int third);
+
+// degrees in sequence order, rotation = R(first) R(second) R(third)
+glm::vec3 cardanAngles(const glm::quat& rotation, int sequence);
+
+// needs the rotations of bakeJoints, four frames at a time
+void computeJointAngles(const ClipTrajectory& trajectory, const std::vector<int>& jointParents,
+                        const JointAngleSettings& settings, JointAngleResult& result);
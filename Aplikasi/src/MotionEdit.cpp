@@ -0,0 +1,186 @@
+#include "MotionEdit.h"
+
+#include <algorithm>
+#include <iostream>
+
+// chunkStart and data again after the chunks changed
+static void finishChunks(Motion& motion)
+{
+  motion.chunkStart.resize(motion.chunks.size() + 1);
+  unsigned int frame = 0;
+  bool contiguous = !motion.chunks.empty();
+  for (size_t c = 0; c < motion.chunks.size(); c++)
+  {
+    motion.chunkStart[c] = frame;
+    frame += motion.chunks[c].numFrames;
+    if (c > 0)
+    {
+      const MotionChunk& previous = motion.chunks[c - 1];
+      contiguous = contiguous && motion.chunks[c].block == previous.block &&
+                   motion.chunks[c].first == previous.first + previous.numFrames;
+    }
+  }
+  motion.chunkStart[motion.chunks.size()] = frame;
+  motion.numFrames = frame;
+  motion.data = contiguous ? motion.chunks[0].block->samples.data() + (size_t)motion.chunks[0].first * motion.numMotionChannels : nullptr;
+}
+
+// one chunk onto the end of chunks, joined with the last one when it continues it in the same
+// block and the two still fit in one chunk, so repeated cuts don't leave slivers behind
+static void pushChunk(std::vector<MotionChunk>& chunks, const MotionChunk& chunk)
+{
+  if (chunk.numFrames == 0)
+    return;
+  if (!chunks.empty())
+  {
+    MotionChunk& last = chunks.back();
+    if (last.block == chunk.block && last.first + last.numFrames == chunk.first &&
+        last.numFrames + chunk.numFrames <= MotionChunkFrames)
+    {
+      last.numFrames += chunk.numFrames;
+      return;
+    }
+  }
+  chunks.push_back(chunk);
+}
+
+// chunks covering frames [begin, end) of motion, the first and last ones cut to the range
+static void pushFrames(const Motion& motion, unsigned int begin, unsigned int end, std::vector<MotionChunk>& chunks)
+{
+  if (begin >= end)
+    return;
+
+  size_t c = std::upper_bound(motion.chunkStart.begin(), motion.chunkStart.end(), begin) - motion.chunkStart.begin() - 1;
+  for (; c < motion.chunks.size() && motion.chunkStart[c] < end; c++)
+  {
+    unsigned int chunkBegin = std::max(begin, motion.chunkStart[c]);
+    unsigned int chunkEnd = std::min(end, motion.chunkStart[c + 1]);
+    MotionChunk chunk = motion.chunks[c];
+    chunk.first += chunkBegin - motion.chunkStart[c];
+    chunk.numFrames = chunkEnd - chunkBegin;
+    pushChunk(chunks, chunk);
+  }
+}
+
+static bool sameChannels(const Motion& a, const Motion& b)
+{
+  if (a.numMotionChannels == b.numMotionChannels)
+    return true;
+  std::cout << "Motions have " << a.numMotionChannels << " and " << b.numMotionChannels << " channels" << std::endl;
+  return false;
+}
+
+void chunkMotion(Motion& motion, const std::shared_ptr<MotionBlock>& block, unsigned int numFrames)
+{
+  motion.chunks.clear();
+  for (unsigned int first = 0; first < numFrames; first += MotionChunkFrames)
+  {
+    MotionChunk chunk;
+    chunk.block = block;
+    chunk.first = first;
+    chunk.numFrames = std::min((unsigned int)MotionChunkFrames, numFrames - first);
+    motion.chunks.push_back(chunk);
+  }
+  finishChunks(motion);
+}
+
+void copyMotionFrames(const Motion& motion, unsigned int begin, unsigned int end, float* out)
+{
+  size_t frameSize = motion.numMotionChannels;
+  std::vector<MotionChunk> chunks;
+  pushFrames(motion, begin, std::min(end, motion.numFrames), chunks);
+  for (const MotionChunk& chunk : chunks)
+  {
+    const float* source = chunk.block->samples.data() + chunk.first * frameSize;
+    out = std::copy(source, source + chunk.numFrames * frameSize, out);
+  }
+}
+
+void compactMotion(Motion& motion)
+{
+  std::shared_ptr<MotionBlock> block = std::make_shared<MotionBlock>();
+  block->samples.resize((size_t)motion.numFrames * motion.numMotionChannels);
+  copyMotionFrames(motion, 0, motion.numFrames, block->samples.data());
+  chunkMotion(motion, block, motion.numFrames);
+}
+
+bool ownsMotion(const Motion& motion)
+{
+  if (motion.data == nullptr)
+    return false;
+  // every chunk of this motion holds one reference, any more belong to someone else
+  const std::shared_ptr<MotionBlock>& block = motion.chunks[0].block;
+  return block.use_count() == (long)motion.chunks.size() &&
+         block->samples.size() == (size_t)motion.numFrames * motion.numMotionChannels;
+}
+
+bool trimMotion(Motion& motion, unsigned int begin, unsigned int end)
+{
+  end = std::min(end, motion.numFrames);
+  if (begin >= end)
+    return false;
+
+  std::vector<MotionChunk> chunks;
+  pushFrames(motion, begin, end, chunks);
+  motion.chunks.swap(chunks);
+  finishChunks(motion);
+  return true;
+}
+
+bool splitMotion(const Motion& motion, unsigned int frame, Motion& head, Motion& tail)
+{
+  if (frame == 0 || frame >= motion.numFrames)
+    return false;
+
+  Motion first = motion;
+  Motion second = motion;
+  trimMotion(first, 0, frame);
+  trimMotion(second, frame, motion.numFrames);
+  head = first;
+  tail = second;
+  return true;
+}
+
+bool concatMotion(const Motion& a, const Motion& b, Motion& out)
+{
+  if (!sameChannels(a, b) || a.numFrames + b.numFrames == 0)
+    return false;
+
+  Motion result = a;
+  result.chunks.clear();
+  pushFrames(a, 0, a.numFrames, result.chunks);
+  pushFrames(b, 0, b.numFrames, result.chunks);
+  finishChunks(result);
+  out = result;
+  return true;
+}
+
+bool insertMotion(Motion& motion, unsigned int frame, const Motion& other, unsigned int begin, unsigned int end)
+{
+  end = std::min(end, other.numFrames);
+  if (!sameChannels(motion, other) || frame > motion.numFrames || begin >= end)
+    return false;
+
+  // other may be motion itself, the chunks are gathered before any of them is replaced
+  std::vector<MotionChunk> chunks;
+  pushFrames(motion, 0, frame, chunks);
+  pushFrames(other, begin, end, chunks);
+  pushFrames(motion, frame, motion.numFrames, chunks);
+  motion.chunks.swap(chunks);
+  finishChunks(motion);
+  return true;
+}
+
+bool eraseMotion(Motion& motion, unsigned int begin, unsigned int end)
+{
+  end = std::min(end, motion.numFrames);
+  if (begin >= end || end - begin == motion.numFrames)
+    return false;
+
+  std::vector<MotionChunk> chunks;
+  pushFrames(motion, 0, begin, chunks);
+  pushFrames(motion, end, motion.numFrames, chunks);
+  motion.chunks.swap(chunks);
+  finishChunks(motion);
+  return true;
+}
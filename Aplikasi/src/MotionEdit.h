@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+
+#include "bvh2.h"
+
+// the numFrames frames of block as the whole motion, in MotionChunkFrames chunks
+void chunkMotion(Motion& motion, const std::shared_ptr<MotionBlock>& block, unsigned int numFrames);
+
+// frames [begin, end) into out, chunk by chunk, for readers that need one run without compacting
+void copyMotionFrames(const Motion& motion, unsigned int begin, unsigned int end, float* out);
+
+// copies every frame into one new block, the old blocks are freed once nothing shares them
+void compactMotion(Motion& motion);
+
+// true when no other motion shares the blocks and every sample of them is in use,
+// writes through data are safe then
+bool ownsMotion(const Motion& motion);
+
+// edits only cut the chunks at the edit points, samples are never copied. frame ranges are
+// [begin, end), motions that are combined must have the same channels. the results are never
+// empty, false leaves the motion as it was
+
+// keeps frames [begin, end)
+bool trimMotion(Motion& motion, unsigned int begin, unsigned int end);
+
+// frames before frame into head, the rest into tail
+bool splitMotion(const Motion& motion, unsigned int frame, Motion& head, Motion& tail);
+
+// a then b, the frame time of a
+bool concatMotion(const Motion& a, const Motion& b, Motion& out);
+
+// frames [begin, end) of other before frame of motion, frame can be numFrames to append
+bool insertMotion(Motion& motion, unsigned int frame, const Motion& other, unsigned int begin, unsigned int end);
+
+bool eraseMotion(Motion& motion, unsigned int begin, unsigned int end);
@@ -0,0 +1,103 @@
+#include "MotionLayout.h"
+
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// 64 x 64 floats, both tiles stay in L1
+#define TransposeTile 64
+
+void transpose(const float* src, unsigned int rows, unsigned int columns, unsigned int srcStride,
+               float* dst, unsigned int dstStride)
+{
+  unsigned int numRowTiles = (rows + TransposeTile - 1) / TransposeTile;
+
+  parallelFor(0, numRowTiles, [&](unsigned int beginTile, unsigned int endTile)
+  {
+    for (unsigned int tile = beginTile; tile < endTile; tile++)
+    {
+      unsigned int rowBegin = tile * TransposeTile;
+      unsigned int rowEnd = std::min(rows, rowBegin + TransposeTile);
+
+      for (unsigned int columnBegin = 0; columnBegin < columns; columnBegin += TransposeTile)
+      {
+        unsigned int columnEnd = std::min(columns, columnBegin + TransposeTile);
+
+        unsigned int row = rowBegin;
+        for (; row + 4 <= rowEnd; row += 4)
+        {
+          const float* s = src + (size_t)row * srcStride;
+          unsigned int column = columnBegin;
+          for (; column + 4 <= columnEnd; column += 4)
+          {
+            __m128 r0 = _mm_loadu_ps(s + column);
+            __m128 r1 = _mm_loadu_ps(s + srcStride + column);
+            __m128 r2 = _mm_loadu_ps(s + 2 * srcStride + column);
+            __m128 r3 = _mm_loadu_ps(s + 3 * srcStride + column);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            float* d = dst + (size_t)column * dstStride + row;
+            _mm_storeu_ps(d, r0);
+            _mm_storeu_ps(d + dstStride, r1);
+            _mm_storeu_ps(d + 2 * dstStride, r2);
+            _mm_storeu_ps(d + 3 * dstStride, r3);
+          }
+          for (; column < columnEnd; column++)
+            for (unsigned int r = row; r < row + 4; r++)
+              dst[(size_t)column * dstStride + r] = src[(size_t)r * srcStride + column];
+        }
+        for (; row < rowEnd; row++)
+          for (unsigned int column = columnBegin; column < columnEnd; column++)
+            dst[(size_t)column * dstStride + row] = src[(size_t)row * srcStride + column];
+      }
+    }
+  }, 4);
+}
+
+void toChannelMajor(const float* frameMajor, unsigned int numFrames, unsigned int numChannels, ChannelMajorMotion& out)
+{
+  out.numFrames = numFrames;
+  out.numChannels = numChannels;
+  out.stride = (numFrames + 3) & ~3u;
+  out.data.resize((size_t)out.stride * numChannels);
+  if (numFrames == 0)
+    return;
+
+  transpose(frameMajor, numFrames, numChannels, numChannels, &out.data[0], out.stride);
+  for (unsigned int c = 0; c < numChannels; c++)
+  {
+    float* samples = out.channel(c);
+    std::fill(samples + numFrames, samples + out.stride, samples[numFrames - 1]);
+  }
+}
+
+void toFrameMajor(const ChannelMajorMotion& channels, float* frameMajor)
+{
+  if (channels.numFrames == 0)
+    return;
+  transpose(&channels.data[0], channels.numChannels, channels.numFrames, channels.stride, frameMajor, channels.numChannels);
+}
+
+void channelRange(const float* samples, unsigned int count, float& minimum, float& maximum)
+{
+  float4 low(FLT_MAX), high(-FLT_MAX);
+  unsigned int i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    float4 x = float4::load(samples + i);
+    low = vmin(low, x);
+    high = vmax(high, x);
+  }
+
+  float lows[4], highs[4];
+  low.store(lows);
+  high.store(highs);
+  minimum = std::min(std::min(lows[0], lows[1]), std::min(lows[2], lows[3]));
+  maximum = std::max(std::max(highs[0], highs[1]), std::max(highs[2], highs[3]));
+  for (; i < count; i++)
+  {
+    minimum = std::min(minimum, samples[i]);
+    maximum = std::max(maximum, samples[i]);
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Motion::data is frame major, data[frame * numChannels + channel], which suits playback.
+// Per channel scans (filters, ranges, statistics) go through this channel major copy instead
+struct ChannelMajorMotion
+{
+  unsigned int numFrames = 0;
+  unsigned int numChannels = 0;
+  unsigned int stride = 0;  // floats from one channel to the next, numFrames rounded up to 4
+  std::vector<float> data;  // channel * stride + frame, the padding repeats the last frame
+
+  float* channel(unsigned int c) { return &data[(size_t)c * stride]; }
+  const float* channel(unsigned int c) const { return &data[(size_t)c * stride]; }
+};
+
+// dst[column * dstStride + row] = src[row * srcStride + column], in cache sized tiles of 4 x 4 SSE transposes
+void transpose(const float* src, unsigned int rows, unsigned int columns, unsigned int srcStride,
+               float* dst, unsigned int dstStride);
+
+void toChannelMajor(const float* frameMajor, unsigned int numFrames, unsigned int numChannels, ChannelMajorMotion& out);
+void toFrameMajor(const ChannelMajorMotion& channels, float* frameMajor);
+
+// min and max of count contiguous samples
+void channelRange(const float* samples, unsigned int count, float& minimum, float& maximum);
@@ -0,0 +1,397 @@
+#include "MotionQuery.h"
+
+#include "Aggregation.h"
+#include "bvh2.h"
+#include "JointAngles.h"
+#include "MotionEdit.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include <xmmintrin.h>
+
+static std::string lowercase(std::string text)
+{
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+  return text;
+}
+
+int QueryTable::findColumn(const std::string& name) const
+{
+  std::string key = lowercase(name);
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    if (lowercase(names[i]) == key)
+      return (int)i;
+  }
+  return -1;
+}
+
+// a run of frame major columns to transpose into the table
+struct QuerySource
+{
+  const float* data;
+  unsigned int numColumns;
+  unsigned int frameStride; // floats
+};
+
+void buildQueryTable(const Bvh2& bvh, const ClipTrajectory& trajectory, const JointAngleResult* angles,
+                     QueryTable& table)
+{
+  const Motion& motion = bvh.getMotion();
+  const std::vector<const Joint*>& joints = bvh.getJoints();
+  unsigned int numJoints = (unsigned int)joints.size();
+
+  table.numFrames = motion.numFrames;
+  table.frameTime = motion.frameTime;
+  table.names.clear();
+
+  std::vector<std::string> jointNames(numJoints);
+  for (unsigned int j = 0; j < numJoints; j++)
+  {
+    jointNames[j] = joints[j]->name;
+    if (jointNames[j] == "EndSite" && j > 0)
+      jointNames[j] = jointNames[j - 1] + jointNames[j];
+  }
+
+  std::vector<QuerySource> sources;
+  std::vector<float> gathered;
+
+  // motion channels
+  static const char* channelNames[] = { "Xposition", "Yposition", "Zposition", "", "Zrotation", "Xrotation", "Yrotation" };
+  if (table.numFrames > 0)
+  {
+    std::vector<std::string> names(motion.numMotionChannels);
+    for (unsigned int j = 0; j < numJoints; j++)
+    {
+      for (unsigned int i = 0; i < joints[j]->numChannels; i++)
+      {
+        short channel = joints[j]->channelsOrder[i];
+        for (int bit = 0; bit < 7; bit++)
+        {
+          if (channel & (1 << bit))
+            names[joints[j]->channelStart + i] = jointNames[j] + "." + channelNames[bit];
+        }
+      }
+    }
+    table.names.insert(table.names.end(), names.begin(), names.end());
+    // edited motions may be spread over several blocks, the transpose reads one run
+    const float* frames = motion.data;
+    if (frames == nullptr)
+    {
+      gathered.resize((size_t)table.numFrames * motion.numMotionChannels);
+      copyMotionFrames(motion, 0, table.numFrames, gathered.data());
+      frames = gathered.data();
+    }
+    sources.push_back(QuerySource{ frames, motion.numMotionChannels, motion.numMotionChannels });
+  }
+
+  // derived signals of the baked clip
+  bool baked = trajectory.numFrames == table.numFrames && trajectory.numJoints == numJoints;
+  if (baked && !trajectory.joints.empty())
+  {
+    for (unsigned int j = 0; j < numJoints; j++)
+    {
+      table.names.push_back(jointNames[j] + ".x");
+      table.names.push_back(jointNames[j] + ".y");
+      table.names.push_back(jointNames[j] + ".z");
+      sources.push_back(QuerySource{ &trajectory.joints[j].x, 3, numJoints * 4 });
+    }
+  }
+  if (baked && angles != nullptr && angles->numFrames == table.numFrames && angles->numJoints == numJoints)
+  {
+    for (unsigned int j = 0; j < numJoints; j++)
+    {
+      const char* sequence = cardanSequenceNames[angles->sequences[j]];
+      for (int k = 0; k < 3; k++)
+        table.names.push_back(jointNames[j] + ".r" + (char)std::tolower(sequence[k]));
+      sources.push_back(QuerySource{ &angles->angles[j].x, 3, numJoints * 3 });
+    }
+  }
+  if (baked && trajectory.bodyCOM.size() == table.numFrames && table.numFrames > 0)
+  {
+    table.names.push_back("com.x");
+    table.names.push_back("com.y");
+    table.names.push_back("com.z");
+    sources.push_back(QuerySource{ &trajectory.bodyCOM[0].x, 3, 4 });
+  }
+
+  // columns through the blocked transpose, padding repeats the last frame
+  ChannelMajorMotion& columns = table.columns;
+  columns.numFrames = table.numFrames;
+  columns.numChannels = (unsigned int)table.names.size();
+  columns.stride = (table.numFrames + 3) & ~3u;
+  columns.data.resize((size_t)columns.stride * columns.numChannels);
+
+  unsigned int column = 0;
+  for (const QuerySource& source : sources)
+  {
+    transpose(source.data, table.numFrames, source.numColumns, source.frameStride, columns.channel(column), columns.stride);
+    column += source.numColumns;
+  }
+
+  // zone maps
+  unsigned int numBlocks = table.numBlocks();
+  table.blockMin.resize((size_t)columns.numChannels * numBlocks);
+  table.blockMax.resize((size_t)columns.numChannels * numBlocks);
+  parallelFor(0, columns.numChannels, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int c = begin; c < end; c++)
+    {
+      float* samples = columns.channel(c);
+      std::fill(samples + table.numFrames, samples + columns.stride, table.numFrames > 0 ? samples[table.numFrames - 1] : 0.0f);
+      for (unsigned int block = 0; block < numBlocks; block++)
+      {
+        unsigned int first = block * QueryBlockFrames;
+        unsigned int count = std::min((unsigned int)QueryBlockFrames, table.numFrames - first);
+        channelRange(samples + first, count, table.blockMin[(size_t)c * numBlocks + block], table.blockMax[(size_t)c * numBlocks + block]);
+      }
+    }
+  }, 16);
+}
+
+bool parseQuery(const QueryTable& table, const std::string& text, std::vector<QueryPredicate>& predicates,
+                std::string& error)
+{
+  predicates.clear();
+
+  // space out the operators so the stream splits name, operator and value
+  std::string spaced;
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    char c = text[i];
+    if (c == '<' || c == '>')
+    {
+      spaced += ' ';
+      spaced += c;
+      if (i + 1 < text.size() && text[i + 1] == '=')
+        spaced += text[++i];
+      spaced += ' ';
+    }
+    else if (c == '&' && i + 1 < text.size() && text[i + 1] == '&')
+    {
+      spaced += " and ";
+      i++;
+    }
+    else
+    {
+      spaced += c;
+    }
+  }
+
+  std::istringstream stream(spaced);
+  std::string name, op, value;
+  while (stream >> name)
+  {
+    if (!predicates.empty())
+    {
+      if (lowercase(name) != "and" || !(stream >> name))
+      {
+        error = "expected 'and' before " + name;
+        return false;
+      }
+    }
+    if (!(stream >> op >> value))
+    {
+      error = "incomplete predicate after " + name;
+      return false;
+    }
+
+    QueryPredicate predicate;
+    predicate.column = table.findColumn(name);
+    if (predicate.column < 0)
+    {
+      error = "unknown signal " + name;
+      return false;
+    }
+
+    if (op == "<")
+      predicate.op = QueryLess;
+    else if (op == "<=")
+      predicate.op = QueryLessEqual;
+    else if (op == ">")
+      predicate.op = QueryGreater;
+    else if (op == ">=")
+      predicate.op = QueryGreaterEqual;
+    else
+    {
+      error = "unknown operator " + op;
+      return false;
+    }
+
+    char* end = nullptr;
+    predicate.value = std::strtof(value.c_str(), &end);
+    if (end == value.c_str() || *end != '\0')
+    {
+      error = "bad number " + value;
+      return false;
+    }
+    predicates.push_back(predicate);
+  }
+
+  if (predicates.empty())
+  {
+    error = "empty query";
+    return false;
+  }
+  return true;
+}
+
+// 1 all frames of the range pass, -1 none does, 0 they have to be looked at
+static int blockDecision(const QueryPredicate& predicate, float minimum, float maximum)
+{
+  switch (predicate.op)
+  {
+  case QueryLess:
+    return maximum < predicate.value ? 1 : (minimum >= predicate.value ? -1 : 0);
+  case QueryLessEqual:
+    return maximum <= predicate.value ? 1 : (minimum > predicate.value ? -1 : 0);
+  case QueryGreater:
+    return minimum > predicate.value ? 1 : (maximum <= predicate.value ? -1 : 0);
+  default:
+    return minimum >= predicate.value ? 1 : (maximum < predicate.value ? -1 : 0);
+  }
+}
+
+// four frame bits of one predicate
+static int compareFour(const float* samples, int op, __m128 value)
+{
+  __m128 x = _mm_loadu_ps(samples);
+  switch (op)
+  {
+  case QueryLess:
+    return _mm_movemask_ps(_mm_cmplt_ps(x, value));
+  case QueryLessEqual:
+    return _mm_movemask_ps(_mm_cmple_ps(x, value));
+  case QueryGreater:
+    return _mm_movemask_ps(_mm_cmpgt_ps(x, value));
+  default:
+    return _mm_movemask_ps(_mm_cmpge_ps(x, value));
+  }
+}
+
+void runQuery(const QueryTable& table, const std::vector<QueryPredicate>& predicates, std::vector<FrameRange>& ranges)
+{
+  ranges.clear();
+  unsigned int numBlocks = table.numBlocks();
+  if (numBlocks == 0 || predicates.empty())
+    return;
+
+  // one bit per frame, 256 frames in four words per block
+  const unsigned int wordsPerBlock = QueryBlockFrames / 64;
+  std::vector<unsigned long long> mask((size_t)numBlocks * wordsPerBlock, 0);
+
+  parallelFor(0, numBlocks, [&](unsigned int beginBlock, unsigned int endBlock)
+  {
+    std::vector<const QueryPredicate*> undecided;
+    for (unsigned int block = beginBlock; block < endBlock; block++)
+    {
+      undecided.clear();
+      bool skip = false;
+      for (const QueryPredicate& predicate : predicates)
+      {
+        size_t zone = (size_t)predicate.column * numBlocks + block;
+        int decision = blockDecision(predicate, table.blockMin[zone], table.blockMax[zone]);
+        if (decision < 0)
+        {
+          skip = true;
+          break;
+        }
+        if (decision == 0)
+          undecided.push_back(&predicate);
+      }
+      if (skip)
+        continue;
+
+      unsigned long long* words = &mask[(size_t)block * wordsPerBlock];
+      unsigned int first = block * QueryBlockFrames;
+      unsigned int count = std::min((unsigned int)QueryBlockFrames, table.numFrames - first);
+      for (unsigned int w = 0; w < wordsPerBlock; w++)
+      {
+        unsigned int frames = count > w * 64 ? std::min(64u, count - w * 64) : 0;
+        words[w] = frames == 64 ? ~0ull : (1ull << frames) - 1;
+      }
+
+      // the columns are padded to four frames, bits past the clip are cleared above
+      for (const QueryPredicate* predicate : undecided)
+      {
+        const float* samples = table.columns.channel(predicate->column) + first;
+        __m128 value = _mm_set1_ps(predicate->value);
+        for (unsigned int i = 0; i < count; i += 4)
+          words[i / 64] &= ~((unsigned long long)(~compareFour(samples + i, predicate->op, value) & 0xF) << (i % 64));
+      }
+    }
+  }, 4);
+
+  // bits to ranges, runs continue across blocks
+  bool open = false;
+  unsigned int begin = 0;
+  for (unsigned int frame = 0; frame < table.numFrames; frame++)
+  {
+    bool match = (mask[frame / 64] >> (frame % 64)) & 1ull;
+    if (match && !open)
+    {
+      begin = frame;
+      open = true;
+    }
+    else if (!match && open)
+    {
+      ranges.push_back(FrameRange{ begin, frame });
+      open = false;
+    }
+  }
+  if (open)
+    ranges.push_back(FrameRange{ begin, table.numFrames });
+}
+
+unsigned int queryClips(const std::vector<ClipEntry>& clips, int model, const std::string& text, std::ostream& out)
+{
+  std::vector<std::vector<FrameRange>> results(clips.size());
+  std::vector<float> frameTimes(clips.size(), 0.0f);
+  std::vector<unsigned char> failed(clips.size(), 1);
+  std::mutex errorMutex;
+
+  parallelFor(0, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      Bvh2 bvh;
+      ClipTrajectory trajectory;
+      if (!loadManifestClip(clips[i], model, bvh, trajectory))
+        continue;
+      JointAngleResult angles;
+      computeJointAngles(trajectory, bvh.getJointParents(), JointAngleSettings(), angles);
+
+      QueryTable table;
+      buildQueryTable(bvh, trajectory, &angles, table);
+      std::vector<QueryPredicate> predicates;
+      std::string error;
+      if (!parseQuery(table, text, predicates, error))
+      {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        std::cout << clips[i].path << ": " << error << std::endl;
+        continue;
+      }
+      runQuery(table, predicates, results[i]);
+      frameTimes[i] = table.frameTime;
+      failed[i] = 0;
+    }
+  }, 1);
+
+  unsigned int failures = 0;
+  out << "path,begin,end,start_time,end_time\n";
+  for (size_t i = 0; i < clips.size(); i++)
+  {
+    failures += failed[i];
+    for (const FrameRange& range : results[i])
+      out << clips[i].path << "," << range.begin << "," << range.end << "," << range.begin * frameTimes[i] << ","
+          << range.end * frameTimes[i] << "\n";
+  }
+  return failures;
+}
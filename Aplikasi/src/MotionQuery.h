@@ -0,0 +1,66 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BodyModel.h"
+#include "MotionLayout.h"
+
+class Bvh2;
+struct ClipEntry;
+struct JointAngleResult;
+
+// frames summarized by one zone map entry
+#define QueryBlockFrames 256
+
+#define QueryLess 0
+#define QueryLessEqual 1
+#define QueryGreater 2
+#define QueryGreaterEqual 3
+
+// every signal of a clip as a column, with the min and max of each block so a predicate
+// can accept or skip whole blocks without looking at their frames
+struct QueryTable
+{
+  unsigned int numFrames = 0;
+  float frameTime = 0.0f;
+  std::vector<std::string> names;
+  ChannelMajorMotion columns;  // column * stride + frame
+  std::vector<float> blockMin; // column * numBlocks + block
+  std::vector<float> blockMax;
+
+  unsigned int numBlocks() const { return (numFrames + QueryBlockFrames - 1) / QueryBlockFrames; }
+  int findColumn(const std::string& name) const; // case insensitive, -1 when missing
+};
+
+struct QueryPredicate
+{
+  int column;
+  int op;
+  float value;
+};
+
+// [begin, end) frames
+struct FrameRange
+{
+  unsigned int begin;
+  unsigned int end;
+};
+
+// columns: <channel joint>.<Xposition ...> for the motion channels, <joint>.x y z for joint
+// positions, <joint>.rx ry rz for the joint angles and com.x y z for the body COM.
+// angles may be null, EndSite joints are named after their parent like the status panel
+void buildQueryTable(const Bvh2& bvh, const ClipTrajectory& trajectory, const JointAngleResult* angles,
+                     QueryTable& table);
+
+// "LeftLeg.rx > 90 and com.y < 80", predicates joined by and
+bool parseQuery(const QueryTable& table, const std::string& text, std::vector<QueryPredicate>& predicates,
+                std::string& error);
+
+// frames where every predicate holds
+void runQuery(const QueryTable& table, const std::vector<QueryPredicate>& predicates, std::vector<FrameRange>& ranges);
+
+// loads the clips in parallel and writes path,begin,end,start time,end time per matching range,
+// returns the number of clips that couldn't be loaded or parsed
+unsigned int queryClips(const std::vector<ClipEntry>& clips, int model, const std::string& text, std::ostream& out);
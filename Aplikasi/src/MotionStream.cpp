@@ -0,0 +1,571 @@
+#include "MotionStream.h"
+
+#include "MotionEdit.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#define MotionMagic 0x544F4D42 // "BMOT"
+#define MotionVersion 1
+#define ReadBufferBytes (1 << 20)
+// frames formatted by one task
+#define FormatPieceFrames 256
+// digits of the frame count field, patched in place on close
+#define FramesFieldWidth 10
+
+struct MotionHeader
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int numFrames;
+  unsigned int numChannels;
+  float frameTime;
+  unsigned int hierarchyBytes;
+};
+
+static const double powersOf10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool hasSuffix(const std::string& name, const char* suffix)
+{
+  size_t length = strlen(suffix);
+  if (name.size() < length)
+    return false;
+  for (size_t i = 0; i < length; i++)
+  {
+    if (std::tolower((unsigned char)name[name.size() - length + i]) != suffix[i])
+      return false;
+  }
+  return true;
+}
+
+int motionFormat(const std::string& filename)
+{
+  if (hasSuffix(filename, ".gz"))
+    return motionFormat(filename.substr(0, filename.size() - 3));
+  if (hasSuffix(filename, ".bvh"))
+    return MotionFormatBvh;
+  if (hasSuffix(filename, ".bmot"))
+    return MotionFormatBinary;
+  if (hasSuffix(filename, ".csv"))
+    return MotionFormatCsv;
+  return -1;
+}
+
+int formatFloat(float value, char* buffer)
+{
+  char* out = buffer;
+  if (value == 0.0f)
+  {
+    if (std::signbit(value))
+      *out++ = '-';
+    *out++ = '0';
+    return (int)(out - buffer);
+  }
+  if (std::signbit(value))
+  {
+    *out++ = '-';
+    value = -value;
+  }
+
+  // a decimal with 1 to 9 significant digits is exact in double up to the single rounding of
+  // the division, so it reads back as value when that double lies strictly between the
+  // midpoints to the neighbouring floats. the midpoints are doubles themselves, so the decimal
+  // lies on the same side of them as its double
+  double v = value;
+  if (std::isfinite(value) && v >= 1e-7 && v < 1e9)
+  {
+    double lower = (v + (double)std::nextafter(value, 0.0f)) * 0.5;
+    double upper = (v + (double)std::nextafter(value, INFINITY)) * 0.5;
+    unsigned int bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    int exponent = -7;
+    while (exponent < 8 && (exponent + 1 >= 0 ? powersOf10[exponent + 1] : 1.0 / powersOf10[-exponent - 1]) <= v)
+      exponent++;
+
+    double rounded = 0.0;
+    int decimals = 0;
+    auto readsBack = [&](int digits)
+    {
+      decimals = digits - 1 - exponent;
+      double scaled = decimals >= 0 ? v * powersOf10[decimals] : v / powersOf10[-decimals];
+      rounded = std::floor(scaled + 0.5);
+      double back = decimals >= 0 ? rounded / powersOf10[decimals] : rounded * powersOf10[-decimals];
+      // an integer landing exactly on a midpoint reads back as the float with the even mantissa
+      if (decimals <= 0 && (back == lower || back == upper))
+        return (bits & 1) == 0;
+      return back > lower && back < upper;
+    };
+
+    // most motion values need 6 to 8 digits, the search starts there and walks to the shortest
+    int digits = 7;
+    bool found = readsBack(digits);
+    if (found)
+    {
+      while (digits > 1 && readsBack(digits - 1))
+        digits--;
+    }
+    else
+    {
+      while (!found && digits < 9)
+        found = readsBack(++digits);
+    }
+
+    if (found)
+    {
+      readsBack(digits);
+      char digitText[24];
+      int numDigits = 0;
+      unsigned long long integer = (unsigned long long)rounded;
+      do
+      {
+        digitText[numDigits++] = (char)('0' + integer % 10);
+        integer /= 10;
+      } while (integer > 0);
+
+      // trailing zeros of the fraction are dropped
+      int first = 0;
+      while (decimals > 0 && first < numDigits - 1 && digitText[first] == '0')
+      {
+        first++;
+        decimals--;
+      }
+
+      if (decimals <= 0)
+      {
+        for (int i = numDigits - 1; i >= first; i--)
+          *out++ = digitText[i];
+        for (int i = 0; i < -decimals; i++)
+          *out++ = '0';
+      }
+      else if (numDigits - first > decimals)
+      {
+        for (int i = numDigits - 1; i >= first + decimals; i--)
+          *out++ = digitText[i];
+        *out++ = '.';
+        for (int i = first + decimals - 1; i >= first; i--)
+          *out++ = digitText[i];
+      }
+      else
+      {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = numDigits - first; i < decimals; i++)
+          *out++ = '0';
+        for (int i = numDigits - 1; i >= first; i--)
+          *out++ = digitText[i];
+      }
+      return (int)(out - buffer);
+    }
+  }
+
+  // tiny, huge or not finite, 9 digits always read back
+  int length = snprintf(out, 24, "%.9g", v);
+  return (int)(out - buffer) + length;
+}
+
+static void appendFloat(std::string& text, float value)
+{
+  char buffer[32];
+  text.append(buffer, formatFloat(value, buffer));
+}
+
+static const char* channelName(short channel)
+{
+  switch (channel)
+  {
+  case Xposition: return "Xposition";
+  case Yposition: return "Yposition";
+  case Zposition: return "Zposition";
+  case Xrotation: return "Xrotation";
+  case Yrotation: return "Yrotation";
+  case Zrotation: return "Zrotation";
+  }
+  return "Unknown";
+}
+
+static bool isEndSite(const Joint* joint)
+{
+  return joint->numChannels == 0 && joint->children.empty() && joint->name != nullptr && strcmp(joint->name, "EndSite") == 0;
+}
+
+static void writeJoint(const Joint* joint, int depth, std::string& text)
+{
+  std::string indent(depth * 4, ' ');
+  if (depth == 0)
+    text += "ROOT ";
+  else if (isEndSite(joint))
+    text += indent + "End Site";
+  else
+    text += indent + "JOINT ";
+  if (!isEndSite(joint))
+    text += joint->name != nullptr ? joint->name : "Joint";
+  text += "\n" + indent + "{\n";
+
+  text += indent + "    OFFSET ";
+  appendFloat(text, joint->offset.x);
+  text += ' ';
+  appendFloat(text, joint->offset.y);
+  text += ' ';
+  appendFloat(text, joint->offset.z);
+  text += '\n';
+
+  if (!isEndSite(joint))
+  {
+    text += indent + "    CHANNELS " + std::to_string(joint->numChannels);
+    for (unsigned int i = 0; i < joint->numChannels; i++)
+    {
+      text += ' ';
+      text += channelName(joint->channelsOrder[i]);
+    }
+    text += '\n';
+  }
+
+  for (const Joint* child : joint->children)
+    writeJoint(child, depth + 1, text);
+  text += indent + "}\n";
+}
+
+void writeBvhHierarchy(const Bvh2& bvh, std::string& text)
+{
+  text = "HIERARCHY\n";
+  if (bvh.getRootJoint() != nullptr)
+    writeJoint(bvh.getRootJoint(), 0, text);
+}
+
+static void refill(MotionReader& reader)
+{
+  // the unparsed tail moves to the front, one byte stays free for a terminating 0
+  size_t remaining = reader.end - reader.position;
+  std::memmove(reader.buffer.data(), reader.buffer.data() + reader.position, remaining);
+  reader.position = 0;
+  reader.end = remaining;
+  reader.stream.read(reader.buffer.data() + reader.end, reader.buffer.size() - 1 - reader.end);
+  reader.end += (size_t)reader.stream.gcount();
+  reader.endOfFile = !reader.stream;
+}
+
+// next whitespace separated number of the text frames, false at the end of the file or at a
+// token that isn't a number
+static bool nextValue(MotionReader& reader, float& value)
+{
+  if (reader.failed)
+    return false;
+  while (true)
+  {
+    char* text = reader.buffer.data();
+    while (reader.position < reader.end && std::isspace((unsigned char)text[reader.position]))
+    {
+      if (text[reader.position] == '\n')
+        reader.line++;
+      reader.position++;
+    }
+
+    // a token is whole once whitespace follows it or the file ended
+    size_t tokenEnd = reader.position;
+    while (tokenEnd < reader.end && !std::isspace((unsigned char)text[tokenEnd]))
+      tokenEnd++;
+    if (reader.position < reader.end && (tokenEnd < reader.end || reader.endOfFile))
+    {
+      // the terminator goes on the whitespace after the token, a newline there is counted now
+      if (tokenEnd < reader.end && text[tokenEnd] == '\n')
+        reader.line++;
+      text[tokenEnd] = '\0';
+      char* parsed = nullptr;
+      value = strtof(text + reader.position, &parsed);
+      if (parsed != text + tokenEnd)
+      {
+        std::cout << reader.name << " line " << reader.line << ": " << text + reader.position << " isn't a number" << std::endl;
+        reader.failed = true;
+        return false;
+      }
+      reader.position = std::min(tokenEnd + 1, reader.end);
+      return true;
+    }
+    if (reader.endOfFile)
+      return false;
+    refill(reader);
+  }
+}
+
+static std::string trimmed(const std::string& line)
+{
+  size_t begin = line.find_first_not_of(" \t\r\n");
+  size_t end = line.find_last_not_of(" \t\r\n");
+  return begin == std::string::npos ? std::string() : line.substr(begin, end - begin + 1);
+}
+
+bool openMotionReader(const std::string& filename, MotionReader& reader)
+{
+  reader.name = filename;
+  reader.format = motionFormat(filename);
+  if (compressedFile(filename))
+  {
+    reader.inflated.reset(new InflateBuffer(filename));
+    reader.stream.rdbuf(reader.inflated.get());
+  }
+  else
+  {
+    // the stream stays bad without a buffer when the file doesn't open
+    reader.file.open(filename, std::ios::binary);
+    if (reader.file.is_open())
+      reader.stream.rdbuf(reader.file.rdbuf());
+  }
+  if (!reader.stream || (reader.format != MotionFormatBvh && reader.format != MotionFormatBinary))
+  {
+    std::cout << "Failed to read " << filename << std::endl;
+    return false;
+  }
+
+  std::string hierarchy;
+  if (reader.format == MotionFormatBinary)
+  {
+    MotionHeader header = {};
+    reader.stream.read((char*)&header, sizeof(header));
+    if (!reader.stream || header.magic != MotionMagic || header.version != MotionVersion)
+    {
+      std::cout << "Not a motion file " << filename << std::endl;
+      return false;
+    }
+    hierarchy.resize(header.hierarchyBytes);
+    reader.stream.read(&hierarchy[0], header.hierarchyBytes);
+    reader.numFrames = header.numFrames;
+    reader.frameTime = header.frameTime;
+  }
+  else
+  {
+    // the hierarchy goes to Bvh2, the frames are parsed here a buffer at a time
+    std::string line;
+    while (std::getline(reader.stream, line) && trimmed(line) != "MOTION")
+    {
+      hierarchy += line + "\n";
+      reader.line++;
+    }
+    reader.line++;
+    while (std::getline(reader.stream, line))
+    {
+      reader.line++;
+      std::istringstream fields(line);
+      std::string word;
+      fields >> word;
+      if (word == "Frames:")
+        fields >> reader.numFrames;
+      else if (word == "Frame")
+      {
+        fields >> word >> reader.frameTime;
+        break;
+      }
+    }
+  }
+
+  std::istringstream hierarchyStream(hierarchy);
+  reader.skeleton.load(hierarchyStream);
+  reader.numChannels = reader.skeleton.getMotion().numMotionChannels;
+  if (reader.skeleton.getRootJoint() == nullptr || reader.numChannels == 0 || !reader.stream)
+  {
+    std::cout << "Failed to load " << filename << std::endl;
+    return false;
+  }
+
+  reader.buffer.resize(ReadBufferBytes + 1);
+  reader.position = reader.end = 0;
+  reader.line++; // the first frame follows the Frame Time line
+  reader.endOfFile = false;
+  reader.failed = false;
+  return true;
+}
+
+unsigned int readMotionFrames(MotionReader& reader, float* frames, unsigned int maxFrames)
+{
+  unsigned int numChannels = reader.numChannels;
+  if (reader.format == MotionFormatBinary)
+  {
+    reader.stream.read((char*)frames, (std::streamsize)maxFrames * numChannels * sizeof(float));
+    return (unsigned int)(reader.stream.gcount() / (numChannels * sizeof(float)));
+  }
+
+  for (unsigned int frame = 0; frame < maxFrames; frame++)
+  {
+    float* values = frames + (size_t)frame * numChannels;
+    for (unsigned int channel = 0; channel < numChannels; channel++)
+    {
+      if (!nextValue(reader, values[channel]))
+        return frame;
+    }
+  }
+  return maxFrames;
+}
+
+bool openMotionWriter(const std::string& filename, int format, const Bvh2& skeleton, float frameTime, MotionWriter& writer)
+{
+  writer.format = format;
+  writer.numChannels = skeleton.getMotion().numMotionChannels;
+  writer.numFrames = 0;
+  writer.file.open(filename, std::ios::binary | std::ios::trunc);
+  if (!writer.file || hasSuffix(filename, ".gz") || skeleton.getRootJoint() == nullptr || format < MotionFormatBvh || format > MotionFormatCsv)
+  {
+    std::cout << "Failed to write " << filename << std::endl;
+    return false;
+  }
+
+  if (format == MotionFormatCsv)
+  {
+    std::string header = "frame";
+    for (const Joint* joint : skeleton.getJoints())
+    {
+      for (unsigned int i = 0; i < joint->numChannels; i++)
+        header += std::string(",") + joint->name + "_" + channelName(joint->channelsOrder[i]);
+    }
+    header += '\n';
+    writer.file.write(header.data(), header.size());
+    return (bool)writer.file;
+  }
+
+  std::string hierarchy;
+  writeBvhHierarchy(skeleton, hierarchy);
+  if (format == MotionFormatBinary)
+  {
+    MotionHeader header = { MotionMagic, MotionVersion, 0, writer.numChannels, frameTime, (unsigned int)hierarchy.size() };
+    writer.framesField = (std::streamoff)offsetof(MotionHeader, numFrames);
+    writer.file.write((const char*)&header, sizeof(header));
+    writer.file.write(hierarchy.data(), hierarchy.size());
+    return (bool)writer.file;
+  }
+
+  hierarchy += "MOTION\nFrames: ";
+  writer.framesField = (std::streamoff)hierarchy.size();
+  hierarchy += std::string(FramesFieldWidth, ' ') + "\nFrame Time: ";
+  appendFloat(hierarchy, frameTime);
+  hierarchy += '\n';
+  writer.file.write(hierarchy.data(), hierarchy.size());
+  return (bool)writer.file;
+}
+
+bool writeMotionFrames(MotionWriter& writer, const float* frames, unsigned int numFrames)
+{
+  unsigned int numChannels = writer.numChannels;
+  if (writer.format == MotionFormatBinary)
+  {
+    writer.file.write((const char*)frames, (std::streamsize)numFrames * numChannels * sizeof(float));
+    writer.numFrames += numFrames;
+    return (bool)writer.file;
+  }
+
+  // pieces of frames are formatted in parallel into their own text, then written in order
+  unsigned int numPieces = (numFrames + FormatPieceFrames - 1) / FormatPieceFrames;
+  if (writer.pieces.size() < numPieces)
+    writer.pieces.resize(numPieces);
+  unsigned int firstFrame = writer.numFrames;
+  bool csv = writer.format == MotionFormatCsv;
+  parallelFor(0, numPieces, [&](unsigned int beginPiece, unsigned int endPiece)
+  {
+    char buffer[32];
+    for (unsigned int piece = beginPiece; piece < endPiece; piece++)
+    {
+      std::string& text = writer.pieces[piece];
+      text.clear();
+      unsigned int end = std::min(numFrames, (piece + 1) * FormatPieceFrames);
+      for (unsigned int frame = piece * FormatPieceFrames; frame < end; frame++)
+      {
+        const float* values = frames + (size_t)frame * numChannels;
+        if (csv)
+        {
+          text += std::to_string(firstFrame + frame);
+          text += ',';
+        }
+        for (unsigned int channel = 0; channel < numChannels; channel++)
+        {
+          if (channel > 0)
+            text += csv ? ',' : ' ';
+          text.append(buffer, formatFloat(values[channel], buffer));
+        }
+        text += '\n';
+      }
+    }
+  }, 1);
+
+  for (unsigned int piece = 0; piece < numPieces; piece++)
+    writer.file.write(writer.pieces[piece].data(), writer.pieces[piece].size());
+  writer.numFrames += numFrames;
+  return (bool)writer.file;
+}
+
+bool closeMotionWriter(MotionWriter& writer)
+{
+  if (writer.format != MotionFormatCsv && writer.file)
+  {
+    writer.file.seekp(writer.framesField);
+    if (writer.format == MotionFormatBinary)
+    {
+      writer.file.write((const char*)&writer.numFrames, sizeof(unsigned int));
+    }
+    else
+    {
+      std::string count = std::to_string(writer.numFrames);
+      writer.file.write(count.data(), count.size());
+    }
+  }
+  bool written = (bool)writer.file;
+  writer.file.close();
+  std::vector<std::string>().swap(writer.pieces);
+  return written;
+}
+
+bool saveMotion(const Bvh2& bvh, const std::string& filename)
+{
+  const Motion& motion = bvh.getMotion();
+  MotionWriter writer;
+  if (motion.numFrames == 0 || !openMotionWriter(filename, motionFormat(filename), bvh, motion.frameTime, writer))
+    return false;
+
+  // edited motions may be spread over several blocks, chunks are gathered before writing
+  std::vector<float> frames;
+  size_t frameSize = motion.numMotionChannels;
+  for (unsigned int begin = 0; begin < motion.numFrames; begin += MotionStreamFrames)
+  {
+    unsigned int count = std::min((unsigned int)MotionStreamFrames, motion.numFrames - begin);
+    const float* chunk = motion.data != nullptr ? motion.data + begin * frameSize : nullptr;
+    if (chunk == nullptr)
+    {
+      frames.resize(count * frameSize);
+      copyMotionFrames(motion, begin, begin + count, frames.data());
+      chunk = frames.data();
+    }
+    if (!writeMotionFrames(writer, chunk, count))
+      break;
+  }
+  return closeMotionWriter(writer);
+}
+
+long long convertMotion(const std::string& input, const std::string& output)
+{
+  MotionReader reader;
+  MotionWriter writer;
+  if (!openMotionReader(input, reader) ||
+      !openMotionWriter(output, motionFormat(output), reader.skeleton, reader.frameTime, writer))
+    return -1;
+
+  std::vector<float> frames((size_t)MotionStreamFrames * reader.numChannels);
+  long long converted = 0;
+  while (unsigned int count = readMotionFrames(reader, frames.data(), MotionStreamFrames))
+  {
+    if (!writeMotionFrames(writer, frames.data(), count))
+      break;
+    converted += count;
+  }
+  if (!closeMotionWriter(writer) || reader.failed)
+    return -1;
+  if (reader.numFrames != 0 && converted != reader.numFrames)
+    std::cout << input << " declares " << reader.numFrames << " frames, " << converted << " were read" << std::endl;
+  return converted;
+}
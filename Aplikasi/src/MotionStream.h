@@ -0,0 +1,76 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Inflate.h"
+#include "bvh2.h"
+
+#define MotionFormatBvh 0
+#define MotionFormatBinary 1 // .bmot, the hierarchy text followed by raw float frames
+#define MotionFormatCsv 2    // written only, there's no hierarchy to read back
+
+// frames the converter and saveMotion hold at once
+#define MotionStreamFrames 4096
+
+// by extension, -1 when it's none of the above. a .gz after it is read the same way, the
+// reader inflates gzip and zlib input whatever the name
+int motionFormat(const std::string& filename);
+
+// the shortest decimal that reads back as the same float, buffer holds at least 32 chars.
+// returns the length, the text isn't terminated
+int formatFloat(float value, char* buffer);
+
+// HIERARCHY section of the Joint tree, offsets and channels as they were loaded
+void writeBvhHierarchy(const Bvh2& bvh, std::string& text);
+
+// frames read a chunk at a time, the skeleton holds the hierarchy and no frames
+struct MotionReader
+{
+  std::ifstream file;
+  std::unique_ptr<InflateBuffer> inflated; // compressed input, decoded on a second thread
+  std::istream stream{nullptr};            // the file or the inflated text
+  int format = MotionFormatBvh;
+  Bvh2 skeleton;
+  unsigned int numFrames = 0;   // as the header says, the reader stops at the end of the data
+  unsigned int numChannels = 0;
+  float frameTime = 0.0f;
+
+  std::string name;
+  std::vector<char> buffer;     // text not parsed yet, [position, end)
+  size_t position = 0;
+  size_t end = 0;
+  unsigned int line = 0;        // of the text at position, from 1
+  bool endOfFile = false;
+  bool failed = false;          // a value that isn't a number, the frames stop before it
+};
+
+// frames are formatted in parallel and written in order, the frame count in the header is
+// patched when the writer is closed
+struct MotionWriter
+{
+  std::ofstream file;
+  int format = MotionFormatBvh;
+  unsigned int numChannels = 0;
+  unsigned int numFrames = 0;   // written so far
+  std::streampos framesField;   // where the frame count is patched
+  std::vector<std::string> pieces;
+};
+
+bool openMotionReader(const std::string& filename, MotionReader& reader);
+
+// up to maxFrames frames into frames (maxFrames * numChannels), returns how many were read.
+// fewer at the end of the data or when reader.failed is set
+unsigned int readMotionFrames(MotionReader& reader, float* frames, unsigned int maxFrames);
+
+bool openMotionWriter(const std::string& filename, int format, const Bvh2& skeleton, float frameTime, MotionWriter& writer);
+bool writeMotionFrames(MotionWriter& writer, const float* frames, unsigned int numFrames);
+bool closeMotionWriter(MotionWriter& writer);
+
+// the current motion of bvh, edited or filtered, in any of the formats
+bool saveMotion(const Bvh2& bvh, const std::string& filename);
+
+// pipes the reader into the writer a chunk at a time, returns the frames converted or -1
+long long convertMotion(const std::string& input, const std::string& output);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// true on threads that already run a parallel range, nested parallelFor calls run inline there
+inline bool& parallelWorker()
+{
+  static thread_local bool worker = false;
+  return worker;
+}
+
+// splits [begin, end) into one contiguous range per hardware thread and calls
+// func(rangeBegin, rangeEnd) on each of them, the calling thread takes the last range
+template <typename Func>
+void parallelFor(unsigned int begin, unsigned int end, Func func, unsigned int minRange = 64)
+{
+  if (end <= begin)
+    return;
+
+  unsigned int count = end - begin;
+  unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, std::max(1u, count / std::max(1u, minRange)));
+
+  if (numThreads == 1 || parallelWorker())
+  {
+    func(begin, end);
+    return;
+  }
+
+  unsigned int rangeSize = (count + numThreads - 1) / numThreads;
+  std::vector<std::thread> workers;
+  workers.reserve(numThreads - 1);
+
+  unsigned int rangeBegin = begin;
+  for (unsigned int t = 0; t < numThreads - 1 && rangeBegin < end; t++)
+  {
+    unsigned int rangeEnd = std::min(end, rangeBegin + rangeSize);
+    workers.emplace_back([&func, rangeBegin, rangeEnd]()
+    {
+      parallelWorker() = true;
+      func(rangeBegin, rangeEnd);
+    });
+    rangeBegin = rangeEnd;
+  }
+
+  if (rangeBegin < end)
+  {
+    parallelWorker() = true;
+    func(rangeBegin, end);
+    parallelWorker() = false;
+  }
+
+  for (auto& worker : workers)
+    worker.join();
+}
@@ -0,0 +1,379 @@
+#include "PoseClusters.h"
+
+#include "Aggregation.h"
+#include "bvh2.h"
+#include "FrameSimilarity.h"
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// frames are split into this many chunks, each with its own partial sums, so the
+// reductions don't depend on the number of threads
+#define ClusterChunks 64
+
+// padding centers sit far enough away to never be nearest but keep the sums finite
+#define FarCenter 1e18f
+
+// centers dim major, four centers per load
+struct CenterTable
+{
+  unsigned int numCenters = 0;
+  unsigned int stride = 0; // numCenters rounded up to 4
+  unsigned int dims = 0;
+  std::vector<float> data; // dim * stride + center
+
+  void build(const std::vector<float>& centers, unsigned int k, unsigned int numDims)
+  {
+    numCenters = k;
+    dims = numDims;
+    stride = (k + 3) & ~3u;
+    data.assign((size_t)dims * stride, FarCenter);
+    for (unsigned int c = 0; c < k; c++)
+      for (unsigned int d = 0; d < dims; d++)
+        data[(size_t)d * stride + c] = centers[(size_t)c * dims + d];
+  }
+
+  // nearest center and its squared distance
+  unsigned int nearest(const float* x, float& distance) const
+  {
+    unsigned int best = 0;
+    distance = FLT_MAX;
+    for (unsigned int c = 0; c < stride; c += 4)
+    {
+      float4 sum;
+      const float* column = &data[c];
+      for (unsigned int d = 0; d < dims; d++)
+      {
+        float4 difference = float4::load(column + (size_t)d * stride) - float4(x[d]);
+        sum += difference * difference;
+      }
+      float lanes[4];
+      sum.store(lanes);
+      for (unsigned int l = 0; l < 4; l++)
+      {
+        if (lanes[l] < distance)
+        {
+          distance = lanes[l];
+          best = c + l;
+        }
+      }
+    }
+    return best;
+  }
+};
+
+static float squaredDistance(const float* a, const float* b, unsigned int dims)
+{
+  float4 sum;
+  for (unsigned int d = 0; d < dims; d += 4)
+  {
+    float4 difference = float4::load(a + d) - float4::load(b + d);
+    sum += difference * difference;
+  }
+  float lanes[4];
+  sum.store(lanes);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// k-means++ over a sample of the frames
+static void seedCenters(const std::vector<float>& vectors, unsigned int numFrames, unsigned int dims, unsigned int k,
+                        const ClusterSettings& settings, std::mt19937& random, std::vector<float>& centers)
+{
+  std::vector<unsigned int> sample;
+  if (numFrames > settings.seedSample)
+  {
+    std::uniform_int_distribution<unsigned int> pick(0, numFrames - 1);
+    sample.resize(settings.seedSample);
+    for (unsigned int& frame : sample)
+      frame = pick(random);
+  }
+  else
+  {
+    sample.resize(numFrames);
+    for (unsigned int f = 0; f < numFrames; f++)
+      sample[f] = f;
+  }
+
+  unsigned int numSamples = (unsigned int)sample.size();
+  std::vector<float> nearest(numSamples, FLT_MAX);
+  centers.assign((size_t)k * dims, 0.0f);
+  unsigned int chosen = sample[std::uniform_int_distribution<unsigned int>(0, numSamples - 1)(random)];
+
+  for (unsigned int c = 0; c < k; c++)
+  {
+    const float* center = &vectors[(size_t)chosen * dims];
+    std::copy(center, center + dims, centers.begin() + (size_t)c * dims);
+    if (c + 1 == k)
+      break;
+
+    parallelFor(0, numSamples, [&](unsigned int begin, unsigned int end)
+    {
+      for (unsigned int s = begin; s < end; s++)
+        nearest[s] = std::min(nearest[s], squaredDistance(&vectors[(size_t)sample[s] * dims], center, dims));
+    }, 1024);
+
+    // next center with probability proportional to the squared distance
+    double total = 0.0;
+    for (float distance : nearest)
+      total += distance;
+    double target = std::uniform_real_distribution<double>(0.0, total)(random);
+    unsigned int s = 0;
+    for (; s + 1 < numSamples; s++)
+    {
+      target -= nearest[s];
+      if (target < 0.0)
+        break;
+    }
+    chosen = sample[s];
+  }
+}
+
+static void clusterVectors(const std::vector<float>& vectors, unsigned int numFrames, const ClusterSettings& settings,
+                           PoseClusters& clusters)
+{
+  unsigned int dims = clusters.dims;
+  unsigned int k = std::min(std::min(settings.numClusters, (unsigned int)MaxPoseClusters), numFrames);
+  clusters.numClusters = k;
+  clusters.assignments.assign(numFrames, 0);
+  if (k == 0)
+    return;
+
+  std::mt19937 random(settings.seed);
+  std::vector<float> centers;
+  seedCenters(vectors, numFrames, dims, k, settings, random, centers);
+  CenterTable table;
+  table.build(centers, k, dims);
+
+  unsigned int chunkSize = (numFrames + ClusterChunks - 1) / ClusterChunks;
+  if (numFrames <= settings.miniBatchAbove)
+  {
+    // Lloyd iterations until no frame changes cluster
+    std::vector<std::vector<double>> sums(ClusterChunks);
+    std::vector<std::vector<unsigned int>> counts(ClusterChunks);
+    std::vector<unsigned int> changes(ClusterChunks);
+    for (unsigned int iteration = 0; iteration < settings.maxIterations; iteration++)
+    {
+      parallelFor(0, ClusterChunks, [&](unsigned int beginChunk, unsigned int endChunk)
+      {
+        for (unsigned int chunk = beginChunk; chunk < endChunk; chunk++)
+        {
+          sums[chunk].assign((size_t)k * dims, 0.0);
+          counts[chunk].assign(k, 0);
+          changes[chunk] = 0;
+          unsigned int end = std::min(numFrames, (chunk + 1) * chunkSize);
+          for (unsigned int f = chunk * chunkSize; f < end; f++)
+          {
+            float distance;
+            const float* x = &vectors[(size_t)f * dims];
+            unsigned int c = table.nearest(x, distance);
+            changes[chunk] += (iteration == 0 || clusters.assignments[f] != c) ? 1 : 0;
+            clusters.assignments[f] = (unsigned char)c;
+            counts[chunk][c]++;
+            double* sum = &sums[chunk][(size_t)c * dims];
+            for (unsigned int d = 0; d < dims; d++)
+              sum[d] += x[d];
+          }
+        }
+      }, 1);
+
+      unsigned int changed = 0;
+      for (unsigned int chunk = 0; chunk < ClusterChunks; chunk++)
+        changed += changes[chunk];
+      if (changed == 0)
+        break;
+
+      // an empty cluster keeps its center
+      for (unsigned int c = 0; c < k; c++)
+      {
+        unsigned int count = 0;
+        for (unsigned int chunk = 0; chunk < ClusterChunks; chunk++)
+          count += counts[chunk][c];
+        if (count == 0)
+          continue;
+        for (unsigned int d = 0; d < dims; d++)
+        {
+          double sum = 0.0;
+          for (unsigned int chunk = 0; chunk < ClusterChunks; chunk++)
+            sum += sums[chunk][(size_t)c * dims + d];
+          centers[(size_t)c * dims + d] = (float)(sum / count);
+        }
+      }
+      table.build(centers, k, dims);
+    }
+  }
+  else
+  {
+    // mini-batch k-means, each center moves by 1 / its running count towards its batch frames
+    std::uniform_int_distribution<unsigned int> pick(0, numFrames - 1);
+    std::vector<unsigned int> batch(settings.batchSize);
+    std::vector<unsigned char> batchAssignments(settings.batchSize);
+    std::vector<unsigned int> seen(k, 0);
+    for (unsigned int iteration = 0; iteration < settings.maxIterations * 10; iteration++)
+    {
+      for (unsigned int& frame : batch)
+        frame = pick(random);
+      parallelFor(0, settings.batchSize, [&](unsigned int begin, unsigned int end)
+      {
+        for (unsigned int b = begin; b < end; b++)
+        {
+          float distance;
+          batchAssignments[b] = (unsigned char)table.nearest(&vectors[(size_t)batch[b] * dims], distance);
+        }
+      }, 256);
+
+      for (unsigned int b = 0; b < settings.batchSize; b++)
+      {
+        unsigned int c = batchAssignments[b];
+        float rate = 1.0f / ++seen[c];
+        float* center = &centers[(size_t)c * dims];
+        const float* x = &vectors[(size_t)batch[b] * dims];
+        for (unsigned int d = 0; d < dims; d++)
+          center[d] += (x[d] - center[d]) * rate;
+      }
+      table.build(centers, k, dims);
+    }
+  }
+
+  // final assignment, spread and the frame nearest to each center
+  std::vector<double> chunkDistance(ClusterChunks, 0.0);
+  std::vector<std::vector<unsigned int>> chunkCounts(ClusterChunks, std::vector<unsigned int>(k, 0));
+  std::vector<std::vector<float>> chunkBest(ClusterChunks, std::vector<float>(k, FLT_MAX));
+  std::vector<std::vector<unsigned int>> chunkBestFrame(ClusterChunks, std::vector<unsigned int>(k, 0));
+  parallelFor(0, ClusterChunks, [&](unsigned int beginChunk, unsigned int endChunk)
+  {
+    for (unsigned int chunk = beginChunk; chunk < endChunk; chunk++)
+    {
+      unsigned int end = std::min(numFrames, (chunk + 1) * chunkSize);
+      for (unsigned int f = chunk * chunkSize; f < end; f++)
+      {
+        float distance;
+        unsigned int c = table.nearest(&vectors[(size_t)f * dims], distance);
+        clusters.assignments[f] = (unsigned char)c;
+        chunkCounts[chunk][c]++;
+        chunkDistance[chunk] += distance;
+        if (distance < chunkBest[chunk][c])
+        {
+          chunkBest[chunk][c] = distance;
+          chunkBestFrame[chunk][c] = f;
+        }
+      }
+    }
+  }, 1);
+
+  double totalDistance = 0.0;
+  clusters.counts.assign(k, 0);
+  std::vector<float> best(k, FLT_MAX);
+  std::vector<unsigned int> bestFrame(k, 0);
+  for (unsigned int chunk = 0; chunk < ClusterChunks; chunk++)
+  {
+    totalDistance += chunkDistance[chunk];
+    for (unsigned int c = 0; c < k; c++)
+    {
+      clusters.counts[c] += chunkCounts[chunk][c];
+      if (chunkBest[chunk][c] < best[c])
+      {
+        best[c] = chunkBest[chunk][c];
+        bestFrame[c] = chunkBestFrame[chunk][c];
+      }
+    }
+  }
+  clusters.meanDistance = (float)std::sqrt(totalDistance / numFrames);
+  clusters.centers = centers;
+
+  // uniform weights scale every joint by sqrt(1 / numJoints)
+  float scale = std::sqrt((float)clusters.numJoints);
+  clusters.representativeClip.resize(k);
+  clusters.representativeFrame.resize(k);
+  clusters.representativePoses.resize((size_t)k * clusters.numJoints);
+  for (unsigned int c = 0; c < k; c++)
+  {
+    unsigned int frame = bestFrame[c];
+    unsigned int clip = (unsigned int)(std::upper_bound(clusters.clipBegin.begin(), clusters.clipBegin.end(), frame) -
+                                       clusters.clipBegin.begin()) - 1;
+    clusters.representativeClip[c] = clip;
+    clusters.representativeFrame[c] = frame - clusters.clipBegin[clip];
+    const float* x = &vectors[(size_t)frame * dims];
+    for (unsigned int j = 0; j < clusters.numJoints; j++)
+      clusters.representativePoses[(size_t)c * clusters.numJoints + j] = glm::vec4(x[j * 3] * scale, x[j * 3 + 1] * scale, x[j * 3 + 2] * scale, 1.0f);
+  }
+}
+
+// concatenates the vectors of every clip and clusters them
+static void finishClusters(std::vector<std::vector<float>>& clipVectors, const ClusterSettings& settings,
+                           PoseClusters& clusters)
+{
+  clusters.clipBegin.assign(clipVectors.size() + 1, 0);
+  for (size_t i = 0; i < clipVectors.size(); i++)
+    clusters.clipBegin[i + 1] = clusters.clipBegin[i] + (unsigned int)(clipVectors[i].size() / std::max(1u, clusters.dims));
+  unsigned int numFrames = clusters.clipBegin.back();
+
+  std::vector<float> vectors((size_t)numFrames * clusters.dims);
+  for (size_t i = 0; i < clipVectors.size(); i++)
+  {
+    std::copy(clipVectors[i].begin(), clipVectors[i].end(), vectors.begin() + (size_t)clusters.clipBegin[i] * clusters.dims);
+    std::vector<float>().swap(clipVectors[i]);
+  }
+  clusterVectors(vectors, numFrames, settings, clusters);
+}
+
+void clusterPoses(const std::vector<const ClipTrajectory*>& trajectories, const std::vector<std::string>& names,
+                  const ClusterSettings& settings, PoseClusters& clusters)
+{
+  clusters = PoseClusters();
+  clusters.clips = names;
+  clusters.clips.resize(trajectories.size());
+  clusters.numJoints = trajectories.empty() ? 0 : trajectories[0]->numJoints;
+  clusters.dims = (clusters.numJoints * 3 + 3) & ~3u;
+
+  std::vector<std::vector<float>> clipVectors(trajectories.size());
+  for (size_t i = 0; i < trajectories.size(); i++)
+  {
+    if (trajectories[i]->numJoints == clusters.numJoints && !trajectories[i]->rotations.empty())
+      buildPoseVectors(*trajectories[i], std::vector<float>(), settings.alignHeading, clusters.dims, clipVectors[i]);
+  }
+  finishClusters(clipVectors, settings, clusters);
+}
+
+unsigned int clusterClips(const std::vector<ClipEntry>& clips, const ClusterSettings& settings, PoseClusters& clusters)
+{
+  clusters = PoseClusters();
+  clusters.clips.resize(clips.size());
+  for (size_t i = 0; i < clips.size(); i++)
+    clusters.clips[i] = clips[i].path;
+
+  // a failed clip keeps its slot with no frames, clips with another skeleton than the first fail
+  std::vector<std::vector<float>> clipVectors(clips.size());
+  std::vector<unsigned int> clipJoints(clips.size(), 0);
+  parallelFor(0, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      Bvh2 bvh;
+      ClipTrajectory trajectory;
+      if (!loadManifestClip(clips[i], ManifestJointsOnly, bvh, trajectory))
+        continue;
+      clipJoints[i] = trajectory.numJoints;
+      buildPoseVectors(trajectory, std::vector<float>(), settings.alignHeading, (trajectory.numJoints * 3 + 3) & ~3u, clipVectors[i]);
+    }
+  }, 1);
+
+  unsigned int failures = 0;
+  for (size_t i = 0; i < clips.size(); i++)
+  {
+    if (clusters.numJoints == 0)
+      clusters.numJoints = clipJoints[i];
+    if (clipJoints[i] == 0 || clipJoints[i] != clusters.numJoints)
+    {
+      std::vector<float>().swap(clipVectors[i]);
+      failures++;
+    }
+  }
+  clusters.dims = (clusters.numJoints * 3 + 3) & ~3u;
+  finishClusters(clipVectors, settings, clusters);
+  return failures;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BodyModel.h"
+
+struct ClipEntry;
+
+struct ClusterSettings
+{
+  unsigned int numClusters = 8;
+  bool alignHeading = true;
+  unsigned int maxIterations = 50;       // full passes, or mini batches times 10
+  unsigned int miniBatchAbove = 200000;  // frames, larger inputs use mini-batch k-means
+  unsigned int batchSize = 4096;
+  unsigned int seedSample = 50000;       // frames k-means++ picks the first centers from
+  unsigned int seed = 1;
+};
+
+// clusters of the pose vectors of every frame (buildPoseVectors with uniform joint weights),
+// distances are RMS joint distances in cm
+struct PoseClusters
+{
+  unsigned int numClusters = 0;
+  unsigned int numJoints = 0;
+  unsigned int dims = 0;
+  float meanDistance = 0.0f;             // RMS distance of the frames to their center
+
+  std::vector<std::string> clips;
+  std::vector<unsigned int> clipBegin;   // first frame of each clip in assignments, numClips + 1
+  std::vector<unsigned char> assignments; // frame
+  std::vector<float> centers;            // cluster * dims
+  std::vector<unsigned int> counts;      // cluster
+
+  // the frame nearest to each center and its joints relative to the root on the floor
+  std::vector<unsigned int> representativeClip;
+  std::vector<unsigned int> representativeFrame;
+  std::vector<glm::vec4> representativePoses; // cluster * numJoints + joint
+};
+
+// at most 255 clusters so a frame's cluster is one byte
+#define MaxPoseClusters 255
+
+// clusters the baked frames of the trajectories (joints and rotations) in parallel
+void clusterPoses(const std::vector<const ClipTrajectory*>& trajectories, const std::vector<std::string>& names,
+                  const ClusterSettings& settings, PoseClusters& clusters);
+
+// loads and bakes the clips of a manifest in parallel first, returns the number that failed
+unsigned int clusterClips(const std::vector<ClipEntry>& clips, const ClusterSettings& settings, PoseClusters& clusters);
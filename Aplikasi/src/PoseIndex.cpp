@@ -0,0 +1,453 @@
+#include "PoseIndex.h"
+
+#include "Aggregation.h"
+#include "bvh2.h"
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Hips, Head, LeftHand, RightHand, LeftFoot, RightFoot
+const unsigned int poseJoints[NumPoseJoints] = { 0, 4, 9, 14, 18, 23 };
+
+// 'PIDX'
+#define PoseIndexMagic 0x58444950
+#define PoseIndexVersion 1
+
+void extractPoseFeature(const ClipTrajectory& trajectory, unsigned int frame, float* feature)
+{
+  unsigned int numJoints = trajectory.numJoints;
+  const glm::vec4* joints = &trajectory.joints[(size_t)frame * numJoints];
+  glm::vec3 hips = glm::vec3(joints[0]);
+
+  glm::vec2 heading = rootHeading(trajectory, frame);
+  float s = heading.x;
+  float c = heading.y;
+
+  unsigned int previous = frame > 0 ? frame - 1 : frame;
+  unsigned int next = frame + 1 < trajectory.numFrames ? frame + 1 : frame;
+  float rate = next > previous ? 1.0f / ((next - previous) * trajectory.frameTime) : 0.0f;
+
+  unsigned int d = 0;
+  for (unsigned int i = 1; i < NumPoseJoints; i++)
+  {
+    glm::vec3 p = glm::vec3(joints[poseJoints[i]]) - hips;
+    feature[d++] = p.x * c - p.z * s;
+    feature[d++] = p.y;
+    feature[d++] = p.x * s + p.z * c;
+  }
+  for (unsigned int i = 0; i < NumPoseJoints; i++)
+  {
+    glm::vec3 v = (glm::vec3(trajectory.joints[(size_t)next * numJoints + poseJoints[i]]) -
+                   glm::vec3(trajectory.joints[(size_t)previous * numJoints + poseJoints[i]])) * rate;
+    feature[d++] = v.x * c - v.z * s;
+    feature[d++] = v.y;
+    feature[d++] = v.x * s + v.z * c;
+  }
+  for (; d < PoseFeatureStride; d++)
+    feature[d] = 0.0f;
+}
+
+void normalizePoseFeature(const PoseIndex& index, float* feature)
+{
+  for (unsigned int d = 0; d < PoseFeatureStride; d += 4)
+    ((float4::load(feature + d) - float4::load(index.mean + d)) * float4::load(index.scale + d)).store(feature + d);
+}
+
+static void extractClipFeatures(const ClipTrajectory& trajectory, std::vector<float>& features)
+{
+  features.resize((size_t)trajectory.numFrames * PoseFeatureStride);
+  for (unsigned int frame = 0; frame < trajectory.numFrames; frame++)
+    extractPoseFeature(trajectory, frame, &features[(size_t)frame * PoseFeatureStride]);
+}
+
+// statistics, normalization and the tree over the features of every clip
+static void finishPoseIndex(std::vector<std::vector<float>>& clipFeatures, PoseIndex& index)
+{
+  index.clipFrames.resize(clipFeatures.size());
+  unsigned int numPoints = 0;
+  for (size_t i = 0; i < clipFeatures.size(); i++)
+  {
+    index.clipFrames[i] = (unsigned int)(clipFeatures[i].size() / PoseFeatureStride);
+    numPoints += index.clipFrames[i];
+  }
+  index.numPoints = numPoints;
+
+  // mean per dimension, one standard deviation per joint so a vector keeps its direction
+  double sum[PoseFeatureStride] = {};
+  double sumSquares[PoseFeatureStride] = {};
+  for (const std::vector<float>& features : clipFeatures)
+  {
+    for (size_t p = 0; p < features.size(); p += PoseFeatureStride)
+    {
+      for (unsigned int d = 0; d < PoseFeatureSize; d++)
+      {
+        sum[d] += features[p + d];
+        sumSquares[d] += (double)features[p + d] * features[p + d];
+      }
+    }
+  }
+  for (unsigned int d = 0; d < PoseFeatureStride; d++)
+  {
+    index.mean[d] = numPoints > 0 && d < PoseFeatureSize ? (float)(sum[d] / numPoints) : 0.0f;
+    index.scale[d] = 0.0f;
+  }
+  for (unsigned int d = 0; d < PoseFeatureSize && numPoints > 0; d += 3)
+  {
+    double variance = 0.0;
+    for (unsigned int k = d; k < d + 3; k++)
+      variance += sumSquares[k] / numPoints - (double)index.mean[k] * index.mean[k];
+    float deviation = (float)std::sqrt(std::max(variance / 3.0, 1e-6));
+    float weight = d < (NumPoseJoints - 1) * 3 ? index.settings.positionWeight : index.settings.velocityWeight;
+    for (unsigned int k = d; k < d + 3; k++)
+      index.scale[k] = weight / deviation;
+  }
+
+  std::vector<float> points((size_t)numPoints * PoseFeatureStride);
+  std::vector<unsigned int> clipBegin(clipFeatures.size() + 1, 0);
+  for (size_t i = 0; i < clipFeatures.size(); i++)
+    clipBegin[i + 1] = clipBegin[i] + index.clipFrames[i];
+
+  parallelFor(0, (unsigned int)clipFeatures.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      std::copy(clipFeatures[i].begin(), clipFeatures[i].end(), points.begin() + (size_t)clipBegin[i] * PoseFeatureStride);
+      for (unsigned int frame = 0; frame < index.clipFrames[i]; frame++)
+        normalizePoseFeature(index, &points[(size_t)(clipBegin[i] + frame) * PoseFeatureStride]);
+      std::vector<float>().swap(clipFeatures[i]);
+    }
+  }, 1);
+
+  // leaves of at most PoseLeafSize points, a power of two of them
+  index.numLeaves = 1;
+  while ((size_t)index.numLeaves * PoseLeafSize < numPoints)
+    index.numLeaves *= 2;
+  index.splitAxis.assign(index.numLeaves - 1, 0);
+  index.splitValue.assign(index.numLeaves - 1, 0.0f);
+
+  std::vector<unsigned int> order(numPoints);
+  for (unsigned int p = 0; p < numPoints; p++)
+    order[p] = p;
+
+  // level by level median splits on the widest axis, nodes of a level split in parallel
+  std::vector<unsigned int> bounds(2);
+  bounds[0] = 0;
+  bounds[1] = numPoints;
+  for (unsigned int levelNodes = 1; levelNodes < index.numLeaves; levelNodes *= 2)
+  {
+    std::vector<unsigned int> childBounds(levelNodes * 2 + 1);
+    parallelFor(0, levelNodes, [&](unsigned int beginNode, unsigned int endNode)
+    {
+      for (unsigned int n = beginNode; n < endNode; n++)
+      {
+        unsigned int begin = bounds[n];
+        unsigned int end = bounds[n + 1];
+        unsigned int middle = begin + (end - begin) / 2;
+        unsigned int node = levelNodes - 1 + n;
+
+        float4 lower[PoseFeatureStride / 4];
+        float4 upper[PoseFeatureStride / 4];
+        for (unsigned int l = 0; l < PoseFeatureStride / 4; l++)
+        {
+          lower[l] = float4(FLT_MAX);
+          upper[l] = float4(-FLT_MAX);
+        }
+        for (unsigned int p = begin; p < end; p++)
+        {
+          const float* point = &points[(size_t)order[p] * PoseFeatureStride];
+          for (unsigned int l = 0; l < PoseFeatureStride / 4; l++)
+          {
+            float4 x = float4::load(point + l * 4);
+            lower[l] = vmin(lower[l], x);
+            upper[l] = vmax(upper[l], x);
+          }
+        }
+        float spread[PoseFeatureStride];
+        for (unsigned int l = 0; l < PoseFeatureStride / 4; l++)
+          (upper[l] - lower[l]).store(spread + l * 4);
+        unsigned int axis = (unsigned int)(std::max_element(spread, spread + PoseFeatureSize) - spread);
+
+        if (end > begin)
+        {
+          std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                           [&](unsigned int a, unsigned int b)
+                           {
+                             return points[(size_t)a * PoseFeatureStride + axis] < points[(size_t)b * PoseFeatureStride + axis];
+                           });
+        }
+        index.splitAxis[node] = (unsigned char)axis;
+        index.splitValue[node] = middle < end ? points[(size_t)order[middle] * PoseFeatureStride + axis] : 0.0f;
+        childBounds[n * 2] = begin;
+        childBounds[n * 2 + 1] = middle;
+      }
+    }, 1);
+    childBounds[levelNodes * 2] = numPoints;
+    bounds.swap(childBounds);
+  }
+  index.leafBegin = bounds;
+
+  // points in leaf order
+  index.features.resize((size_t)numPoints * PoseFeatureStride);
+  index.pointClip.resize(numPoints);
+  index.pointFrame.resize(numPoints);
+  parallelFor(0, numPoints, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int p = begin; p < end; p++)
+    {
+      unsigned int source = order[p];
+      std::copy(&points[(size_t)source * PoseFeatureStride], &points[(size_t)source * PoseFeatureStride] + PoseFeatureStride,
+                &index.features[(size_t)p * PoseFeatureStride]);
+      unsigned int clip = (unsigned int)(std::upper_bound(clipBegin.begin(), clipBegin.end(), source) - clipBegin.begin()) - 1;
+      index.pointClip[p] = clip;
+      index.pointFrame[p] = source - clipBegin[clip];
+    }
+  }, 4096);
+}
+
+void buildPoseIndex(const std::vector<const ClipTrajectory*>& trajectories, const std::vector<std::string>& names,
+                    const PoseFeatureSettings& settings, PoseIndex& index)
+{
+  index.settings = settings;
+  index.clips = names;
+  index.clips.resize(trajectories.size());
+
+  std::vector<std::vector<float>> clipFeatures(trajectories.size());
+  parallelFor(0, (unsigned int)trajectories.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      if (trajectories[i]->numJoints >= MinBodyModelJoints && !trajectories[i]->rotations.empty())
+        extractClipFeatures(*trajectories[i], clipFeatures[i]);
+    }
+  }, 1);
+  finishPoseIndex(clipFeatures, index);
+}
+
+unsigned int buildPoseIndex(const std::vector<ClipEntry>& clips, const PoseFeatureSettings& settings, PoseIndex& index)
+{
+  index.settings = settings;
+  index.clips.resize(clips.size());
+  for (size_t i = 0; i < clips.size(); i++)
+    index.clips[i] = clips[i].path;
+
+  // a failed clip keeps its slot with no frames so clip numbers match the manifest
+  std::vector<std::vector<float>> clipFeatures(clips.size());
+  std::vector<unsigned char> failed(clips.size(), 1);
+  parallelFor(0, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      // the features need the joints of the body model, not its COM
+      Bvh2 bvh;
+      ClipTrajectory trajectory;
+      if (!loadManifestClip(clips[i], ManifestJointsOnly, bvh, trajectory) || trajectory.numJoints < MinBodyModelJoints)
+        continue;
+      extractClipFeatures(trajectory, clipFeatures[i]);
+      failed[i] = 0;
+    }
+  }, 1);
+  finishPoseIndex(clipFeatures, index);
+
+  unsigned int failures = 0;
+  for (unsigned char f : failed)
+    failures += f;
+  return failures;
+}
+
+struct PoseSearch
+{
+  const PoseIndex& index;
+  const float* feature;
+  unsigned int k;
+  std::vector<PoseMatch>& matches; // sorted by distance, at most k
+  int excludeClip;
+  unsigned int excludeFrame;
+  unsigned int excludeRadius;
+  float offsets[PoseFeatureStride]; // distance of the query to the current cell per axis
+
+  float worst() const { return matches.size() < k ? FLT_MAX : matches.back().distance; }
+
+  void scanLeaf(unsigned int leaf)
+  {
+    for (unsigned int p = index.leafBegin[leaf]; p < index.leafBegin[leaf + 1]; p++)
+    {
+      const float* point = &index.features[(size_t)p * PoseFeatureStride];
+      float4 sum;
+      for (unsigned int d = 0; d < PoseFeatureStride; d += 4)
+      {
+        float4 difference = float4::load(point + d) - float4::load(feature + d);
+        sum += difference * difference;
+      }
+      float lanes[4];
+      sum.store(lanes);
+      float distance = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+      if (distance >= worst())
+        continue;
+
+      if ((int)index.pointClip[p] == excludeClip)
+      {
+        unsigned int frame = index.pointFrame[p];
+        unsigned int gap = frame > excludeFrame ? frame - excludeFrame : excludeFrame - frame;
+        if (gap <= excludeRadius)
+          continue;
+      }
+
+      PoseMatch match = { index.pointClip[p], index.pointFrame[p], distance };
+      auto position = std::upper_bound(matches.begin(), matches.end(), match,
+                                       [](const PoseMatch& a, const PoseMatch& b) { return a.distance < b.distance; });
+      matches.insert(position, match);
+      if (matches.size() > k)
+        matches.pop_back();
+    }
+  }
+
+  // cellDistance is the squared distance of the query to the cell of the node
+  void visit(unsigned int node, float cellDistance)
+  {
+    unsigned int numInner = index.numLeaves - 1;
+    if (node >= numInner)
+    {
+      scanLeaf(node - numInner);
+      return;
+    }
+
+    unsigned int axis = index.splitAxis[node];
+    float difference = feature[axis] - index.splitValue[node];
+    unsigned int nearChild = difference < 0.0f ? node * 2 + 1 : node * 2 + 2;
+    unsigned int farChild = difference < 0.0f ? node * 2 + 2 : node * 2 + 1;
+    visit(nearChild, cellDistance);
+
+    float previous = offsets[axis];
+    float farDistance = cellDistance - previous * previous + difference * difference;
+    if (farDistance < worst())
+    {
+      offsets[axis] = difference;
+      visit(farChild, farDistance);
+      offsets[axis] = previous;
+    }
+  }
+};
+
+void searchPoseIndex(const PoseIndex& index, const float* feature, unsigned int k, std::vector<PoseMatch>& matches,
+                     int excludeClip, unsigned int excludeFrame, unsigned int excludeRadius)
+{
+  matches.clear();
+  if (index.numPoints == 0 || k == 0)
+    return;
+
+  PoseSearch search = { index, feature, k, matches, excludeClip, excludeFrame, excludeRadius, {} };
+  search.visit(0, 0.0f);
+}
+
+template <typename T>
+static void writeVector(std::ofstream& file, const std::vector<T>& values)
+{
+  unsigned long long size = values.size();
+  file.write((const char*)&size, sizeof(size));
+  if (size > 0)
+    file.write((const char*)values.data(), sizeof(T) * size);
+}
+
+template <typename T>
+static bool readVector(std::ifstream& file, std::vector<T>& values)
+{
+  unsigned long long size = 0;
+  if (!file.read((char*)&size, sizeof(size)) || size > (1ull << 40) / sizeof(T))
+    return false;
+  values.resize((size_t)size);
+  return size == 0 || (bool)file.read((char*)values.data(), sizeof(T) * size);
+}
+
+bool savePoseIndex(const PoseIndex& index, const std::string& filename)
+{
+  std::ofstream file(filename, std::ios::binary);
+  if (!file)
+  {
+    std::cout << "Failed to write " << filename << std::endl;
+    return false;
+  }
+
+  unsigned int header[5] = { PoseIndexMagic, PoseIndexVersion, PoseFeatureStride, index.numPoints, index.numLeaves };
+  file.write((const char*)header, sizeof(header));
+  file.write((const char*)&index.settings, sizeof(index.settings));
+  file.write((const char*)index.mean, sizeof(index.mean));
+  file.write((const char*)index.scale, sizeof(index.scale));
+
+  unsigned int numClips = (unsigned int)index.clips.size();
+  file.write((const char*)&numClips, sizeof(numClips));
+  for (const std::string& clip : index.clips)
+  {
+    unsigned int length = (unsigned int)clip.size();
+    file.write((const char*)&length, sizeof(length));
+    file.write(clip.data(), length);
+  }
+
+  writeVector(file, index.clipFrames);
+  writeVector(file, index.splitAxis);
+  writeVector(file, index.splitValue);
+  writeVector(file, index.leafBegin);
+  writeVector(file, index.features);
+  writeVector(file, index.pointClip);
+  writeVector(file, index.pointFrame);
+  return (bool)file;
+}
+
+bool loadPoseIndex(const std::string& filename, PoseIndex& index)
+{
+  std::ifstream file(filename, std::ios::binary);
+  unsigned int header[5] = {};
+  if (!file || !file.read((char*)header, sizeof(header)) || header[0] != PoseIndexMagic ||
+      header[1] != PoseIndexVersion || header[2] != PoseFeatureStride)
+  {
+    std::cout << "Failed to load pose index " << filename << std::endl;
+    return false;
+  }
+
+  index.numPoints = header[3];
+  index.numLeaves = header[4];
+  file.read((char*)&index.settings, sizeof(index.settings));
+  file.read((char*)index.mean, sizeof(index.mean));
+  file.read((char*)index.scale, sizeof(index.scale));
+
+  unsigned int numClips = 0;
+  file.read((char*)&numClips, sizeof(numClips));
+  index.clips.clear();
+  for (unsigned int i = 0; i < numClips && file; i++)
+  {
+    unsigned int length = 0;
+    file.read((char*)&length, sizeof(length));
+    std::string clip(length, '\0');
+    if (length > 0)
+      file.read(&clip[0], length);
+    index.clips.push_back(clip);
+  }
+
+  bool valid = file && readVector(file, index.clipFrames) && readVector(file, index.splitAxis) &&
+               readVector(file, index.splitValue) && readVector(file, index.leafBegin) &&
+               readVector(file, index.features) && readVector(file, index.pointClip) && readVector(file, index.pointFrame);
+  valid = valid && index.numLeaves > 0 && index.splitAxis.size() == index.numLeaves - 1 &&
+          index.leafBegin.size() == index.numLeaves + 1 && index.features.size() == (size_t)index.numPoints * PoseFeatureStride &&
+          index.pointClip.size() == index.numPoints && index.pointFrame.size() == index.numPoints &&
+          index.splitValue.size() == index.numLeaves - 1 && index.clipFrames.size() == index.clips.size();
+
+  // the search indexes with these without checking
+  for (size_t i = 0; valid && i < index.splitAxis.size(); i++)
+    valid = index.splitAxis[i] < PoseFeatureSize;
+  for (size_t i = 0; valid && i < index.numLeaves; i++)
+    valid = index.leafBegin[i] <= index.leafBegin[i + 1] && index.leafBegin[i + 1] <= index.numPoints;
+  for (size_t i = 0; valid && i < index.numPoints; i++)
+    valid = index.pointClip[i] < index.clips.size();
+  if (!valid)
+  {
+    std::cout << "Corrupt pose index " << filename << std::endl;
+    index = PoseIndex();
+    return false;
+  }
+  return true;
+}
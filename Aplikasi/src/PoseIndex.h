@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BodyModel.h"
+
+struct ClipEntry;
+
+// hips plus the end effectors, positions are taken for all but the hips, velocities for all
+#define NumPoseJoints 6
+#define PoseFeatureSize ((NumPoseJoints - 1) * 3 + NumPoseJoints * 3)
+// padded to whole float4 lanes
+#define PoseFeatureStride ((PoseFeatureSize + 3) & ~3)
+#define PoseLeafSize 16
+
+extern const unsigned int poseJoints[NumPoseJoints];
+
+struct PoseFeatureSettings
+{
+  float positionWeight = 1.0f;
+  float velocityWeight = 1.0f;
+};
+
+struct PoseMatch
+{
+  unsigned int clip;
+  unsigned int frame;
+  float distance; // normalized feature space
+};
+
+// exact KD tree over normalized pose features of every frame of a library. the tree is
+// implicit and balanced: node n has children 2n+1 and 2n+2 and each leaf owns a contiguous
+// run of at most PoseLeafSize points, stored in leaf order
+struct PoseIndex
+{
+  PoseFeatureSettings settings;
+  std::vector<std::string> clips;
+  std::vector<unsigned int> clipFrames;
+
+  float mean[PoseFeatureStride];
+  float scale[PoseFeatureStride]; // weight / standard deviation
+
+  unsigned int numPoints = 0;
+  unsigned int numLeaves = 0;
+  std::vector<unsigned char> splitAxis; // inner node
+  std::vector<float> splitValue;
+  std::vector<unsigned int> leafBegin;  // leaf, numLeaves + 1 entries
+  std::vector<float> features;          // point * PoseFeatureStride
+  std::vector<unsigned int> pointClip;
+  std::vector<unsigned int> pointFrame;
+};
+
+// raw features of one frame in the heading frame of the hips, cm and cm / s,
+// velocities are central differences. needs joints and rotations baked
+void extractPoseFeature(const ClipTrajectory& trajectory, unsigned int frame, float* feature);
+
+// normalizes a raw feature in place with the statistics of the index
+void normalizePoseFeature(const PoseIndex& index, float* feature);
+
+// features of every baked trajectory, statistics and tree, parallel over clips and tree levels
+void buildPoseIndex(const std::vector<const ClipTrajectory*>& trajectories, const std::vector<std::string>& names,
+                    const PoseFeatureSettings& settings, PoseIndex& index);
+
+// loads and bakes the clips of a manifest in parallel, returns the number of clips that failed
+unsigned int buildPoseIndex(const std::vector<ClipEntry>& clips, const PoseFeatureSettings& settings, PoseIndex& index);
+
+// k nearest frames to a normalized feature. frames of excludeClip within excludeRadius of
+// excludeFrame are skipped so a clip doesn't only find its own neighborhood
+void searchPoseIndex(const PoseIndex& index, const float* feature, unsigned int k, std::vector<PoseMatch>& matches,
+                     int excludeClip = -1, unsigned int excludeFrame = 0, unsigned int excludeRadius = 0);
+
+bool savePoseIndex(const PoseIndex& index, const std::string& filename);
+bool loadPoseIndex(const std::string& filename, PoseIndex& index);
@@ -0,0 +1,306 @@
+#include "PoseShare.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// a reader gives up on a slot the writer keeps rewriting after this many tries
+#define ReadAttempts 64
+
+long long poseShareTime()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// "Local\name" on windows, "/name" for shm_open
+static std::string sharedName(const std::string& name)
+{
+  std::string bare = name;
+  while (!bare.empty() && (bare[0] == '/' || bare[0] == '\\'))
+    bare.erase(0, 1);
+#ifdef _WIN32
+  return "Local\\" + bare;
+#else
+  return "/" + bare;
+#endif
+}
+
+#ifndef _WIN32
+// a ring under the name that no publisher writes anymore, closed or its process gone. a live
+// publisher's ring isn't taken over, the same as a second CreateFileMapping on windows
+static bool staleShared(const std::string& name)
+{
+  int file = shm_open(name.c_str(), O_RDONLY, 0);
+  if (file < 0)
+    return errno == ENOENT;
+  struct stat status;
+  bool stale = false;
+  if (fstat(file, &status) == 0 && (size_t)status.st_size >= sizeof(PoseShareHeader))
+  {
+    void* memory = mmap(nullptr, sizeof(PoseShareHeader), PROT_READ, MAP_SHARED, file, 0);
+    if (memory != MAP_FAILED)
+    {
+      const PoseShareHeader* header = (const PoseShareHeader*)memory;
+      pid_t publisher = (pid_t)header->publisher;
+      stale = header->magic == PoseShareMagic &&
+              (header->open.load(std::memory_order_acquire) == 0 ||
+               (publisher > 0 && kill(publisher, 0) != 0 && errno == ESRCH));
+      munmap(memory, sizeof(PoseShareHeader));
+    }
+  }
+  close(file);
+  return stale;
+}
+#endif
+
+// the whole ring mapped, writable for the publisher
+static PoseShareHeader* mapShared(const std::string& name, bool create, void*& mapping)
+{
+  size_t size = sizeof(PoseShareHeader);
+  mapping = nullptr;
+#ifdef _WIN32
+  HANDLE handle;
+  if (create)
+  {
+    handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size, name.c_str());
+    // mappings go away with the last process holding them, so this one is still published
+    if (handle != nullptr && GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+      CloseHandle(handle);
+      return nullptr;
+    }
+  }
+  else
+    handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+  if (handle == nullptr)
+    return nullptr;
+
+  void* memory = MapViewOfFile(handle, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+  if (memory == nullptr)
+  {
+    CloseHandle(handle);
+    return nullptr;
+  }
+  mapping = handle;
+#else
+  int file;
+  if (create)
+  {
+    file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    // a name left behind by a publisher that crashed is replaced, readers still on it keep the old ring
+    if (file < 0 && errno == EEXIST && staleShared(name))
+    {
+      shm_unlink(name.c_str());
+      file = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (file >= 0 && ftruncate(file, (off_t)size) != 0)
+    {
+      close(file);
+      shm_unlink(name.c_str());
+      return nullptr;
+    }
+  }
+  else
+  {
+    file = shm_open(name.c_str(), O_RDONLY, 0);
+    struct stat status;
+    if (file >= 0 && (fstat(file, &status) != 0 || (size_t)status.st_size < size))
+    {
+      close(file);
+      return nullptr;
+    }
+  }
+  if (file < 0)
+    return nullptr;
+
+  void* memory = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (memory == MAP_FAILED)
+  {
+    if (create)
+      shm_unlink(name.c_str());
+    return nullptr;
+  }
+#endif
+  return (PoseShareHeader*)memory;
+}
+
+static void unmapShared(PoseShare& share)
+{
+#ifdef _WIN32
+  UnmapViewOfFile(share.header);
+  CloseHandle((HANDLE)share.mapping);
+#else
+  munmap(share.header, sizeof(PoseShareHeader));
+#endif
+}
+
+bool createPoseShare(const std::string& name, PoseShare& share)
+{
+  closePoseShare(share);
+  share.name = sharedName(name);
+  PoseShareHeader* header = mapShared(share.name, true, share.mapping);
+  if (header == nullptr)
+  {
+    std::cout << "Failed to create shared memory " << share.name << std::endl;
+    return false;
+  }
+
+  // new memory is zero, the atomics start at 0
+  header = new (header) PoseShareHeader();
+  header->magic = PoseShareMagic;
+  header->version = PoseShareVersion;
+  header->numSlots = PoseShareSlots;
+  header->slotBytes = sizeof(PoseSlot);
+  header->maxJoints = PoseShareMaxJoints;
+  header->numSegments = NumSegments;
+#ifdef _WIN32
+  header->publisher = GetCurrentProcessId();
+#else
+  header->publisher = (unsigned int)getpid();
+#endif
+  header->open.store(1, std::memory_order_release);
+
+  share.header = header;
+  share.publisher = true;
+  return true;
+}
+
+bool openPoseShare(const std::string& name, PoseShare& share)
+{
+  closePoseShare(share);
+  share.name = sharedName(name);
+  PoseShareHeader* header = mapShared(share.name, false, share.mapping);
+  if (header == nullptr)
+  {
+    std::cout << "No poses published as " << share.name << std::endl;
+    return false;
+  }
+
+  share.header = header;
+  if (!poseShareOpen(share) || header->magic != PoseShareMagic || header->version != PoseShareVersion ||
+      header->numSlots != PoseShareSlots || header->slotBytes != sizeof(PoseSlot) ||
+      header->maxJoints != PoseShareMaxJoints || header->numSegments != NumSegments)
+  {
+    std::cout << "Shared memory " << share.name << " isn't a pose ring of this version" << std::endl;
+    closePoseShare(share);
+    return false;
+  }
+  return true;
+}
+
+void closePoseShare(PoseShare& share)
+{
+  if (share.header == nullptr)
+    return;
+
+  if (share.publisher)
+  {
+    share.header->open.store(0, std::memory_order_release);
+#ifndef _WIN32
+    shm_unlink(share.name.c_str());
+#endif
+  }
+  unmapShared(share);
+  share = PoseShare();
+}
+
+void publishPose(PoseShare& share, const glm::vec4* joints, unsigned int numJoints, const glm::vec4* segmentsCOM,
+                 const glm::vec4& bodyCOM, unsigned int frame)
+{
+  PoseShareHeader* header = share.header;
+  if (header == nullptr || !share.publisher)
+    return;
+
+  // only this process writes, the counter and the sequences need no read-modify-write
+  unsigned long long index = header->published.load(std::memory_order_relaxed);
+  PoseSlot& slot = header->slots[index % PoseShareSlots];
+  unsigned int sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.numJoints = numJoints < PoseShareMaxJoints ? numJoints : PoseShareMaxJoints;
+  slot.frame = frame;
+  slot.index = index;
+  slot.time = poseShareTime();
+  memcpy(slot.joints, joints, slot.numJoints * sizeof(glm::vec4));
+  memcpy(slot.segmentsCOM, segmentsCOM, NumSegments * sizeof(glm::vec4));
+  memcpy(slot.bodyCOM, &bodyCOM, sizeof(glm::vec4));
+
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  header->published.store(index + 1, std::memory_order_release);
+}
+
+bool readPose(const PoseShare& share, unsigned long long index, PoseSample& sample)
+{
+  if (index >= publishedPoses(share))
+    return false;
+
+  const PoseSlot& slot = share.header->slots[index % PoseShareSlots];
+  for (int attempt = 0; attempt < ReadAttempts; attempt++)
+  {
+    unsigned int sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    sample.index = slot.index;
+    sample.time = slot.time;
+    sample.frame = slot.frame;
+    sample.numJoints = slot.numJoints < PoseShareMaxJoints ? slot.numJoints : PoseShareMaxJoints;
+    memcpy(sample.joints, slot.joints, sample.numJoints * sizeof(glm::vec4));
+    memcpy(sample.segmentsCOM, slot.segmentsCOM, NumSegments * sizeof(glm::vec4));
+    memcpy(&sample.bodyCOM, slot.bodyCOM, sizeof(glm::vec4));
+
+    // the copy holds if the writer didn't touch the slot meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+      return sample.index == index;
+  }
+  return false;
+}
+
+bool readLatestPose(const PoseShare& share, PoseSample& sample)
+{
+  // a slow reader can be lapped while it copies the newest pose, it tries the newest again then
+  for (int attempt = 0; attempt < ReadAttempts; attempt++)
+  {
+    unsigned long long published = publishedPoses(share);
+    if (published == 0)
+      return false;
+    if (readPose(share, published - 1, sample))
+      return true;
+  }
+  return false;
+}
+
+unsigned long long waitForPoses(const PoseShare& share, unsigned long long published, long long timeoutMicroseconds)
+{
+  long long deadline = poseShareTime() + timeoutMicroseconds;
+  while (true)
+  {
+    unsigned long long now = publishedPoses(share);
+    if (now > published)
+      return now;
+    if (!poseShareOpen(share) || poseShareTime() >= deadline)
+      return published;
+    std::this_thread::yield();
+  }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "BodyModel.h"
+
+// poses published to other processes on the machine through a named shared memory ring. the
+// writer never waits for readers, each slot has a sequence lock and a reader copies a pose out
+// and checks the sequence didn't move meanwhile, so a pose it returns is never torn
+#define PoseShareMagic 0x45534F50 // "POSE"
+#define PoseShareVersion 1
+#define PoseShareSlots 64
+#define PoseShareMaxJoints 64     // joints past this aren't published
+#define PoseShareDefaultName "aplikasi_pose"
+
+// the shared layout, plain floats so both sides agree whatever they were compiled with
+struct PoseSlot
+{
+  std::atomic<unsigned int> sequence; // odd while the slot is written
+  unsigned int numJoints;
+  unsigned int frame;                 // clip frame the pose came from
+  unsigned int reserved;
+  unsigned long long index;           // count of poses published before this one
+  long long time;                     // steady clock microseconds when it was published
+  float joints[PoseShareMaxJoints][4];
+  float segmentsCOM[NumSegments][4];
+  float bodyCOM[4];
+};
+
+struct PoseShareHeader
+{
+  unsigned int magic;
+  unsigned int version;
+  unsigned int numSlots;
+  unsigned int slotBytes;
+  unsigned int maxJoints;
+  unsigned int numSegments;
+  std::atomic<unsigned int> open;               // 0 once the publisher closed it
+  unsigned int publisher;                       // process id of the publisher
+  std::atomic<unsigned long long> published;    // poses published so far
+  PoseSlot slots[PoseShareSlots];
+};
+
+// a pose copied out of the ring
+struct PoseSample
+{
+  unsigned long long index = 0;
+  long long time = 0;
+  unsigned int frame = 0;
+  unsigned int numJoints = 0;
+  glm::vec4 joints[PoseShareMaxJoints];
+  glm::vec4 segmentsCOM[NumSegments];
+  glm::vec4 bodyCOM;
+};
+
+struct PoseShare
+{
+  PoseShareHeader* header = nullptr;
+  std::string name;
+  void* mapping = nullptr; // HANDLE on windows, unused elsewhere
+  bool publisher = false;
+};
+
+// steady clock microseconds, the clock the poses are stamped with
+long long poseShareTime();
+
+// creates the ring, a ring of the same name left by a publisher that crashed is replaced. false
+// while another publisher has the name
+bool createPoseShare(const std::string& name, PoseShare& share);
+// attaches to the ring of a running publisher
+bool openPoseShare(const std::string& name, PoseShare& share);
+// the publisher marks the ring closed and removes the name, readers keep their mapping
+void closePoseShare(PoseShare& share);
+
+void publishPose(PoseShare& share, const glm::vec4* joints, unsigned int numJoints, const glm::vec4* segmentsCOM,
+                 const glm::vec4& bodyCOM, unsigned int frame);
+
+// poses published so far, the newest is this - 1
+inline unsigned long long publishedPoses(const PoseShare& share)
+{
+  return share.header->published.load(std::memory_order_acquire);
+}
+
+// false when the publisher closed the ring, a new one may be created under the same name
+inline bool poseShareOpen(const PoseShare& share)
+{
+  return share.header->open.load(std::memory_order_acquire) != 0;
+}
+
+// pose index, false when it isn't published yet or the ring already wrote over it
+bool readPose(const PoseShare& share, unsigned long long index, PoseSample& sample);
+
+// the newest pose, false while there's none
+bool readLatestPose(const PoseShare& share, PoseSample& sample);
+
+// spins until more than published poses are out, the new count. published when the timeout
+// passed or the ring was closed
+unsigned long long waitForPoses(const PoseShare& share, unsigned long long published, long long timeoutMicroseconds);
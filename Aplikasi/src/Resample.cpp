@@ -0,0 +1,289 @@
+#include "Resample.h"
+
+#include "bvh2.h"
+#include "JointAngles.h"
+#include "MotionEdit.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+// polyphase table, row p holds the weights of the taps for the fractional position p / numPhases
+struct ResampleKernel
+{
+  int width = 0;
+  int numPhases = 0;
+  std::vector<float> table;
+
+  // first tap relative to the sample before the position
+  int firstOffset() const { return 1 - width / 2; }
+
+  const float* weights(double position, int& base) const
+  {
+    base = (int)std::floor(position);
+    int phase = (int)std::floor((position - base) * numPhases + 0.5);
+    if (phase >= numPhases)
+    {
+      base++;
+      phase = 0;
+    }
+    return &table[(size_t)phase * width];
+  }
+};
+
+static void buildKernel(const ResampleSettings& settings, float scale, ResampleKernel& kernel)
+{
+  const float pi = 3.14159265f;
+  kernel.numPhases = std::max(1, settings.numPhases);
+
+  float halfWidth = 0.0f;
+  if (settings.kernel == SincResampling)
+  {
+    halfWidth = std::max(1, settings.sincTaps) / scale;
+    kernel.width = 2 * (int)std::ceil(halfWidth);
+  }
+  else
+  {
+    kernel.width = 4;
+  }
+
+  kernel.table.resize((size_t)kernel.numPhases * kernel.width);
+  for (int phase = 0; phase < kernel.numPhases; phase++)
+  {
+    float t = (float)phase / kernel.numPhases;
+    float* row = &kernel.table[(size_t)phase * kernel.width];
+
+    if (settings.kernel == SincResampling)
+    {
+      // low pass at the lower of the two rates, Hann windowed
+      for (int i = 0; i < kernel.width; i++)
+      {
+        float x = (kernel.firstOffset() + i) - t;
+        float sinc = std::fabs(x) < 1e-6f ? 1.0f : std::sin(pi * scale * x) / (pi * scale * x);
+        float window = std::fabs(x) < halfWidth ? 0.5f + 0.5f * std::cos(pi * x / halfWidth) : 0.0f;
+        row[i] = sinc * window;
+      }
+    }
+    else
+    {
+      // Catmull-Rom
+      float t2 = t * t, t3 = t2 * t;
+      row[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+      row[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+      row[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+      row[3] = 0.5f * (t3 - t2);
+    }
+
+    // unit DC gain on every phase
+    float sum = 0.0f;
+    for (int i = 0; i < kernel.width; i++)
+      sum += row[i];
+    for (int i = 0; i < kernel.width; i++)
+      row[i] /= sum;
+  }
+}
+
+static unsigned int resampledFrames(unsigned int numFrames, float frameTime, float targetFrameTime)
+{
+  return (unsigned int)std::floor((numFrames - 1) * (double)frameTime / targetFrameTime + 1e-3) + 1;
+}
+
+static void unwrapChannel(float* data, unsigned int numFrames, unsigned int numChannels, unsigned int channel)
+{
+  for (unsigned int frame = 1; frame < numFrames; frame++)
+  {
+    float& value = data[(size_t)frame * numChannels + channel];
+    float previous = data[(size_t)(frame - 1) * numChannels + channel];
+    value -= 360.0f * std::floor((value - previous + 180.0f) / 360.0f);
+  }
+}
+
+void resampleChannels(const float* data, unsigned int numFrames, unsigned int numChannels,
+                      const unsigned char* angleChannels, float frameTime, const ResampleSettings& settings,
+                      std::vector<float>& out, unsigned int& outFrames)
+{
+  outFrames = 0;
+  out.clear();
+  if (data == nullptr || numFrames < 2 || frameTime <= 0.0f || settings.frameTime <= 0.0f)
+    return;
+
+  // angles unwrapped on a copy so the kernel never averages across a wrap
+  std::vector<float> unwrapped;
+  if (angleChannels != nullptr)
+  {
+    unwrapped.assign(data, data + (size_t)numFrames * numChannels);
+    for (unsigned int c = 0; c < numChannels; c++)
+    {
+      if (angleChannels[c])
+        unwrapChannel(&unwrapped[0], numFrames, numChannels, c);
+    }
+    data = &unwrapped[0];
+  }
+
+  ResampleKernel kernel;
+  buildKernel(settings, std::min(1.0f, frameTime / settings.frameTime), kernel);
+
+  outFrames = resampledFrames(numFrames, frameTime, settings.frameTime);
+  out.assign((size_t)outFrames * numChannels, 0.0f);
+  double step = (double)settings.frameTime / frameTime;
+  float* result = &out[0];
+
+  // output frames in parallel chunks, the channel loops are contiguous
+  parallelFor(0, outFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      int base;
+      const float* weights = kernel.weights(frame * step, base);
+      float* row = result + (size_t)frame * numChannels;
+      for (int i = 0; i < kernel.width; i++)
+      {
+        int source = std::min(std::max(base + kernel.firstOffset() + i, 0), (int)numFrames - 1);
+        const float* input = data + (size_t)source * numChannels;
+        float w = weights[i];
+        for (unsigned int c = 0; c < numChannels; c++)
+          row[c] += w * input[c];
+      }
+    }
+  }, 64);
+}
+
+// the rotation channels of a joint, resampled as one rotation
+struct RotationTriple
+{
+  unsigned int channels[3];
+  int axes[3];
+  int sequence;
+};
+
+static glm::quat channelRotation(const float* frameData, const RotationTriple& triple)
+{
+  static const glm::vec3 axisVectors[3] = { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) };
+  glm::quat q(1.0f, 0.0f, 0.0f, 0.0f);
+  for (int k = 0; k < 3; k++)
+    q = q * glm::angleAxis(glm::radians(frameData[triple.channels[k]]), axisVectors[triple.axes[k]]);
+  return q;
+}
+
+bool resampleMotion(Bvh2& bvh, const ResampleSettings& settings)
+{
+  if (bvh.getMotion().numFrames < 2 || settings.frameTime <= 0.0f)
+    return false;
+
+  // the filters run again on the new rate
+  bvh.restoreRawMotion();
+  const Motion& motion = bvh.getMotion();
+  unsigned int numFrames = motion.numFrames;
+  unsigned int numChannels = motion.numMotionChannels;
+  float frameTime = motion.frameTime > 0.0f ? motion.frameTime : 1.0f / 100.0f;
+
+  // edited motions may be spread over several blocks, the kernel reads them as one run
+  const float* frames = motion.data;
+  std::vector<float> gathered;
+  if (frames == nullptr)
+  {
+    gathered.resize((size_t)numFrames * numChannels);
+    copyMotionFrames(motion, 0, numFrames, gathered.data());
+    frames = gathered.data();
+  }
+
+  // joints with three rotation channels go through quaternions, the rest through the kernel
+  std::vector<unsigned char> rotations;
+  bvh.getRotationChannels(rotations);
+  std::vector<RotationTriple> triples;
+  for (const Joint* joint : bvh.getJoints())
+  {
+    RotationTriple triple;
+    int count = 0;
+    for (unsigned int i = 0; i < joint->numChannels && count <= 3; i++)
+    {
+      short channel = joint->channelsOrder[i];
+      int axis = (channel & Xrotation) ? 0 : (channel & Yrotation) ? 1 : (channel & Zrotation) ? 2 : -1;
+      if (axis < 0)
+        continue;
+      if (count < 3)
+      {
+        triple.channels[count] = joint->channelStart + i;
+        triple.axes[count] = axis;
+      }
+      count++;
+    }
+    if (count != 3)
+      continue;
+    triple.sequence = cardanSequence(triple.axes[0], triple.axes[1], triple.axes[2]);
+    if (triple.sequence >= 0)
+      triples.push_back(triple);
+  }
+
+  std::vector<float> out;
+  unsigned int outFrames;
+  resampleChannels(frames, numFrames, numChannels, rotations.data(), frameTime, settings, out, outFrames);
+  if (outFrames == 0)
+    return false;
+
+  // quaternions of every frame, kept in one hemisphere along the clip
+  size_t numTriples = triples.size();
+  std::vector<glm::quat> quats((size_t)numFrames * numTriples);
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+      for (size_t t = 0; t < numTriples; t++)
+        quats[frame * numTriples + t] = channelRotation(frames + (size_t)frame * numChannels, triples[t]);
+  });
+  for (unsigned int frame = 1; frame < numFrames; frame++)
+  {
+    for (size_t t = 0; t < numTriples; t++)
+    {
+      glm::quat& q = quats[frame * numTriples + t];
+      if (glm::dot(q, quats[(frame - 1) * numTriples + t]) < 0.0f)
+        q = -q;
+    }
+  }
+
+  ResampleKernel kernel;
+  buildKernel(settings, std::min(1.0f, frameTime / settings.frameTime), kernel);
+  double step = (double)settings.frameTime / frameTime;
+
+  parallelFor(0, outFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      double position = frame * step;
+      int base;
+      const float* weights = kernel.weights(position, base);
+      float* row = &out[(size_t)frame * numChannels];
+
+      for (size_t t = 0; t < numTriples; t++)
+      {
+        glm::quat q;
+        if (settings.kernel == SincResampling)
+        {
+          q = glm::quat(0.0f, 0.0f, 0.0f, 0.0f);
+          for (int i = 0; i < kernel.width; i++)
+          {
+            int source = std::min(std::max(base + kernel.firstOffset() + i, 0), (int)numFrames - 1);
+            q += weights[i] * quats[source * numTriples + t];
+          }
+        }
+        else
+        {
+          int a = std::min(std::max((int)std::floor(position), 0), (int)numFrames - 1);
+          int b = std::min(a + 1, (int)numFrames - 1);
+          q = glm::slerp(quats[a * numTriples + t], quats[b * numTriples + t], (float)(position - a));
+        }
+
+        glm::vec3 angles = cardanAngles(glm::normalize(q), triples[t].sequence);
+        for (int k = 0; k < 3; k++)
+          row[triples[t].channels[k]] = angles[k];
+      }
+    }
+  }, 64);
+
+  // back to continuous curves, the decomposition lands in -180 to 180
+  for (size_t t = 0; t < numTriples; t++)
+    for (int k = 0; k < 3; k++)
+      unwrapChannel(&out[0], outFrames, numChannels, triples[t].channels[k]);
+
+  bvh.replaceMotion(out, outFrames, settings.frameTime);
+  return true;
+}
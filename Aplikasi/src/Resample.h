@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+class Bvh2;
+
+#define CubicResampling 0
+#define SincResampling 1
+
+struct ResampleSettings
+{
+  float frameTime = 1.0f / 60.0f; // target, seconds
+  int kernel = SincResampling;
+  int sincTaps = 4;               // zero crossings per side of the windowed sinc, at the lower rate
+  int numPhases = 256;            // fractional positions tabulated for the polyphase kernel
+};
+
+// kernel resampling of frame major channels, out gets numFrames * numChannels samples at the new rate.
+// angleChannels are unwrapped before and stay unwrapped
+void resampleChannels(const float* data, unsigned int numFrames, unsigned int numChannels,
+                      const unsigned char* angleChannels, float frameTime, const ResampleSettings& settings,
+                      std::vector<float>& out, unsigned int& outFrames);
+
+// converts the clip to settings.frameTime. Joints with three rotation channels are resampled as
+// quaternions, slerp for cubic and a normalized kernel weighted blend for sinc, and go back to
+// Euler angles in their channel order. Starts from the raw data when the clip was filtered
+bool resampleMotion(Bvh2& bvh, const ResampleSettings& settings);
@@ -0,0 +1,255 @@
+#include "SegmentGeometry.h"
+
+#include "bvh2.h"
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <cmath>
+
+const SegmentShape segmentShapes[NumSegments] = {
+  { EllipsoidShape, 1.0f, 0.22f, 0.27f },      // head neck
+  { EllipsoidShape, 1.75f, 0.32f, 0.19f },     // trunk
+  { TruncatedConeShape, 0.73f, 0.16f, 0.12f }, // left upper arm, without the clavicle
+  { TruncatedConeShape, 0.73f, 0.16f, 0.12f }, // right upper arm
+  { TruncatedConeShape, 1.0f, 0.2f, 0.14f },   // left fore arm
+  { TruncatedConeShape, 1.0f, 0.2f, 0.14f },   // right fore arm
+  { EllipsoidShape, 1.0f, 0.3f, 0.12f },       // left hand
+  { EllipsoidShape, 1.0f, 0.3f, 0.12f },       // right hand
+  { TruncatedConeShape, 1.0f, 0.2f, 0.12f },   // left thigh
+  { TruncatedConeShape, 1.0f, 0.2f, 0.12f },   // right thigh
+  { TruncatedConeShape, 1.0f, 0.13f, 0.08f },  // left shank
+  { TruncatedConeShape, 1.0f, 0.13f, 0.08f },  // right shank
+  { TruncatedConeShape, 1.0f, 0.2f, 0.12f },   // left foot
+  { TruncatedConeShape, 1.0f, 0.2f, 0.12f }    // right foot
+};
+
+// principal moments per unit mass, long axis first
+static glm::vec3 principalInertia(const SegmentShape& shape, float length)
+{
+  if (shape.shape == EllipsoidShape)
+  {
+    float a = 0.5f * length;
+    float b = shape.widthRatio * length;
+    float c = shape.depthRatio * length;
+    return glm::vec3(b * b + c * c, a * a + c * c, a * a + b * b) / 5.0f;
+  }
+
+  // truncated cone integrated as stacked disks, the transverse moment moved to its COM
+  const int numSlices = 64;
+  double r0 = shape.widthRatio * length;
+  double r1 = shape.depthRatio * length;
+  double dz = length / numSlices;
+  double mass = 0.0, firstMoment = 0.0, axial = 0.0, transverse = 0.0;
+  for (int i = 0; i < numSlices; i++)
+  {
+    double z = (i + 0.5) * dz;
+    double r = r0 + (r1 - r0) * z / length;
+    double dm = r * r * dz;
+    mass += dm;
+    firstMoment += dm * z;
+    axial += dm * r * r / 2.0;
+    transverse += dm * (r * r / 4.0 + z * z);
+  }
+  double center = firstMoment / mass;
+  transverse = transverse / mass - center * center;
+  axial /= mass;
+  return glm::vec3((float)axial, (float)transverse, (float)transverse);
+}
+
+void buildSegmentGeometry(const Bvh2& bvh, float lengthUnit, SegmentGeometry& geometry)
+{
+  const std::vector<const Joint*>& joints = bvh.getJoints();
+  const std::vector<int>& parents = bvh.getJointParents();
+
+  for (int s = 0; s < NumSegments; s++)
+  {
+    int proximal = segmentJoints[s].proximal;
+    int distal = segmentJoints[s].distal;
+    geometry.frameJoint[s] = distal < (int)parents.size() ? parents[distal] : -1;
+    geometry.length[s] = 0.0f;
+    geometry.inertia[s] = glm::mat3(0.0f);
+    if (distal >= (int)joints.size() || geometry.frameJoint[s] < 0)
+      continue;
+
+    // rest pose direction, every joint frame is aligned with the world there
+    glm::vec3 direction(0.0f);
+    for (int j = distal; j >= 0 && j != proximal; j = parents[j])
+      direction += glm::vec3(joints[j]->offset.x, joints[j]->offset.y, joints[j]->offset.z);
+
+    float length = glm::length(direction) * lengthUnit * segmentShapes[s].lengthScale;
+    geometry.length[s] = length;
+    if (length <= 0.0f)
+      continue;
+
+    // long axis along the bone, width along X unless the bone is, depth completes the frame
+    glm::vec3 longAxis = glm::normalize(direction);
+    glm::vec3 reference = std::fabs(longAxis.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 widthAxis = glm::normalize(reference - longAxis * glm::dot(reference, longAxis));
+    glm::vec3 depthAxis = glm::cross(longAxis, widthAxis);
+
+    glm::vec3 moments = principalInertia(segmentShapes[s], length);
+    geometry.inertia[s] = moments.x * glm::outerProduct(longAxis, longAxis) +
+                          moments.y * glm::outerProduct(widthAxis, widthAxis) +
+                          moments.z * glm::outerProduct(depthAxis, depthAxis);
+  }
+}
+
+void computeAngularMomentum(const ClipTrajectory& trajectory, const BodyParameters& parameters,
+                            const SegmentGeometry& geometry, float lengthUnit, AngularMomentumResult& result)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+  result.angularMomentum.assign(numFrames, glm::vec3(0.0f));
+  result.spinMomentum.assign(numFrames, glm::vec3(0.0f));
+  result.inertia.assign(numFrames, glm::mat3(0.0f));
+  if (numFrames < 2 || trajectory.rotations.size() != (size_t)numFrames * numJoints ||
+      trajectory.segmentsCOM.size() != (size_t)numFrames * NumSegments)
+    return;
+
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+  float mass[NumSegments];
+  for (int s = 0; s < NumSegments; s++)
+    mass[s] = parameters.massPercent[s] / 100.0f * parameters.totalBodyWeight;
+
+  unsigned int numBlocks = (numFrames + 3) / 4;
+  parallelFor(0, numBlocks, [&](unsigned int beginBlock, unsigned int endBlock)
+  {
+    for (unsigned int block = beginBlock; block < endBlock; block++)
+    {
+      unsigned int frames[4], previous[4], next[4];
+      float spans[4];
+      for (int lane = 0; lane < 4; lane++)
+      {
+        unsigned int frame = block * 4 + lane;
+        frames[lane] = frame < numFrames ? frame : numFrames - 1;
+        previous[lane] = frames[lane] > 0 ? frames[lane] - 1 : 0;
+        next[lane] = frames[lane] + 1 < numFrames ? frames[lane] + 1 : numFrames - 1;
+        spans[lane] = 1.0f / ((next[lane] - previous[lane]) * dt);
+      }
+      float4 inverseSpan = float4::load(spans);
+
+      // body COM position and velocity in m and m / s
+      float lanes[6][4];
+      for (int lane = 0; lane < 4; lane++)
+      {
+        const glm::vec4& c = trajectory.bodyCOM[frames[lane]];
+        glm::vec4 v = trajectory.bodyCOM[next[lane]] - trajectory.bodyCOM[previous[lane]];
+        for (int axis = 0; axis < 3; axis++)
+        {
+          lanes[axis][lane] = c[axis];
+          lanes[3 + axis][lane] = v[axis];
+        }
+      }
+      float4 unit(lengthUnit);
+      vec3x4 com = vec3x4::load(lanes[0], lanes[1], lanes[2]) * unit;
+      vec3x4 comVelocity = vec3x4::load(lanes[3], lanes[4], lanes[5]) * (unit * inverseSpan);
+
+      vec3x4 momentum, spinMomentum;
+      float4 ixx, iyy, izz, ixy, ixz, iyz;
+
+      for (int s = 0; s < NumSegments; s++)
+      {
+        int joint = geometry.frameJoint[s];
+        if (joint < 0 || mass[s] <= 0.0f)
+          continue;
+
+        float q[3][4][4];
+        for (int lane = 0; lane < 4; lane++)
+        {
+          const glm::vec4& p = trajectory.segmentsCOM[(size_t)frames[lane] * NumSegments + s];
+          glm::vec4 v = trajectory.segmentsCOM[(size_t)next[lane] * NumSegments + s] -
+                        trajectory.segmentsCOM[(size_t)previous[lane] * NumSegments + s];
+          for (int axis = 0; axis < 3; axis++)
+          {
+            lanes[axis][lane] = p[axis];
+            lanes[3 + axis][lane] = v[axis];
+          }
+
+          const unsigned int* which[3] = { frames, previous, next };
+          for (int k = 0; k < 3; k++)
+          {
+            const glm::quat& r = trajectory.rotations[(size_t)which[k][lane] * numJoints + joint];
+            q[k][0][lane] = r.w;
+            q[k][1][lane] = r.x;
+            q[k][2][lane] = r.y;
+            q[k][3][lane] = r.z;
+          }
+        }
+
+        float4 m(mass[s]);
+        vec3x4 d = vec3x4::load(lanes[0], lanes[1], lanes[2]) * unit - com;
+        vec3x4 dv = vec3x4::load(lanes[3], lanes[4], lanes[5]) * (unit * inverseSpan) - comVelocity;
+
+        quat4 rotation(float4::load(q[0][0]), float4::load(q[0][1]), float4::load(q[0][2]), float4::load(q[0][3]));
+        quat4 rotationPrevious(float4::load(q[1][0]), float4::load(q[1][1]), float4::load(q[1][2]), float4::load(q[1][3]));
+        quat4 rotationNext(float4::load(q[2][0]), float4::load(q[2][1]), float4::load(q[2][2]), float4::load(q[2][3]));
+
+        // world angular velocity, small angle form of 2 log(next * conjugate(previous)) / span
+        quat4 delta = rotationNext * conjugate(rotationPrevious);
+        float4 sign = _mm_or_ps(_mm_and_ps(delta.w.v, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.0f));
+        vec3x4 omega = vec3x4(delta.x, delta.y, delta.z) * (float4(2.0f) * sign * inverseSpan);
+
+        // rotation matrix columns of the frame joint
+        float4 two(2.0f), one(1.0f);
+        const quat4& r = rotation;
+        float4 xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+        float4 xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+        float4 wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+        vec3x4 column[3] = {
+          vec3x4(one - two * (yy + zz), two * (xy + wz), two * (xz - wy)),
+          vec3x4(two * (xy - wz), one - two * (xx + zz), two * (yz + wx)),
+          vec3x4(two * (xz + wy), two * (yz - wx), one - two * (xx + yy))
+        };
+
+        // world tensor R I R^T, I is constant per segment
+        const glm::mat3& local = geometry.inertia[s];
+        vec3x4 ri[3];
+        for (int c = 0; c < 3; c++)
+          ri[c] = column[0] * float4(local[c][0]) + column[1] * float4(local[c][1]) + column[2] * float4(local[c][2]);
+        float4 wxx = ri[0].x * column[0].x + ri[1].x * column[1].x + ri[2].x * column[2].x;
+        float4 wyy = ri[0].y * column[0].y + ri[1].y * column[1].y + ri[2].y * column[2].y;
+        float4 wzz = ri[0].z * column[0].z + ri[1].z * column[1].z + ri[2].z * column[2].z;
+        float4 wxy = ri[0].x * column[0].y + ri[1].x * column[1].y + ri[2].x * column[2].y;
+        float4 wxz = ri[0].x * column[0].z + ri[1].x * column[1].z + ri[2].x * column[2].z;
+        float4 wyz = ri[0].y * column[0].z + ri[1].y * column[1].z + ri[2].y * column[2].z;
+
+        // spin I w plus the orbital d x m dv
+        vec3x4 spin(wxx * omega.x + wxy * omega.y + wxz * omega.z,
+                    wxy * omega.x + wyy * omega.y + wyz * omega.z,
+                    wxz * omega.x + wyz * omega.y + wzz * omega.z);
+        spinMomentum += spin * m;
+        momentum += (spin + cross(d, dv)) * m;
+
+        // parallel axis terms about the body COM
+        float4 dd = dot(d, d);
+        ixx += m * (wxx + dd - d.x * d.x);
+        iyy += m * (wyy + dd - d.y * d.y);
+        izz += m * (wzz + dd - d.z * d.z);
+        ixy += m * (wxy - d.x * d.y);
+        ixz += m * (wxz - d.x * d.z);
+        iyz += m * (wyz - d.y * d.z);
+      }
+
+      float out[12][4];
+      momentum.store(out[0], out[1], out[2]);
+      spinMomentum.store(out[9], out[10], out[11]);
+      ixx.store(out[3]);
+      iyy.store(out[4]);
+      izz.store(out[5]);
+      ixy.store(out[6]);
+      ixz.store(out[7]);
+      iyz.store(out[8]);
+      for (int lane = 0; lane < 4; lane++)
+      {
+        unsigned int frame = block * 4 + lane;
+        if (frame >= numFrames)
+          break;
+        result.angularMomentum[frame] = glm::vec3(out[0][lane], out[1][lane], out[2][lane]);
+        result.spinMomentum[frame] = glm::vec3(out[9][lane], out[10][lane], out[11][lane]);
+        result.inertia[frame] = glm::mat3(out[3][lane], out[6][lane], out[7][lane],
+                                          out[6][lane], out[4][lane], out[8][lane],
+                                          out[7][lane], out[8][lane], out[5][lane]);
+      }
+    }
+  }, 16);
+}
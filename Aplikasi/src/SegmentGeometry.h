@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BodyModel.h"
+
+class Bvh2;
+
+#define EllipsoidShape 0
+#define TruncatedConeShape 1
+
+// Hanavan style solid of a segment, sizes are fractions of the segment length. Ellipsoids take
+// width and depth as transverse semi-axes, truncated cones take proximal and distal radius
+struct SegmentShape
+{
+  int shape;
+  float lengthScale; // of the segmentJoints distance, the trunk solid reaches up to the neck
+  float widthRatio;
+  float depthRatio;
+};
+
+extern const SegmentShape segmentShapes[NumSegments];
+
+// built once per skeleton from Joint::offset, inertia per unit mass in the local frame of
+// frameJoint, the joint that orients the segment
+struct SegmentGeometry
+{
+  int frameJoint[NumSegments];
+  float length[NumSegments];       // m
+  glm::mat3 inertia[NumSegments];  // m^2, about the solid's own COM
+};
+
+struct AngularMomentumResult
+{
+  std::vector<glm::vec3> angularMomentum; // frame, kg m^2 / s about the body COM
+  std::vector<glm::vec3> spinMomentum;    // frame, kg m^2 / s, only the segments' own I w
+  std::vector<glm::mat3> inertia;         // frame, kg m^2 about the body COM
+};
+
+void buildSegmentGeometry(const Bvh2& bvh, float lengthUnit, SegmentGeometry& geometry);
+
+// needs rotations, segmentsCOM and bodyCOM baked, four frames at a time
+void computeAngularMomentum(const ClipTrajectory& trajectory, const BodyParameters& parameters,
+                            const SegmentGeometry& geometry, float lengthUnit, AngularMomentumResult& result);
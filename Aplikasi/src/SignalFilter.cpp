@@ -0,0 +1,261 @@
+#include "SignalFilter.h"
+
+#include "bvh2.h"
+#include "MotionLayout.h"
+#include "ParallelFor.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+// frames of reflected signal on both ends, they take the IIR start up transient
+#define FilterPadding 32
+
+static void unwrapAngles(float* samples, unsigned int numFrames)
+{
+  for (unsigned int frame = 1; frame < numFrames; frame++)
+  {
+    float delta = samples[frame] - samples[frame - 1];
+    if (std::isfinite(delta))
+      samples[frame] -= 360.0f * std::floor((delta + 180.0f) / 360.0f);
+  }
+}
+
+// Hampel filter, samples far from the window median become gaps
+static void markSpikes(float* samples, unsigned int numFrames, const FilterSettings& settings)
+{
+  int half = std::max(1, settings.medianWindow / 2);
+  std::vector<float> window, deviations;
+  std::vector<unsigned int> spikes;
+
+  for (unsigned int frame = 0; frame < numFrames; frame++)
+  {
+    if (!std::isfinite(samples[frame]))
+      continue;
+
+    window.clear();
+    unsigned int first = frame > (unsigned int)half ? frame - half : 0;
+    unsigned int last = std::min(numFrames - 1, frame + half);
+    for (unsigned int i = first; i <= last; i++)
+    {
+      if (std::isfinite(samples[i]))
+        window.push_back(samples[i]);
+    }
+
+    std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+    float median = window[window.size() / 2];
+    deviations.resize(window.size());
+    for (size_t i = 0; i < window.size(); i++)
+      deviations[i] = std::fabs(window[i] - median);
+    std::nth_element(deviations.begin(), deviations.begin() + deviations.size() / 2, deviations.end());
+    float deviation = std::max(1.4826f * deviations[deviations.size() / 2], settings.minDeviation);
+
+    if (std::fabs(samples[frame] - median) > settings.spikeThreshold * deviation)
+      spikes.push_back(frame);
+  }
+
+  // marked afterwards so a spike doesn't shift the windows of its neighbours
+  for (unsigned int frame : spikes)
+    samples[frame] = NAN;
+}
+
+// cubic Hermite through each gap with the neighbours' slopes, or a straight line,
+// ends hold the nearest sample
+static void fillGaps(float* samples, unsigned int numFrames, bool cubic)
+{
+  unsigned int frame = 0;
+  while (frame < numFrames)
+  {
+    if (std::isfinite(samples[frame]))
+    {
+      frame++;
+      continue;
+    }
+
+    unsigned int start = frame;
+    while (frame < numFrames && !std::isfinite(samples[frame]))
+      frame++;
+    unsigned int end = frame; // first valid after the gap
+
+    if (start == 0 && end == numFrames)
+    {
+      std::fill(samples, samples + numFrames, 0.0f);
+      return;
+    }
+    if (start == 0 || end == numFrames)
+    {
+      float value = start == 0 ? samples[end] : samples[start - 1];
+      std::fill(samples + start, samples + end, value);
+      continue;
+    }
+
+    unsigned int a = start - 1;
+    unsigned int b = end;
+    float p0 = samples[a], p1 = samples[b];
+    float span = (float)(b - a);
+    float slope0 = cubic && a > 0 && std::isfinite(samples[a - 1]) ? p0 - samples[a - 1] : (p1 - p0) / span;
+    float slope1 = cubic && b + 1 < numFrames && std::isfinite(samples[b + 1]) ? samples[b + 1] - p1 : (p1 - p0) / span;
+
+    for (unsigned int i = start; i < end; i++)
+    {
+      float t = (i - a) / span;
+      float t2 = t * t, t3 = t2 * t;
+      samples[i] = (2.0f * t3 - 3.0f * t2 + 1.0f) * p0 + (t3 - 2.0f * t2 + t) * slope0 * span +
+                   (-2.0f * t3 + 3.0f * t2) * p1 + (t3 - t2) * slope1 * span;
+    }
+  }
+}
+
+// second order Butterworth low pass, y = a0 x + a1 x1 + a2 x2 + b1 y1 + b2 y2
+struct Biquad
+{
+  float a0, a1, a2, b1, b2;
+};
+
+static Biquad butterworth(float cutoff, float sampleRate, int passes)
+{
+  // each pass lowers the -3 dB point, the cutoff is moved up to compensate
+  float correction = std::pow(std::pow(2.0f, 1.0f / passes) - 1.0f, 0.25f);
+  float adjusted = std::min(cutoff / correction, 0.45f * sampleRate);
+  float omega = std::tan(3.14159265f * adjusted / sampleRate);
+  float k1 = 1.41421356f * omega;
+  float k2 = omega * omega;
+
+  Biquad filter;
+  filter.a0 = k2 / (1.0f + k1 + k2);
+  filter.a1 = 2.0f * filter.a0;
+  filter.a2 = filter.a0;
+  filter.b1 = 2.0f * filter.a0 * (1.0f / k2 - 1.0f);
+  filter.b2 = 1.0f - (filter.a0 + filter.a1 + filter.a2 + filter.b1);
+  return filter;
+}
+
+// one direction over four interleaved channels, started at rest on the first sample
+static void runBiquad(float* block, int count, int step, const Biquad& filter)
+{
+  float4 a0(filter.a0), a1(filter.a1), a2(filter.a2), b1(filter.b1), b2(filter.b2);
+  float4 x1 = float4::load(block), x2 = x1, y1 = x1, y2 = x1;
+
+  float* p = block;
+  for (int i = 0; i < count; i++, p += step)
+  {
+    float4 x = float4::load(p);
+    float4 y = a0 * x + a1 * x1 + a2 * x2 + b1 * y1 + b2 * y2;
+    y.store(p);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+  }
+}
+
+void conditionSignals(float* data, unsigned int numFrames, unsigned int numChannels,
+                      const unsigned char* angleChannels, float frameTime, const FilterSettings& settings)
+{
+  if (data == nullptr || numFrames < 2 || numChannels == 0)
+    return;
+
+  float sampleRate = 1.0f / (frameTime > 0.0f ? frameTime : 1.0f / 100.0f);
+  Biquad filter = butterworth(settings.cutoff, sampleRate, 2);
+  unsigned int padding = std::min(numFrames - 1, (unsigned int)FilterPadding);
+  unsigned int paddedFrames = numFrames + 2 * padding;
+  unsigned int numBlocks = (numChannels + 3) / 4;
+
+  // the per channel passes run on contiguous samples
+  ChannelMajorMotion channels;
+  toChannelMajor(data, numFrames, numChannels, channels);
+
+  parallelFor(0, numBlocks, [&](unsigned int beginBlock, unsigned int endBlock)
+  {
+    std::vector<float> block((size_t)paddedFrames * 4);
+
+    for (unsigned int b = beginBlock; b < endBlock; b++)
+    {
+      unsigned int first = b * 4;
+      unsigned int count = std::min(4u, numChannels - first);
+
+      // per channel clean up, then into the interleaved block with reflected ends
+      for (unsigned int lane = 0; lane < 4; lane++)
+      {
+        if (lane >= count)
+        {
+          for (unsigned int i = 0; i < paddedFrames; i++)
+            block[(size_t)i * 4 + lane] = 0.0f;
+          continue;
+        }
+
+        unsigned int c = first + lane;
+        float* channel = channels.channel(c);
+
+        if (angleChannels != nullptr && angleChannels[c])
+          unwrapAngles(channel, numFrames);
+        if (settings.removeSpikes)
+          markSpikes(channel, numFrames, settings);
+        fillGaps(channel, numFrames, settings.fillGaps);
+
+        for (unsigned int i = 0; i < padding; i++)
+        {
+          block[(size_t)(padding - 1 - i) * 4 + lane] = 2.0f * channel[0] - channel[i + 1];
+          block[(size_t)(padding + numFrames + i) * 4 + lane] = 2.0f * channel[numFrames - 1] - channel[numFrames - 2 - i];
+        }
+        for (unsigned int frame = 0; frame < numFrames; frame++)
+          block[(size_t)(padding + frame) * 4 + lane] = channel[frame];
+      }
+
+      // forward and backward cancel the phase
+      if (!settings.lowPass)
+        continue;
+      runBiquad(&block[0], (int)paddedFrames, 4, filter);
+      runBiquad(&block[(size_t)(paddedFrames - 1) * 4], (int)paddedFrames, -4, filter);
+
+      for (unsigned int lane = 0; lane < count; lane++)
+      {
+        float* channel = channels.channel(first + lane);
+        for (unsigned int frame = 0; frame < numFrames; frame++)
+          channel[frame] = block[(size_t)(padding + frame) * 4 + lane];
+      }
+    }
+  }, 1);
+
+  toFrameMajor(channels, data);
+}
+
+void conditionMotion(Bvh2& bvh, const FilterSettings& settings)
+{
+  const Motion& motion = bvh.getMotion();
+  if (motion.numFrames == 0)
+    return;
+
+  std::vector<unsigned char> rotations;
+  bvh.getRotationChannels(rotations);
+
+  // always from the loaded data, filtering twice would lower the cutoff
+  float* data = bvh.editMotion();
+  bvh.restoreRawMotion();
+  conditionSignals(data, motion.numFrames, motion.numMotionChannels, rotations.data(), motion.frameTime, settings);
+}
+
+void conditionClips(const std::vector<Bvh2*>& clips, const FilterSettings& settings)
+{
+  parallelFor(0, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+      conditionMotion(*clips[i], settings);
+  }, 1);
+}
+
+void conditionCOM(ClipTrajectory& trajectory, const FilterSettings& settings)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  if (trajectory.bodyCOM.size() != numFrames || trajectory.segmentsCOM.size() != (size_t)numFrames * NumSegments)
+    return;
+
+  conditionSignals(&trajectory.segmentsCOM[0].x, numFrames, NumSegments * 4, nullptr, trajectory.frameTime, settings);
+  conditionSignals(&trajectory.bodyCOM[0].x, numFrames, 4, nullptr, trajectory.frameTime, settings);
+
+  // w is filtered along with the rest, it goes back to a point
+  for (glm::vec4& com : trajectory.segmentsCOM)
+    com.w = 1.0f;
+  for (glm::vec4& com : trajectory.bodyCOM)
+    com.w = 1.0f;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "BodyModel.h"
+
+class Bvh2;
+
+struct FilterSettings
+{
+  bool removeSpikes = true;
+  int medianWindow = 7;          // frames, odd
+  float spikeThreshold = 4.0f;   // robust SDs away from the window median
+  float minDeviation = 0.5f;     // floor of the robust SD, clip units or degrees
+  bool fillGaps = true;          // cubic Hermite across non finite samples and removed spikes, else a line
+  bool lowPass = true;
+  float cutoff = 6.0f;           // Hz of the zero phase result
+};
+
+// conditions frame major samples in place, data[frame * numChannels + channel]. Angle channels
+// are unwrapped first and stay unwrapped. Four channels at a time, channel blocks in parallel
+void conditionSignals(float* data, unsigned int numFrames, unsigned int numChannels,
+                      const unsigned char* angleChannels, float frameTime, const FilterSettings& settings);
+
+// filters Motion::data of the clip, its raw data is kept for Bvh2::restoreRawMotion
+void conditionMotion(Bvh2& bvh, const FilterSettings& settings);
+
+// clips in parallel
+void conditionClips(const std::vector<Bvh2*>& clips, const FilterSettings& settings);
+
+// segmentsCOM and bodyCOM of a baked clip, for COMs that come from unfiltered joints
+void conditionCOM(ClipTrajectory& trajectory, const FilterSettings& settings);
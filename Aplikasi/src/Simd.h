@@ -0,0 +1,88 @@
+#pragma once
+
+#include <xmmintrin.h>
+
+// four lanes of floats, the x64 targets always have SSE
+struct float4
+{
+  __m128 v;
+
+  float4() : v(_mm_setzero_ps()) {}
+  float4(__m128 value) : v(value) {}
+  float4(float value) : v(_mm_set1_ps(value)) {}
+
+  static float4 load(const float* p) { return float4(_mm_loadu_ps(p)); }
+  void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline float4 operator+(const float4& a, const float4& b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(const float4& a, const float4& b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(const float4& a, const float4& b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(const float4& a, const float4& b) { return _mm_div_ps(a.v, b.v); }
+inline float4 vmin(const float4& a, const float4& b) { return _mm_min_ps(a.v, b.v); }
+inline float4 vmax(const float4& a, const float4& b) { return _mm_max_ps(a.v, b.v); }
+inline float4 vsqrt(const float4& a) { return _mm_sqrt_ps(a.v); }
+inline float4& operator+=(float4& a, const float4& b) { a.v = _mm_add_ps(a.v, b.v); return a; }
+inline float4& operator-=(float4& a, const float4& b) { a.v = _mm_sub_ps(a.v, b.v); return a; }
+
+// three components for four frames, struct of arrays
+struct vec3x4
+{
+  float4 x, y, z;
+
+  vec3x4() {}
+  vec3x4(const float4& x, const float4& y, const float4& z) : x(x), y(y), z(z) {}
+
+  static vec3x4 load(const float* px, const float* py, const float* pz)
+  {
+    return vec3x4(float4::load(px), float4::load(py), float4::load(pz));
+  }
+
+  void store(float* px, float* py, float* pz) const
+  {
+    x.store(px);
+    y.store(py);
+    z.store(pz);
+  }
+};
+
+inline vec3x4 operator+(const vec3x4& a, const vec3x4& b) { return vec3x4(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline vec3x4 operator-(const vec3x4& a, const vec3x4& b) { return vec3x4(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline vec3x4 operator*(const vec3x4& a, const float4& s) { return vec3x4(a.x * s, a.y * s, a.z * s); }
+inline vec3x4& operator+=(vec3x4& a, const vec3x4& b) { a = a + b; return a; }
+inline vec3x4& operator-=(vec3x4& a, const vec3x4& b) { a = a - b; return a; }
+
+inline float4 dot(const vec3x4& a, const vec3x4& b)
+{
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline vec3x4 cross(const vec3x4& a, const vec3x4& b)
+{
+  return vec3x4(a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x);
+}
+
+// four quaternions, struct of arrays
+struct quat4
+{
+  float4 w, x, y, z;
+
+  quat4() {}
+  quat4(const float4& w, const float4& x, const float4& y, const float4& z) : w(w), x(x), y(y), z(z) {}
+};
+
+inline quat4 operator*(const quat4& a, const quat4& b)
+{
+  return quat4(a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+               a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+               a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+               a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w);
+}
+
+inline quat4 conjugate(const quat4& q)
+{
+  float4 zero;
+  return quat4(q.w, zero - q.x, zero - q.y, zero - q.z);
+}
@@ -0,0 +1,201 @@
+#include "Stability.h"
+
+#include "BodyModel.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static const int footJoints[2][3] = {
+  { LeftAnkleJoint, LeftToeJoint, LeftToeEndJoint },
+  { RightAnkleJoint, RightToeJoint, RightToeEndJoint }
+};
+
+static inline float cross(const glm::vec2& o, const glm::vec2& a, const glm::vec2& b)
+{
+  return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Andrew's monotone chain, the points are sorted in place
+static int convexHull(glm::vec2* points, int numPoints, glm::vec2* hull)
+{
+  if (numPoints < 3)
+  {
+    std::copy(points, points + numPoints, hull);
+    return numPoints;
+  }
+
+  // insertion sort, there are at most MaxSupportPoints. std::sort's paths for long ranges also
+  // make GCC warn about indexing past the array
+  for (int i = 1; i < numPoints; i++)
+  {
+    glm::vec2 point = points[i];
+    int j = i;
+    for (; j > 0 && (points[j - 1].x > point.x || (points[j - 1].x == point.x && points[j - 1].y > point.y)); j--)
+      points[j] = points[j - 1];
+    points[j] = point;
+  }
+
+  glm::vec2 chain[2 * MaxSupportPoints];
+  int k = 0;
+  for (int i = 0; i < numPoints; i++)
+  {
+    while (k >= 2 && cross(chain[k - 2], chain[k - 1], points[i]) <= 0.0f)
+      k--;
+    chain[k++] = points[i];
+  }
+  for (int i = numPoints - 2, lower = k + 1; i >= 0; i--)
+  {
+    while (k >= lower && cross(chain[k - 2], chain[k - 1], points[i]) <= 0.0f)
+      k--;
+    chain[k++] = points[i];
+  }
+
+  int hullSize = std::min(k - 1, MaxSupportPoints);
+  std::copy(chain, chain + hullSize, hull);
+  return hullSize;
+}
+
+static inline float segmentDistance(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b)
+{
+  glm::vec2 ab = b - a;
+  float lengthSquared = glm::dot(ab, ab);
+  float t = lengthSquared > 0.0f ? glm::clamp(glm::dot(p - a, ab) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+  return glm::length(p - (a + t * ab));
+}
+
+static float stabilityMargin(const SupportPolygon& polygon, const glm::vec2& p)
+{
+  if (polygon.numPoints == 0)
+    return 0.0f;
+
+  if (polygon.numPoints == 1)
+    return -glm::length(p - polygon.points[0]);
+
+  bool inside = polygon.numPoints >= 3;
+  float distance = FLT_MAX;
+  for (int i = 0; i < polygon.numPoints; i++)
+  {
+    const glm::vec2& a = polygon.points[i];
+    const glm::vec2& b = polygon.points[(i + 1) % polygon.numPoints];
+    if (cross(a, b, p) < 0.0f)
+      inside = false;
+    distance = std::min(distance, segmentDistance(p, a, b));
+  }
+
+  return inside ? distance : -distance;
+}
+
+void computeStability(const ClipTrajectory& trajectory, const StabilitySettings& settings, StabilityResult& result)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  unsigned int numJoints = trajectory.numJoints;
+
+  result.contacts.assign(numFrames, 0);
+  result.supportPolygons.resize(numFrames);
+  result.com.resize(numFrames);
+  result.margin.resize(numFrames);
+
+  if (numFrames == 0 || numJoints <= RightToeEndJoint)
+    return;
+
+  const glm::vec4* joints = trajectory.joints.data();
+  const glm::vec4* bodyCOM = trajectory.bodyCOM.data();
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+
+  // floor heights of the foot joints, the skeleton doesn't have to touch y = 0 exactly
+  float floorHeight[2][3];
+  for (int foot = 0; foot < 2; foot++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      float lowest = FLT_MAX;
+      for (unsigned int frame = 0; frame < numFrames; frame++)
+        lowest = std::min(lowest, joints[(size_t)frame * numJoints + footJoints[foot][j]].y);
+      floorHeight[foot][j] = lowest;
+    }
+  }
+
+  float contactSpeedSquared = settings.contactSpeed * settings.contactSpeed * dt * dt * 4.0f;
+
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      unsigned int previous = frame > 0 ? frame - 1 : frame;
+      unsigned int next = frame + 1 < numFrames ? frame + 1 : frame;
+      const glm::vec4* pose = joints + (size_t)frame * numJoints;
+      const glm::vec4* posePrevious = joints + (size_t)previous * numJoints;
+      const glm::vec4* poseNext = joints + (size_t)next * numJoints;
+
+      // contacts, central difference scaled to two frames
+      unsigned char contacts = 0;
+      glm::vec2 points[MaxSupportPoints];
+      int numPoints = 0;
+
+      for (int foot = 0; foot < 2; foot++)
+      {
+        const glm::vec4& ankle = pose[footJoints[foot][0]];
+        const glm::vec4& toe = pose[footJoints[foot][1]];
+        const glm::vec4& toeEnd = pose[footJoints[foot][2]];
+
+        glm::vec3 ankleMove = glm::vec3(poseNext[footJoints[foot][0]] - posePrevious[footJoints[foot][0]]);
+        glm::vec3 toeMove = glm::vec3(poseNext[footJoints[foot][1]] - posePrevious[footJoints[foot][1]]);
+        if (next - previous == 1)
+        {
+          ankleMove *= 2.0f;
+          toeMove *= 2.0f;
+        }
+
+        bool heel = ankle.y - floorHeight[foot][0] < settings.contactHeight &&
+                    glm::dot(ankleMove, ankleMove) < contactSpeedSquared;
+        bool toes = toe.y - floorHeight[foot][1] < settings.contactHeight &&
+                    glm::dot(toeMove, toeMove) < contactSpeedSquared;
+
+        if (!heel && !toes)
+          continue;
+
+        glm::vec2 heelPoint(ankle.x, ankle.z);
+        glm::vec2 toePoint(toe.x, toe.z);
+        glm::vec2 toeEndPoint(toeEnd.x, toeEnd.z);
+        glm::vec2 direction = toeEndPoint - heelPoint;
+        float length = glm::length(direction);
+        direction = length > 0.0f ? direction / length : glm::vec2(0.0f, 1.0f);
+        glm::vec2 side = glm::vec2(-direction.y, direction.x) * settings.footHalfWidth;
+
+        if (heel)
+        {
+          contacts |= foot == 0 ? LeftHeelContact : RightHeelContact;
+          points[numPoints++] = heelPoint + side;
+          points[numPoints++] = heelPoint - side;
+        }
+        if (toes)
+        {
+          contacts |= foot == 0 ? LeftToeContact : RightToeContact;
+          points[numPoints++] = toePoint + side;
+          points[numPoints++] = toePoint - side;
+          points[numPoints++] = toeEndPoint + side;
+          points[numPoints++] = toeEndPoint - side;
+        }
+      }
+
+      SupportPolygon& polygon = result.supportPolygons[frame];
+      polygon.numPoints = convexHull(points, numPoints, polygon.points);
+      result.contacts[frame] = contacts;
+
+      // COM on the floor, optionally extrapolated with its velocity (Hof 2005)
+      glm::vec2 com(bodyCOM[frame].x, bodyCOM[frame].z);
+      if (settings.extrapolatedCOM && next != previous)
+      {
+        glm::vec4 velocity = (bodyCOM[next] - bodyCOM[previous]) / ((next - previous) * dt);
+        float height = std::max(bodyCOM[frame].y, 1.0f);
+        float omega = std::sqrt(settings.gravity / height);
+        com += glm::vec2(velocity.x, velocity.z) / omega;
+      }
+
+      result.com[frame] = com;
+      result.margin[frame] = stabilityMargin(polygon, com);
+    }
+  });
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct ClipTrajectory;
+
+// foot joints, same indices as bvhVertices
+#define LeftAnkleJoint 18
+#define LeftToeJoint 19
+#define LeftToeEndJoint 20
+#define RightAnkleJoint 23
+#define RightToeJoint 24
+#define RightToeEndJoint 25
+
+#define LeftHeelContact 0x01
+#define LeftToeContact 0x02
+#define RightHeelContact 0x04
+#define RightToeContact 0x08
+
+#define MaxSupportPoints 12
+
+struct StabilitySettings
+{
+  float contactHeight = 3.0f;   // above the lowest height the joint reaches in the clip
+  float contactSpeed = 25.0f;   // units per second
+  float footHalfWidth = 4.5f;   // half width of the foot print
+  float gravity = 981.0f;       // the example clips are in cm
+  bool extrapolatedCOM = false; // Hof's extrapolated COM instead of the projected COM
+};
+
+// convex hull on the floor plane, x and z, counter clockwise
+struct SupportPolygon
+{
+  int numPoints = 0;
+  glm::vec2 points[MaxSupportPoints];
+};
+
+struct StabilityResult
+{
+  std::vector<unsigned char> contacts;
+  std::vector<SupportPolygon> supportPolygons;
+  std::vector<glm::vec2> com;  // projected or extrapolated COM on the floor
+  std::vector<float> margin;   // distance from com to the polygon edge, positive inside, 0 without contact
+};
+
+// needs joints and bodyCOM baked
+void computeStability(const ClipTrajectory& trajectory, const StabilitySettings& settings, StabilityResult& result);
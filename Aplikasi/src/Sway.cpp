@@ -0,0 +1,195 @@
+#include "Sway.h"
+
+#include "Aggregation.h"
+#include "bvh2.h"
+#include "FFT.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+// fills the spectrum of one detrended signal, Welch segments with half overlap
+static void welchSpectrum(const std::vector<float>& signal, const RealFFT& fft, float sampleRate, std::vector<float>& power)
+{
+  unsigned int n = fft.getSize();
+  unsigned int count = (unsigned int)signal.size();
+  unsigned int step = n / 2;
+  power.assign(n / 2 + 1, 0.0f);
+
+  std::vector<float> window(n), segment(n);
+  std::vector<std::complex<float>> spectrum(n / 2 + 1);
+  unsigned int windowLength = std::min(n, count);
+  double windowPower = 0.0;
+  for (unsigned int i = 0; i < windowLength; i++)
+  {
+    window[i] = windowLength > 1 ? 0.5f - 0.5f * std::cos(2.0f * 3.14159265f * i / (windowLength - 1)) : 1.0f;
+    windowPower += window[i] * window[i];
+  }
+  if (windowPower <= 0.0)
+    return;
+
+  unsigned int numSegments = 0;
+  for (unsigned int start = 0; start == 0 || start + n <= count; start += step)
+  {
+    std::fill(segment.begin(), segment.end(), 0.0f);
+    for (unsigned int i = 0; i < windowLength && start + i < count; i++)
+      segment[i] = signal[start + i] * window[i];
+
+    fft.forward(&segment[0], &spectrum[0]);
+    for (unsigned int k = 0; k <= n / 2; k++)
+      power[k] += std::norm(spectrum[k]);
+    numSegments++;
+  }
+
+  // one sided density, DC and Nyquist aren't doubled
+  float scale = 1.0f / (float)(numSegments * windowPower * sampleRate);
+  for (unsigned int k = 0; k <= n / 2; k++)
+    power[k] *= (k == 0 || k == n / 2) ? scale : 2.0f * scale;
+}
+
+static void spectralFrequencies(const std::vector<float>& power, float step, float& mean, float& median)
+{
+  // DC is the removed mean, leave it out
+  double total = 0.0, moment = 0.0;
+  for (size_t k = 1; k < power.size(); k++)
+  {
+    total += power[k];
+    moment += power[k] * k * step;
+  }
+  mean = total > 0.0 ? (float)(moment / total) : 0.0f;
+  median = 0.0f;
+
+  double cumulative = 0.0;
+  for (size_t k = 1; k < power.size() && total > 0.0; k++)
+  {
+    double next = cumulative + power[k];
+    if (next >= 0.5 * total)
+    {
+      // inside the bin, linear in the cumulative power
+      double t = power[k] > 0.0 ? (0.5 * total - cumulative) / power[k] : 0.0;
+      median = (float)((k - 0.5 + t) * step);
+      break;
+    }
+    cumulative = next;
+  }
+}
+
+void computeSway(const ClipTrajectory& trajectory, const SwaySettings& settings, SwayResult& result)
+{
+  result = SwayResult();
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+
+  unsigned int first = (unsigned int)std::max(0.0f, settings.startTime / dt);
+  unsigned int last = settings.endTime > 0.0f ? (unsigned int)(settings.endTime / dt) + 1 : trajectory.numFrames;
+  last = std::min(last, trajectory.numFrames);
+  if (last < first + 4 || trajectory.bodyCOM.size() < last)
+    return;
+
+  unsigned int count = last - first;
+  result.numFrames = count;
+  result.duration = (count - 1) * dt;
+
+  std::vector<float> signal[2];
+  signal[SwayX].resize(count);
+  signal[SwayZ].resize(count);
+  double mean[2] = {};
+  float minimum[2] = { 1e30f, 1e30f }, maximum[2] = { -1e30f, -1e30f };
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const glm::vec4& com = trajectory.bodyCOM[first + i];
+    signal[SwayX][i] = com.x;
+    signal[SwayZ][i] = com.z;
+    for (int axis = 0; axis < 2; axis++)
+    {
+      mean[axis] += signal[axis][i];
+      minimum[axis] = std::min(minimum[axis], signal[axis][i]);
+      maximum[axis] = std::max(maximum[axis], signal[axis][i]);
+    }
+  }
+
+  // path, then moments about the mean
+  double path = 0.0, xx = 0.0, zz = 0.0, xz = 0.0;
+  for (int axis = 0; axis < 2; axis++)
+  {
+    mean[axis] /= count;
+    result.range[axis] = maximum[axis] - minimum[axis];
+  }
+  for (unsigned int i = 0; i < count; i++)
+  {
+    float x = signal[SwayX][i] -= (float)mean[SwayX];
+    float z = signal[SwayZ][i] -= (float)mean[SwayZ];
+    if (i > 0)
+      path += std::sqrt((x - signal[SwayX][i - 1]) * (x - signal[SwayX][i - 1]) + (z - signal[SwayZ][i - 1]) * (z - signal[SwayZ][i - 1]));
+    xx += x * x;
+    zz += z * z;
+    xz += x * z;
+  }
+  result.pathLength = (float)path;
+  result.meanVelocity = result.duration > 0.0f ? result.pathLength / result.duration : 0.0f;
+  result.rms[SwayX] = (float)std::sqrt(xx / count);
+  result.rms[SwayZ] = (float)std::sqrt(zz / count);
+
+  // prediction ellipse from the covariance eigenvalues, chi square with two degrees of freedom
+  double sxx = xx / (count - 1), szz = zz / (count - 1), sxz = xz / (count - 1);
+  double trace = sxx + szz;
+  double root = std::sqrt(std::max(0.0, (sxx - szz) * (sxx - szz) / 4.0 + sxz * sxz));
+  double major = std::max(0.0, trace / 2.0 + root);
+  double minor = std::max(0.0, trace / 2.0 - root);
+  double confidence = std::min(0.9999, std::max(0.01, (double)settings.confidence));
+  double chiSquare = -2.0 * std::log(1.0 - confidence);
+  result.ellipseAxes[0] = (float)std::sqrt(chiSquare * major);
+  result.ellipseAxes[1] = (float)std::sqrt(chiSquare * minor);
+  result.ellipseArea = 3.14159265f * result.ellipseAxes[0] * result.ellipseAxes[1];
+  result.ellipseAngle = (float)(0.5 * std::atan2(2.0 * sxz, sxx - szz));
+
+  // spectra
+  unsigned int segmentLength = nextPowerOfTwo(std::max(4u, settings.segmentLength));
+  if (count < segmentLength)
+    segmentLength = nextPowerOfTwo(count);
+  RealFFT fft(segmentLength);
+  float sampleRate = 1.0f / dt;
+  result.frequencyStep = sampleRate / fft.getSize();
+
+  welchSpectrum(signal[SwayX], fft, sampleRate, result.power[SwayX]);
+  welchSpectrum(signal[SwayZ], fft, sampleRate, result.power[SwayZ]);
+  result.power[SwayResultant].resize(result.power[SwayX].size());
+  for (size_t k = 0; k < result.power[SwayX].size(); k++)
+    result.power[SwayResultant][k] = result.power[SwayX][k] + result.power[SwayZ][k];
+
+  for (int axis = 0; axis < 3; axis++)
+    spectralFrequencies(result.power[axis], result.frequencyStep, result.meanFrequency[axis], result.medianFrequency[axis]);
+}
+
+void computeClipsSway(const std::vector<ClipEntry>& clips, int model, const SwaySettings& settings,
+                      std::vector<SwayResult>& results)
+{
+  results.assign(clips.size(), SwayResult());
+
+  parallelFor(0, (unsigned int)clips.size(), [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int i = begin; i < end; i++)
+    {
+      Bvh2 bvh;
+      ClipTrajectory trajectory;
+      if (!loadManifestClip(clips[i], model, bvh, trajectory))
+        continue;
+      computeSway(trajectory, settings, results[i]);
+    }
+  }, 1);
+}
+
+void writeSwayTable(const std::vector<ClipEntry>& clips, const std::vector<SwayResult>& results, std::ostream& out)
+{
+  out << "path,subject,condition,frames,duration,path_length,mean_velocity,rms_x,rms_z,ellipse_area,"
+         "median_frequency_x,median_frequency_z,median_frequency,mean_frequency\n";
+  for (size_t i = 0; i < clips.size() && i < results.size(); i++)
+  {
+    const SwayResult& r = results[i];
+    if (r.numFrames == 0)
+      continue;
+    out << clips[i].path << "," << clips[i].subject << "," << clips[i].condition << "," << r.numFrames << ","
+        << r.duration << "," << r.pathLength << "," << r.meanVelocity << "," << r.rms[SwayX] << "," << r.rms[SwayZ] << ","
+        << r.ellipseArea << "," << r.medianFrequency[SwayX] << "," << r.medianFrequency[SwayZ] << ","
+        << r.medianFrequency[SwayResultant] << "," << r.meanFrequency[SwayResultant] << "\n";
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include "BodyModel.h"
+
+struct ClipEntry;
+
+// axes of the horizontal COM, X mediolateral and Z anteroposterior in the example clips
+#define SwayX 0
+#define SwayZ 1
+#define SwayResultant 2
+
+struct SwaySettings
+{
+  float startTime = 0.0f;            // seconds, trims the settling at the start of a trial
+  float endTime = 0.0f;              // seconds, 0 runs to the end
+  unsigned int segmentLength = 1024; // samples per Welch segment, shorter trials use one zero padded segment
+  float confidence = 0.95f;          // of the ellipse
+};
+
+struct SwayResult
+{
+  unsigned int numFrames = 0;
+  float duration = 0.0f;        // s
+  float pathLength = 0.0f;      // clip units
+  float meanVelocity = 0.0f;    // clip units / s
+  float rms[2] = {};            // clip units, about the mean
+  float range[2] = {};
+  float ellipseArea = 0.0f;     // clip units^2
+  float ellipseAxes[2] = {};    // semi-axes, major first
+  float ellipseAngle = 0.0f;    // radians of the major axis from X towards Z
+  float meanFrequency[3] = {};  // Hz, X, Z and both
+  float medianFrequency[3] = {};
+  float frequencyStep = 0.0f;   // Hz per bin
+  std::vector<float> power[3];  // clip units^2 / Hz, from DC to Nyquist
+};
+
+// needs bodyCOM baked, spectra by Welch averaging of Hann windowed segments
+void computeSway(const ClipTrajectory& trajectory, const SwaySettings& settings, SwayResult& result);
+
+// loads and analyzes the clips in parallel, results line up with clips and failed clips get numFrames 0
+void computeClipsSway(const std::vector<ClipEntry>& clips, int model, const SwaySettings& settings,
+                      std::vector<SwayResult>& results);
+
+void writeSwayTable(const std::vector<ClipEntry>& clips, const std::vector<SwayResult>& results, std::ostream& out);
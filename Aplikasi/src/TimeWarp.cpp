@@ -0,0 +1,230 @@
+#include "TimeWarp.h"
+
+#include "MotionLayout.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include <xmmintrin.h>
+
+const unsigned int defaultWarpJoints[NumWarpJoints] = { 9, 14, 18, 23 };
+
+// which neighbor a cell was reached from
+#define WarpDiagonal 0
+#define WarpUp 1   // (i - 1, j)
+#define WarpLeft 2 // (i, j - 1)
+
+void dynamicTimeWarp(const float* a, unsigned int numFramesA, const float* b, unsigned int numFramesB,
+                     unsigned int dims, unsigned int radius, float abandonCost, WarpResult& result)
+{
+  result = WarpResult();
+  if (numFramesA == 0 || numFramesB == 0)
+    return;
+
+  const float infinity = std::numeric_limits<float>::infinity();
+  unsigned int n = numFramesA;
+  unsigned int m = numFramesB;
+  double slope = n > 1 ? (double)(m - 1) / (n - 1) : 0.0;
+  radius = std::max(radius, std::max(1u, (unsigned int)std::ceil(slope)));
+
+  // dim major copies, b reversed so the cells of an anti-diagonal read both forward
+  unsigned int strideA = ((n + 3) & ~3u) + 4;
+  unsigned int strideB = ((m + 3) & ~3u) + 4;
+  std::vector<float> columnsA((size_t)dims * strideA, 0.0f);
+  std::vector<float> columnsB((size_t)dims * strideB, 0.0f);
+  transpose(a, n, dims, dims, columnsA.data(), strideA);
+  std::vector<float> reversed((size_t)m * dims);
+  for (unsigned int j = 0; j < m; j++)
+    std::copy(b + (size_t)(m - 1 - j) * dims, b + (size_t)(m - j) * dims, reversed.begin() + (size_t)j * dims);
+  transpose(reversed.data(), m, dims, dims, columnsB.data(), strideB);
+
+  // band of every anti-diagonal k = i + j as a range of i
+  unsigned int numDiagonals = n + m - 1;
+  std::vector<unsigned int> lower(numDiagonals), upper(numDiagonals);
+  std::vector<size_t> offsets(numDiagonals + 1, 0);
+  for (unsigned int k = 0; k < numDiagonals; k++)
+  {
+    double first = std::ceil((k - (double)radius) / (1.0 + slope));
+    double last = std::floor((k + (double)radius) / (1.0 + slope));
+    lower[k] = std::max((unsigned int)std::max(first, 0.0), k + 1 > m ? k + 1 - m : 0);
+    upper[k] = std::min((unsigned int)std::max(last, 0.0), std::min(n - 1, k));
+    offsets[k + 1] = offsets[k] + (upper[k] >= lower[k] ? upper[k] - lower[k] + 1 : 0);
+  }
+  std::vector<unsigned char> directions(offsets[numDiagonals]);
+
+  // three rolling anti-diagonals indexed by i + 1, slot 0 is i = -1, padded for the last step
+  std::vector<float> buffers[3];
+  for (std::vector<float>& buffer : buffers)
+    buffer.assign(n + 8, infinity);
+  float* previous2 = buffers[0].data();
+  float* previous1 = buffers[1].data();
+  float* current = buffers[2].data();
+  previous2[0] = 0.0f; // D(-1, -1) starts the path at (0, 0)
+
+  float previousMinimum = infinity;
+  for (unsigned int k = 0; k < numDiagonals; k++)
+  {
+    unsigned int lo = lower[k];
+    unsigned int hi = upper[k];
+    unsigned char* direction = &directions[offsets[k]];
+    float4 minimum(infinity);
+    float tailMinimum = infinity;
+
+    for (unsigned int i = lo; i <= hi; i += 4)
+    {
+      const float* pa = &columnsA[i];
+      const float* pb = &columnsB[m - 1 - (k - i)];
+      float4 sum;
+      for (unsigned int d = 0; d < dims; d++)
+      {
+        float4 difference = float4::load(pa + (size_t)d * strideA) - float4::load(pb + (size_t)d * strideB);
+        sum += difference * difference;
+      }
+
+      float4 up = float4::load(previous1 + i);
+      float4 left = float4::load(previous1 + i + 1);
+      float4 diagonal = float4::load(previous2 + i);
+      float4 best = vmin(vmin(up, left), diagonal);
+      float4 cost = best + vsqrt(sum);
+      cost.store(current + i + 1);
+
+      int isDiagonal = _mm_movemask_ps(_mm_cmpeq_ps(diagonal.v, best.v));
+      int isUp = _mm_movemask_ps(_mm_cmpeq_ps(up.v, best.v));
+      unsigned int lanes = std::min(4u, hi - i + 1);
+      for (unsigned int l = 0; l < lanes; l++)
+        direction[i - lo + l] = (isDiagonal >> l) & 1 ? WarpDiagonal : ((isUp >> l) & 1 ? WarpUp : WarpLeft);
+
+      if (lanes == 4)
+      {
+        minimum = vmin(minimum, cost);
+      }
+      else
+      {
+        for (unsigned int l = 0; l < lanes; l++)
+          tailMinimum = std::min(tailMinimum, current[i + 1 + l]);
+      }
+    }
+
+    // the next two anti-diagonals read one cell past each end of this one
+    current[lo] = infinity;
+    current[hi + 2] = infinity;
+
+    // a diagonal step skips an anti-diagonal but no path skips two in a row
+    float lanes[4];
+    minimum.store(lanes);
+    float diagonalMinimum = std::min(std::min(lanes[0], lanes[1]), std::min(std::min(lanes[2], lanes[3]), tailMinimum));
+    if (abandonCost > 0.0f && std::min(diagonalMinimum, previousMinimum) > abandonCost)
+      return;
+    previousMinimum = diagonalMinimum;
+
+    float* oldest = previous2;
+    previous2 = previous1;
+    previous1 = current;
+    current = oldest;
+  }
+
+  result.cost = previous1[n];
+  result.complete = result.cost < infinity;
+  if (!result.complete)
+    return;
+
+  unsigned int i = n - 1;
+  unsigned int j = m - 1;
+  while (true)
+  {
+    result.path.push_back(WarpStep{ i, j });
+    if (i == 0 && j == 0)
+      break;
+    unsigned int k = i + j;
+    unsigned char direction = directions[offsets[k] + i - lower[k]];
+    if (direction == WarpDiagonal)
+    {
+      i--;
+      j--;
+    }
+    else if (direction == WarpUp)
+    {
+      i--;
+    }
+    else
+    {
+      j--;
+    }
+  }
+  std::reverse(result.path.begin(), result.path.end());
+  result.meanCost = result.cost / result.path.size();
+
+  // the middle of each frame's run of partners
+  std::vector<unsigned int> firstB(n, m), lastB(n, 0), firstA(m, n), lastA(m, 0);
+  for (const WarpStep& step : result.path)
+  {
+    firstB[step.a] = std::min(firstB[step.a], step.b);
+    lastB[step.a] = std::max(lastB[step.a], step.b);
+    firstA[step.b] = std::min(firstA[step.b], step.a);
+    lastA[step.b] = std::max(lastA[step.b], step.a);
+  }
+  result.aToB.resize(n);
+  result.bToA.resize(m);
+  for (unsigned int f = 0; f < n; f++)
+    result.aToB[f] = (firstB[f] + lastB[f]) / 2;
+  for (unsigned int f = 0; f < m; f++)
+    result.bToA[f] = (firstA[f] + lastA[f]) / 2;
+}
+
+// frame major warp features of one clip
+static void warpFeatures(const ClipTrajectory& trajectory, const WarpSettings& settings,
+                         const std::vector<unsigned int>& joints, unsigned int dims, std::vector<float>& features)
+{
+  unsigned int numJoints = trajectory.numJoints;
+  features.assign((size_t)trajectory.numFrames * dims, 0.0f);
+  glm::vec3 start = glm::vec3(trajectory.bodyCOM[0]);
+  glm::vec2 startHeading = rootHeading(trajectory, 0);
+
+  for (unsigned int frame = 0; frame < trajectory.numFrames; frame++)
+  {
+    float* feature = &features[(size_t)frame * dims];
+    glm::vec3 com = glm::vec3(trajectory.bodyCOM[frame]) - start;
+    feature[0] = (com.x * startHeading.y - com.z * startHeading.x) * settings.comWeight;
+    feature[1] = (trajectory.bodyCOM[frame].y) * settings.comWeight;
+    feature[2] = (com.x * startHeading.x + com.z * startHeading.y) * settings.comWeight;
+
+    const glm::vec4* pose = &trajectory.joints[(size_t)frame * numJoints];
+    glm::vec2 heading = rootHeading(trajectory, frame);
+    for (size_t i = 0; i < joints.size(); i++)
+    {
+      glm::vec3 p = glm::vec3(pose[joints[i]] - pose[0]);
+      feature[3 + i * 3 + 0] = (p.x * heading.y - p.z * heading.x) * settings.jointWeight;
+      feature[3 + i * 3 + 1] = p.y * settings.jointWeight;
+      feature[3 + i * 3 + 2] = (p.x * heading.x + p.z * heading.y) * settings.jointWeight;
+    }
+  }
+}
+
+void alignClips(const ClipTrajectory& a, const ClipTrajectory& b, const WarpSettings& settings, WarpResult& result)
+{
+  result = WarpResult();
+  std::vector<unsigned int> joints = settings.joints;
+  if (joints.empty())
+    joints.assign(defaultWarpJoints, defaultWarpJoints + NumWarpJoints);
+
+  bool baked = a.numFrames > 0 && b.numFrames > 0 && a.bodyCOM.size() == a.numFrames && b.bodyCOM.size() == b.numFrames &&
+               !a.rotations.empty() && !b.rotations.empty();
+  for (unsigned int joint : joints)
+    baked = baked && joint < a.numJoints && joint < b.numJoints;
+  if (!baked)
+  {
+    std::cout << "Time warping needs two clips with joints and COM baked" << std::endl;
+    return;
+  }
+
+  unsigned int dims = 3 + (unsigned int)joints.size() * 3;
+  std::vector<float> featuresA, featuresB;
+  warpFeatures(a, settings, joints, dims, featuresA);
+  warpFeatures(b, settings, joints, dims, featuresB);
+
+  unsigned int radius = (unsigned int)(settings.bandWidth * std::max(a.numFrames, b.numFrames));
+  dynamicTimeWarp(featuresA.data(), a.numFrames, featuresB.data(), b.numFrames, dims, radius, settings.abandonCost, result);
+}
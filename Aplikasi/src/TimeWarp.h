@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "BodyModel.h"
+
+#define NumWarpJoints 4
+
+// LeftHand, RightHand, LeftFoot, RightFoot
+extern const unsigned int defaultWarpJoints[NumWarpJoints];
+
+struct WarpSettings
+{
+  std::vector<unsigned int> joints; // empty uses defaultWarpJoints
+  float comWeight = 1.0f;
+  float jointWeight = 1.0f;
+  float bandWidth = 0.1f;   // Sakoe-Chiba radius as a fraction of the longer clip
+  float abandonCost = 0.0f; // stop once every path costs more, 0 never stops
+};
+
+struct WarpStep
+{
+  unsigned int a;
+  unsigned int b;
+};
+
+struct WarpResult
+{
+  bool complete = false; // false when abandoned or the clips can't be compared
+  float cost = 0.0f;     // sum of the frame distances along the path, cm
+  float meanCost = 0.0f; // per step of the path
+  std::vector<WarpStep> path; // from (0, 0) to (numFramesA - 1, numFramesB - 1)
+  std::vector<unsigned int> aToB; // frame of b shown with each frame of a
+  std::vector<unsigned int> bToA;
+};
+
+// DTW over frame major features, a is numFramesA * dims and b numFramesB * dims. cells with
+// |j - i (numFramesB - 1) / (numFramesA - 1)| > radius are skipped, the radius is widened
+// when the slope would leave the band disconnected. anti-diagonals are filled four cells
+// at a time since their cells only depend on the two previous anti-diagonals
+void dynamicTimeWarp(const float* a, unsigned int numFramesA, const float* b, unsigned int numFramesB,
+                     unsigned int dims, unsigned int radius, float abandonCost, WarpResult& result);
+
+// aligns the body COM, relative to its first frame and turned to the first heading, and the
+// root relative joints turned to each frame's heading. needs joints, rotations and bodyCOM baked
+void alignClips(const ClipTrajectory& a, const ClipTrajectory& b, const WarpSettings& settings, WarpResult& result);
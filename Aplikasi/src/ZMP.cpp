@@ -0,0 +1,71 @@
+#include "ZMP.h"
+
+#include "Dynamics.h"
+#include "ParallelFor.h"
+#include "SegmentGeometry.h"
+
+void computeZMP(const ClipTrajectory& trajectory, const BodyParameters& parameters,
+                const AngularMomentumResult* momentum, const DynamicsSettings& dynamicsSettings,
+                const ZMPSettings& settings, ZMPResult& result)
+{
+  unsigned int numFrames = trajectory.numFrames;
+  result.zmp.assign(numFrames, glm::vec2(0.0f));
+  result.valid.assign(numFrames, 0);
+  if (numFrames < 3 || trajectory.segmentsCOM.size() != (size_t)numFrames * NumSegments)
+    return;
+  if (momentum != nullptr && momentum->spinMomentum.size() != numFrames)
+    momentum = nullptr;
+
+  float dt = trajectory.frameTime > 0.0f ? trajectory.frameTime : 1.0f / 100.0f;
+  float gravity = dynamicsSettings.gravity / dynamicsSettings.lengthUnit;
+  // kg m^2 / s^2 to kg unit^2 / s^2
+  float momentUnit = 1.0f / (dynamicsSettings.lengthUnit * dynamicsSettings.lengthUnit);
+
+  float mass[NumSegments];
+  float totalMass = 0.0f;
+  for (int s = 0; s < NumSegments; s++)
+  {
+    mass[s] = parameters.massPercent[s] / 100.0f * parameters.totalBodyWeight;
+    totalMass += mass[s];
+  }
+
+  const glm::vec4* segments = trajectory.segmentsCOM.data();
+
+  parallelFor(0, numFrames, [&](unsigned int begin, unsigned int end)
+  {
+    for (unsigned int frame = begin; frame < end; frame++)
+    {
+      // second differences, the end frames take their neighbour's
+      unsigned int center = frame == 0 ? 1 : (frame + 1 == numFrames ? frame - 1 : frame);
+      const glm::vec4* previous = &segments[(size_t)(center - 1) * NumSegments];
+      const glm::vec4* current = &segments[(size_t)center * NumSegments];
+      const glm::vec4* next = &segments[(size_t)(center + 1) * NumSegments];
+      const glm::vec4* position = &segments[(size_t)frame * NumSegments];
+
+      // moments of the inertial and gravity forces about the floor origin
+      float load = 0.0f, momentX = 0.0f, momentZ = 0.0f;
+      for (int s = 0; s < NumSegments; s++)
+      {
+        glm::vec3 acceleration = glm::vec3(next[s] - 2.0f * current[s] + previous[s]) / (dt * dt);
+        float vertical = mass[s] * (acceleration.y + gravity);
+        float height = position[s].y - settings.floorHeight;
+        load += vertical;
+        momentX += vertical * position[s].x - mass[s] * acceleration.x * height;
+        momentZ += vertical * position[s].z - mass[s] * acceleration.z * height;
+      }
+
+      if (momentum != nullptr)
+      {
+        glm::vec3 rate = (momentum->spinMomentum[center + 1] - momentum->spinMomentum[center - 1]) / (2.0f * dt);
+        momentX += rate.z * momentUnit;
+        momentZ -= rate.x * momentUnit;
+      }
+
+      if (load > settings.minLoad * totalMass * gravity)
+      {
+        result.zmp[frame] = glm::vec2(momentX / load, momentZ / load);
+        result.valid[frame] = 1;
+      }
+    }
+  }, 256);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BodyModel.h"
+
+struct AngularMomentumResult;
+struct DynamicsSettings;
+
+struct ZMPSettings
+{
+  float floorHeight = 0.0f;  // clip units, the drawn floor
+  float minLoad = 0.1f;      // of the body weight, below it the body is airborne and the ZMP undefined
+  int trailLength = 50;      // frames drawn behind the current one
+};
+
+struct ZMPResult
+{
+  std::vector<glm::vec2> zmp;         // frame, (x, z) on the floor in clip units
+  std::vector<unsigned char> valid;   // frame
+};
+
+// multi body ZMP from the segment masses and COM accelerations, the segments' spin momentum
+// rates are added when momentum is not null
+void computeZMP(const ClipTrajectory& trajectory, const BodyParameters& parameters,
+                const AngularMomentumResult* momentum, const DynamicsSettings& dynamicsSettings,
+                const ZMPSettings& settings, ZMPResult& result);
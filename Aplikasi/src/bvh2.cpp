@@ -1,11 +1,18 @@
 #include "bvh2.h"
 
+#include "Inflate.h"
+#include "MotionEdit.h"
+
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <fstream>
 #include <iostream>
 
+#define SampleBufferBytes (1 << 20)
+
 // trim from start
 static inline std::string &ltrim(std::string &s)
 {
@@ -46,9 +53,9 @@ void deleteJoint(Joint* joint)
   delete joint;
 }
 
-void moveJoint(Joint* joint, Motion* motionData, int frameStartsIndex)
+void moveJoint(Joint* joint, const float* frameData)
 {
-  int startIndex = frameStartsIndex + joint->channelStart;
+  const float* channels = frameData + joint->channelStart;
 
   joint->matrix = glm::translate(glm::mat4(1.0f),
                                  glm::vec3(joint->offset.x,
@@ -58,7 +65,7 @@ void moveJoint(Joint* joint, Motion* motionData, int frameStartsIndex)
   for (unsigned int i = 0; i < joint->numChannels; i++)
   {
     const short& channel = joint->channelsOrder[i];
-    float value = motionData->data[startIndex + i];
+    float value = channels[i];
 
     if (channel & Xposition)
       joint->matrix = glm::translate(joint->matrix, glm::vec3(value, 0, 0));
@@ -78,7 +85,7 @@ void moveJoint(Joint* joint, Motion* motionData, int frameStartsIndex)
     joint->matrix = joint->parent->matrix * joint->matrix;
 
   for (auto& child : joint->children)
-    moveJoint(child, motionData, frameStartsIndex);
+    moveJoint(child, frameData);
 }
 
 Bvh2::Bvh2()
@@ -86,17 +93,12 @@ Bvh2::Bvh2()
   rootJoint(nullptr),
   jointNames()
 {
-  motionData.data = 0;
 }
 
 Bvh2::~Bvh2()
 {
   jointNames.clear();
   deleteJoint(rootJoint);
-  if (motionData.data != nullptr)
-  {
-    delete[] motionData.data;
-  }
 }
 
 void Bvh2::printJoint(const Joint * const joint) const
@@ -117,25 +119,45 @@ void Bvh2::printJoint(const Joint * const joint) const
 
 void Bvh2::load(const std::string & filename)
 {
-  std::fstream file;
-  file.open(filename.c_str(), std::ios_base::in);
-
-  if (file.is_open())
+  // .bvh.gz and zlib streams are inflated on a second thread while the text is parsed
+  if (compressedFile(filename))
   {
-    std::string line;
+    InflateBuffer inflated(filename);
+    std::istream stream(&inflated);
+    load(stream);
+  }
+  else
+  {
+    std::fstream file;
+    file.open(filename.c_str(), std::ios_base::in);
 
-    while (file.good())
+    if (file.is_open())
     {
-      file >> line;
-      if (trim(line) == "HIERARCHY")
-      {
-        loadHierarchy(file);
-      }
-      break;
+      load(file);
+      file.close();
     }
-    file.close();
   }
+  if (rootJoint == nullptr)
+    std::cout << "Failed to load " << filename << std::endl;
+}
+
+void Bvh2::load(std::istream& stream)
+{
+  std::string line;
+
+  while (stream.good())
+  {
+    stream >> line;
+    if (trim(line) == "HIERARCHY")
+    {
+      loadHierarchy(stream);
+    }
+    break;
+  }
+  if (rootJoint == nullptr)
+    return;
   setJointNames(rootJoint);
+  setJoints(rootJoint, -1);
 }
 
 void Bvh2::testOutput() const
@@ -149,8 +171,114 @@ void Bvh2::testOutput() const
 
 void Bvh2::moveTo(unsigned int frame)
 {
-  unsigned int startIndex = frame * motionData.numMotionChannels;
-  moveJoint(rootJoint, &motionData, startIndex);
+  moveJoint(rootJoint, motionFrame(motionData, frame));
+}
+
+void Bvh2::getRotationChannels(std::vector<unsigned char>& rotations) const
+{
+  rotations.assign(motionData.numMotionChannels, 0);
+  for (const Joint* joint : joints)
+  {
+    for (unsigned int i = 0; i < joint->numChannels; i++)
+    {
+      if (joint->channelsOrder[i] & (Xrotation | Yrotation | Zrotation))
+        rotations[joint->channelStart + i] = 1;
+    }
+  }
+}
+
+float* Bvh2::editMotion()
+{
+  // chunks may be shared with copies of the motion, writes get a block of their own
+  if (!motionData.chunks.empty() && !ownsMotion(motionData))
+    ::compactMotion(motionData);
+  if (rawMotion.empty() && motionData.data != nullptr)
+    rawMotion.assign(motionData.data, motionData.data + (size_t)motionData.numFrames * motionData.numMotionChannels);
+  return motionData.data;
+}
+
+void Bvh2::restoreRawMotion()
+{
+  if (rawMotion.empty())
+    return;
+  if (!ownsMotion(motionData))
+    ::compactMotion(motionData);
+  std::copy(rawMotion.begin(), rawMotion.end(), motionData.data);
+}
+
+void Bvh2::replaceMotion(const std::vector<float>& data, unsigned int numFrames, float frameTime)
+{
+  std::shared_ptr<MotionBlock> block = std::make_shared<MotionBlock>();
+  block->samples = data;
+  chunkMotion(motionData, block, numFrames);
+  motionData.frameTime = frameTime;
+  rawMotion.clear();
+}
+
+bool Bvh2::setMotion(const Motion& motion)
+{
+  if (motion.numMotionChannels != motionData.numMotionChannels || motion.numFrames == 0)
+    return false;
+  motionData = motion;
+  rawMotion.clear();
+  return true;
+}
+
+void Bvh2::compactMotion()
+{
+  if (motionData.data == nullptr && !motionData.chunks.empty())
+    ::compactMotion(motionData);
+}
+
+void Bvh2::computePositions(unsigned int frame, glm::vec4* positions, glm::mat4* matrices) const
+{
+  const float* frameData = motionFrame(motionData, frame);
+
+  for (size_t j = 0; j < joints.size(); j++)
+  {
+    const Joint* joint = joints[j];
+    glm::mat4 matrix = glm::translate(glm::mat4(1.0f),
+                                      glm::vec3(joint->offset.x,
+                                      joint->offset.y,
+                                      joint->offset.z));
+
+    for (unsigned int i = 0; i < joint->numChannels; i++)
+    {
+      const short& channel = joint->channelsOrder[i];
+      float value = frameData[joint->channelStart + i];
+
+      if (channel & Xposition)
+        matrix = glm::translate(matrix, glm::vec3(value, 0, 0));
+      if (channel & Yposition)
+        matrix = glm::translate(matrix, glm::vec3(0, value, 0));
+      if (channel & Zposition)
+        matrix = glm::translate(matrix, glm::vec3(0, 0, value));
+      if (channel & Xrotation)
+        matrix = glm::rotate(matrix, glm::radians(value), glm::vec3(1, 0, 0));
+      if (channel & Yrotation)
+        matrix = glm::rotate(matrix, glm::radians(value), glm::vec3(0, 1, 0));
+      if (channel & Zrotation)
+        matrix = glm::rotate(matrix, glm::radians(value), glm::vec3(0, 0, 1));
+    }
+
+    if (jointParents[j] >= 0)
+      matrix = matrices[jointParents[j]] * matrix;
+
+    matrices[j] = matrix;
+    positions[j] = matrix[3];
+  }
+}
+
+void Bvh2::setJoints(const Joint* const joint, int parentIndex)
+{
+  int myIndex = (int)joints.size();
+  joints.push_back(joint);
+  jointParents.push_back(parentIndex);
+
+  for (const Joint* child : joint->children)
+  {
+    setJoints(child, myIndex);
+  }
 }
 
 void Bvh2::setJointNames(const Joint* const joint)
@@ -191,7 +319,6 @@ Joint * Bvh2::loadJoint(std::istream & stream, Joint * parent)
   std::string tmp;
   joint->matrix = glm::mat4(1.0f);
 
-  static int _channelStart = 0;
   unsigned channelOrderIndex = 0;
   while (stream.good())
   {
@@ -223,9 +350,9 @@ Joint * Bvh2::loadJoint(std::istream & stream, Joint * parent)
     {
       stream >> joint->numChannels;
 
+      // channels of the joints loaded so far, so every Bvh2 starts at 0
+      joint->channelStart = motionData.numMotionChannels;
       motionData.numMotionChannels += joint->numChannels;
-      joint->channelStart = _channelStart;
-      _channelStart += joint->numChannels;
       joint->channelsOrder = new short[joint->numChannels];
     }
     else if (tmp == "JOINT")
@@ -261,9 +388,9 @@ Joint * Bvh2::loadJoint(std::istream & stream, Joint * parent)
 void Bvh2::loadHierarchy(std::istream & stream)
 {
   std::string tmp;
-  while (stream.good())
+  // a failed read keeps the last word, which would load the root a second time at the end
+  while (stream >> tmp)
   {
-    stream >> tmp;
     if (trim(tmp) == "ROOT")
       rootJoint = loadJoint(stream);
     else if (trim(tmp) == "MOTION")
@@ -271,6 +398,49 @@ void Bvh2::loadHierarchy(std::istream & stream)
   }
 }
 
+// the frame values straight from the stream buffer a buffer at a time, a stringstream per
+// value made the text parsing the slow part of loading. returns how many were read
+static size_t readSamples(std::istream& stream, float* samples, size_t count)
+{
+  std::streambuf* source = stream.rdbuf();
+  std::vector<char> buffer(SampleBufferBytes + 1);
+  size_t position = 0;
+  size_t end = 0;
+  bool endOfStream = false;
+  size_t read = 0;
+
+  while (read < count)
+  {
+    while (position < end && std::isspace((unsigned char)buffer[position]))
+      position++;
+    // no number is this long, so one that starts in the last bytes may not be whole yet
+    if (end - position < 64 && !endOfStream)
+    {
+      std::memmove(buffer.data(), buffer.data() + position, end - position);
+      end -= position;
+      position = 0;
+      std::streamsize got = source->sgetn(buffer.data() + end, (std::streamsize)(buffer.size() - 1 - end));
+      end += (size_t)got;
+      endOfStream = got == 0;
+      buffer[end] = '\0';
+      continue;
+    }
+    if (position == end)
+      break;
+
+    char* text = buffer.data() + position;
+    char* next = nullptr;
+    float value = strtof(text, &next);
+    if (next == text)
+      break;
+    samples[read++] = value;
+    position = (size_t)(next - buffer.data());
+  }
+  if (endOfStream)
+    stream.setstate(std::ios::eofbit);
+  return read;
+}
+
 void Bvh2::loadMotion(std::istream & stream)
 {
   std::string tmp;
@@ -284,28 +454,23 @@ void Bvh2::loadMotion(std::istream & stream)
     }
     else if (trim(tmp) == "Frame")
     {
-      float frameTime;
-      stream >> tmp >> frameTime;
+      stream >> tmp >> motionData.frameTime;
 
       int numFrames = motionData.numFrames;
       int numChannels = motionData.numMotionChannels;
 
-      motionData.data = new float[numFrames * numChannels];
+      std::shared_ptr<MotionBlock> block = std::make_shared<MotionBlock>();
+      block->samples.resize((size_t)numFrames * numChannels);
 
-      for (int frame = 0; frame < numFrames; frame++)
+      size_t read = readSamples(stream, block->samples.data(), block->samples.size());
+      if (read < block->samples.size())
       {
-        for (int channel = 0; channel < numChannels; channel++)
-        {
-          float x;
-          std::stringstream ss;
-          stream >> tmp;
-          ss << tmp;
-          ss >> x;
-
-          int index = frame * numChannels + channel;
-          motionData.data[index] = x;
-        }
+        // only the whole frames that were read are kept
+        std::cout << "Motion ends after " << read / numChannels << " of " << numFrames << " frames" << std::endl;
+        numFrames = (int)(read / numChannels);
+        block->samples.resize((size_t)numFrames * numChannels);
       }
+      chunkMotion(motionData, block, numFrames);
     }
   }
 }
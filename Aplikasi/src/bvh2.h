@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -37,14 +39,50 @@ struct Hierarchy
   int numChanneles;
 };
 
+// frames per chunk of a freshly loaded or compacted Motion
+#define MotionChunkFrames 256
+
+// frame major samples, shared by every chunk cut from them
+struct MotionBlock
+{
+  std::vector<float> samples;
+};
+
+// frames [first, first + numFrames) of block
+struct MotionChunk
+{
+  std::shared_ptr<MotionBlock> block;
+  unsigned int first = 0;
+  unsigned int numFrames = 0;
+};
+
+// frames are a rope of reference counted chunks, copies of a Motion share them and edits
+// (MotionEdit.h) only cut the chunks they touch
 struct Motion
 {
-  unsigned int numFrames;
+  unsigned int numFrames = 0;
   unsigned int numMotionChannels = 0;
+  float frameTime = 0.0f;
+  // every frame in one run, nullptr before loading and while edits leave the chunks
+  // spread over several blocks, read through motionFrame or copyMotionFrames then
   float* data = nullptr;
   unsigned int* jointChannelsOffsets;
+
+  std::vector<MotionChunk> chunks;
+  std::vector<unsigned int> chunkStart; // first frame of each chunk, numFrames at the end
 };
 
+// samples of one frame, straight from data when the frames are in one run
+inline const float* motionFrame(const Motion& motion, unsigned int frame)
+{
+  if (motion.data != nullptr)
+    return motion.data + (size_t)frame * motion.numMotionChannels;
+
+  size_t chunk = std::upper_bound(motion.chunkStart.begin(), motion.chunkStart.end(), frame) - motion.chunkStart.begin() - 1;
+  const MotionChunk& c = motion.chunks[chunk];
+  return c.block->samples.data() + (size_t)(c.first + frame - motion.chunkStart[chunk]) * motion.numMotionChannels;
+}
+
 class Bvh2
 {
 public:
@@ -53,22 +91,54 @@ public:
 
   void printJoint(const Joint* const joint) const;
   void load(const std::string& filename);
+  // the whole file from HIERARCHY on, a stream holding only the hierarchy gives no frames
+  void load(std::istream& stream);
   void testOutput() const;
   void moveTo(unsigned int frame);
 
+  // thread safe forward kinematics, doesn't touch Joint::matrix.
+  // positions and matrices must hold getNumJoints() elements, indexed like processBvh
+  void computePositions(unsigned int frame, glm::vec4* positions, glm::mat4* matrices) const;
+
   const Joint* getRootJoint() const { return rootJoint; }
   unsigned int getNumFrames() const { return motionData.numFrames - 1; }
   std::vector<std::string> getJointNames() { return jointNames; };
+  const Motion& getMotion() const { return motionData; }
+  float getFrameTime() const { return motionData.frameTime; }
+  unsigned int getNumJoints() const { return (unsigned int)joints.size(); }
+  const std::vector<const Joint*>& getJoints() const { return joints; }
+  const std::vector<int>& getJointParents() const { return jointParents; }
+
+  // 1 for the rotation channels of Motion::data, they're in degrees and can wrap
+  void getRotationChannels(std::vector<unsigned char>& rotations) const;
+
+  // motion data to be edited in place, the first call keeps a copy of the loaded data
+  float* editMotion();
+  void restoreRawMotion();
+  bool hasRawMotion() const { return !rawMotion.empty(); }
+
+  // takes numFrames * numMotionChannels samples as the new loaded data, drops the raw copy
+  void replaceMotion(const std::vector<float>& data, unsigned int numFrames, float frameTime);
+
+  // takes an edited copy of the motion, sharing its chunks. false when the channels don't match
+  bool setMotion(const Motion& motion);
+  void compactMotion();
 
 private:
   Joint* loadJoint(std::istream& stream, Joint* parent = nullptr);
   void loadHierarchy(std::istream& stream);
   void loadMotion(std::istream& stream);
   void setJointNames(const Joint* const joint);
+  void setJoints(const Joint* const joint, int parentIndex);
 
 private:
   Joint* rootJoint;
   Motion motionData;
+  std::vector<float> rawMotion;
 
   std::vector<std::string> jointNames;
+
+  // joints flattened in depth first order, parents always come before children
+  std::vector<const Joint*> joints;
+  std::vector<int> jointParents;
 };
@@ -10,10 +10,41 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
 
 #include "Shader.h"
 #include "bvh2.h"
+#include "Aggregation.h"
+#include "AnthropometricModels.h"
+#include "BodyModel.h"
+#include "C3D.h"
+#include "ClipCatalog.h"
+#include "COMSweep.h"
+#include "Dynamics.h"
+#include "FloorIndex.h"
+#include "FrameSimilarity.h"
+#include "Gait.h"
+#include "JointAngles.h"
+#include "MotionEdit.h"
+#include "MotionQuery.h"
+#include "MotionStream.h"
+#include "PoseClusters.h"
+#include "PoseIndex.h"
+#include "PoseShare.h"
+#include "Resample.h"
+#include "SegmentGeometry.h"
+#include "SignalFilter.h"
+#include "Stability.h"
+#include "Sway.h"
+#include "TimeWarp.h"
+#include "Timer.h"
+#include "ZMP.h"
 
 // GLFW callbacks declarations
 void frameBufferSizeCallback(GLFWwindow* window, int width, int height);
@@ -31,6 +62,8 @@ bool renderBones = true;
 bool renderJoints = true;
 bool renderSegmentCOM = false;
 bool renderBodyCOM = true;
+bool renderSupportPolygon = true;
+bool renderZMP = true;
 
 // camera settings
 glm::vec3 cameraPos = glm::vec3(100.0f, 70.0f, 300.0f);
@@ -49,11 +82,16 @@ float boneColor[3] = { 0.5f, 0.25f, 0.25f };
 float jointColor[3] = { 1.0f, 0.5f, 0.5f };
 float segmentComColor[3] = { 1.0f, 1.0f, 0.0f };
 float comColor[3] = { 0.0f, 1.0f, 0.0f };
+float supportColor[3] = { 0.0f, 0.6f, 1.0f };
+float zmpColor[3] = { 1.0f, 0.3f, 0.8f };
 
 // COM properties
 int selectedGender = 0;
+int selectedModel = ZatsiorskyDeLevaModel;
 float totalBodyWeight = 60.0f;
 
+// values of the Custom model, editable in COM Properties
+
 float headNeckMassPercent[2] = { 6.94f, 6.68f };
 float trunkMassPercent[2] = { 43.46f, 42.58f };
 float upperArmMassPercent[2] = { 2.71f, 2.55f };
@@ -90,6 +128,101 @@ std::vector<glm::vec4> comVertices;
 unsigned int segmentsCogVBO, segmentsCogVAO;
 std::vector<glm::vec4> segmentsCogVertices;
 
+// whole clip analysis
+ClipTrajectory clipTrajectory;
+BodyParameters clipBodyParameters = {};
+StabilitySettings stabilitySettings;
+StabilityResult stability;
+bool stabilityChanged = true;
+DynamicsTopology dynamicsTopology;
+DynamicsSettings dynamicsSettings;
+DynamicsResult dynamics;
+SegmentGeometry segmentGeometry;
+AngularMomentumResult angularMomentum;
+ZMPSettings zmpSettings;
+ZMPResult zmp;
+SwaySettings swaySettings;
+SwayResult sway;
+bool swayChanged = true;
+FilterSettings filterSettings;
+bool filterMotion = false;
+bool filterCOM = false;
+bool filterChanged = false;
+ResampleSettings resampleSettings;
+SweepSettings sweepSettings;
+SweepResult comSweep;
+double comSweepTime = 0.0;
+GaitSettings gaitSettings;
+GaitEvents gaitEvents;
+GaitCycles gaitCycles[2];
+bool gaitChanged = true;
+JointAngleSettings jointAngleSettings;
+JointAngleResult jointAngles;
+bool jointAnglesChanged = true;
+QueryTable queryTable;
+std::vector<FrameRange> queryRanges;
+std::string queryError;
+char queryText[256] = "LeftLeg.rx > 30 and com.y < 80";
+std::string clipPath = "data/example2.bvh";
+PoseIndex poseIndex;
+std::vector<PoseMatch> poseMatches;
+double poseSearchTime = 0.0;
+SimilaritySettings similaritySettings;
+SimilarityResult similarity;
+double similarityTime = 0.0;
+Bvh2* warpBvh = nullptr;
+ClipTrajectory warpTrajectory;
+WarpSettings warpSettings;
+WarpResult warp;
+bool renderWarpClip = true;
+float warpOffset = 100.0f;
+float warpColor[3] = { 0.25f, 0.5f, 1.0f };
+unsigned int warpVBO, warpVAO;
+std::vector<glm::vec4> warpVertices;
+ClusterSettings clusterSettings;
+PoseClusters poseClusters;
+int poseClusterClip = -1; // clip of poseClusters that is loaded, -1 when none
+int selectedCluster = 0;
+bool renderCluster = true;
+unsigned int clusterVBO, clusterVAO;
+std::vector<glm::vec4> clusterVertices;
+FloorIndex floorIndex;
+std::vector<FloorPoint> floorHits;
+std::vector<FloorClipRange> floorRanges;
+int floorIndexClip = -1; // clip of floorIndex that is loaded, -1 when none
+unsigned int floorKinds = FloorRootMask | FloorCOMMask;
+bool floorSelecting = false;
+glm::vec2 floorSelectionStart(0.0f), floorSelectionEnd(0.0f);
+float floorSelectionColor[3] = { 1.0f, 0.8f, 0.2f };
+unsigned int floorSelectionVBO, floorSelectionVAO;
+std::vector<glm::vec4> floorSelectionVertices;
+ClipCatalog clipCatalog;
+CatalogIndexer catalogIndexer;
+CatalogFilter catalogFilter;
+std::vector<unsigned int> catalogClips; // filtered and sorted rows of clipCatalog
+int catalogSort = CatalogSortPath;
+bool catalogDescending = false;
+int selectedCatalogClip = -1;
+C3DFile markerTrial;
+MarkerSettings markerSettings;
+ClipTrajectory markerTrajectory;     // joints and COM of markerTrial, empty when none is loaded
+BodyParameters markerBodyParameters = {};
+bool markerTrialChanged = false;
+bool useMarkerTrial = false;         // COM from the marker trial instead of the clip
+bool renderMarkers = true;
+float markerColor[3] = { 0.3f, 0.9f, 1.0f };
+float markerTime = 0.0f;
+unsigned int markerFrame = 0;
+unsigned int markersVBO, markersVAO;
+std::vector<glm::vec4> markerVertices;
+PoseShare poseShare;                 // open while poses are published to other processes
+
+unsigned int supportVBO, supportVAO;
+std::vector<glm::vec4> supportVertices;
+
+unsigned int zmpVBO, zmpVAO;
+std::vector<glm::vec4> zmpVertices;
+
 /*################################################################################################################################################*/
 
 void processBvh(Joint* joint, std::vector<glm::vec4>& vertices,
@@ -109,111 +242,15 @@ void processBvh(Joint* joint, std::vector<glm::vec4>& vertices,
   }
 }
 
-glm::vec4 myLerp(glm::vec4 x, glm::vec4 y, float t) {
-  return x * (1.f - t / 100.0f) + y * (t / 100.0f);
-}
-
-void processCOM(const std::vector<glm::vec4>& bvhVertices, std::vector<glm::vec4>& comVertices)
+// segment and body COM of the frame, taken from the whole clip or marker trial bake
+void processCOM(const ClipTrajectory& trajectory, unsigned int frame, std::vector<glm::vec4>& comVertices)
 {
   comVertices.clear();
   segmentsCogVertices.clear();
 
-  glm::vec4 headNeck = myLerp(bvhVertices[3], bvhVertices[5], headNeckLengthPercent[selectedGender]);
-  glm::vec4 trunk = myLerp(bvhVertices[0], bvhVertices[2], trunkLengthPercent[selectedGender]);
-  glm::vec4 leftUpperArm = myLerp(bvhVertices[6], bvhVertices[8], upperArmLengthPercent[selectedGender]);
-  glm::vec4 rightUpperArm = myLerp(bvhVertices[11], bvhVertices[13], upperArmLengthPercent[selectedGender]);
-  glm::vec4 leftForeArm = myLerp(bvhVertices[8], bvhVertices[9], foreArmLengthPercent[selectedGender]);
-  glm::vec4 rightForeArm = myLerp(bvhVertices[13], bvhVertices[14], foreArmLengthPercent[selectedGender]);
-
-  // TODO:(denilson) WRIST JOINT to MCP3(the middle finger base joint!), make some interpolation
-  glm::vec4 leftHand = myLerp(bvhVertices[9], bvhVertices[10], handLengthPercent[selectedGender]);
-  glm::vec4 rightHand = myLerp(bvhVertices[14], bvhVertices[15], handLengthPercent[selectedGender]);
-  glm::vec4 leftThigh = myLerp(bvhVertices[16], bvhVertices[17], thighLengthPercent[selectedGender]);
-  glm::vec4 rightThigh = myLerp(bvhVertices[21], bvhVertices[22], thighLengthPercent[selectedGender]);
-  glm::vec4 leftShank = myLerp(bvhVertices[17], bvhVertices[18], shankLengthPercent[selectedGender]);
-  glm::vec4 rightShank = myLerp(bvhVertices[22], bvhVertices[23], shankLengthPercent[selectedGender]);
-  glm::vec4 leftFoot = myLerp(bvhVertices[18], bvhVertices[20], footLengthPercent[selectedGender]);
-  glm::vec4 rightFoot = myLerp(bvhVertices[23], bvhVertices[25], footLengthPercent[selectedGender]);
-
-  // body COM
-  float headNeckMass = (headNeckMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float trunkMass = (trunkMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float upperArmMass = (upperArmMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float foreArmMass = (foreArmMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float handMass = (handMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float thighMass = (thighMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float shankMass = (shankMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-  float footMass = (footMassPercent[selectedGender] / 100.0f) * totalBodyWeight;
-
-  float bodyCOMX = (
-    (headNeck.x * headNeckMass) +
-    (trunk.x * trunkMass) +
-    (leftUpperArm.x * upperArmMass) +
-    (rightUpperArm.x * upperArmMass) +
-    (leftForeArm.x * foreArmMass) +
-    (rightForeArm.x * foreArmMass) +
-    (leftHand.x * handMass) +
-    (rightHand.x * handMass) +
-    (leftThigh.x * thighMass) +
-    (rightThigh.x * thighMass) +
-    (leftShank.x * shankMass) +
-    (rightShank.x * shankMass) +
-    (leftFoot.x * footMass) +
-    (rightFoot.x * footMass)
-    ) / totalBodyWeight;
-
-  float bodyCOMY = (
-    (headNeck.y * headNeckMass) +
-    (trunk.y * trunkMass) +
-    (leftUpperArm.y * upperArmMass) +
-    (rightUpperArm.y * upperArmMass) +
-    (leftForeArm.y * foreArmMass) +
-    (rightForeArm.y * foreArmMass) +
-    (leftHand.y * handMass) +
-    (rightHand.y * handMass) +
-    (leftThigh.y * thighMass) +
-    (rightThigh.y * thighMass) +
-    (leftShank.y * shankMass) +
-    (rightShank.y * shankMass) +
-    (leftFoot.y * footMass) +
-    (rightFoot.y * footMass)
-    ) / totalBodyWeight;
-
-  float bodyCOMZ = (
-    (headNeck.z * headNeckMass) +
-    (trunk.z * trunkMass) +
-    (leftUpperArm.z * upperArmMass) +
-    (rightUpperArm.z * upperArmMass) +
-    (leftForeArm.z * foreArmMass) +
-    (rightForeArm.z * foreArmMass) +
-    (leftHand.z * handMass) +
-    (rightHand.z * handMass) +
-    (leftThigh.z * thighMass) +
-    (rightThigh.z * thighMass) +
-    (leftShank.z * shankMass) +
-    (rightShank.z * shankMass) +
-    (leftFoot.z * footMass) +
-    (rightFoot.z * footMass)
-    ) / totalBodyWeight;
-
-  glm::vec4 bodyCOM = glm::vec4(bodyCOMX, bodyCOMY, bodyCOMZ, 1.0f);
-
-  // push
-  segmentsCogVertices.push_back(headNeck);
-  segmentsCogVertices.push_back(trunk);
-  segmentsCogVertices.push_back(leftUpperArm);
-  segmentsCogVertices.push_back(rightUpperArm);
-  segmentsCogVertices.push_back(leftForeArm);
-  segmentsCogVertices.push_back(rightForeArm);
-  segmentsCogVertices.push_back(leftHand);
-  segmentsCogVertices.push_back(rightHand);
-  segmentsCogVertices.push_back(leftThigh);
-  segmentsCogVertices.push_back(rightThigh);
-  segmentsCogVertices.push_back(leftShank);
-  segmentsCogVertices.push_back(rightShank);
-  segmentsCogVertices.push_back(leftFoot);
-  segmentsCogVertices.push_back(rightFoot);
-
+  const glm::vec4* segments = &trajectory.segmentsCOM[(size_t)frame * NumSegments];
+  segmentsCogVertices.assign(segments, segments + NumSegments);
+  glm::vec4 bodyCOM = trajectory.bodyCOM[frame];
 
   glBindVertexArray(segmentsCogVAO);
   glBindBuffer(GL_ARRAY_BUFFER, segmentsCogVBO);
@@ -230,6 +267,423 @@ void processCOM(const std::vector<glm::vec4>& bvhVertices, std::vector<glm::vec4
   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
 }
 
+BodyParameters currentBodyParameters()
+{
+  if (selectedModel != CustomModel)
+    return modelParameters((AnthropometricModel)selectedModel, selectedGender, totalBodyWeight);
+
+  BodyParameters parameters;
+  parameters.totalBodyWeight = totalBodyWeight;
+
+  parameters.massPercent[HeadNeck] = headNeckMassPercent[selectedGender];
+  parameters.massPercent[Trunk] = trunkMassPercent[selectedGender];
+  parameters.massPercent[LeftUpperArm] = upperArmMassPercent[selectedGender];
+  parameters.massPercent[RightUpperArm] = upperArmMassPercent[selectedGender];
+  parameters.massPercent[LeftForeArm] = foreArmMassPercent[selectedGender];
+  parameters.massPercent[RightForeArm] = foreArmMassPercent[selectedGender];
+  parameters.massPercent[LeftHand] = handMassPercent[selectedGender];
+  parameters.massPercent[RightHand] = handMassPercent[selectedGender];
+  parameters.massPercent[LeftThigh] = thighMassPercent[selectedGender];
+  parameters.massPercent[RightThigh] = thighMassPercent[selectedGender];
+  parameters.massPercent[LeftShank] = shankMassPercent[selectedGender];
+  parameters.massPercent[RightShank] = shankMassPercent[selectedGender];
+  parameters.massPercent[LeftFoot] = footMassPercent[selectedGender];
+  parameters.massPercent[RightFoot] = footMassPercent[selectedGender];
+
+  parameters.lengthPercent[HeadNeck] = headNeckLengthPercent[selectedGender];
+  parameters.lengthPercent[Trunk] = trunkLengthPercent[selectedGender];
+  parameters.lengthPercent[LeftUpperArm] = upperArmLengthPercent[selectedGender];
+  parameters.lengthPercent[RightUpperArm] = upperArmLengthPercent[selectedGender];
+  parameters.lengthPercent[LeftForeArm] = foreArmLengthPercent[selectedGender];
+  parameters.lengthPercent[RightForeArm] = foreArmLengthPercent[selectedGender];
+  parameters.lengthPercent[LeftHand] = handLengthPercent[selectedGender];
+  parameters.lengthPercent[RightHand] = handLengthPercent[selectedGender];
+  parameters.lengthPercent[LeftThigh] = thighLengthPercent[selectedGender];
+  parameters.lengthPercent[RightThigh] = thighLengthPercent[selectedGender];
+  parameters.lengthPercent[LeftShank] = shankLengthPercent[selectedGender];
+  parameters.lengthPercent[RightShank] = shankLengthPercent[selectedGender];
+  parameters.lengthPercent[LeftFoot] = footLengthPercent[selectedGender];
+  parameters.lengthPercent[RightFoot] = footLengthPercent[selectedGender];
+
+  return parameters;
+}
+
+// re-runs the whole clip passes when the COM properties or the analysis settings were edited
+void updateClipAnalysis()
+{
+  // filtered or raw motion, everything downstream is baked again
+  bool motionChanged = filterChanged;
+  if (filterChanged)
+  {
+    if (filterMotion)
+      conditionMotion(*bvh, filterSettings);
+    else
+      bvh->restoreRawMotion();
+    bakeJoints(*bvh, clipTrajectory);
+    jointAnglesChanged = true;
+    filterChanged = false;
+  }
+
+  BodyParameters parameters = currentBodyParameters();
+  if (motionChanged || memcmp(&parameters, &clipBodyParameters, sizeof(BodyParameters)) != 0)
+  {
+    clipBodyParameters = parameters;
+    if (selectedModel == CustomModel)
+      bakeCOM(clipBodyParameters, clipTrajectory);
+    else
+      bakeModelCOM((AnthropometricModel)selectedModel, selectedGender, clipTrajectory);
+    if (filterCOM)
+      conditionCOM(clipTrajectory, filterSettings);
+    stabilityChanged = true;
+    gaitChanged = true;
+    swayChanged = true;
+  }
+
+  if (swayChanged)
+  {
+    computeSway(clipTrajectory, swaySettings, sway);
+    swayChanged = false;
+  }
+
+  if (jointAnglesChanged)
+  {
+    computeJointAngles(clipTrajectory, bvh->getJointParents(), jointAngleSettings, jointAngles);
+    jointAnglesChanged = false;
+  }
+
+  if (gaitChanged)
+  {
+    detectGaitEvents(clipTrajectory, gaitSettings, gaitEvents);
+    for (int foot = 0; foot < 2; foot++)
+    {
+      gaitCycles[foot] = GaitCycles();
+      accumulateGaitCycles(clipTrajectory, gaitEvents, gaitSettings, foot, gaitCycles[foot]);
+      gaitCycles[foot].finish();
+    }
+    gaitChanged = false;
+  }
+
+  if (stabilityChanged)
+  {
+    computeStability(clipTrajectory, stabilitySettings, stability);
+    computeDynamics(clipTrajectory, clipBodyParameters, stability, dynamicsTopology, dynamicsSettings, dynamics);
+    computeAngularMomentum(clipTrajectory, clipBodyParameters, segmentGeometry, dynamicsSettings.lengthUnit, angularMomentum);
+    computeZMP(clipTrajectory, clipBodyParameters, &angularMomentum, dynamicsSettings, zmpSettings, zmp);
+    stabilityChanged = false;
+  }
+}
+
+void processSupportPolygon()
+{
+  supportVertices.clear();
+
+  // polygon as a line loop slightly above the floor, the COM it was measured against last
+  const SupportPolygon& polygon = stability.supportPolygons[bvhFrame];
+  for (int i = 0; i < polygon.numPoints; i++)
+    supportVertices.push_back(glm::vec4(polygon.points[i].x, 0.1f, polygon.points[i].y, 1.0f));
+  supportVertices.push_back(glm::vec4(stability.com[bvhFrame].x, 0.1f, stability.com[bvhFrame].y, 1.0f));
+
+  glBindVertexArray(supportVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, supportVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(supportVertices[0]) * supportVertices.size(), &supportVertices[0], GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+// ZMP of the recent frames as a trail on the floor, airborne frames are left out
+void processZMP()
+{
+  zmpVertices.clear();
+
+  int first = bvhFrame - zmpSettings.trailLength;
+  for (int frame = first < 0 ? 0 : first; frame <= bvhFrame; frame++)
+  {
+    if (zmp.valid[frame])
+      zmpVertices.push_back(glm::vec4(zmp.zmp[frame].x, zmpSettings.floorHeight + 0.1f, zmp.zmp[frame].y, 1.0f));
+  }
+  if (zmpVertices.empty())
+    return;
+
+  glBindVertexArray(zmpVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, zmpVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(zmpVertices[0]) * zmpVertices.size(), &zmpVertices[0], GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+// bones of the aligned clip at the frame the warping path pairs with the current one
+void processWarpClip()
+{
+  warpVertices.clear();
+  if (warpBvh == nullptr || warp.aToB.empty() || (unsigned int)bvhFrame >= warp.aToB.size())
+    return;
+
+  unsigned int frame = warp.aToB[bvhFrame];
+  const std::vector<int>& parents = warpBvh->getJointParents();
+  const glm::vec4* pose = &warpTrajectory.joints[(size_t)frame * warpTrajectory.numJoints];
+  glm::vec4 offset(warpOffset, 0.0f, 0.0f, 0.0f);
+  for (unsigned int j = 0; j < warpTrajectory.numJoints; j++)
+  {
+    if (parents[j] < 0)
+      continue;
+    warpVertices.push_back(pose[parents[j]] + offset);
+    warpVertices.push_back(pose[j] + offset);
+  }
+
+  glBindVertexArray(warpVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, warpVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(warpVertices[0]) * warpVertices.size(), &warpVertices[0], GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+ImU32 clusterColor(int cluster)
+{
+  return ImColor::HSV(cluster * 0.618034f - (int)(cluster * 0.618034f), 0.7f, 0.9f);
+}
+
+// representative pose of the selected cluster next to the skeleton, turned to face +z
+void processCluster()
+{
+  clusterVertices.clear();
+  if (selectedCluster >= (int)poseClusters.numClusters || clipTrajectory.numFrames == 0)
+    return;
+
+  const std::vector<int>& parents = bvh->getJointParents();
+  if (parents.size() != poseClusters.numJoints)
+    return;
+
+  const glm::vec4* pose = &poseClusters.representativePoses[(size_t)selectedCluster * poseClusters.numJoints];
+  glm::vec4 hips = clipTrajectory.joints[(size_t)bvhFrame * clipTrajectory.numJoints];
+  glm::vec4 offset(hips.x - 100.0f, 0.0f, hips.z, 0.0f);
+  for (unsigned int j = 0; j < poseClusters.numJoints; j++)
+  {
+    if (parents[j] < 0)
+      continue;
+    clusterVertices.push_back(pose[parents[j]] + offset);
+    clusterVertices.push_back(pose[j] + offset);
+  }
+
+  glBindVertexArray(clusterVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, clusterVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(clusterVertices[0]) * clusterVertices.size(), &clusterVertices[0], GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+// where the ray under the cursor meets the floor, false when it points away from it
+bool cursorOnFloor(GLFWwindow* window, const glm::mat4& view, const glm::mat4& projection, glm::vec2& point)
+{
+  double x, y;
+  glfwGetCursorPos(window, &x, &y);
+  glm::vec4 viewport(0.0f, 0.0f, (float)screenWidth, (float)screenHeight);
+  glm::vec3 cursor((float)x, screenHeight - (float)y, 0.0f);
+  glm::vec3 nearPoint = glm::unProject(cursor, view, projection, viewport);
+  cursor.z = 1.0f;
+  glm::vec3 farPoint = glm::unProject(cursor, view, projection, viewport);
+
+  glm::vec3 direction = farPoint - nearPoint;
+  if (std::abs(direction.y) < 1e-6f)
+    return false;
+  float t = -nearPoint.y / direction.y;
+  if (t < 0.0f)
+    return false;
+  point = glm::vec2(nearPoint.x + direction.x * t, nearPoint.z + direction.z * t);
+  return true;
+}
+
+// ctrl + left drag on the floor selects a rectangle, the index is queried while dragging
+void processFloorSelection(GLFWwindow* window, const glm::mat4& view, const glm::mat4& projection)
+{
+  bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS &&
+                 glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS;
+  glm::vec2 point;
+  if (pressed && !ImGui::GetIO().WantCaptureMouse && cursorOnFloor(window, view, projection, point))
+  {
+    if (!floorSelecting)
+      floorSelectionStart = point;
+    floorSelectionEnd = point;
+    floorSelecting = true;
+
+    glm::vec2 lower = glm::min(floorSelectionStart, floorSelectionEnd);
+    glm::vec2 upper = glm::max(floorSelectionStart, floorSelectionEnd);
+    queryFloorRange(floorIndex, lower.x, lower.y, upper.x, upper.y, floorKinds, floorHits);
+    floorHitRanges(floorHits, floorRanges);
+  }
+  else if (!pressed)
+  {
+    floorSelecting = false;
+  }
+
+  floorSelectionVertices.clear();
+  if (floorSelectionStart == floorSelectionEnd)
+    return;
+  floorSelectionVertices.push_back(glm::vec4(floorSelectionStart.x, 0.2f, floorSelectionStart.y, 1.0f));
+  floorSelectionVertices.push_back(glm::vec4(floorSelectionEnd.x, 0.2f, floorSelectionStart.y, 1.0f));
+  floorSelectionVertices.push_back(glm::vec4(floorSelectionEnd.x, 0.2f, floorSelectionEnd.y, 1.0f));
+  floorSelectionVertices.push_back(glm::vec4(floorSelectionStart.x, 0.2f, floorSelectionEnd.y, 1.0f));
+
+  glBindVertexArray(floorSelectionVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, floorSelectionVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(floorSelectionVertices[0]) * floorSelectionVertices.size(), &floorSelectionVertices[0], GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+// opens a C3D trial and turns its markers into body model joints, mapFile empty for Plug-in Gait
+bool loadMarkerTrial(const std::string& filename, const std::string& mapFile)
+{
+  markerTrajectory = ClipTrajectory();
+  markerTime = 0.0f;
+  markerFrame = 0;
+  MarkerJointMap map;
+  if (mapFile.empty())
+    defaultMarkerJointMap(map);
+  else if (!readMarkerJointMap(mapFile, map))
+    return false;
+  if (!openC3D(filename, markerTrial) || !bakeMarkerJoints(markerTrial, map, markerSettings, markerTrajectory))
+  {
+    markerTrajectory = ClipTrajectory();
+    useMarkerTrial = false;
+    return false;
+  }
+  markerTrialChanged = true;
+  return true;
+}
+
+// markers of the trial frame that follows the player clock, the trial COM is baked again when the
+// body model changed
+void processMarkers()
+{
+  markerVertices.clear();
+  if (markerTrajectory.numFrames == 0)
+    return;
+
+  BodyParameters parameters = currentBodyParameters();
+  if (markerTrialChanged || memcmp(&parameters, &markerBodyParameters, sizeof(BodyParameters)) != 0)
+  {
+    markerBodyParameters = parameters;
+    if (selectedModel == CustomModel)
+      bakeCOM(markerBodyParameters, markerTrajectory);
+    else
+      bakeModelCOM((AnthropometricModel)selectedModel, selectedGender, markerTrajectory);
+    markerTrialChanged = false;
+  }
+
+  if (frameChange)
+    markerTime += deltaTime;
+  if (markerTrajectory.frameTime > 0.0f)
+    markerFrame = (unsigned int)(markerTime / markerTrajectory.frameTime) % markerTrajectory.numFrames;
+
+  for (unsigned int point = 0; point < markerTrial.points.numPoints; point++)
+  {
+    glm::vec4 marker = c3dPoint(markerTrial.points, markerFrame, point);
+    if (marker.w >= 0.0f)
+      markerVertices.push_back(glm::vec4(c3dScenePoint(markerTrial, markerSettings, glm::vec3(marker)), 1.0f));
+  }
+  if (markerVertices.empty())
+    return;
+
+  glBindVertexArray(markersVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, markersVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(markerVertices[0]) * markerVertices.size(), &markerVertices[0], GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+// front view of a catalog thumbnail pose, scaled to fit
+void drawCatalogThumbnail(unsigned int clip, float width, float height)
+{
+  ImVec2 origin = ImGui::GetCursorScreenPos();
+  ImGui::InvisibleButton("##thumbnail", ImVec2(width, height));
+  ImDrawList* drawList = ImGui::GetWindowDrawList();
+  drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), IM_COL32(20, 20, 20, 255));
+
+  const glm::vec3* pose = &clipCatalog.thumbnails[clip * CatalogThumbnailJoints];
+  const signed char* parents = &clipCatalog.thumbnailParents[clip * CatalogThumbnailJoints];
+  unsigned int numJoints = clipCatalog.numJoints[clip] < CatalogThumbnailJoints ? clipCatalog.numJoints[clip] : CatalogThumbnailJoints;
+  glm::vec2 lower(1e9f), upper(-1e9f);
+  for (unsigned int j = 0; j < numJoints; j++)
+  {
+    lower = glm::min(lower, glm::vec2(pose[j].x, pose[j].y));
+    upper = glm::max(upper, glm::vec2(pose[j].x, pose[j].y));
+  }
+  float extent = upper.x - lower.x > upper.y - lower.y ? upper.x - lower.x : upper.y - lower.y;
+  if (numJoints == 0 || extent <= 0.0f)
+    return;
+
+  float scale = 0.9f * (width < height ? width : height) / extent;
+  glm::vec2 center = (lower + upper) * 0.5f;
+  for (unsigned int j = 1; j < numJoints; j++)
+  {
+    if (parents[j] < 0)
+      continue;
+    const glm::vec3& a = pose[parents[j]];
+    const glm::vec3& b = pose[j];
+    drawList->AddLine(ImVec2(origin.x + width * 0.5f + (a.x - center.x) * scale, origin.y + height * 0.5f - (a.y - center.y) * scale),
+                      ImVec2(origin.x + width * 0.5f + (b.x - center.x) * scale, origin.y + height * 0.5f - (b.y - center.y) * scale),
+                      IM_COL32(230, 230, 230, 255), 1.5f);
+  }
+}
+
+void refreshCatalogClips()
+{
+  filterCatalog(clipCatalog, catalogFilter, catalogClips);
+  sortCatalog(clipCatalog, catalogSort, catalogDescending, catalogClips);
+  selectedCatalogClip = -1;
+}
+
+// mean and its band drawn over each other on one scale, stride in bytes between samples
+void plotBand(const char* label, const float* mean, const float* lower, const float* upper, int count, int stride)
+{
+  float scaleMin = FLT_MAX, scaleMax = -FLT_MAX;
+  for (int i = 0; i < count; i++)
+  {
+    float low = *(const float*)((const char*)lower + (size_t)i * stride);
+    float high = *(const float*)((const char*)upper + (size_t)i * stride);
+    if (low < scaleMin)
+      scaleMin = low;
+    if (high > scaleMax)
+      scaleMax = high;
+  }
+
+  ImVec2 position = ImGui::GetCursorPos();
+  ImGui::PlotLines(label, mean, count, 0, "", scaleMin, scaleMax, ImVec2(0, 100), stride);
+  ImVec2 next = ImGui::GetCursorPos();
+
+  ImGui::PushID(label);
+  ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.0f, 0.0f, 0.0f, 0.0f));
+  ImGui::PushStyleColor(ImGuiCol_PlotLines, ImVec4(1.0f, 0.6f, 0.0f, 0.6f));
+  ImGui::SetCursorPos(position);
+  ImGui::PlotLines("##lower", lower, count, 0, "", scaleMin, scaleMax, ImVec2(ImGui::CalcItemWidth(), 100), stride);
+  ImGui::SetCursorPos(position);
+  ImGui::PlotLines("##upper", upper, count, 0, "", scaleMin, scaleMax, ImVec2(ImGui::CalcItemWidth(), 100), stride);
+  ImGui::PopStyleColor(2);
+  ImGui::PopID();
+
+  ImGui::SetCursorPos(next);
+}
+
+void plotBand(const char* label, const SweepResult& sweep, int axis, int count)
+{
+  plotBand(label, &sweep.mean[0][axis], &sweep.lower[0][axis], &sweep.upper[0][axis], count, sizeof(glm::vec3));
+}
+
+// mean +- one SD of a channel over the normalized gait cycle
+void plotGaitChannel(const char* label, const GaitCycles& cycles, unsigned int channel)
+{
+  static std::vector<float> lower, upper;
+  lower.resize(GaitSamples);
+  upper.resize(GaitSamples);
+  for (int s = 0; s < GaitSamples; s++)
+  {
+    size_t i = (size_t)s * cycles.numChannels + channel;
+    lower[s] = cycles.mean[i] - cycles.standardDeviation[i];
+    upper[s] = cycles.mean[i] + cycles.standardDeviation[i];
+  }
+  plotBand(label, &cycles.mean[channel], &lower[0], &upper[0], GaitSamples, cycles.numChannels * sizeof(float));
+}
+
 void updateBvh()
 {
   if (frameChange)
@@ -261,114 +715,559 @@ void updateBvh()
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-/*################################################################################################################################################*/
-
-int main(int argc, char* argv[])
+// headless batch mode: Aplikasi --aggregate manifest.csv [table.csv]
+int runAggregation(int argc, char* argv[])
 {
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-  GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "PENULISAN ILMIAH", nullptr, nullptr);
-  if (window == nullptr)
+  std::vector<ClipEntry> clips;
+  if (argc < 3 || !readClipManifest(argv[2], clips))
   {
-    std::cout << "Failed to create GLFW window" << std::endl;
-    glfwTerminate();
+    std::cout << "Usage: Aplikasi --aggregate manifest.csv [table.csv]" << std::endl;
     return -1;
   }
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
-  glfwSetCursorPosCallback(window, mouseCallback);
 
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+  Timer timer;
+  timer.Start();
+  std::map<std::string, GroupSummary> groups;
+  AggregationSettings settings;
+  unsigned int failures = aggregateClips(clips, settings, groups);
+  timer.Stop();
+
+  std::cout << clips.size() - failures << " clips in " << groups.size() << " groups, "
+            << failures << " failed, " << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+
+  if (argc > 3)
   {
-    std::cout << "Failed to initialize Glad" << std::endl;
+    std::ofstream table(argv[3]);
+    writeGroupTable(groups, table);
+  }
+  else
+  {
+    writeGroupTable(groups, std::cout);
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+// headless gait averaging: Aplikasi --gait manifest.csv [curves.csv], strides of the left foot
+int runGait(int argc, char* argv[])
+{
+  std::vector<ClipEntry> clips;
+  if (argc < 3 || !readClipManifest(argv[2], clips))
+  {
+    std::cout << "Usage: Aplikasi --gait manifest.csv [curves.csv]" << std::endl;
     return -1;
   }
-  glEnable(GL_DEPTH_TEST);
-  glfwSwapInterval(0);
 
-  // floor
-  float floorVertices[] = {
-    100.0f, 0.0f, 100.0f,
-    100.0f, 0.0f, -100.0f,
-    -100.0f, 0.0f, -100.0f,
-    -100.0f, 0.0f, 100.0f
-  };
-  unsigned int floorIndices[] = {
-    0, 1, 3,
-    1, 2, 3
-  };
-  unsigned int floorVBO, floorEBO, floorVAO;
+  Timer timer;
+  timer.Start();
+  GaitCycles cycles;
+  unsigned int used = averageGaitClips(clips, ZatsiorskyDeLevaModel, gaitSettings, 0, cycles);
+  timer.Stop();
+
+  std::cout << cycles.numCycles << " strides from " << used << " of " << clips.size() << " clips, "
+            << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+  if (cycles.numCycles == 0)
+    return 1;
+
+  std::ofstream file;
+  if (argc > 3)
+    file.open(argv[3]);
+  std::ostream& out = argc > 3 ? file : std::cout;
+
+  // one row per cycle percent, mean and SD of the COM and then of every joint
+  out << "percent,com_x,com_x_sd,com_y,com_y_sd,com_z,com_z_sd";
+  for (unsigned int j = 0; j < (cycles.numChannels - 3) / 3; j++)
+    out << ",joint" << j << "_x,joint" << j << "_x_sd,joint" << j << "_y,joint" << j << "_y_sd,joint" << j << "_z,joint" << j << "_z_sd";
+  out << "\n";
+  for (int s = 0; s < GaitSamples; s++)
+  {
+    out << s;
+    for (unsigned int c = 0; c < cycles.numChannels; c++)
+    {
+      size_t i = (size_t)s * cycles.numChannels + c;
+      out << "," << cycles.mean[i] << "," << cycles.standardDeviation[i];
+    }
+    out << "\n";
+  }
+  return 0;
+}
 
-  glGenVertexArrays(1, &floorVAO);
-  glGenBuffers(1, &floorVBO);
-  glGenBuffers(1, &floorEBO);
+// headless joint angle export: Aplikasi --angles clip.bvh [angles.csv]
+int runJointAngles(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "Usage: Aplikasi --angles clip.bvh [angles.csv]" << std::endl;
+    return -1;
+  }
 
-  glBindVertexArray(floorVAO);
+  Bvh2 clip;
+  clip.load(argv[2]);
+  if (clip.getRootJoint() == nullptr || clip.getMotion().numFrames == 0)
+    return 1;
+
+  ClipTrajectory trajectory;
+  bakeJoints(clip, trajectory);
+  JointAngleResult result;
+  computeJointAngles(trajectory, clip.getJointParents(), jointAngleSettings, result);
+
+  std::ofstream file;
+  if (argc > 3)
+    file.open(argv[3]);
+  std::ostream& out = argc > 3 ? file : std::cout;
+
+  // angles in sequence order and the angular velocity in the parent frame
+  std::vector<std::string> names = clip.getJointNames();
+  const char* sequence = cardanSequenceNames[jointAngleSettings.defaultSequence];
+  out << "frame,time";
+  for (unsigned int j = 0; j < result.numJoints; j++)
+  {
+    std::string name = names[j] == "EndSite" && j > 0 ? names[j - 1] + names[j] : names[j];
+    for (int axis = 0; axis < 3; axis++)
+      out << "," << name << "_" << sequence[axis];
+    out << "," << name << "_wx," << name << "_wy," << name << "_wz";
+  }
+  out << "\n";
+  for (unsigned int frame = 0; frame < result.numFrames; frame++)
+  {
+    out << frame << "," << frame * trajectory.frameTime;
+    for (unsigned int j = 0; j < result.numJoints; j++)
+    {
+      const glm::vec3& angle = result.angles[(size_t)frame * result.numJoints + j];
+      const glm::vec3& velocity = result.angularVelocities[(size_t)frame * result.numJoints + j];
+      out << "," << angle.x << "," << angle.y << "," << angle.z << "," << velocity.x << "," << velocity.y << "," << velocity.z;
+    }
+    out << "\n";
+  }
+  return 0;
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), floorVertices, GL_STATIC_DRAW);
+// headless sway metrics: Aplikasi --sway manifest.csv [table.csv], one row per clip
+int runSway(int argc, char* argv[])
+{
+  std::vector<ClipEntry> clips;
+  if (argc < 3 || !readClipManifest(argv[2], clips))
+  {
+    std::cout << "Usage: Aplikasi --sway manifest.csv [table.csv]" << std::endl;
+    return -1;
+  }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, floorEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(floorIndices), floorIndices, GL_STATIC_DRAW);
+  Timer timer;
+  timer.Start();
+  std::vector<SwayResult> results;
+  computeClipsSway(clips, ZatsiorskyDeLevaModel, swaySettings, results);
+  timer.Stop();
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-  Shader floorShader("floor.vs", "floor.fs");
+  unsigned int failures = 0;
+  for (const SwayResult& result : results)
+    failures += result.numFrames == 0 ? 1 : 0;
+  std::cout << clips.size() - failures << " clips, " << failures << " failed, "
+            << timer.GetMilisecondsElapsed() << " ms" << std::endl;
 
-  // bvh
-  bvh = new Bvh2;
-  if (argc > 1)
+  if (argc > 3)
   {
-    const char* filename = argv[1];
-    bvh->load(filename);
+    std::ofstream table(argv[3]);
+    writeSwayTable(clips, results, table);
   }
   else
   {
-    bvh->load("data/example2.bvh");
+    writeSwayTable(clips, results, std::cout);
   }
+  return failures == 0 ? 0 : 1;
+}
 
-  bvh->moveTo(bvhFrame);
-  bvhVertices.clear();
-  bvhIndices.clear();
-  processBvh((Joint*)bvh->getRootJoint(), bvhVertices, bvhIndices);
-  bvhElements = (short)bvhIndices.size();
+// headless library query: Aplikasi --query manifest.csv "LeftLeg.rx > 90 and com.y < 80" [ranges.csv]
+int runMotionQuery(int argc, char* argv[])
+{
+  std::vector<ClipEntry> clips;
+  if (argc < 4 || !readClipManifest(argv[2], clips))
+  {
+    std::cout << "Usage: Aplikasi --query manifest.csv \"expression\" [ranges.csv]" << std::endl;
+    return -1;
+  }
 
-  glGenVertexArrays(1, &segmentsCogVAO);
-  glGenBuffers(1, &segmentsCogVBO);
-  glGenVertexArrays(1, &comVAO);
-  glGenBuffers(1, &comVBO);
+  Timer timer;
+  timer.Start();
+  unsigned int failures;
+  if (argc > 4)
+  {
+    std::ofstream table(argv[4]);
+    failures = queryClips(clips, ZatsiorskyDeLevaModel, argv[3], table);
+  }
+  else
+  {
+    failures = queryClips(clips, ZatsiorskyDeLevaModel, argv[3], std::cout);
+  }
+  timer.Stop();
 
-  glGenVertexArrays(1, &bvhVAO);
-  glGenBuffers(1, &bvhVBO);
-  glGenBuffers(1, &bvhEBO);
+  std::cout << clips.size() - failures << " clips, " << failures << " failed, "
+            << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
 
-  glBindVertexArray(bvhVAO);
+// headless pose index build: Aplikasi --pose-index manifest.csv poses.idx
+int runPoseIndex(int argc, char* argv[])
+{
+  std::vector<ClipEntry> clips;
+  if (argc < 4 || !readClipManifest(argv[2], clips))
+  {
+    std::cout << "Usage: Aplikasi --pose-index manifest.csv poses.idx" << std::endl;
+    return -1;
+  }
 
-  glBindBuffer(GL_ARRAY_BUFFER, bvhVBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(bvhVertices[0]) * bvhVertices.size(), &bvhVertices[0], GL_DYNAMIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, bvhVBO);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+  Timer timer;
+  timer.Start();
+  PoseIndex index;
+  unsigned int failures = buildPoseIndex(clips, PoseFeatureSettings(), index);
+  timer.Stop();
+  std::cout << clips.size() - failures << " clips, " << failures << " failed, " << index.numPoints << " poses, "
+            << timer.GetMilisecondsElapsed() << " ms" << std::endl;
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bvhEBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(bvhIndices[0]) * bvhIndices.size(), &bvhIndices[0], GL_DYNAMIC_DRAW);
+  if (!savePoseIndex(index, argv[3]))
+    return -1;
+  return failures == 0 ? 0 : 1;
+}
 
-  Shader bvhShader("shader.vs", "shader.fs");
+// headless loop and transition search: Aplikasi --similarity a.bvh [b.bvh], local minima as csv
+int runSimilarity(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "Usage: Aplikasi --similarity a.bvh [b.bvh]" << std::endl;
+    return -1;
+  }
 
-  // ImGui Context
-  ImGui::CreateContext();
-  ImGuiIO& io = ImGui::GetIO();
-  (void)io;
-  ImGui::StyleColorsDark();
-  ImGui_ImplGlfw_InitForOpenGL(window, true);
-  ImGui_ImplOpenGL3_Init("#version 330");
-  bool showDemoWindow = true;
+  Bvh2 clips[2];
+  ClipTrajectory trajectories[2];
+  int numClips = argc > 3 ? 2 : 1;
+  for (int i = 0; i < numClips; i++)
+  {
+    clips[i].load(argv[2 + i]);
+    if (clips[i].getRootJoint() == nullptr || clips[i].getMotion().numFrames == 0)
+      return -1;
+    bakeJoints(clips[i], trajectories[i]);
+  }
 
-  // mvp
-  glm::mat4 model = glm::mat4(1.0f);
+  Timer timer;
+  timer.Start();
+  SimilarityResult result;
+  computeSimilarity(trajectories[0], trajectories[numClips - 1], similaritySettings, result);
+  timer.Stop();
+  std::cout << result.numRows << " x " << result.numColumns << " frames, " << result.minima.size() << " minima, "
+            << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+
+  std::cout << "row,column,distance" << std::endl;
+  for (const SimilarityMatch& match : result.minima)
+    std::cout << match.row << "," << match.column << "," << match.distance << std::endl;
+  return 0;
+}
+
+// headless catalog update: Aplikasi --catalog folder-or-manifest catalog.ccat
+int runCatalog(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    std::cout << "Usage: Aplikasi --catalog folder-or-manifest catalog.ccat" << std::endl;
+    return -1;
+  }
+
+  Timer timer;
+  timer.Start();
+  CatalogProgress progress;
+  if (!indexCatalog(argv[2], argv[3], selectedModel, progress) || !replaceFile(std::string(argv[3]) + ".tmp", argv[3]))
+    return -1;
+  timer.Stop();
+  std::cout << progress.numTotal << " clips, " << progress.numReused << " unchanged, " << progress.numFailed << " failed, "
+            << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+  return progress.numFailed == 0 ? 0 : 1;
+}
+
+// headless conversion: Aplikasi --convert in.bvh[.gz]|in.bmot out.bvh|out.bmot|out.csv, streamed a chunk at a time
+int runConvert(int argc, char* argv[])
+{
+  if (argc < 4 || motionFormat(argv[3]) < 0)
+  {
+    std::cout << "Usage: Aplikasi --convert in.bvh[.gz]|in.bmot out.bvh|out.bmot|out.csv" << std::endl;
+    return -1;
+  }
+
+  Timer timer;
+  timer.Start();
+  long long frames = convertMotion(argv[2], argv[3]);
+  timer.Stop();
+  if (frames < 0)
+    return -1;
+  std::cout << frames << " frames, " << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+  return 0;
+}
+
+// headless marker COM: Aplikasi --c3d trial.c3d [markers.txt] [com.csv], body COM of every frame in cm
+int runC3D(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "Usage: Aplikasi --c3d trial.c3d [markers.txt] [com.csv]" << std::endl;
+    return -1;
+  }
+
+  Timer timer;
+  timer.Start();
+  C3DFile trial;
+  // unmapped on every return
+  struct C3DCloser
+  {
+    C3DFile& file;
+    ~C3DCloser() { closeC3D(file); }
+  } closer = { trial };
+  if (!openC3D(argv[2], trial))
+    return 1;
+  timer.Stop();
+  std::cout << trial.points.numPoints << " markers, " << trial.points.numFrames << " frames at " << trial.pointRate
+            << " Hz, opened in " << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+
+  MarkerJointMap map;
+  if (argc > 3)
+  {
+    if (!readMarkerJointMap(argv[3], map))
+      return 1;
+  }
+  else
+    defaultMarkerJointMap(map);
+
+  ClipTrajectory trajectory;
+  if (!bakeMarkerJoints(trial, map, markerSettings, trajectory))
+    return 1;
+  bakeModelCOM((AnthropometricModel)selectedModel, selectedGender, trajectory);
+
+  std::ofstream file;
+  if (argc > 4)
+    file.open(argv[4]);
+  std::ostream& out = argc > 4 ? file : std::cout;
+  out << "frame,time,com_x,com_y,com_z\n";
+  for (unsigned int frame = 0; frame < trajectory.numFrames; frame++)
+  {
+    const glm::vec4& com = trajectory.bodyCOM[frame];
+    out << frame << "," << frame * trajectory.frameTime << "," << com.x << "," << com.y << "," << com.z << "\n";
+  }
+  return 0;
+}
+
+// headless pose publisher: Aplikasi --pose-publish clip.bvh [name] [loops], plays the clip at its frame rate
+int runPosePublish(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "Usage: Aplikasi --pose-publish clip.bvh [name] [loops]" << std::endl;
+    return -1;
+  }
+
+  Bvh2 clip;
+  clip.load(argv[2]);
+  if (clip.getRootJoint() == nullptr || clip.getMotion().numFrames == 0 || clip.getNumJoints() < MinBodyModelJoints)
+    return 1;
+  ClipTrajectory trajectory;
+  bakeJoints(clip, trajectory);
+  bakeModelCOM((AnthropometricModel)selectedModel, selectedGender, trajectory);
+
+  PoseShare share;
+  if (!createPoseShare(argc > 3 ? argv[3] : PoseShareDefaultName, share))
+    return 1;
+  int loops = argc > 4 ? atoi(argv[4]) : 1;
+  std::cout << "publishing " << trajectory.numFrames << " frames as " << share.name << std::endl;
+
+  std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+  std::chrono::microseconds frameTime((long long)(trajectory.frameTime * 1e6f));
+  for (int loop = 0; loop < loops; loop++)
+  {
+    for (unsigned int frame = 0; frame < trajectory.numFrames; frame++)
+    {
+      publishPose(share, &trajectory.joints[(size_t)frame * trajectory.numJoints], trajectory.numJoints,
+                  &trajectory.segmentsCOM[(size_t)frame * NumSegments], trajectory.bodyCOM[frame], frame);
+      next += frameTime;
+      std::this_thread::sleep_until(next);
+    }
+  }
+  closePoseShare(share);
+  return 0;
+}
+
+// headless pose reader: Aplikasi --pose-read [name] [count], every pose as csv until the publisher stops
+int runPoseRead(int argc, char* argv[])
+{
+  PoseShare share;
+  if (!openPoseShare(argc > 2 ? argv[2] : PoseShareDefaultName, share))
+    return 1;
+  long long count = argc > 3 ? atoll(argv[3]) : -1;
+
+  std::cout << "index,frame,latency_us,com_x,com_y,com_z" << std::endl;
+  PoseSample sample;
+  unsigned long long seen = publishedPoses(share);
+  bool open = true;
+  while (count != 0 && open)
+  {
+    // one more pass after the ring closed, for the poses published just before it
+    open = poseShareOpen(share);
+    unsigned long long published = open ? waitForPoses(share, seen, 1000000) : publishedPoses(share);
+    // poses the ring already wrote over are skipped
+    unsigned long long first = published - seen > PoseShareSlots ? published - PoseShareSlots : seen;
+    for (unsigned long long index = first; index < published && count != 0; index++)
+    {
+      if (!readPose(share, index, sample))
+        continue;
+      long long latency = poseShareTime() - sample.time;
+      std::cout << sample.index << "," << sample.frame << "," << latency << "," << sample.bodyCOM.x << ","
+                << sample.bodyCOM.y << "," << sample.bodyCOM.z << "\n";
+      count--;
+    }
+    seen = published;
+  }
+  std::cout.flush();
+  closePoseShare(share);
+  return 0;
+}
+
+/*################################################################################################################################################*/
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && strcmp(argv[1], "--aggregate") == 0)
+    return runAggregation(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--gait") == 0)
+    return runGait(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--angles") == 0)
+    return runJointAngles(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--sway") == 0)
+    return runSway(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--query") == 0)
+    return runMotionQuery(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--pose-index") == 0)
+    return runPoseIndex(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--similarity") == 0)
+    return runSimilarity(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--catalog") == 0)
+    return runCatalog(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--convert") == 0)
+    return runConvert(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--c3d") == 0)
+    return runC3D(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--pose-publish") == 0)
+    return runPosePublish(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--pose-read") == 0)
+    return runPoseRead(argc, argv);
+
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+  GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "PENULISAN ILMIAH", nullptr, nullptr);
+  if (window == nullptr)
+  {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glfwSetFramebufferSizeCallback(window, frameBufferSizeCallback);
+  glfwSetCursorPosCallback(window, mouseCallback);
+
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+  {
+    std::cout << "Failed to initialize Glad" << std::endl;
+    return -1;
+  }
+  glEnable(GL_DEPTH_TEST);
+  glfwSwapInterval(0);
+
+  // floor
+  float floorVertices[] = {
+    100.0f, 0.0f, 100.0f,
+    100.0f, 0.0f, -100.0f,
+    -100.0f, 0.0f, -100.0f,
+    -100.0f, 0.0f, 100.0f
+  };
+  unsigned int floorIndices[] = {
+    0, 1, 3,
+    1, 2, 3
+  };
+  unsigned int floorVBO, floorEBO, floorVAO;
+
+  glGenVertexArrays(1, &floorVAO);
+  glGenBuffers(1, &floorVBO);
+  glGenBuffers(1, &floorEBO);
+
+  glBindVertexArray(floorVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), floorVertices, GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, floorEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(floorIndices), floorIndices, GL_STATIC_DRAW);
+
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+  glEnableVertexAttribArray(0);
+  Shader floorShader("floor.vs", "floor.fs");
+
+  // bvh
+  bvh = new Bvh2;
+  if (argc > 1)
+    clipPath = argv[1];
+  bvh->load(clipPath);
+
+  bvh->moveTo(bvhFrame);
+  bvhVertices.clear();
+  bvhIndices.clear();
+  processBvh((Joint*)bvh->getRootJoint(), bvhVertices, bvhIndices);
+  bvhElements = (short)bvhIndices.size();
+
+  bakeJoints(*bvh, clipTrajectory);
+  buildDynamicsTopology(bvh->getJointParents(), dynamicsTopology);
+  buildSegmentGeometry(*bvh, dynamicsSettings.lengthUnit, segmentGeometry);
+
+  glGenVertexArrays(1, &segmentsCogVAO);
+  glGenBuffers(1, &segmentsCogVBO);
+  glGenVertexArrays(1, &comVAO);
+  glGenBuffers(1, &comVBO);
+  glGenVertexArrays(1, &supportVAO);
+  glGenBuffers(1, &supportVBO);
+  glGenVertexArrays(1, &zmpVAO);
+  glGenBuffers(1, &zmpVBO);
+  glGenVertexArrays(1, &warpVAO);
+  glGenBuffers(1, &warpVBO);
+  glGenVertexArrays(1, &clusterVAO);
+  glGenBuffers(1, &clusterVBO);
+  glGenVertexArrays(1, &floorSelectionVAO);
+  glGenBuffers(1, &floorSelectionVBO);
+  glGenVertexArrays(1, &markersVAO);
+  glGenBuffers(1, &markersVBO);
+
+  glGenVertexArrays(1, &bvhVAO);
+  glGenBuffers(1, &bvhVBO);
+  glGenBuffers(1, &bvhEBO);
+
+  glBindVertexArray(bvhVAO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, bvhVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(bvhVertices[0]) * bvhVertices.size(), &bvhVertices[0], GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, bvhVBO);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bvhEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(bvhIndices[0]) * bvhIndices.size(), &bvhIndices[0], GL_DYNAMIC_DRAW);
+
+  Shader bvhShader("shader.vs", "shader.fs");
+
+  // ImGui Context
+  ImGui::CreateContext();
+  ImGuiIO& io = ImGui::GetIO();
+  (void)io;
+  ImGui::StyleColorsDark();
+  ImGui_ImplGlfw_InitForOpenGL(window, true);
+  ImGui_ImplOpenGL3_Init("#version 330");
+  bool showDemoWindow = true;
+
+  // mvp
+  glm::mat4 model = glm::mat4(1.0f);
   glm::mat4 view = glm::mat4(1.0f);
   glm::mat4 projection = glm::mat4(1.0f);
   glm::mat4 mvp = glm::mat4(1.0f);
@@ -482,6 +1381,13 @@ int main(int argc, char* argv[])
   rightFootGraph[1].resize(graphFrames);
   rightFootGraph[2].resize(graphFrames);
 
+  // per frame graphs, sized again when resampling changes the clip length
+  std::vector<std::vector<float>>* frameGraphs[] = {
+    &comGraph, &headNeckGraph, &trunkGraph, &leftUpperArmGraph, &rightUpperArmGraph, &leftForeArmGraph,
+    &rightForeArmGraph, &leftHandGraph, &rightHandGraph, &leftThighGraph, &rightThighGraph,
+    &leftShankGraph, &rightShankGraph, &leftFootGraph, &rightFootGraph
+  };
+
   double lastTimeFrame = glfwGetTime();
   while (!glfwWindowShouldClose(window))
   {
@@ -534,7 +1440,22 @@ int main(int argc, char* argv[])
     }
 
     // com
-    processCOM(bvhVertices, comVertices);
+    updateClipAnalysis();
+    processMarkers();
+    if (useMarkerTrial && markerTrajectory.numFrames > 0)
+    {
+      processCOM(markerTrajectory, markerFrame, comVertices);
+      // the pose goes out whole from the marker trial, joints and COM of the same frame
+      if (poseShare.header != nullptr)
+        publishPose(poseShare, &markerTrajectory.joints[(size_t)markerFrame * markerTrajectory.numJoints], markerTrajectory.numJoints,
+                    segmentsCogVertices.data(), comVertices[0], markerFrame);
+    }
+    else
+    {
+      processCOM(clipTrajectory, bvhFrame, comVertices);
+      if (poseShare.header != nullptr)
+        publishPose(poseShare, bvhVertices.data(), (unsigned int)bvhVertices.size(), segmentsCogVertices.data(), comVertices[0], bvhFrame);
+    }
     if (renderBodyCOM)
     {
       floorShader.setVec3("ourColor", comColor[0], comColor[1], comColor[2]);
@@ -549,6 +1470,66 @@ int main(int argc, char* argv[])
       glDrawArrays(GL_POINTS, 0, (int)segmentsCogVertices.size());
     }
 
+    // base of support
+    if (renderSupportPolygon)
+    {
+      processSupportPolygon();
+      bvhShader.setVec3("ourColor", supportColor[0], supportColor[1], supportColor[2]);
+      glBindVertexArray(supportVAO);
+      glDrawArrays(GL_LINE_LOOP, 0, (int)supportVertices.size() - 1);
+      glDrawArrays(GL_POINTS, (int)supportVertices.size() - 1, 1);
+    }
+
+    if (renderZMP)
+    {
+      processZMP();
+      if (!zmpVertices.empty())
+      {
+        bvhShader.setVec3("ourColor", zmpColor[0], zmpColor[1], zmpColor[2]);
+        glBindVertexArray(zmpVAO);
+        glDrawArrays(GL_LINE_STRIP, 0, (int)zmpVertices.size());
+        glDrawArrays(GL_POINTS, (int)zmpVertices.size() - 1, 1);
+      }
+    }
+
+    if (renderWarpClip)
+    {
+      processWarpClip();
+      if (!warpVertices.empty())
+      {
+        bvhShader.setVec3("ourColor", warpColor[0], warpColor[1], warpColor[2]);
+        glBindVertexArray(warpVAO);
+        glDrawArrays(GL_LINES, 0, (int)warpVertices.size());
+      }
+    }
+
+    if (renderCluster)
+    {
+      processCluster();
+      if (!clusterVertices.empty())
+      {
+        ImVec4 color = ImGui::ColorConvertU32ToFloat4(clusterColor(selectedCluster));
+        bvhShader.setVec3("ourColor", color.x, color.y, color.z);
+        glBindVertexArray(clusterVAO);
+        glDrawArrays(GL_LINES, 0, (int)clusterVertices.size());
+      }
+    }
+
+    processFloorSelection(window, view, projection);
+    if (!floorSelectionVertices.empty())
+    {
+      bvhShader.setVec3("ourColor", floorSelectionColor[0], floorSelectionColor[1], floorSelectionColor[2]);
+      glBindVertexArray(floorSelectionVAO);
+      glDrawArrays(GL_LINE_LOOP, 0, (int)floorSelectionVertices.size());
+    }
+
+    if (renderMarkers && !markerVertices.empty())
+    {
+      bvhShader.setVec3("ourColor", markerColor[0], markerColor[1], markerColor[2]);
+      glBindVertexArray(markersVAO);
+      glDrawArrays(GL_POINTS, 0, (int)markerVertices.size());
+    }
+
     // BVH Player Settings;
     {
       ImGui::Begin("BVH Player Settings");
@@ -566,6 +1547,34 @@ int main(int argc, char* argv[])
       if (ImGui::Button(">") && bvhFrame != bvh->getNumFrames())
         bvhFrame++;
 
+      // which cluster every frame of the clip falls in, click to jump
+      if (poseClusterClip >= 0)
+      {
+        unsigned int first = poseClusters.clipBegin[poseClusterClip];
+        unsigned int count = poseClusters.clipBegin[poseClusterClip + 1] - first;
+        float width = ImGui::GetContentRegionAvailWidth();
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        for (unsigned int f = 0; f < count; f++)
+        {
+          ImVec2 a(origin.x + width * f / count, origin.y);
+          ImVec2 b(origin.x + width * (f + 1) / count + 0.5f, origin.y + 12.0f);
+          drawList->AddRectFilled(a, b, clusterColor(poseClusters.assignments[first + f]));
+        }
+        float x = origin.x + width * (bvhFrame + 0.5f) / count;
+        drawList->AddLine(ImVec2(x, origin.y - 2.0f), ImVec2(x, origin.y + 14.0f), IM_COL32(255, 255, 255, 255), 2.0f);
+        ImGui::InvisibleButton("Cluster Strip", ImVec2(width, 12.0f));
+        if (ImGui::IsItemClicked())
+        {
+          int frame = (int)((ImGui::GetIO().MousePos.x - origin.x) / width * count);
+          if (frame >= 0 && frame < (int)count && frame <= (int)bvh->getNumFrames())
+          {
+            bvhFrame = frame;
+            selectedCluster = poseClusters.assignments[first + frame];
+          }
+        }
+      }
+
       ImGui::Checkbox("Render Bones", &renderBones);
       ImGui::SameLine();
       ImGui::Checkbox("Render Joints", &renderJoints);
@@ -573,6 +1582,10 @@ int main(int argc, char* argv[])
       ImGui::Checkbox("Render Segments COM", &renderSegmentCOM);
       ImGui::SameLine();
       ImGui::Checkbox("Render Body COM", &renderBodyCOM);
+      ImGui::SameLine();
+      ImGui::Checkbox("Render Support Polygon", &renderSupportPolygon);
+      ImGui::SameLine();
+      ImGui::Checkbox("Render ZMP", &renderZMP);
       //ImGui::SameLine();
 
       //ImGui::InputInt("Desired FPS", &FPS);
@@ -608,6 +1621,12 @@ int main(int argc, char* argv[])
           comColor[0] = 0.0f;
           comColor[1] = 1.0f;
           comColor[2] = 0.0f;
+          supportColor[0] = 0.0f;
+          supportColor[1] = 0.6f;
+          supportColor[2] = 1.0f;
+          zmpColor[0] = 1.0f;
+          zmpColor[1] = 0.3f;
+          zmpColor[2] = 0.8f;
           boneWidth = 3.0;
           jointPointSize = 8.0;
         }
@@ -623,6 +1642,9 @@ int main(int argc, char* argv[])
         ImGui::SliderFloat("Joint Size ", &jointPointSize, 0.001f, 10.0f);
         ImGui::SameLine();
         ImGui::ColorEdit3("Segments COM Color", segmentComColor);
+        ImGui::ColorEdit3("Support Polygon Color", supportColor);
+        ImGui::SameLine();
+        ImGui::ColorEdit3("ZMP Color", zmpColor);
         ImGui::PopItemWidth();
       }
 
@@ -652,150 +1674,875 @@ int main(int argc, char* argv[])
         }
       }
 
-      if (ImGui::CollapsingHeader("COM Properties"))
+      if (ImGui::CollapsingHeader("Signal Conditioning"))
       {
-        ImGui::Text(" ");
+        filterChanged |= ImGui::Checkbox("Filter Motion Channels", &filterMotion);
+        ImGui::SameLine();
+        filterChanged |= ImGui::Checkbox("Filter COM", &filterCOM);
+        filterChanged |= ImGui::Checkbox("Remove Spikes", &filterSettings.removeSpikes);
+        filterChanged |= ImGui::SliderInt("Median Window", &filterSettings.medianWindow, 3, 31);
+        filterChanged |= ImGui::SliderFloat("Spike Threshold (SD)", &filterSettings.spikeThreshold, 1.0f, 10.0f);
+        filterChanged |= ImGui::InputFloat("Min Deviation", &filterSettings.minDeviation);
+        filterChanged |= ImGui::Checkbox("Spline Gap Fill", &filterSettings.fillGaps);
+        filterChanged |= ImGui::Checkbox("Low Pass", &filterSettings.lowPass);
+        filterChanged |= ImGui::SliderFloat("Cutoff (Hz)", &filterSettings.cutoff, 0.5f, 30.0f);
+      }
 
-        ImGui::Separator();
-        ImGui::Columns(1);
-        ImGui::Text("Gender");
-        ImGui::Separator();
-        ImGui::Columns(1);
-        ImGui::Columns(2);
-        ImGui::RadioButton("Male", &selectedGender, 0);
-        ImGui::NextColumn();
-        ImGui::RadioButton("Female", &selectedGender, 1);
-        ImGui::Columns(1);
-        ImGui::InputFloat("Total Body Weight", &totalBodyWeight);
-        ImGui::Separator();
+      if (ImGui::CollapsingHeader("Resampling"))
+      {
+        static const char* kernelNames[] = { "Cubic", "Windowed Sinc" };
+        static float targetRate = 60.0f;
 
-        ImGui::Text(" ");
+        ImGui::Text("Current: %.2f Hz, %u frames", bvh->getFrameTime() > 0.0f ? 1.0f / bvh->getFrameTime() : 0.0f, bvh->getNumFrames() + 1);
+        ImGui::InputFloat("Target Rate (Hz)", &targetRate);
+        ImGui::Combo("Kernel", &resampleSettings.kernel, kernelNames, 2);
+        if (resampleSettings.kernel == SincResampling)
+          ImGui::SliderInt("Sinc Taps", &resampleSettings.sincTaps, 2, 16);
 
-        ImGui::Columns(1);
-        ImGui::Separator();
-        ImGui::Text("Segment Mass Percent");
+        if (ImGui::Button("Resample") && targetRate > 0.0f)
+        {
+          resampleSettings.frameTime = 1.0f / targetRate;
+          if (resampleMotion(*bvh, resampleSettings))
+          {
+            graphFrames = bvh->getNumFrames() + 1;
+            for (auto graph : frameGraphs)
+              for (auto& axis : *graph)
+                axis.assign(graphFrames, 0.0f);
+            if (bvhFrame > (int)bvh->getNumFrames())
+              bvhFrame = bvh->getNumFrames();
+            // these index the frames before resampling
+            similarity = SimilarityResult();
+            poseClusterClip = -1;
+            floorIndexClip = -1;
+            warp = WarpResult();
+
+            // the filters run again on the new rate, then everything is baked again before
+            // the rest of the panels read the new length
+            filterChanged = true;
+            updateClipAnalysis();
+          }
+        }
+      }
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Head & Neck Mass Male", &headNeckMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Head & Neck Mass Female", &headNeckMassPercent[1]);
-        ImGui::Columns(1);
+      if (ImGui::CollapsingHeader("Motion Editing"))
+      {
+        static int editRange[2] = { 0, 0 };
+        static char spliceClip[256] = "data/example3.bvh";
+
+        const Motion& motion = bvh->getMotion();
+        ImGui::Text("%u frames in %d chunks, %s", motion.numFrames, (int)motion.chunks.size(), motion.data != nullptr ? "one run" : "fragmented");
+        ImGui::InputInt2("Range (first, last)", editRange);
+        if (ImGui::Button("Range From Frame"))
+          editRange[0] = bvhFrame;
+        ImGui::SameLine();
+        if (ImGui::Button("Range To Frame"))
+          editRange[1] = bvhFrame;
+
+        // edits cut the loaded frames, the filters run on the result again
+        bool edited = false;
+        unsigned int first = editRange[0] > 0 ? editRange[0] : 0;
+        unsigned int end = editRange[1] >= editRange[0] ? editRange[1] + 1 : first;
+        if (ImGui::Button("Keep Range"))
+        {
+          bvh->restoreRawMotion();
+          Motion edit = bvh->getMotion();
+          edited = trimMotion(edit, first, end) && bvh->setMotion(edit);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Erase Range"))
+        {
+          bvh->restoreRawMotion();
+          Motion edit = bvh->getMotion();
+          edited = eraseMotion(edit, first, end) && bvh->setMotion(edit);
+        }
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Trunk Mass Male", &trunkMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Trunk Mass Female", &trunkMassPercent[1]);
-        ImGui::Columns(1);
+        ImGui::InputText("Splice Clip", spliceClip, sizeof(spliceClip));
+        bool append = ImGui::Button("Append Clip");
+        ImGui::SameLine();
+        bool insert = ImGui::Button("Insert At Frame");
+        if (append || insert)
+        {
+          // the chunks of the spliced clip outlive it, they're shared rather than copied
+          Bvh2 splice;
+          splice.load(spliceClip);
+          if (splice.getMotion().numFrames > 0)
+          {
+            bvh->restoreRawMotion();
+            Motion edit = bvh->getMotion();
+            edited = insertMotion(edit, append ? edit.numFrames : (unsigned int)bvhFrame, splice.getMotion(), 0, splice.getMotion().numFrames) &&
+                     bvh->setMotion(edit);
+          }
+        }
+        if (ImGui::Button("Compact"))
+          bvh->compactMotion();
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Upper Arm Mass Male", &upperArmMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Upper Arm Mass Female", &upperArmMassPercent[1]);
-        ImGui::Columns(1);
+        // the motion as it is now, edited, resampled and filtered
+        static char savePath[256] = "data/edited.bvh";
+        ImGui::InputText("Save As (.bvh, .bmot, .csv)", savePath, sizeof(savePath));
+        if (ImGui::Button("Save Motion"))
+          saveMotion(*bvh, savePath);
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Fore Arm Mass Male", &foreArmMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Fore Arm Mass Female", &foreArmMassPercent[1]);
-        ImGui::Columns(1);
+        if (edited)
+        {
+          graphFrames = bvh->getNumFrames() + 1;
+          for (auto graph : frameGraphs)
+            for (auto& axis : *graph)
+              axis.assign(graphFrames, 0.0f);
+          if (bvhFrame > (int)bvh->getNumFrames())
+            bvhFrame = bvh->getNumFrames();
+          similarity = SimilarityResult();
+          poseClusterClip = -1;
+          floorIndexClip = -1;
+          warp = WarpResult();
+          filterChanged = true;
+          updateClipAnalysis();
+        }
+      }
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Hand Mass Male", &handMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Hand Mass Female", &handMassPercent[1]);
-        ImGui::Columns(1);
+      if (ImGui::CollapsingHeader("Joint Angles"))
+      {
+        static int angleJoint = 17;
+        if (angleJoint >= (int)jointAngles.numJoints)
+          angleJoint = 0;
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Thigh Mass Male", &thighMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Thigh Mass Female", &thighMassPercent[1]);
-        ImGui::Columns(1);
+        jointAnglesChanged |= ImGui::Combo("Default Sequence", &jointAngleSettings.defaultSequence, cardanSequenceNames, NumCardanSequences);
+        ImGui::SliderInt("Angle Joint", &angleJoint, 0, (int)jointAngles.numJoints - 1);
+        ImGui::Text("%s", nameVector[angleJoint].c_str());
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Shank Mass Male", &shankMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Shank Mass Female", &shankMassPercent[1]);
-        ImGui::Columns(1);
+        int selected = angleJoint < (int)jointAngleSettings.sequences.size() ? jointAngleSettings.sequences[angleJoint] : jointAngleSettings.defaultSequence;
+        if (ImGui::Combo("Joint Sequence", &selected, cardanSequenceNames, NumCardanSequences))
+        {
+          jointAngleSettings.sequences.resize(jointAngles.numJoints, jointAngleSettings.defaultSequence);
+          jointAngleSettings.sequences[angleJoint] = selected;
+          jointAnglesChanged = true;
+        }
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Foot Mass Male", &footMassPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Foot Mass Female", &footMassPercent[1]);
-        ImGui::Columns(1);
-        ImGui::Separator();
+        if (!jointAngles.angles.empty())
+        {
+          size_t index = (size_t)bvhFrame * jointAngles.numJoints + angleJoint;
+          glm::vec3 angle = jointAngles.angles[index];
+          glm::vec3 velocity = jointAngles.angularVelocities[index];
+          ImGui::InputFloat3("Angles (deg)", &angle[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+          ImGui::InputFloat3("Angular Velocity (deg/s)", &velocity[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+
+          int stride = (int)(jointAngles.numJoints * sizeof(glm::vec3));
+          const float* angles = &jointAngles.angles[angleJoint][0];
+          const float* velocities = &jointAngles.angularVelocities[angleJoint][0];
+          ImGui::PlotLines("First Angle", angles + 0, graphFrames, 0, "", FLT_MAX, FLT_MAX, ImVec2(0, 100), stride);
+          ImGui::PlotLines("Second Angle", angles + 1, graphFrames, 0, "", FLT_MAX, FLT_MAX, ImVec2(0, 100), stride);
+          ImGui::PlotLines("Third Angle", angles + 2, graphFrames, 0, "", FLT_MAX, FLT_MAX, ImVec2(0, 100), stride);
+          ImGui::PlotLines("Angular Velocity X", velocities + 0, graphFrames, 0, "", FLT_MAX, FLT_MAX, ImVec2(0, 100), stride);
+          ImGui::PlotLines("Angular Velocity Y", velocities + 1, graphFrames, 0, "", FLT_MAX, FLT_MAX, ImVec2(0, 100), stride);
+          ImGui::PlotLines("Angular Velocity Z", velocities + 2, graphFrames, 0, "", FLT_MAX, FLT_MAX, ImVec2(0, 100), stride);
+        }
+      }
 
-        ImGui::Text(" ");
+      if (ImGui::CollapsingHeader("Motion Query"))
+      {
+        ImGui::InputText("Expression", queryText, sizeof(queryText));
+        if (ImGui::Button("Run Query"))
+        {
+          // rebuilt every run so it follows filtering, resampling and the angle sequences
+          buildQueryTable(*bvh, clipTrajectory, &jointAngles, queryTable);
+          std::vector<QueryPredicate> predicates;
+          queryRanges.clear();
+          queryError.clear();
+          if (parseQuery(queryTable, queryText, predicates, queryError))
+            runQuery(queryTable, predicates, queryRanges);
+        }
+        ImGui::SameLine();
+        ImGui::Text("%d ranges", (int)queryRanges.size());
 
-        ImGui::Columns(1);
-        ImGui::Separator();
-        ImGui::Text("Segment Length Percent");
+        if (!queryError.empty())
+          ImGui::Text("%s", queryError.c_str());
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Head & Neck Length Male", &headNeckLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Head & Neck Length Female", &headNeckLengthPercent[1]);
-        ImGui::Columns(1);
+        ImGui::BeginChild("Query Ranges", ImVec2(0, 120), true);
+        for (size_t i = 0; i < queryRanges.size(); i++)
+        {
+          const FrameRange& range = queryRanges[i];
+          char label[64];
+          snprintf(label, sizeof(label), "%u - %u (%.2f s)##range%d", range.begin, range.end - 1,
+                   (range.end - range.begin) * queryTable.frameTime, (int)i);
+          bool current = bvhFrame >= (int)range.begin && bvhFrame < (int)range.end;
+          if (ImGui::Selectable(label, current))
+            bvhFrame = range.begin;
+        }
+        ImGui::EndChild();
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Trunk Length Male", &trunkLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Trunk Length Female", &trunkLengthPercent[1]);
-        ImGui::Columns(1);
+        if (ImGui::TreeNode("Signals"))
+        {
+          for (const std::string& name : queryTable.names)
+            ImGui::BulletText("%s", name.c_str());
+          ImGui::TreePop();
+        }
+      }
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Upper Arm Length Male", &upperArmLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Upper Arm Length Female", &upperArmLengthPercent[1]);
-        ImGui::Columns(1);
+      if (ImGui::CollapsingHeader("Pose Search"))
+      {
+        static char manifestPath[256] = "data/library.csv";
+        static char indexPath[256] = "data/poses.idx";
+        static int numMatches = 5;
+        static int excludeRadius = 30;
+        static bool searchEveryFrame = false;
+
+        ImGui::InputText("Library Manifest", manifestPath, sizeof(manifestPath));
+        ImGui::InputText("Index File", indexPath, sizeof(indexPath));
+        if (ImGui::Button("Build From Manifest"))
+        {
+          std::vector<ClipEntry> clips;
+          if (readClipManifest(manifestPath, clips))
+            buildPoseIndex(clips, PoseFeatureSettings(), poseIndex);
+          poseMatches.clear();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Build From Clip"))
+        {
+          std::vector<const ClipTrajectory*> trajectories(1, &clipTrajectory);
+          buildPoseIndex(trajectories, std::vector<std::string>(1, clipPath), PoseFeatureSettings(), poseIndex);
+          poseMatches.clear();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Save Index"))
+          savePoseIndex(poseIndex, indexPath);
+        ImGui::SameLine();
+        if (ImGui::Button("Load Index"))
+        {
+          loadPoseIndex(indexPath, poseIndex);
+          poseMatches.clear();
+        }
+        ImGui::Text("%d clips, %u poses", (int)poseIndex.clips.size(), poseIndex.numPoints);
 
-        ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Fore Arm Length Male", &foreArmLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Fore Arm Length Female", &foreArmLengthPercent[1]);
-        ImGui::Columns(1);
+        ImGui::SliderInt("Matches", &numMatches, 1, 16);
+        ImGui::SliderInt("Exclude Own Frames", &excludeRadius, 0, 200);
+        ImGui::Checkbox("Search Every Frame", &searchEveryFrame);
+        ImGui::SameLine();
+        bool search = ImGui::Button("Search Current Pose") || searchEveryFrame;
 
-        ImGui::Columns(2);
+        if (search && poseIndex.numPoints > 0 && (unsigned int)bvhFrame < clipTrajectory.numFrames &&
+            clipTrajectory.numJoints >= MinBodyModelJoints)
+        {
+          // the loaded clip is excluded around the current frame when it is part of the library
+          int currentClip = -1;
+          for (size_t i = 0; i < poseIndex.clips.size(); i++)
+          {
+            if (poseIndex.clips[i] == clipPath)
+              currentClip = (int)i;
+          }
+
+          Timer timer;
+          timer.Start();
+          float feature[PoseFeatureStride];
+          extractPoseFeature(clipTrajectory, bvhFrame, feature);
+          normalizePoseFeature(poseIndex, feature);
+          searchPoseIndex(poseIndex, feature, numMatches, poseMatches, currentClip, bvhFrame, excludeRadius);
+          timer.Stop();
+          poseSearchTime = timer.GetMilisecondsElapsed();
+        }
+        ImGui::Text("Search: %.3f ms", poseSearchTime);
+
+        for (size_t i = 0; i < poseMatches.size(); i++)
+        {
+          const PoseMatch& match = poseMatches[i];
+          const std::string& clip = poseIndex.clips[match.clip];
+          char label[320];
+          snprintf(label, sizeof(label), "%s : %u (%.3f)##pose%d", clip.c_str(), match.frame, sqrtf(match.distance), (int)i);
+          if (ImGui::Selectable(label, false) && clip == clipPath && match.frame <= bvh->getNumFrames())
+            bvhFrame = match.frame;
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Frame Similarity"))
+      {
+        static int topK = 0;
+        int heatmapSize = (int)similaritySettings.heatmapSize;
+        int excludeRadius = (int)similaritySettings.excludeRadius;
+        ImGui::Checkbox("Align Heading", &similaritySettings.alignHeading);
+        ImGui::SameLine();
+        ImGui::Checkbox("Local Minima", &similaritySettings.localMinima);
+        ImGui::SliderFloat("Max Distance (cm)", &similaritySettings.maxDistance, 0.5f, 50.0f);
+        ImGui::SliderInt("Exclude Diagonal", &excludeRadius, 0, 200);
+        ImGui::SliderInt("Nearest Per Row", &topK, 0, 8);
+        ImGui::SliderInt("Heatmap Size", &heatmapSize, 16, 256);
+        similaritySettings.excludeRadius = excludeRadius;
+        similaritySettings.topK = topK;
+        similaritySettings.heatmapSize = heatmapSize;
+
+        if (ImGui::Button("Compute Self Similarity") && clipTrajectory.numFrames > 0)
+        {
+          Timer timer;
+          timer.Start();
+          computeSimilarity(clipTrajectory, clipTrajectory, similaritySettings, similarity);
+          timer.Stop();
+          similarityTime = timer.GetMilisecondsElapsed();
+        }
+        ImGui::Text("%u minima, %.1f ms", (unsigned int)similarity.minima.size(), similarityTime);
+
+        if (!similarity.heatmap.empty())
+        {
+          // dark cells are similar poses, clicking jumps to the row frame
+          const float side = 256.0f;
+          float cellWidth = side / similarity.heatmapColumns;
+          float cellHeight = side / similarity.heatmapRows;
+          ImVec2 origin = ImGui::GetCursorScreenPos();
+          ImDrawList* drawList = ImGui::GetWindowDrawList();
+          for (unsigned int r = 0; r < similarity.heatmapRows; r++)
+          {
+            for (unsigned int c = 0; c < similarity.heatmapColumns; c++)
+            {
+              float value = similarity.heatmap[(size_t)r * similarity.heatmapColumns + c];
+              int shade = similarity.heatmapMax > 0.0f ? (int)(255.0f * value / similarity.heatmapMax) : 0;
+              ImVec2 a(origin.x + c * cellWidth, origin.y + r * cellHeight);
+              ImVec2 b(a.x + cellWidth + 0.5f, a.y + cellHeight + 0.5f);
+              drawList->AddRectFilled(a, b, IM_COL32(shade, shade, 255 - shade / 2, 255));
+            }
+          }
+          float frameY = origin.y + side * bvhFrame / similarity.numRows;
+          drawList->AddLine(ImVec2(origin.x, frameY), ImVec2(origin.x + side, frameY), IM_COL32(255, 64, 64, 255));
+
+          ImGui::InvisibleButton("Heatmap", ImVec2(side, side));
+          if (ImGui::IsItemClicked())
+          {
+            float y = ImGui::GetIO().MousePos.y - origin.y;
+            int frame = (int)(y / side * similarity.numRows);
+            if (frame >= 0 && frame <= (int)bvh->getNumFrames())
+              bvhFrame = frame;
+          }
+
+          ImGui::BeginChild("Similarity Minima", ImVec2(0, 120), true);
+          for (size_t i = 0; i < similarity.minima.size() && i < 500; i++)
+          {
+            const SimilarityMatch& match = similarity.minima[i];
+            char label[64];
+            snprintf(label, sizeof(label), "%u -> %u (%.2f cm)##minimum%d", match.row, match.column, match.distance, (int)i);
+            if (ImGui::Selectable(label, bvhFrame == (int)match.row) && match.row <= bvh->getNumFrames())
+              bvhFrame = match.row;
+          }
+          ImGui::EndChild();
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Time Warp"))
+      {
+        static char warpPath[256] = "data/example3.bvh";
+        ImGui::InputText("Other Clip", warpPath, sizeof(warpPath));
+        ImGui::SliderFloat("Band Width", &warpSettings.bandWidth, 0.01f, 1.0f);
+        ImGui::SliderFloat("COM Weight", &warpSettings.comWeight, 0.0f, 4.0f);
+        ImGui::SliderFloat("Joint Weight", &warpSettings.jointWeight, 0.0f, 4.0f);
+        ImGui::InputFloat("Abandon Above (cm)", &warpSettings.abandonCost);
+
+        if (ImGui::Button("Load & Align"))
+        {
+          delete warpBvh;
+          warpBvh = new Bvh2;
+          warpBvh->load(warpPath);
+          warp = WarpResult();
+          if (warpBvh->getRootJoint() != nullptr && warpBvh->getMotion().numFrames > 0 &&
+              warpBvh->getNumJoints() >= MinBodyModelJoints)
+          {
+            bakeJoints(*warpBvh, warpTrajectory);
+            if (selectedModel == CustomModel)
+              bakeCOM(clipBodyParameters, warpTrajectory);
+            else
+              bakeModelCOM((AnthropometricModel)selectedModel, selectedGender, warpTrajectory);
+
+            Timer timer;
+            timer.Start();
+            alignClips(clipTrajectory, warpTrajectory, warpSettings, warp);
+            timer.Stop();
+            std::cout << "aligned " << warpPath << " in " << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+          }
+        }
+
+        if (warp.complete)
+        {
+          ImGui::Text("Cost: %.1f cm, %.2f cm per step, %d steps", warp.cost, warp.meanCost, (int)warp.path.size());
+          if ((unsigned int)bvhFrame < warp.aToB.size())
+            ImGui::Text("Frame %d plays with frame %u", bvhFrame, warp.aToB[bvhFrame]);
+          ImGui::Checkbox("Render Synced Clip", &renderWarpClip);
+          ImGui::SliderFloat("Synced Clip Offset", &warpOffset, -300.0f, 300.0f);
+          ImGui::ColorEdit3("Synced Clip Color", warpColor);
+
+          std::vector<float> warpCurve(warp.aToB.begin(), warp.aToB.end());
+          ImGui::PlotLines("Warping Path", warpCurve.data(), (int)warpCurve.size(), 0, "", 0.0f, (float)warp.bToA.size(), ImVec2(0, 100));
+        }
+        else if (warpBvh != nullptr)
+        {
+          ImGui::Text("Not aligned");
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Pose Clusters"))
+      {
+        static char clusterManifest[256] = "data/library.csv";
+        int numClusters = (int)clusterSettings.numClusters;
+        ImGui::SliderInt("Clusters", &numClusters, 1, 32);
+        clusterSettings.numClusters = numClusters;
+        ImGui::Checkbox("Align Heading##clusters", &clusterSettings.alignHeading);
+        ImGui::InputText("Cluster Manifest", clusterManifest, sizeof(clusterManifest));
+
+        bool clustered = false;
+        Timer timer;
+        timer.Start();
+        if (ImGui::Button("Cluster Clip"))
+        {
+          std::vector<const ClipTrajectory*> trajectories(1, &clipTrajectory);
+          clusterPoses(trajectories, std::vector<std::string>(1, clipPath), clusterSettings, poseClusters);
+          clustered = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Cluster Library"))
+        {
+          std::vector<ClipEntry> clips;
+          if (readClipManifest(clusterManifest, clips))
+            clusterClips(clips, clusterSettings, poseClusters);
+          clustered = true;
+        }
+        timer.Stop();
+
+        if (clustered)
+        {
+          std::cout << "clustered " << poseClusters.assignments.size() << " frames in " << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+          selectedCluster = 0;
+          poseClusterClip = -1;
+          for (size_t i = 0; i < poseClusters.clips.size(); i++)
+          {
+            unsigned int frames = poseClusters.clipBegin[i + 1] - poseClusters.clipBegin[i];
+            if (poseClusters.clips[i] == clipPath && frames == clipTrajectory.numFrames)
+              poseClusterClip = (int)i;
+          }
+        }
+
+        if (poseClusters.numClusters > 0)
+        {
+          ImGui::Text("%u frames, RMS distance to center %.2f cm", (unsigned int)poseClusters.assignments.size(), poseClusters.meanDistance);
+          ImGui::Checkbox("Render Representative Pose", &renderCluster);
+          for (unsigned int c = 0; c < poseClusters.numClusters; c++)
+          {
+            char label[320];
+            snprintf(label, sizeof(label), "%u: %u frames, %s : %u##cluster%u", c, poseClusters.counts[c],
+                     poseClusters.clips[poseClusters.representativeClip[c]].c_str(), poseClusters.representativeFrame[c], c);
+            char swatch[32];
+            snprintf(swatch, sizeof(swatch), "##swatch%u", c);
+            ImGui::ColorButton(swatch, ImGui::ColorConvertU32ToFloat4(clusterColor(c)), ImGuiColorEditFlags_NoTooltip, ImVec2(12, 12));
+            ImGui::SameLine();
+            if (ImGui::Selectable(label, selectedCluster == (int)c))
+            {
+              selectedCluster = c;
+              if ((int)poseClusters.representativeClip[c] == poseClusterClip && poseClusters.representativeFrame[c] < clipTrajectory.numFrames)
+                bvhFrame = poseClusters.representativeFrame[c];
+            }
+          }
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Floor Regions"))
+      {
+        static char floorManifest[256] = "data/library.csv";
+        static float nearestPoint[2] = { 0.0f, 0.0f };
+        static int numNearest = 10;
+
+        ImGui::InputText("Floor Manifest", floorManifest, sizeof(floorManifest));
+        bool built = false;
+        if (ImGui::Button("Index Clip"))
+        {
+          std::vector<const ClipTrajectory*> trajectories(1, &clipTrajectory);
+          buildFloorIndex(trajectories, std::vector<std::string>(1, clipPath), floorIndex);
+          built = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Index Library"))
+        {
+          std::vector<ClipEntry> clips;
+          if (readClipManifest(floorManifest, clips))
+            buildFloorIndex(clips, selectedModel, floorIndex);
+          built = true;
+        }
+        if (built)
+        {
+          floorHits.clear();
+          floorRanges.clear();
+          floorIndexClip = -1;
+          for (size_t i = 0; i < floorIndex.clips.size(); i++)
+          {
+            if (floorIndex.clips[i] == clipPath && floorIndex.clipFrames[i] == clipTrajectory.numFrames)
+              floorIndexClip = (int)i;
+          }
+        }
+        ImGui::Text("%d points in %u x %u cells of %.1f cm", (int)floorIndex.points.size(), floorIndex.columns, floorIndex.rows, floorIndex.cellSize);
+
+        bool root = (floorKinds & FloorRootMask) != 0;
+        bool com = (floorKinds & FloorCOMMask) != 0;
+        ImGui::Checkbox("Root", &root);
+        ImGui::SameLine();
+        ImGui::Checkbox("COM", &com);
+        floorKinds = (root ? FloorRootMask : 0) | (com ? FloorCOMMask : 0);
+
+        ImGui::Text("Ctrl + left drag on the floor selects a region");
+        ImGui::Text("Selection: x %.1f to %.1f, z %.1f to %.1f", std::fmin(floorSelectionStart.x, floorSelectionEnd.x),
+                    std::fmax(floorSelectionStart.x, floorSelectionEnd.x), std::fmin(floorSelectionStart.y, floorSelectionEnd.y),
+                    std::fmax(floorSelectionStart.y, floorSelectionEnd.y));
+        ImGui::ColorEdit3("Selection Color", floorSelectionColor);
+
+        ImGui::InputFloat2("Nearest To (x, z)", nearestPoint);
+        ImGui::SliderInt("Nearest Count", &numNearest, 1, 100);
+        if (ImGui::Button("Use Current COM") && (unsigned int)bvhFrame < clipTrajectory.bodyCOM.size())
+        {
+          nearestPoint[0] = clipTrajectory.bodyCOM[bvhFrame].x;
+          nearestPoint[1] = clipTrajectory.bodyCOM[bvhFrame].z;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Find Nearest"))
+        {
+          queryFloorNearest(floorIndex, nearestPoint[0], nearestPoint[1], numNearest, floorKinds, floorHits);
+          std::vector<FloorPoint> sorted = floorHits;
+          std::sort(sorted.begin(), sorted.end(), [](const FloorPoint& a, const FloorPoint& b)
+          {
+            return a.clip != b.clip ? a.clip < b.clip : a.frame < b.frame;
+          });
+          floorHitRanges(sorted, floorRanges);
+        }
+
+        ImGui::Text("%d points, %d ranges", (int)floorHits.size(), (int)floorRanges.size());
+        ImGui::BeginChild("Floor Ranges", ImVec2(0, 120), true);
+        for (size_t i = 0; i < floorRanges.size() && i < 500; i++)
+        {
+          const FloorClipRange& range = floorRanges[i];
+          char label[320];
+          snprintf(label, sizeof(label), "%s : %u - %u##floor%d", floorIndex.clips[range.clip].c_str(), range.begin, range.end - 1, (int)i);
+          if (ImGui::Selectable(label, false) && (int)range.clip == floorIndexClip && range.begin < clipTrajectory.numFrames)
+            bvhFrame = range.begin;
+        }
+        ImGui::EndChild();
+      }
+
+      // a finished background index is swapped in whether the panel is open or not
+      if (finishCatalogIndexer(catalogIndexer, clipCatalog))
+        refreshCatalogClips();
+
+      if (ImGui::CollapsingHeader("Clip Catalog"))
+      {
+        static char catalogSource[256] = "data";
+        static char catalogFile[256] = "data/catalog.ccat";
+        static char catalogText[128] = "";
+        static int catalogFrames[2] = { 0, 0 };
+        static bool sameSkeleton = false;
+
+        ImGui::InputText("Library (folder or manifest)", catalogSource, sizeof(catalogSource));
+        ImGui::InputText("Catalog File", catalogFile, sizeof(catalogFile));
+        if (ImGui::Button("Open Catalog") && !catalogIndexer.running)
+        {
+          openCatalog(catalogFile, clipCatalog);
+          refreshCatalogClips();
+        }
+        ImGui::SameLine();
+        if (catalogIndexer.running)
+        {
+          if (ImGui::Button("Cancel"))
+            stopCatalogIndexer(catalogIndexer);
+          unsigned int total = catalogIndexer.progress.numTotal;
+          ImGui::SameLine();
+          ImGui::ProgressBar(total > 0 ? (float)catalogIndexer.progress.numDone / total : 0.0f);
+        }
+        else if (ImGui::Button("Update Catalog"))
+        {
+          startCatalogIndexer(catalogIndexer, catalogSource, catalogFile, selectedModel);
+        }
+
+        bool changed = ImGui::InputText("Path Contains", catalogText, sizeof(catalogText));
+        changed |= ImGui::InputInt2("Frames (min, max)", catalogFrames);
+        changed |= ImGui::Checkbox("Same Skeleton", &sameSkeleton);
+        ImGui::SameLine();
+        changed |= ImGui::Checkbox("With COM", &catalogFilter.requireCOM);
+        changed |= ImGui::Combo("Sort By", &catalogSort, "Path\0Frames\0Duration\0Height\0COM Speed\0Skeleton\0");
+        ImGui::SameLine();
+        changed |= ImGui::Checkbox("Descending", &catalogDescending);
+        if (changed)
+        {
+          catalogFilter.text = catalogText;
+          catalogFilter.minFrames = catalogFrames[0] > 0 ? catalogFrames[0] : 0;
+          catalogFilter.maxFrames = catalogFrames[1] > 0 ? catalogFrames[1] : 0;
+          catalogFilter.skeleton = sameSkeleton ? skeletonHash(*bvh) : 0;
+          refreshCatalogClips();
+        }
+
+        ImGui::Text("%d of %u clips", (int)catalogClips.size(), clipCatalog.numClips);
+        ImGui::BeginChild("Catalog Clips", ImVec2(0, 200), true);
+        ImGui::Columns(4, "catalog");
+        ImGui::Text("Path"); ImGui::NextColumn();
+        ImGui::Text("Frames"); ImGui::NextColumn();
+        ImGui::Text("Seconds"); ImGui::NextColumn();
+        ImGui::Text("COM cm/s"); ImGui::NextColumn();
         ImGui::Separator();
-        ImGui::InputFloat("Hand Length Male", &handLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Hand Length Female", &handLengthPercent[1]);
+        ImGuiListClipper clipper((int)catalogClips.size());
+        while (clipper.Step())
+        {
+          for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+          {
+            unsigned int clip = catalogClips[row];
+            char label[320];
+            snprintf(label, sizeof(label), "%s##catalog%u", catalogPath(clipCatalog, clip), clip);
+            if (ImGui::Selectable(label, selectedCatalogClip == (int)clip, ImGuiSelectableFlags_SpanAllColumns))
+              selectedCatalogClip = (int)clip;
+            ImGui::NextColumn();
+            ImGui::Text("%u", clipCatalog.numFrames[clip]); ImGui::NextColumn();
+            ImGui::Text("%.2f", clipCatalog.numFrames[clip] * clipCatalog.frameTimes[clip]); ImGui::NextColumn();
+            if (clipCatalog.flags[clip] & CatalogHasCOM)
+              ImGui::Text("%.1f", clipCatalog.comSpeed[clip]);
+            ImGui::NextColumn();
+          }
+        }
         ImGui::Columns(1);
+        ImGui::EndChild();
+
+        if (selectedCatalogClip >= 0 && (unsigned int)selectedCatalogClip < clipCatalog.numClips)
+        {
+          unsigned int clip = (unsigned int)selectedCatalogClip;
+          drawCatalogThumbnail(clip, 120.0f, 160.0f);
+          ImGui::SameLine();
+          ImGui::BeginGroup();
+          ImGui::Text("%u joints, skeleton %016llx", clipCatalog.numJoints[clip], clipCatalog.skeletonHashes[clip]);
+          ImGui::Text("Frame time %.4f s", clipCatalog.frameTimes[clip]);
+          const glm::vec3& lower = clipCatalog.boundsMin[clip];
+          const glm::vec3& upper = clipCatalog.boundsMax[clip];
+          ImGui::Text("Bounds %.0f x %.0f x %.0f cm", upper.x - lower.x, upper.y - lower.y, upper.z - lower.z);
+          if (clipCatalog.flags[clip] & CatalogHasCOM)
+          {
+            ImGui::Text("COM height %.1f (%.1f - %.1f) cm", clipCatalog.comMean[clip].y, clipCatalog.comHeight[clip].x, clipCatalog.comHeight[clip].y);
+            ImGui::Text("COM path %.1f cm", clipCatalog.comPath[clip]);
+          }
+          ImGui::EndGroup();
+        }
+      }
+
+      if (ImGui::CollapsingHeader("C3D Markers"))
+      {
+        static char trialPath[256] = "data/trial.c3d";
+        static char markerMapPath[256] = "";
+        ImGui::InputText("Trial (.c3d)", trialPath, sizeof(trialPath));
+        ImGui::InputText("Marker Map (empty for Plug-in Gait)", markerMapPath, sizeof(markerMapPath));
+        ImGui::Checkbox("Z Up", &markerSettings.zUp);
+        if (ImGui::Button("Load Trial"))
+        {
+          Timer timer;
+          timer.Start();
+          if (loadMarkerTrial(trialPath, markerMapPath))
+          {
+            timer.Stop();
+            std::cout << "loaded " << trialPath << " in " << timer.GetMilisecondsElapsed() << " ms" << std::endl;
+          }
+        }
+
+        if (markerTrajectory.numFrames > 0)
+        {
+          static const char* processorNames[] = { "Intel", "DEC", "MIPS" };
+          const C3DPointView& points = markerTrial.points;
+          ImGui::Text("%u markers, %u frames at %.0f Hz", points.numPoints, points.numFrames, markerTrial.pointRate);
+          ImGui::Text("%s %s, units %s, %u analog samples per frame", processorNames[markerTrial.processor - C3DProcessorIntel],
+                      points.floats ? "floats" : "integers", markerTrial.units.c_str(), markerTrial.analogPerFrame);
+          ImGui::Text("Frame %u", markerFrame);
+          ImGui::Checkbox("COM From Markers", &useMarkerTrial);
+          ImGui::Checkbox("Render Markers", &renderMarkers);
+          ImGui::ColorEdit3("Marker Color", markerColor);
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Pose Sharing"))
+      {
+        static char poseShareName[64] = PoseShareDefaultName;
+        bool publishing = poseShare.header != nullptr;
+        ImGui::InputText("Shared Memory Name", poseShareName, sizeof(poseShareName));
+        if (ImGui::Checkbox("Publish Poses", &publishing))
+        {
+          if (publishing)
+            createPoseShare(poseShareName, poseShare);
+          else
+            closePoseShare(poseShare);
+        }
+        if (poseShare.header != nullptr)
+          ImGui::Text("%llu poses published as %s", publishedPoses(poseShare), poseShare.name.c_str());
+      }
+
+      if (ImGui::CollapsingHeader("COM Properties"))
+      {
+        ImGui::Text(" ");
 
-        ImGui::Columns(2);
         ImGui::Separator();
-        ImGui::InputFloat("Thigh Length Male", &thighLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Thigh Length Female", &thighLengthPercent[1]);
         ImGui::Columns(1);
-
-        ImGui::Columns(2);
+        ImGui::Text("Gender");
         ImGui::Separator();
-        ImGui::InputFloat("Shank Length Male", &shankLengthPercent[0]);
-        ImGui::NextColumn();
-        ImGui::InputFloat("Shank Length Female", &shankLengthPercent[1]);
         ImGui::Columns(1);
-
         ImGui::Columns(2);
-        ImGui::Separator();
-        ImGui::InputFloat("Foot Length Male", &footLengthPercent[0]);
+        ImGui::RadioButton("Male", &selectedGender, 0);
         ImGui::NextColumn();
-        ImGui::InputFloat("Foot Length Female", &footLengthPercent[1]);
+        ImGui::RadioButton("Female", &selectedGender, 1);
         ImGui::Columns(1);
+        ImGui::InputFloat("Total Body Weight", &totalBodyWeight);
+        ImGui::Combo("Anthropometric Model", &selectedModel, anthropometricModelNames, NumAnthropometricModels);
         ImGui::Separator();
 
         ImGui::Text(" ");
+
+        const SegmentProperties* modelTable = modelSegments((AnthropometricModel)selectedModel, selectedGender);
+        if (modelTable != nullptr)
+        {
+          static const char* modelSegmentNames[NumSegments] = {
+            "Head & Neck", "Trunk", "Left Upper Arm", "Right Upper Arm", "Left Fore Arm", "Right Fore Arm",
+            "Left Hand", "Right Hand", "Left Thigh", "Right Thigh", "Left Shank", "Right Shank", "Left Foot", "Right Foot"
+          };
+
+          ImGui::Columns(4);
+          ImGui::Separator();
+          ImGui::Text("Segment");
+          ImGui::NextColumn();
+          ImGui::Text("Mass %%");
+          ImGui::NextColumn();
+          ImGui::Text("COM %%");
+          ImGui::NextColumn();
+          ImGui::Text("Gyration %%");
+          ImGui::NextColumn();
+          ImGui::Separator();
+          for (int s = 0; s < NumSegments; s++)
+          {
+            ImGui::Text("%s", modelSegmentNames[s]);
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", modelTable[s].massPercent);
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", modelTable[s].comPercent);
+            ImGui::NextColumn();
+            ImGui::Text("%.2f", modelTable[s].gyrationPercent);
+            ImGui::NextColumn();
+          }
+          ImGui::Columns(1);
+          ImGui::Separator();
+        }
+        else
+        {
+          ImGui::Columns(1);
+          ImGui::Separator();
+          ImGui::Text("Segment Mass Percent");
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Head & Neck Mass Male", &headNeckMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Head & Neck Mass Female", &headNeckMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Trunk Mass Male", &trunkMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Trunk Mass Female", &trunkMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Upper Arm Mass Male", &upperArmMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Upper Arm Mass Female", &upperArmMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Fore Arm Mass Male", &foreArmMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Fore Arm Mass Female", &foreArmMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Hand Mass Male", &handMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Hand Mass Female", &handMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Thigh Mass Male", &thighMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Thigh Mass Female", &thighMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Shank Mass Male", &shankMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Shank Mass Female", &shankMassPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Foot Mass Male", &footMassPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Foot Mass Female", &footMassPercent[1]);
+          ImGui::Columns(1);
+          ImGui::Separator();
+
+          ImGui::Text(" ");
+
+          ImGui::Columns(1);
+          ImGui::Separator();
+          ImGui::Text("Segment Length Percent");
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Head & Neck Length Male", &headNeckLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Head & Neck Length Female", &headNeckLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Trunk Length Male", &trunkLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Trunk Length Female", &trunkLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Upper Arm Length Male", &upperArmLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Upper Arm Length Female", &upperArmLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Fore Arm Length Male", &foreArmLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Fore Arm Length Female", &foreArmLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Hand Length Male", &handLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Hand Length Female", &handLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Thigh Length Male", &thighLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Thigh Length Female", &thighLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Shank Length Male", &shankLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Shank Length Female", &shankLengthPercent[1]);
+          ImGui::Columns(1);
+
+          ImGui::Columns(2);
+          ImGui::Separator();
+          ImGui::InputFloat("Foot Length Male", &footLengthPercent[0]);
+          ImGui::NextColumn();
+          ImGui::InputFloat("Foot Length Female", &footLengthPercent[1]);
+          ImGui::Columns(1);
+          ImGui::Separator();
+        }
+
+        ImGui::Text(" ");
       }
 
       if (ImGui::CollapsingHeader("Body COM"))
@@ -814,6 +2561,212 @@ int main(int argc, char* argv[])
         ImGui::SliderFloat("Body COM Z Height", &comGraphZHeight, 1, 200);
       }
 
+      if (ImGui::CollapsingHeader("Stability"))
+      {
+        stabilityChanged |= ImGui::SliderFloat("Contact Height", &stabilitySettings.contactHeight, 0.1f, 20.0f);
+        stabilityChanged |= ImGui::SliderFloat("Contact Speed", &stabilitySettings.contactSpeed, 1.0f, 200.0f);
+        stabilityChanged |= ImGui::SliderFloat("Foot Half Width", &stabilitySettings.footHalfWidth, 0.0f, 10.0f);
+        stabilityChanged |= ImGui::Checkbox("Extrapolated COM", &stabilitySettings.extrapolatedCOM);
+
+        unsigned char contacts = stability.contacts[bvhFrame];
+        ImGui::Text("Contacts: %s%s%s%s",
+          contacts & LeftHeelContact ? "left heel " : "",
+          contacts & LeftToeContact ? "left toe " : "",
+          contacts & RightHeelContact ? "right heel " : "",
+          contacts & RightToeContact ? "right toe " : "");
+        ImGui::Text("Stability Margin: %.3f", stability.margin[bvhFrame]);
+
+        static float marginGraphHeight = 30.0f;
+        ImGui::PlotLines("Stability Margin", &stability.margin[0], graphFrames, 0, "", -marginGraphHeight, marginGraphHeight, ImVec2(0, 100));
+        ImGui::SliderFloat("Stability Margin Height", &marginGraphHeight, 1, 200);
+      }
+
+      if (ImGui::CollapsingHeader("Dynamics"))
+      {
+        static const char* segmentNames[NumSegments] = {
+          "Head & Neck", "Trunk", "Left Upper Arm", "Right Upper Arm", "Left Fore Arm", "Right Fore Arm",
+          "Left Hand", "Right Hand", "Left Thigh", "Right Thigh", "Left Shank", "Right Shank", "Left Foot", "Right Foot"
+        };
+        static int selectedSegment = LeftShank;
+
+        if (ImGui::InputFloat("Length Unit (m)", &dynamicsSettings.lengthUnit, 0.0f, 0.0f, "%.4f"))
+        {
+          buildSegmentGeometry(*bvh, dynamicsSettings.lengthUnit, segmentGeometry);
+          stabilityChanged = true;
+        }
+
+        glm::vec3 groundReaction = dynamics.groundReaction[bvhFrame];
+        ImGui::InputFloat3("Ground Reaction (N)", &groundReaction[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+        static float groundReactionGraphHeight = 1500.0f;
+        ImGui::PlotLines("Vertical Ground Reaction", [](void* data, int idx) { return ((glm::vec3*)data)[idx].y; },
+          &dynamics.groundReaction[0], graphFrames, 0, "", -groundReactionGraphHeight, groundReactionGraphHeight, ImVec2(0, 100));
+        ImGui::SliderFloat("Ground Reaction Height", &groundReactionGraphHeight, 100, 5000);
+
+        ImGui::Combo("Proximal Joint Of", &selectedSegment, segmentNames, NumSegments);
+        glm::vec3 jointForce = dynamics.jointForces[bvhFrame * NumSegments + selectedSegment];
+        glm::vec3 jointMoment = dynamics.jointMoments[bvhFrame * NumSegments + selectedSegment];
+        ImGui::InputFloat3("Joint Force (N)", &jointForce[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+        ImGui::InputFloat3("Joint Moment (N m)", &jointMoment[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+        static float jointMomentGraphHeight = 200.0f;
+        ImGui::PlotLines("Joint Moment", [](void* data, int idx) { return glm::length(((glm::vec3*)data)[idx * NumSegments]); },
+          &dynamics.jointMoments[selectedSegment], graphFrames, 0, "", 0.0f, jointMomentGraphHeight, ImVec2(0, 100));
+        ImGui::SliderFloat("Joint Moment Height", &jointMomentGraphHeight, 1, 1000);
+      }
+
+      if (ImGui::CollapsingHeader("Angular Momentum"))
+      {
+        glm::vec3 momentum = angularMomentum.angularMomentum[bvhFrame];
+        glm::mat3 inertia = angularMomentum.inertia[bvhFrame];
+        glm::vec3 principal = glm::vec3(inertia[0][0], inertia[1][1], inertia[2][2]);
+        ImGui::InputFloat3("Angular Momentum (kg m^2/s)", &momentum[0], "%.4f", ImGuiInputTextFlags_ReadOnly);
+        ImGui::InputFloat3("Body Inertia XX YY ZZ (kg m^2)", &principal[0], "%.4f", ImGuiInputTextFlags_ReadOnly);
+
+        static float angularMomentumGraphHeight = 10.0f;
+        ImGui::PlotLines("Angular Momentum X", &angularMomentum.angularMomentum[0].x, graphFrames, 0, "",
+          -angularMomentumGraphHeight, angularMomentumGraphHeight, ImVec2(0, 100), sizeof(glm::vec3));
+        ImGui::PlotLines("Angular Momentum Y", &angularMomentum.angularMomentum[0].y, graphFrames, 0, "",
+          -angularMomentumGraphHeight, angularMomentumGraphHeight, ImVec2(0, 100), sizeof(glm::vec3));
+        ImGui::PlotLines("Angular Momentum Z", &angularMomentum.angularMomentum[0].z, graphFrames, 0, "",
+          -angularMomentumGraphHeight, angularMomentumGraphHeight, ImVec2(0, 100), sizeof(glm::vec3));
+        ImGui::SliderFloat("Angular Momentum Height", &angularMomentumGraphHeight, 0.1f, 50.0f);
+      }
+
+      if (ImGui::CollapsingHeader("ZMP"))
+      {
+        stabilityChanged |= ImGui::InputFloat("Floor Height", &zmpSettings.floorHeight);
+        stabilityChanged |= ImGui::SliderFloat("Min Load", &zmpSettings.minLoad, 0.0f, 1.0f);
+        ImGui::SliderInt("Trail Frames", &zmpSettings.trailLength, 0, 500);
+
+        if (zmp.valid[bvhFrame])
+        {
+          glm::vec2 point = zmp.zmp[bvhFrame];
+          glm::vec2 offset = point - glm::vec2(clipTrajectory.bodyCOM[bvhFrame].x, clipTrajectory.bodyCOM[bvhFrame].z);
+          ImGui::InputFloat2("ZMP X Z", &point[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+          ImGui::InputFloat2("ZMP - COM X Z", &offset[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+        }
+        else
+        {
+          ImGui::Text("Airborne, no ZMP");
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Postural Sway"))
+      {
+        static const char* swayAxisNames[] = { "X", "Z", "Both" };
+        static int swayAxis = SwayResultant;
+        static float swayMaxFrequency = 5.0f;
+        int segmentLength = (int)swaySettings.segmentLength;
+
+        swayChanged |= ImGui::InputFloat("Start Time (s)", &swaySettings.startTime);
+        swayChanged |= ImGui::InputFloat("End Time (s)", &swaySettings.endTime);
+        swayChanged |= ImGui::SliderFloat("Ellipse Confidence", &swaySettings.confidence, 0.5f, 0.99f);
+        if (ImGui::InputInt("Welch Segment", &segmentLength) && segmentLength >= 4)
+        {
+          swaySettings.segmentLength = (unsigned int)segmentLength;
+          swayChanged = true;
+        }
+
+        ImGui::Text("Frames: %u (%.2f s)", sway.numFrames, sway.duration);
+        ImGui::Text("Path Length: %.3f", sway.pathLength);
+        ImGui::Text("Mean Velocity: %.3f /s", sway.meanVelocity);
+        ImGui::Text("RMS X Z: %.3f %.3f", sway.rms[SwayX], sway.rms[SwayZ]);
+        ImGui::Text("Range X Z: %.3f %.3f", sway.range[SwayX], sway.range[SwayZ]);
+        ImGui::Text("Ellipse Area: %.3f (%.3f x %.3f)", sway.ellipseArea, sway.ellipseAxes[0], sway.ellipseAxes[1]);
+        ImGui::Text("Median Frequency X Z Both: %.3f %.3f %.3f Hz", sway.medianFrequency[SwayX], sway.medianFrequency[SwayZ], sway.medianFrequency[SwayResultant]);
+        ImGui::Text("Mean Frequency X Z Both: %.3f %.3f %.3f Hz", sway.meanFrequency[SwayX], sway.meanFrequency[SwayZ], sway.meanFrequency[SwayResultant]);
+
+        ImGui::Combo("Spectrum Axis", &swayAxis, swayAxisNames, 3);
+        ImGui::SliderFloat("Max Frequency (Hz)", &swayMaxFrequency, 0.5f, 50.0f);
+        const std::vector<float>& power = sway.power[swayAxis];
+        if (power.size() > 1 && sway.frequencyStep > 0.0f)
+        {
+          int bins = (int)(swayMaxFrequency / sway.frequencyStep) + 1;
+          if (bins > (int)power.size() - 1)
+            bins = (int)power.size() - 1;
+          // DC is the removed mean
+          ImGui::PlotHistogram("Power Spectrum", &power[1], bins, 0, "", 0.0f, FLT_MAX, ImVec2(0, 100));
+        }
+      }
+
+      if (ImGui::CollapsingHeader("COM Uncertainty"))
+      {
+        static const char* sweepSexNames[] = { "Male", "Female", "Both" };
+
+        ImGui::InputInt("Parameter Sets", &sweepSettings.numSets);
+        ImGui::Combo("Sweep Model", &sweepSettings.model, anthropometricModelNames, CustomModel);
+        ImGui::Combo("Sweep Sex", &sweepSettings.sex, sweepSexNames, 3);
+        ImGui::SliderFloat("Mass Perturbation %", &sweepSettings.massPerturbation, 0.0f, 50.0f);
+        ImGui::SliderFloat("Length Perturbation %", &sweepSettings.lengthPerturbation, 0.0f, 50.0f);
+        ImGui::SliderFloat("Confidence %", &sweepSettings.confidence, 50.0f, 99.9f);
+        ImGui::InputInt("Seed", (int*)&sweepSettings.seed);
+
+        if (ImGui::Button("Run Sweep"))
+        {
+          Timer timer;
+          timer.Start();
+          std::vector<BodyParameters> parameterSets;
+          generateParameterSets(sweepSettings, parameterSets);
+          sweepCOM(clipTrajectory, parameterSets, sweepSettings.confidence, comSweep);
+          timer.Stop();
+          comSweepTime = timer.GetMilisecondsElapsed();
+        }
+
+        if (comSweep.mean.size() == clipTrajectory.numFrames && !comSweep.mean.empty())
+        {
+          ImGui::SameLine();
+          ImGui::Text("%.1f ms", comSweepTime);
+
+          glm::vec3 standardDeviation = comSweep.standardDeviation[bvhFrame];
+          ImGui::InputFloat3("COM SD", &standardDeviation[0], "%.3f", ImGuiInputTextFlags_ReadOnly);
+          plotBand("Body COM X Band", comSweep, 0, graphFrames);
+          plotBand("Body COM Y Band", comSweep, 1, graphFrames);
+          plotBand("Body COM Z Band", comSweep, 2, graphFrames);
+        }
+      }
+
+      if (ImGui::CollapsingHeader("Gait"))
+      {
+        static const char* footNames[] = { "Left", "Right" };
+        static int gaitFoot = 0;
+        static int gaitJoint = LeftAnkleJoint;
+
+        gaitChanged |= ImGui::SliderFloat("Contact Height Fraction", &gaitSettings.heightFraction, 0.01f, 0.5f);
+        gaitChanged |= ImGui::SliderFloat("Contact Speed Fraction", &gaitSettings.speedFraction, 0.01f, 0.5f);
+        gaitChanged |= ImGui::SliderInt("Min Phase Frames", &gaitSettings.minPhaseFrames, 1, 20);
+        gaitChanged |= ImGui::DragFloatRange2("Stride Time", &gaitSettings.minStrideTime, &gaitSettings.maxStrideTime, 0.01f, 0.1f, 5.0f, "%.2f s");
+
+        for (int foot = 0; foot < 2; foot++)
+        {
+          ImGui::Text("%s heel strikes:", footNames[foot]);
+          for (unsigned int frame : gaitEvents.heelStrikes[foot])
+          {
+            ImGui::SameLine();
+            ImGui::Text("%u", frame);
+          }
+          ImGui::Text("%s toe offs:", footNames[foot]);
+          for (unsigned int frame : gaitEvents.toeOffs[foot])
+          {
+            ImGui::SameLine();
+            ImGui::Text("%u", frame);
+          }
+        }
+
+        ImGui::Combo("Stride Foot", &gaitFoot, footNames, 2);
+        const GaitCycles& cycles = gaitCycles[gaitFoot];
+        ImGui::Text("Strides: %u", cycles.numCycles);
+        if (cycles.numCycles > 0)
+        {
+          plotGaitChannel("Cycle COM X", cycles, 0);
+          plotGaitChannel("Cycle COM Y", cycles, 1);
+          plotGaitChannel("Cycle COM Z", cycles, 2);
+
+          ImGui::SliderInt("Cycle Joint", &gaitJoint, 0, (int)clipTrajectory.numJoints - 1);
+          plotGaitChannel("Cycle Joint X", cycles, 3 + 3 * gaitJoint + 0);
+          plotGaitChannel("Cycle Joint Y", cycles, 3 + 3 * gaitJoint + 1);
+          plotGaitChannel("Cycle Joint Z", cycles, 3 + 3 * gaitJoint + 2);
+        }
+      }
+
       if (ImGui::CollapsingHeader("Head & Neck COM"))
       {
         headNeckGraph[0][bvhFrame] = segmentsCogVertices[0].x;
@@ -1055,6 +3008,10 @@ int main(int argc, char* argv[])
     }
     lastTimeFrame += 1.0 / FPS; 
   }
+  stopCatalogIndexer(catalogIndexer);
+  closeCatalog(clipCatalog);
+  closeC3D(markerTrial);
+  closePoseShare(poseShare);
   glfwTerminate();
   return 0;
 }